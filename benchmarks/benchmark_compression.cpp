@@ -0,0 +1,84 @@
+#include <hawktracer/compression.h>
+#include <hawktracer/core_events.h>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+// A serialized stream of 16MB of events with timestamps growing at an irregular
+// pace and identifiers from a limited set, like a real trace of scoped tracepoints.
+static std::vector<HT_Byte> create_event_stream()
+{
+    std::vector<HT_Byte> stream(16 * 1024 * 1024);
+    std::mt19937 generator(42);
+    HT_DECL_EVENT(HT_CallstackIntEvent, event);
+    size_t event_size = HT_EVENT_GET_KLASS(&event)->get_size(HT_EVENT(&event));
+
+    event.base.base.timestamp = 1000000000ull;
+    event.base.thread_id = 1;
+    for (size_t offset = 0; offset + event_size <= stream.size(); offset += event_size)
+    {
+        event.base.base.timestamp += 20 + generator() % 1000;
+        event.base.base.id++;
+        event.base.duration = 10 + generator() % 5000;
+        event.label = generator() % 64;
+        HT_EVENT_GET_KLASS(&event)->serialize(HT_EVENT(&event), stream.data() + offset);
+    }
+
+    return stream;
+}
+
+static void BenchmarkCompressionCompress(benchmark::State& state)
+{
+    std::vector<HT_Byte> stream = create_event_stream();
+    size_t block_size = state.range(0);
+    std::vector<HT_Byte> compressed(ht_compression_get_max_compressed_size(block_size));
+    std::vector<uint32_t> work_memory(HT_COMPRESSION_WORK_MEMORY_SIZE / sizeof(uint32_t));
+    size_t compressed_size = 0;
+
+    for (auto _ : state)
+    {
+        compressed_size = 0;
+        for (size_t offset = 0; offset < stream.size(); offset += block_size)
+        {
+            compressed_size += ht_compression_compress(stream.data() + offset, block_size,
+                                                       compressed.data(), compressed.size(), work_memory.data());
+        }
+        benchmark::DoNotOptimize(compressed_size);
+    }
+
+    state.SetBytesProcessed(state.iterations() * stream.size());
+    state.counters["ratio"] = (double)stream.size() / compressed_size;
+}
+// Passing the size of the compressed block (i.e. the listener's buffer) as the first argument
+BENCHMARK(BenchmarkCompressionCompress)->Arg(4096)->Arg(65536)->Arg(1024 * 1024);
+
+static void BenchmarkCompressionDecompress(benchmark::State& state)
+{
+    std::vector<HT_Byte> stream = create_event_stream();
+    size_t block_size = state.range(0);
+    std::vector<std::vector<HT_Byte>> blocks;
+    std::vector<uint32_t> work_memory(HT_COMPRESSION_WORK_MEMORY_SIZE / sizeof(uint32_t));
+    std::vector<HT_Byte> decompressed(block_size);
+
+    for (size_t offset = 0; offset < stream.size(); offset += block_size)
+    {
+        std::vector<HT_Byte> block(ht_compression_get_max_compressed_size(block_size));
+        block.resize(ht_compression_compress(stream.data() + offset, block_size,
+                                             block.data(), block.size(), work_memory.data()));
+        blocks.push_back(std::move(block));
+    }
+
+    for (auto _ : state)
+    {
+        for (const auto& block : blocks)
+        {
+            benchmark::DoNotOptimize(ht_compression_decompress(block.data(), block.size(), decompressed.data(), block_size));
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+// Passing the size of the compressed block (i.e. the listener's buffer) as the first argument
+BENCHMARK(BenchmarkCompressionDecompress)->Arg(4096)->Arg(65536)->Arg(1024 * 1024);
@@ -0,0 +1,99 @@
+#include <hawktracer/core_events.h>
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#define HT_CORE_EVENT_TYPES(X) \
+    X(HT_Event) \
+    X(HT_EndiannessInfoEvent) \
+    X(HT_EventKlassInfoEvent) \
+    X(HT_EventKlassFieldInfoEvent) \
+    X(HT_CallstackBaseEvent) \
+    X(HT_CallstackIntEvent) \
+    X(HT_CallstackStringEvent) \
+    X(HT_StringMappingEvent) \
+    X(HT_SystemInfoEvent) \
+    X(HT_ClockCalibrationEvent) \
+    X(HT_CallstackOverflowEvent) \
+    X(HT_CallstackFilteredEvent) \
+    X(HT_CallstackSummaryEvent) \
+    X(HT_CallstackSummaryHistogramEvent) \
+    X(HT_CompactBlockEvent)
+
+#define HT_DEFINE_GET_EVENT_KLASS(EVENT_TYPE) \
+    static HT_EventKlass* get_event_klass(EVENT_TYPE*) { return HT_EVENT_KLASS_GET(EVENT_TYPE); }
+HT_CORE_EVENT_TYPES(HT_DEFINE_GET_EVENT_KLASS)
+
+template<typename T>
+static void init_event_fields(T*)
+{
+}
+
+static void init_event_fields(HT_EventKlassInfoEvent* event)
+{
+    event->event_klass_name = "HT_CallstackIntEvent";
+}
+
+static void init_event_fields(HT_EventKlassFieldInfoEvent* event)
+{
+    event->field_type = "HT_CallstackEventLabel";
+    event->field_name = "label";
+}
+
+static void init_event_fields(HT_CallstackStringEvent* event)
+{
+    event->label = "BenchmarkEventSerialize";
+}
+
+static void init_event_fields(HT_StringMappingEvent* event)
+{
+    event->label = "BenchmarkEventSerialize";
+}
+
+template<typename T>
+static T create_event()
+{
+    T event = {};
+    HT_EVENT(&event)->klass = get_event_klass(&event);
+    HT_EVENT(&event)->timestamp = 123456789;
+    HT_EVENT(&event)->id = 42;
+    init_event_fields(&event);
+    return event;
+}
+
+template<typename T>
+static void BenchmarkEventGetSizeAndSerialize(benchmark::State& state)
+{
+    T event = create_event<T>();
+    HT_EventKlass* klass = HT_EVENT_GET_KLASS(&event);
+    std::vector<HT_Byte> buffer(1024);
+
+    for (auto _ : state)
+    {
+        size_t size = klass->get_size(HT_EVENT(&event));
+        benchmark::DoNotOptimize(size);
+        klass->serialize(HT_EVENT(&event), buffer.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+template<typename T>
+static void BenchmarkEventTrySerialize(benchmark::State& state)
+{
+    T event = create_event<T>();
+    HT_EventKlass* klass = HT_EVENT_GET_KLASS(&event);
+    std::vector<HT_Byte> buffer(1024);
+
+    for (auto _ : state)
+    {
+        size_t size = klass->try_serialize(HT_EVENT(&event), buffer.data(), buffer.size());
+        benchmark::DoNotOptimize(size);
+        benchmark::ClobberMemory();
+    }
+}
+
+#define HT_REGISTER_EVENT_BENCHMARKS(EVENT_TYPE) \
+    BENCHMARK_TEMPLATE(BenchmarkEventGetSizeAndSerialize, EVENT_TYPE); \
+    BENCHMARK_TEMPLATE(BenchmarkEventTrySerialize, EVENT_TYPE);
+HT_CORE_EVENT_TYPES(HT_REGISTER_EVENT_BENCHMARKS)
@@ -121,3 +121,69 @@ static void FeatureCachedStringAddMappingDynamic(benchmark::State& state)
 }
 BENCHMARK(FeatureCachedStringAddMappingDynamic);
 
+// Mapping labels which are already in the map from many threads; lookups
+// don't take the feature's lock, so the threads should scale.
+static const char* shared_labels[] = {"label_a", "label_b", "label_c", "label_d"};
+
+static HT_Timeline* get_shared_timeline()
+{
+    // shared by all the benchmark threads, and never destroyed
+    static HT_Timeline* timeline = [] {
+        HT_Timeline* t = ht_timeline_create(1024, HT_TRUE, HT_TRUE, NULL, NULL);
+        ht_feature_cached_string_enable(t, HT_TRUE);
+        for (const char* label : shared_labels)
+        {
+            ht_feature_cached_string_add_mapping_dynamic(t, label);
+        }
+        return t;
+    }();
+    return timeline;
+}
+
+static void FeatureCachedStringAddMappingDynamicThreadSafe(benchmark::State& state)
+{
+    HT_Timeline* timeline = get_shared_timeline();
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        ht_feature_cached_string_add_mapping_dynamic(timeline, shared_labels[i++ & 3]);
+    }
+}
+BENCHMARK(FeatureCachedStringAddMappingDynamicThreadSafe)->Threads(1)->Threads(4)->UseRealTime();
+
+
+#include <hawktracer/feature_callstack.h>
+#include <hawktracer/string_scoped_tracepoint.h>
+
+static void FeatureCachedStringStaticTracepoint(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    ht_feature_callstack_enable(timeline);
+
+    for (auto _ : state)
+    {
+        HT_TP_STRACEPOINT(timeline, "static_label")
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(FeatureCachedStringStaticTracepoint);
+
+#ifdef HT_TP_CONSTEXPR_STRACEPOINT
+static void FeatureCachedStringConstexprTracepoint(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    ht_feature_callstack_enable(timeline);
+
+    for (auto _ : state)
+    {
+        HT_TP_CONSTEXPR_STRACEPOINT(timeline, "constexpr_label")
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(FeatureCachedStringConstexprTracepoint);
+#endif
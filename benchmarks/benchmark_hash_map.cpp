@@ -2,6 +2,9 @@
 
 #include <benchmark/benchmark.h>
 
+#include <unordered_map>
+#include <vector>
+
 inline uint64_t randomize_integer(uint64_t x)
 {
     x = ((x >> 16) ^ x) * 0x45d9f3b;
@@ -39,7 +42,6 @@ static void HashMapInsertElements(benchmark::State& state)
 }
 BENCHMARK(HashMapInsertElements)->Range(1, 1<<15);
 
-#include <unordered_map>
 static void HashMapInsertElementsCpp(benchmark::State& state)
 {
     std::unordered_map<uint64_t, const char*> map;
@@ -93,3 +95,103 @@ BENCHMARK(HashMapGetValueCpp)
     ->Args({1<<12, 0})
     ->Args({1<<12, (1<<12)/2})
     ->Args({1<<12, (1<<12)-1});
+
+static std::vector<uint64_t> make_random_keys(size_t count)
+{
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = randomize_integer(i);
+    }
+    return keys;
+}
+
+// Builds a new map in every iteration, so the time includes all the resizes.
+static void HashMapInsertNewElements(benchmark::State& state)
+{
+    std::vector<uint64_t> keys = make_random_keys(state.range(0));
+
+    for (auto _ : state)
+    {
+        HT_HashMap map;
+        ht_hash_map_init(&map);
+        for (uint64_t key : keys)
+        {
+            ht_hash_map_insert(&map, key, "test", NULL);
+        }
+        ht_hash_map_deinit(&map);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+// Passing the number of keys as the first argument
+BENCHMARK(HashMapInsertNewElements)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+static void HashMapInsertNewElementsCpp(benchmark::State& state)
+{
+    std::vector<uint64_t> keys = make_random_keys(state.range(0));
+
+    for (auto _ : state)
+    {
+        std::unordered_map<uint64_t, const char*> map;
+        for (uint64_t key : keys)
+        {
+            map[key] = "test";
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(HashMapInsertNewElementsCpp)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+// Looks up all the keys in the map, in a random order.
+static void HashMapGetExistingValues(benchmark::State& state)
+{
+    std::vector<uint64_t> keys = make_random_keys(state.range(0));
+    HT_HashMap map;
+    ht_hash_map_init(&map);
+    for (uint64_t key : keys)
+    {
+        ht_hash_map_insert(&map, key, "test", NULL);
+    }
+    std::vector<uint64_t> lookups = make_random_keys(state.range(0) * 2);
+    for (auto& key : lookups)
+    {
+        key = keys[key % keys.size()];
+    }
+
+    for (auto _ : state)
+    {
+        for (uint64_t key : lookups)
+        {
+            benchmark::DoNotOptimize(ht_hash_map_get_value(&map, key));
+        }
+    }
+    ht_hash_map_deinit(&map);
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+// Passing the number of keys as the first argument
+BENCHMARK(HashMapGetExistingValues)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+static void HashMapGetExistingValuesCpp(benchmark::State& state)
+{
+    std::vector<uint64_t> keys = make_random_keys(state.range(0));
+    std::unordered_map<uint64_t, const char*> map;
+    for (uint64_t key : keys)
+    {
+        map[key] = "test";
+    }
+    std::vector<uint64_t> lookups = make_random_keys(state.range(0) * 2);
+    for (auto& key : lookups)
+    {
+        key = keys[key % keys.size()];
+    }
+
+    for (auto _ : state)
+    {
+        for (uint64_t key : lookups)
+        {
+            benchmark::DoNotOptimize(map.find(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+BENCHMARK(HashMapGetExistingValuesCpp)->Arg(1000)->Arg(100000)->Arg(1000000);
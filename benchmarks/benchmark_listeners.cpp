@@ -0,0 +1,167 @@
+#include <hawktracer/listeners/file_dump_listener.h>
+#include <hawktracer/listeners/flight_recorder_listener.h>
+#include <hawktracer/listeners/mmap_file_dump_listener.h>
+#include <hawktracer/core_events.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static void BenchmarkFlightRecorderListenerPushBaseEvent(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(state.range(0), HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_flight_recorder_listener_register(timeline, 1024 * 1024, NULL);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_init_event(timeline, &event);
+    for (auto _ : state)
+    {
+        ht_timeline_push_event(timeline, &event);
+    }
+
+    state.SetBytesProcessed(state.iterations() * HT_EVENT_GET_KLASS(&event)->get_size(&event));
+
+    ht_timeline_destroy(timeline);
+}
+// Passing the capacity of the timeline's buffer as the first argument
+BENCHMARK(BenchmarkFlightRecorderListenerPushBaseEvent)->Arg(1024)->Arg(65536);
+
+static const char* benchmark_file = "benchmark_listener_file.htdump";
+
+// Every iteration writes 16MB of serialized events, delivered in 4KB chunks
+// (as if they came from a timeline with a 4KB buffer), and closes the file.
+static const size_t chunk_size = 4096;
+static const size_t chunk_count = 4096;
+
+static std::vector<HT_Byte> create_serialized_chunk()
+{
+    std::vector<HT_Byte> chunk(chunk_size);
+    HT_DECL_EVENT(HT_Event, event);
+    size_t event_size = HT_EVENT_GET_KLASS(&event)->get_size(&event);
+
+    for (size_t offset = 0; offset + event_size <= chunk.size(); offset += event_size)
+    {
+        event.id = offset;
+        HT_EVENT_GET_KLASS(&event)->serialize(&event, chunk.data() + offset);
+    }
+
+    return chunk;
+}
+
+static void BenchmarkFileDumpListenerThroughput(benchmark::State& state)
+{
+    std::vector<HT_Byte> chunk = create_serialized_chunk();
+
+    for (auto _ : state)
+    {
+        HT_FileDumpListener* listener = ht_file_dump_listener_create(benchmark_file, state.range(0), NULL);
+        for (size_t i = 0; i < chunk_count; i++)
+        {
+            ht_file_dump_listener_callback(chunk.data(), chunk.size(), HT_TRUE, listener);
+        }
+        ht_file_dump_listener_destroy(listener);
+    }
+
+    state.SetBytesProcessed(state.iterations() * chunk_size * chunk_count);
+    std::remove(benchmark_file);
+}
+// Passing the size of the listener's buffer as the first argument
+BENCHMARK(BenchmarkFileDumpListenerThroughput)->Arg(4096)->Arg(65536)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+
+static void BenchmarkMmapFileDumpListenerThroughput(benchmark::State& state)
+{
+    std::vector<HT_Byte> chunk = create_serialized_chunk();
+
+    for (auto _ : state)
+    {
+        HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_create(benchmark_file, state.range(0), NULL);
+        for (size_t i = 0; i < chunk_count; i++)
+        {
+            ht_mmap_file_dump_listener_callback(chunk.data(), chunk.size(), HT_TRUE, listener);
+        }
+        ht_mmap_file_dump_listener_destroy(listener);
+    }
+
+    state.SetBytesProcessed(state.iterations() * chunk_size * chunk_count);
+    std::remove(benchmark_file);
+}
+// Passing the extent size as the first argument
+BENCHMARK(BenchmarkMmapFileDumpListenerThroughput)->Arg(4096)->Arg(65536)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+
+static size_t get_file_size(const char* filename)
+{
+    size_t size = 0;
+    FILE* fp = std::fopen(filename, "rb");
+    if (fp)
+    {
+        std::fseek(fp, 0, SEEK_END);
+        size = std::ftell(fp);
+        std::fclose(fp);
+    }
+    return size;
+}
+
+// Unlike the chunk above, the stream doesn't repeat itself, so it doesn't
+// compress unrealistically well: timestamps grow at an irregular pace,
+// and durations and labels are random.
+static std::vector<HT_Byte> create_serialized_callstack_stream()
+{
+    std::vector<HT_Byte> stream(chunk_size * chunk_count);
+    std::mt19937 generator(42);
+    HT_DECL_EVENT(HT_CallstackIntEvent, event);
+    size_t event_size = HT_EVENT_GET_KLASS(&event)->get_size(HT_EVENT(&event));
+
+    for (size_t offset = 0; offset + event_size <= stream.size(); offset += event_size)
+    {
+        event.base.base.timestamp += 20 + generator() % 1000;
+        event.base.base.id++;
+        event.base.duration = 10 + generator() % 5000;
+        event.label = generator() % 64;
+        HT_EVENT_GET_KLASS(&event)->serialize(HT_EVENT(&event), stream.data() + offset);
+    }
+
+    return stream;
+}
+
+// Compares the CPU cost and the number of bytes written with and without compression
+static void BenchmarkFileDumpListenerCompression(benchmark::State& state)
+{
+    std::vector<HT_Byte> stream = create_serialized_callstack_stream();
+    HT_Boolean compress = state.range(1) ? HT_TRUE : HT_FALSE;
+
+    for (auto _ : state)
+    {
+        HT_FileDumpListener* listener = ht_file_dump_listener_create_full(
+                    benchmark_file, state.range(0), NULL, NULL, compress, NULL);
+        for (size_t offset = 0; offset < stream.size(); offset += chunk_size)
+        {
+            ht_file_dump_listener_callback(stream.data() + offset, chunk_size, HT_TRUE, listener);
+        }
+        ht_file_dump_listener_destroy(listener);
+    }
+
+    state.SetBytesProcessed(state.iterations() * chunk_size * chunk_count);
+    state.counters["written"] = get_file_size(benchmark_file);
+    std::remove(benchmark_file);
+}
+// Passing the size of the listener's buffer and compression flag as arguments
+BENCHMARK(BenchmarkFileDumpListenerCompression)
+    ->Args({65536, 0})->Args({65536, 1})->Args({1024 * 1024, 0})->Args({1024 * 1024, 1});
+
+// Measures the cost of sending the metadata to a newly attached listener
+// (e.g. a new TCP client), which happens while the registry is locked.
+static void BenchmarkTimelineListenerPushMetadata(benchmark::State& state)
+{
+    size_t total_size = 0;
+    auto callback = [](TEventPtr, size_t, HT_Boolean, void*) {};
+
+    for (auto _ : state)
+    {
+        total_size += ht_timeline_listener_push_metadata(callback, NULL, HT_TRUE);
+    }
+
+    state.SetBytesProcessed(total_size);
+}
+BENCHMARK(BenchmarkTimelineListenerPushMetadata);
@@ -0,0 +1,211 @@
+#include <hawktracer/listeners/shm_listener.h>
+#include <hawktracer/listeners/tcp_listener.h>
+
+#include <benchmark/benchmark.h>
+
+#ifdef __unix__
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compares end-to-end throughput of the listeners which send data to a client
+// running on the same host. Every iteration pushes 16MB in 4KB chunks and waits
+// until the client has received all of it.
+static const size_t transport_chunk_size = 4096;
+static const size_t transport_chunk_count = 4096;
+static const char* benchmark_socket_path = "benchmark_local_transports.sock";
+static const char* benchmark_shm_name = "benchmark_local_transports";
+
+static void wait_for_metadata(int fd)
+{
+    char buffer[4096];
+    struct pollfd pfd = {fd, POLLIN, 0};
+    bool received = false;
+
+    while (poll(&pfd, 1, received ? 100 : 5000) > 0 && recv(fd, buffer, sizeof(buffer), 0) > 0)
+    {
+        received = true;
+    }
+}
+
+static void run_socket_benchmark(benchmark::State& state, HT_TCPListener* listener, int client_fd)
+{
+    std::vector<HT_Byte> chunk(transport_chunk_size, 1);
+    std::atomic<size_t> received(0);
+    std::atomic<bool> running(true);
+
+    // the client must get all the data
+    ht_tcp_listener_set_slow_client_policy(listener, HT_TCP_LISTENER_DEFAULT_CLIENT_QUEUE_SIZE, HT_TCP_LISTENER_SLOW_CLIENT_BLOCK);
+    wait_for_metadata(client_fd);
+
+    std::thread consumer([&] {
+        std::vector<char> buffer(64 * 1024);
+        ssize_t size;
+        while (running && (size = recv(client_fd, buffer.data(), buffer.size(), 0)) > 0)
+        {
+            received += size;
+        }
+    });
+
+    size_t expected = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < transport_chunk_count; i++)
+        {
+            ht_tcp_listener_callback(chunk.data(), chunk.size(), HT_TRUE, listener);
+        }
+        expected += transport_chunk_size * transport_chunk_count;
+        while (received < expected)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    running = false;
+    ht_tcp_listener_destroy(listener);
+    consumer.join();
+    close(client_fd);
+
+    state.SetBytesProcessed(state.iterations() * transport_chunk_size * transport_chunk_count);
+}
+
+static void BenchmarkTcpListenerTransport(benchmark::State& state)
+{
+    const int port = 8781;
+    HT_TCPListener* listener = ht_tcp_listener_create(port, transport_chunk_size, NULL);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (listener == NULL || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        state.SkipWithError("Can't connect to the listener");
+        ht_tcp_listener_destroy(listener);
+        close(fd);
+        return;
+    }
+
+    run_socket_benchmark(state, listener, fd);
+}
+BENCHMARK(BenchmarkTcpListenerTransport)->UseRealTime();
+
+static void BenchmarkUnixSocketListenerTransport(benchmark::State& state)
+{
+    HT_TCPListener* listener = ht_tcp_listener_create_unix_socket(benchmark_socket_path, transport_chunk_size, HT_FALSE, NULL);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, benchmark_socket_path);
+    if (listener == NULL || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        state.SkipWithError("Can't connect to the listener");
+        ht_tcp_listener_destroy(listener);
+        close(fd);
+        return;
+    }
+
+    run_socket_benchmark(state, listener, fd);
+}
+BENCHMARK(BenchmarkUnixSocketListenerTransport)->UseRealTime();
+
+static void BenchmarkShmListenerTransport(benchmark::State& state)
+{
+    std::vector<HT_Byte> chunk(transport_chunk_size, 1);
+    HT_ShmListener* listener = ht_shm_listener_create(benchmark_shm_name, state.range(0), NULL);
+    int fd = shm_open((std::string("/") + benchmark_shm_name).c_str(), O_RDWR, 0);
+    struct stat st;
+    if (listener == NULL || fd < 0 || fstat(fd, &st) != 0)
+    {
+        state.SkipWithError("Can't open the shared memory segment");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        ht_shm_listener_destroy(listener);
+        return;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    HT_ShmListenerHeader* header = (HT_ShmListenerHeader*)map;
+    const char* data = (const char*)map + header->data_offset;
+    std::atomic<size_t> received(0);
+    std::atomic<bool> running(true);
+
+    // a consumer which works like the ShmClientStream from client_utils
+    std::thread consumer([&] {
+        std::vector<char> buffer(64 * 1024);
+        uint64_t read_position = __atomic_load_n(&header->read_position, __ATOMIC_ACQUIRE);
+        while (running)
+        {
+            uint64_t available = __atomic_load_n(&header->write_position, __ATOMIC_ACQUIRE) - read_position;
+            if (available == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t size = std::min<size_t>(available, buffer.size());
+            size_t offset = read_position % header->capacity;
+            size_t first_part = std::min<size_t>(size, header->capacity - offset);
+            memcpy(buffer.data(), data + offset, first_part);
+            memcpy(buffer.data() + first_part, data, size - first_part);
+            read_position += size;
+            __atomic_store_n(&header->read_position, read_position, __ATOMIC_RELEASE);
+            received += size;
+        }
+    });
+
+    size_t expected = __atomic_load_n(&header->write_position, __ATOMIC_ACQUIRE);
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < transport_chunk_count;)
+        {
+            size_t dropped_size = ht_shm_listener_get_dropped_size(listener);
+            ht_shm_listener_callback(chunk.data(), chunk.size(), HT_TRUE, listener);
+            if (ht_shm_listener_get_dropped_size(listener) == dropped_size)
+            {
+                i++;
+            }
+            else
+            {
+                // the ring is full, let the consumer run
+                std::this_thread::yield();
+            }
+        }
+        expected += transport_chunk_size * transport_chunk_count;
+        while (received < expected)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    running = false;
+    consumer.join();
+    munmap(map, (size_t)st.st_size);
+    ht_shm_listener_destroy(listener);
+
+    state.SetBytesProcessed(state.iterations() * transport_chunk_size * transport_chunk_count);
+}
+// Passing the size of the ring as the first argument
+BENCHMARK(BenchmarkShmListenerTransport)->Arg(256 * 1024)->Arg(4 * 1024 * 1024)->UseRealTime();
+
+#endif /* __unix__ */
@@ -0,0 +1,38 @@
+#include <hawktracer/monotonic_clock.h>
+#include <internal/monotonic_clock.h>
+
+#include <benchmark/benchmark.h>
+
+static void BenchmarkMonotonicClockGetTimestamp(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ht_monotonic_clock_get_timestamp());
+    }
+}
+BENCHMARK(BenchmarkMonotonicClockGetTimestamp);
+
+static void BenchmarkMonotonicClockGetSystemTimestamp(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ht_monotonic_clock_get_system_timestamp());
+    }
+}
+BENCHMARK(BenchmarkMonotonicClockGetSystemTimestamp);
+
+#ifdef HT_MONOTONIC_CLOCK_TSC_SUPPORTED
+static void BenchmarkMonotonicClockGetTscTimestamp(benchmark::State& state)
+{
+    if (ht_monotonic_clock_get_tsc_calibration() == NULL && !ht_monotonic_clock_calibrate_tsc())
+    {
+        state.SkipWithError("Invariant time stamp counter is not available");
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ht_monotonic_clock_get_tsc_timestamp());
+    }
+}
+BENCHMARK(BenchmarkMonotonicClockGetTscTimestamp);
+#endif
@@ -1,4 +1,5 @@
 #include <hawktracer/timeline.h>
+#include <hawktracer/core_events.h>
 
 #include <benchmark/benchmark.h>
 
@@ -71,3 +72,338 @@ static void BenchmarkTimelineFlushNoListener(benchmark::State& state)
     ht_timeline_destroy(timeline);
 }
 BENCHMARK(BenchmarkTimelineFlushNoListener);
+
+static void BenchmarkTimelinePushCallstackIntEvent(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, (HT_Boolean)state.range(0), NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        HT_TIMELINE_PUSH_EVENT_PEDANTIC(timeline, HT_CallstackIntEvent, {ht_base_event, 10, 1}, label++);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+// Passing the serialize_events flag as the first argument
+BENCHMARK(BenchmarkTimelinePushCallstackIntEvent)->Arg(0)->Arg(1);
+
+static void BenchmarkTimelinePushCallstackIntEventInPlace(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, (HT_Boolean)state.range(0), NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, HT_CallstackIntEvent, ({ht_base_event, 10, 1}), label++);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+// Passing the serialize_events flag as the first argument
+BENCHMARK(BenchmarkTimelinePushCallstackIntEventInPlace)->Arg(0)->Arg(1);
+
+static const size_t benchmark_batch_size = 64;
+
+static void BenchmarkTimelinePushCallstackIntEventBatch(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(4096, HT_TRUE, (HT_Boolean)state.range(0), NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+
+    HT_CallstackIntEvent events[benchmark_batch_size];
+    for (size_t i = 0; i < benchmark_batch_size; i++)
+    {
+        HT_DECL_EVENT(HT_CallstackIntEvent, event);
+        ht_timeline_init_event(timeline, HT_EVENT(&event));
+        event.label = i;
+        events[i] = event;
+    }
+
+    for (auto _ : state)
+    {
+        if (state.range(1))
+        {
+            ht_timeline_push_events(timeline, HT_EVENT_KLASS_GET(HT_CallstackIntEvent), HT_EVENT(events), benchmark_batch_size);
+        }
+        else
+        {
+            for (size_t i = 0; i < benchmark_batch_size; i++)
+            {
+                ht_timeline_push_event(timeline, HT_EVENT(&events[i]));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * benchmark_batch_size);
+
+    ht_timeline_destroy(timeline);
+}
+// Passing the serialize_events flag as the first argument, and 1 as the second argument
+// if events are pushed with ht_timeline_push_events() (or one by one otherwise).
+BENCHMARK(BenchmarkTimelinePushCallstackIntEventBatch)->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1});
+
+static void BenchmarkTimelinePushCallstackIntEventColumns(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(4096, HT_TRUE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+
+    HT_DECL_EVENT(HT_CallstackIntEvent, prototype);
+    ht_timeline_init_event(timeline, HT_EVENT(&prototype));
+    HT_CallstackEventLabel labels[benchmark_batch_size];
+    for (size_t i = 0; i < benchmark_batch_size; i++)
+    {
+        labels[i] = i;
+    }
+    const void* columns[] = {labels};
+
+    for (auto _ : state)
+    {
+        if (state.range(0))
+        {
+            ht_timeline_push_event_columns(timeline, HT_EVENT(&prototype), columns, benchmark_batch_size);
+        }
+        else
+        {
+            for (size_t i = 0; i < benchmark_batch_size; i++)
+            {
+                HT_TIMELINE_PUSH_EVENT_PEDANTIC(timeline, HT_CallstackIntEvent, {ht_base_event, 0, 0}, labels[i]);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * benchmark_batch_size);
+
+    ht_timeline_destroy(timeline);
+}
+// Passing 1 as the first argument if events are pushed with ht_timeline_push_event_columns()
+// (or created and pushed one by one otherwise).
+BENCHMARK(BenchmarkTimelinePushCallstackIntEventColumns)->Arg(0)->Arg(1);
+
+// All the benchmark threads push to the same timeline, so the timeline is created
+// once and shared between benchmark runs.
+template<HT_TimelineThreadSafety ThreadSafety>
+static HT_Timeline* get_shared_timeline()
+{
+    struct SharedTimeline
+    {
+        SharedTimeline()
+        {
+            timeline = ht_timeline_create_full(1024, ThreadSafety, HT_TRUE, NULL, NULL);
+            ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+        }
+
+        ~SharedTimeline()
+        {
+            ht_timeline_destroy(timeline);
+        }
+
+        HT_Timeline* timeline;
+    };
+
+    static SharedTimeline shared_timeline;
+
+    return shared_timeline.timeline;
+}
+
+template<HT_TimelineThreadSafety ThreadSafety>
+static void BenchmarkTimelinePushBaseEventMultipleThreads(benchmark::State& state)
+{
+    HT_Timeline* timeline = get_shared_timeline<ThreadSafety>();
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_init_event(timeline, &event);
+    for (auto _ : state)
+    {
+        ht_timeline_push_event(timeline, &event);
+    }
+}
+BENCHMARK_TEMPLATE(BenchmarkTimelinePushBaseEventMultipleThreads, HT_TIMELINE_THREAD_SAFETY_LOCK)
+    ->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BenchmarkTimelinePushBaseEventMultipleThreads, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    ->ThreadRange(1, 32)->UseRealTime();
+
+// Every thread sets the block size of the default ID provider (used by all the timelines);
+// the shared counter variant is registered last, so the default setting is restored.
+template<size_t BlockSize>
+static void BenchmarkTimelineInitEventMultipleThreads(benchmark::State& state)
+{
+    static HT_Timeline* timeline = ht_timeline_create(1024, HT_TRUE, HT_FALSE, NULL, NULL);
+    ht_event_id_provider_set_block_size(ht_timeline_get_id_provider(timeline), BlockSize);
+
+    for (auto _ : state)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        ht_timeline_init_event(timeline, &event);
+        benchmark::DoNotOptimize(event.id);
+    }
+}
+BENCHMARK_TEMPLATE(BenchmarkTimelineInitEventMultipleThreads, 4096)
+    ->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BenchmarkTimelineInitEventMultipleThreads, 1)
+    ->ThreadRange(1, 32)->UseRealTime();
+
+#include <hawktracer/feature_callstack.h>
+
+static HT_Timeline* get_shared_callstack_timeline()
+{
+    // shared by all the benchmark threads, and never destroyed
+    static HT_Timeline* timeline = [] {
+        HT_Timeline* t = ht_timeline_create(64 * 1024, HT_TRUE, HT_TRUE, NULL, NULL);
+        ht_feature_callstack_enable(t);
+        return t;
+    }();
+    return timeline;
+}
+
+// Scoped tracepoints from many threads using a single thread-safe timeline;
+// every thread has its own callstack.
+static void BenchmarkTimelineCallstackSharedTimeline(benchmark::State& state)
+{
+    HT_Timeline* timeline = get_shared_callstack_timeline();
+
+    for (auto _ : state)
+    {
+        ht_feature_callstack_start_int(timeline, 1);
+        ht_feature_callstack_stop(timeline);
+    }
+}
+BENCHMARK(BenchmarkTimelineCallstackSharedTimeline)->Threads(1)->Threads(4)->UseRealTime();
+
+// Nested scoped tracepoints, 16 levels deep; passing the max depth of the callstack
+// as the first argument (0 for the callstack growing as needed).
+static void BenchmarkTimelineCallstackNested(benchmark::State& state)
+{
+    const int depth = 16;
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    if (state.range(0))
+    {
+        ht_feature_callstack_enable_fixed_depth(timeline, state.range(0), sizeof(HT_CallstackIntEvent));
+    }
+    else
+    {
+        ht_feature_callstack_enable(timeline);
+    }
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < depth; i++)
+        {
+            ht_feature_callstack_start_int(timeline, i);
+        }
+        for (int i = 0; i < depth; i++)
+        {
+            ht_feature_callstack_stop(timeline);
+        }
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineCallstackNested)->Arg(0)->Arg(32)->Arg(8);
+
+#include <hawktracer/feature_callstack_aggregation.h>
+
+// Passing 1 as the first argument to aggregate the frames in the process
+// instead of pushing them to the timeline.
+static void BenchmarkTimelineCallstackAggregation(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    ht_feature_callstack_enable(timeline);
+    if (state.range(0))
+    {
+        ht_feature_callstack_aggregation_enable(timeline, 1000000000, HT_FALSE);
+    }
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        ht_feature_callstack_start_int(timeline, 1);
+        ht_feature_callstack_start_int(timeline, 2 + label++ % 16);
+        ht_feature_callstack_stop(timeline);
+        ht_feature_callstack_stop(timeline);
+    }
+
+    ht_feature_callstack_aggregation_flush(timeline);
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineCallstackAggregation)->Arg(0)->Arg(1);
+
+// Passing the duration threshold of the frames as the first argument; with the
+// threshold above the duration of the frames, no frames are pushed to the timeline.
+static void BenchmarkTimelineCallstackDurationThreshold(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    ht_feature_callstack_enable(timeline);
+    ht_feature_callstack_set_duration_threshold(timeline, state.range(0), 1000000000);
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        ht_feature_callstack_start_int(timeline, label++ % 16);
+        ht_feature_callstack_stop(timeline);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineCallstackDurationThreshold)->Arg(0)->Arg(1000000);
+
+// Passing the sampling rate of the root frames as the first argument (0 disables sampling).
+static void BenchmarkTimelineCallstackSampling(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    ht_feature_callstack_enable(timeline);
+    ht_feature_callstack_set_sampling_rate(timeline, state.range(0));
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        ht_feature_callstack_start_int(timeline, label++ % 16);
+        ht_feature_callstack_stop(timeline);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineCallstackSampling)->Arg(0)->Arg(16)->Arg(1024);
+
+#include <hawktracer/scoped_tracepoint.h>
+
+// Passing the sampling rate of the tracepoint as the first argument.
+static void BenchmarkTimelineSampledScopedTracepoint(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    ht_feature_callstack_enable(timeline);
+    uint32_t rate = (uint32_t)state.range(0);
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        HT_TP_SAMPLED_SCOPED_INT(timeline, rate, label++ % 16);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineSampledScopedTracepoint)->Arg(1)->Arg(16)->Arg(1024);
+
+// Passing 1 as the first argument if the category of the tracepoint is enabled.
+static void BenchmarkTimelineCategoryScopedTracepoint(benchmark::State& state)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, NULL);
+    ht_timeline_register_listener(timeline, [](TEventPtr, size_t, HT_Boolean, void*) {}, nullptr);
+    ht_feature_callstack_enable(timeline);
+    HT_Category category = ht_category_register("benchmark", NULL);
+    ht_category_set_enabled(category, (HT_Boolean)state.range(0));
+
+    HT_CallstackEventLabel label = 0;
+    for (auto _ : state)
+    {
+        HT_TP_CATEGORY_SCOPED_INT(timeline, category, label++ % 16);
+    }
+
+    ht_category_set_enabled(category, HT_TRUE);
+    ht_timeline_destroy(timeline);
+}
+BENCHMARK(BenchmarkTimelineCategoryScopedTracepoint)->Arg(0)->Arg(1);
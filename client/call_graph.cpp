@@ -33,9 +33,9 @@ std::shared_ptr<CallGraph::TreeNode> CallGraph::_add_new_call(const NodeData& no
             });
     if (call != calls.end())
     {
-        call->first->total_duration += node_data.get_duration();
+        call->first->total_duration += node_data.get_weighted_duration();
         call->first->data = node_data;
-        ++call->second;
+        call->second += node_data.weight;
 
         return call->first;
     }
@@ -43,7 +43,7 @@ std::shared_ptr<CallGraph::TreeNode> CallGraph::_add_new_call(const NodeData& no
     {
         std::shared_ptr<TreeNode> event_node = std::make_shared<TreeNode>(node_data);
         event_node->parent = parent;
-        calls.emplace_back(event_node, 1);
+        calls.emplace_back(event_node, node_data.weight);
 
         return event_node;
     }
@@ -57,7 +57,7 @@ void CallGraph::_add_new_calltree(const NodeData& node_data)
 void CallGraph::_add_new_event_call(const std::shared_ptr<TreeNode>& caller,
                                     const NodeData& node_data)
 {
-    caller->total_children_duration += node_data.get_duration();
+    caller->total_children_duration += node_data.get_weighted_duration();
     _current_call = _add_new_call(node_data, caller, caller->children);
 }
 
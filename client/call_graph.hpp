@@ -17,15 +17,18 @@ public:
         std::string label;
         HT_TimestampNs start_ts;
         HT_TimestampNs stop_ts;
+        // number of calls the node stands for (if the calls are sampled)
+        uint32_t weight;
 
         NodeData()
         {
         }
 
-        NodeData(std::string name, HT_TimestampNs start, HT_DurationNs dur) :
+        NodeData(std::string name, HT_TimestampNs start, HT_DurationNs dur, uint32_t node_weight = 1) :
             label(std::move(name)),
             start_ts(start),
-            stop_ts(start + dur)
+            stop_ts(start + dur),
+            weight(node_weight)
         {
         }
 
@@ -33,6 +36,11 @@ public:
         {
             return stop_ts - start_ts;
         }
+
+        HT_DurationNs get_weighted_duration() const
+        {
+            return get_duration() * weight;
+        }
     };
 
     struct TreeNode
@@ -47,7 +55,7 @@ public:
         TreeNode(NodeData node_data)
         {
             data = node_data;
-            total_duration = node_data.get_duration();
+            total_duration = node_data.get_weighted_duration();
             total_children_duration = 0u;
         }
     };
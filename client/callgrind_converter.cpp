@@ -30,7 +30,9 @@ void CallgrindConverter::process_event(const parser::Event& event)
     HT_ThreadId thread_id = event.get_value_or_default<HT_ThreadId>("thread_id", 0u);
     HT_TimestampNs start_ts = event.get_timestamp();
     HT_DurationNs duration = event.get_value_or_default<HT_DurationNs>("duration", 0u);
-    _events[thread_id].emplace_back(label, start_ts, duration);
+    // sampled frames stand for weight calls
+    uint32_t weight = event.get_value_or_default<uint32_t>("weight", 1u);
+    _events[thread_id].emplace_back(label, start_ts, duration, weight ? weight : 1u);
 }
 
 void CallgrindConverter::_print_function(std::ofstream& file, std::shared_ptr<CallGraph::TreeNode> root)
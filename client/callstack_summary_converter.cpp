@@ -0,0 +1,132 @@
+#include "callstack_summary_converter.hpp"
+
+#include <hawktracer/feature_callstack_aggregation.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace HawkTracer
+{
+namespace client
+{
+
+CallstackSummaryConverter::~CallstackSummaryConverter()
+{
+}
+
+bool CallstackSummaryConverter::init(const std::string& file_name)
+{
+    _file_name = file_name;
+    return true;
+}
+
+void CallstackSummaryConverter::process_event(const parser::Event& event)
+{
+    // collects the string mappings
+    _get_label(event);
+
+    const std::string klass_name = event.get_klass()->get_name();
+    if (klass_name == "HT_CallstackSummaryEvent")
+    {
+        PathStats& stats = _paths[event.get_value<uint64_t>("path_id")];
+        HT_DurationNs min_duration = event.get_value<uint64_t>("min_duration");
+        HT_DurationNs max_duration = event.get_value<uint64_t>("max_duration");
+
+        stats.parent_path_id = event.get_value<uint64_t>("parent_path_id");
+        stats.label = event.get_value<uint64_t>("frame_label");
+        stats.count += event.get_value<uint64_t>("count");
+        stats.total_duration += event.get_value<uint64_t>("total_duration");
+        stats.self_duration += event.get_value<uint64_t>("self_duration");
+        stats.min_duration = std::min(stats.min_duration, min_duration);
+        stats.max_duration = std::max(stats.max_duration, max_duration);
+    }
+    else if (klass_name == "HT_CallstackSummaryHistogramEvent")
+    {
+        PathStats& stats = _paths[event.get_value<uint64_t>("path_id")];
+        stats.histogram[event.get_value<uint16_t>("bucket")] += event.get_value<uint32_t>("count");
+    }
+}
+
+HT_DurationNs CallstackSummaryConverter::_get_percentile(const PathStats& stats, double percentile) const
+{
+    uint64_t threshold = (uint64_t)(stats.count * percentile);
+    uint64_t count = 0;
+
+    for (const auto& bucket : stats.histogram)
+    {
+        count += bucket.second;
+        if (count > threshold)
+        {
+            // the lower bound of the bucket, but never outside of the observed range
+            HT_DurationNs duration = ht_feature_callstack_aggregation_get_bucket_min_duration(bucket.first);
+            return std::min(std::max(duration, stats.min_duration), stats.max_duration);
+        }
+    }
+
+    return stats.max_duration;
+}
+
+void CallstackSummaryConverter::_write_paths(std::ostream& stream, uint64_t parent_path_id, size_t depth,
+                                             const std::unordered_multimap<uint64_t, uint64_t>& children)
+{
+    std::vector<uint64_t> paths;
+    auto range = children.equal_range(parent_path_id);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        paths.push_back(it->second);
+    }
+    std::sort(paths.begin(), paths.end(), [this] (uint64_t a, uint64_t b) {
+        return _paths[a].total_duration > _paths[b].total_duration;
+    });
+
+    for (uint64_t path_id : paths)
+    {
+        const PathStats& stats = _paths[path_id];
+        if (stats.count > 0)
+        {
+            stream << std::string(depth * 2, ' ') << _tracepoint_map->get_label_info(stats.label).label
+                   << " " << stats.count
+                   << " " << stats.total_duration
+                   << " " << stats.self_duration
+                   << " " << stats.min_duration
+                   << " " << stats.total_duration / stats.count
+                   << " " << stats.max_duration
+                   << " " << _get_percentile(stats, 0.5)
+                   << " " << _get_percentile(stats, 0.9)
+                   << " " << _get_percentile(stats, 0.99) << "\n";
+        }
+        _write_paths(stream, path_id, depth + 1, children);
+    }
+}
+
+void CallstackSummaryConverter::write_report(std::ostream& stream)
+{
+    std::unordered_multimap<uint64_t, uint64_t> children;
+    for (const auto& path : _paths)
+    {
+        // paths with unknown parents are reported as roots
+        uint64_t parent = _paths.count(path.second.parent_path_id) ? path.second.parent_path_id : 0;
+        children.emplace(parent, path.first);
+    }
+
+    stream << "# label count total_ns self_ns min_ns avg_ns max_ns p50_ns p90_ns p99_ns\n";
+    _write_paths(stream, 0, 0, children);
+}
+
+void CallstackSummaryConverter::stop()
+{
+    std::ofstream file(_file_name);
+    if (file.is_open())
+    {
+        write_report(file);
+    }
+    else
+    {
+        std::cerr << "Can't open file: " << _file_name << std::endl;
+    }
+}
+
+} // namespace client
+} // namespace HawkTracer
@@ -0,0 +1,54 @@
+#ifndef HAWKTRACER_CLIENT_CALLSTACK_SUMMARY_CONVERTER_HPP
+#define HAWKTRACER_CLIENT_CALLSTACK_SUMMARY_CONVERTER_HPP
+
+#include <hawktracer/parser/event.hpp>
+#include "converter.hpp"
+
+#include <map>
+#include <ostream>
+#include <unordered_map>
+
+namespace HawkTracer
+{
+namespace client
+{
+
+// Renders summaries of callstack frames aggregated in the process
+// (see feature_callstack_aggregation.h) as a tree of call paths. Summaries
+// of all the intervals are merged.
+class CallstackSummaryConverter : public Converter
+{
+public:
+    ~CallstackSummaryConverter() override;
+
+    bool init(const std::string& file_name) override;
+    void process_event(const parser::Event& event) override;
+    void stop() override;
+
+    void write_report(std::ostream& stream);
+
+private:
+    struct PathStats
+    {
+        uint64_t parent_path_id = 0;
+        uint64_t label = 0;
+        uint64_t count = 0;
+        HT_DurationNs total_duration = 0;
+        HT_DurationNs self_duration = 0;
+        HT_DurationNs min_duration = (HT_DurationNs)-1;
+        HT_DurationNs max_duration = 0;
+        std::map<uint16_t, uint64_t> histogram;
+    };
+
+    HT_DurationNs _get_percentile(const PathStats& stats, double percentile) const;
+    void _write_paths(std::ostream& stream, uint64_t parent_path_id, size_t depth,
+                      const std::unordered_multimap<uint64_t, uint64_t>& children);
+
+    std::string _file_name;
+    std::unordered_map<uint64_t, PathStats> _paths;
+};
+
+} // namespace client
+} // namespace HawkTracer
+
+#endif // HAWKTRACER_CLIENT_CALLSTACK_SUMMARY_CONVERTER_HPP
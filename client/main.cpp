@@ -1,4 +1,5 @@
 #include "callgrind_converter.hpp"
+#include "callstack_summary_converter.hpp"
 #include "chrome_trace_converter.hpp"
 
 #include <hawktracer/parser/protocol_reader.hpp>
@@ -6,8 +7,11 @@
 
 #include <hawktracer/client_utils/command_line_parser.hpp>
 #include <hawktracer/client_utils/stream_factory.hpp>
+#include <hawktracer/client_utils/tcp_client_stream.hpp>
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <vector>
 
 using namespace HawkTracer;
 using ClientUtils::CommandLineParser;
@@ -37,6 +41,59 @@ void init_supported_formats(std::map<std::string, std::unique_ptr<client::Conver
 {
     formats["chrome-tracing"] = parser::make_unique<client::ChromeTraceConverter>();
     formats["callgrind"] = parser::make_unique<client::CallgrindConverter>();
+    formats["callstack-summary"] = parser::make_unique<client::CallstackSummaryConverter>();
+}
+
+/* Remote control commands which are sent to the listener right after connecting. */
+std::vector<std::string> get_initial_commands(const CommandLineParser& parser)
+{
+    std::vector<std::string> commands;
+
+    if (parser.has_value("enable-categories"))
+    {
+        commands.push_back("enable-categories " + parser.get_value("enable-categories", ""));
+    }
+    if (parser.has_value("disable-categories"))
+    {
+        commands.push_back("disable-categories " + parser.get_value("disable-categories", ""));
+    }
+    if (parser.has_value("new-global-timeline-buffer-size"))
+    {
+        commands.push_back("new-global-timeline-buffer-size " + parser.get_value("new-global-timeline-buffer-size", ""));
+    }
+    if (parser.has_value("sampling-rate"))
+    {
+        commands.push_back("sampling-rate " + parser.get_value("sampling-rate", ""));
+    }
+    if (parser.has_value("duration-threshold"))
+    {
+        /* the threshold and the report interval are separated with a space in the command */
+        std::string arguments = parser.get_value("duration-threshold", "");
+        std::replace(arguments.begin(), arguments.end(), ',', ' ');
+        commands.push_back("duration-threshold " + arguments);
+    }
+    if (parser.has_value("pause-aggregation"))
+    {
+        commands.push_back("pause-aggregation");
+    }
+    if (parser.has_value("resume-aggregation"))
+    {
+        commands.push_back("resume-aggregation");
+    }
+    if (parser.has_value("pause"))
+    {
+        commands.push_back("pause");
+    }
+    if (parser.has_value("resume"))
+    {
+        commands.push_back("resume");
+    }
+    if (parser.has_value("flush"))
+    {
+        commands.push_back("flush");
+    }
+
+    return commands;
 }
 
 int main(int argc, char** argv)
@@ -48,8 +105,18 @@ int main(int argc, char** argv)
     CommandLineParser parser("--", argv[0]);
     parser.register_option("format", CommandLineParser::OptionInfo(false, false, "Output format. Supported formats: " + supported_formats(formats)));
     parser.register_option("output", CommandLineParser::OptionInfo(false, false, "Output file"));
-    parser.register_option("source", CommandLineParser::OptionInfo(false, true, "Data source description (either filename, or server address)"));
+    parser.register_option("source", CommandLineParser::OptionInfo(false, true, "Data source description (either filename, server address, unix:<socket path> or shm:<segment name>)"));
     parser.register_option("map", CommandLineParser::OptionInfo(false, false, "Comma-separated list of map files"));
+    parser.register_option("enable-categories", CommandLineParser::OptionInfo(false, false, "Comma-separated list of tracepoint categories to enable in the traced process"));
+    parser.register_option("disable-categories", CommandLineParser::OptionInfo(false, false, "Comma-separated list of tracepoint categories to disable in the traced process"));
+    parser.register_option("new-global-timeline-buffer-size", CommandLineParser::OptionInfo(false, false, "Buffer size (in bytes) of Global Timelines created afterwards in the traced process (existing ones are not resized)"));
+    parser.register_option("sampling-rate", CommandLineParser::OptionInfo(false, false, "Record 1 in N root callstack frames in the traced process"));
+    parser.register_option("duration-threshold", CommandLineParser::OptionInfo(false, false, "Minimum duration of recorded callstack frames and interval between reports of dropped frames in the traced process (<ns>,<ns>)"));
+    parser.register_option("pause-aggregation", CommandLineParser::OptionInfo(true, false, "Pause the callstack aggregation in the traced process"));
+    parser.register_option("resume-aggregation", CommandLineParser::OptionInfo(true, false, "Resume the callstack aggregation in the traced process"));
+    parser.register_option("pause", CommandLineParser::OptionInfo(true, false, "Pause sending events by the traced process"));
+    parser.register_option("resume", CommandLineParser::OptionInfo(true, false, "Resume sending events by the traced process"));
+    parser.register_option("flush", CommandLineParser::OptionInfo(true, false, "Flush all the timelines of the traced process"));
     parser.register_option("help", CommandLineParser::OptionInfo(true, false, "Print this help"));
 
     if (!parser.parse(argc, argv) || parser.has_value("help"))
@@ -70,6 +137,14 @@ int main(int argc, char** argv)
     }
 
     bool is_stream_continuous = stream->is_continuous();
+    /* remote control commands can only be sent to TCP and Unix domain socket listeners */
+    ClientUtils::TCPClientStream* control_stream = dynamic_cast<ClientUtils::TCPClientStream*>(stream.get());
+    std::vector<std::string> initial_commands = get_initial_commands(parser);
+
+    if (!initial_commands.empty() && !control_stream)
+    {
+        std::cerr << "Commands can only be sent to the TCP or Unix domain socket source, they will be ignored" << std::endl;
+    }
 
     parser::KlassRegister klass_register;
     parser::ProtocolReader reader(&klass_register, std::move(stream), true);
@@ -112,7 +187,34 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (is_stream_continuous)
+    if (control_stream)
+    {
+        for (const auto& command : initial_commands)
+        {
+            if (!control_stream->send_command(command))
+            {
+                std::cerr << "Can't send command: " << command << std::endl;
+            }
+        }
+    }
+
+    if (control_stream)
+    {
+        std::string command;
+
+        std::cout << "Type a command (pause, resume, flush, enable-categories <names>, disable-categories <names>, "
+                     "new-global-timeline-buffer-size <bytes>, sampling-rate <rate>, duration-threshold <ns> <ns>, "
+                     "pause-aggregation, resume-aggregation), or hit [Enter] to finish the trace..." << std::endl;
+        while (std::getline(std::cin, command) && !command.empty())
+        {
+            if (!control_stream->send_command(command))
+            {
+                std::cerr << "Can't send command: " << command << std::endl;
+            }
+        }
+        reader.stop();
+    }
+    else if (is_stream_continuous)
     {
         std::cout << "Hit [Enter] to finish the trace..." << std::endl;
         getchar();
@@ -127,5 +229,11 @@ int main(int argc, char** argv)
     reader.stop();
     converter->second->stop();
 
+    if (reader.has_stream_error())
+    {
+        std::cerr << "The source is truncated or malformed; the trace might be incomplete" << std::endl;
+        return 1;
+    }
+
     return 0;
 }
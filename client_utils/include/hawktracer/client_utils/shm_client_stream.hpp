@@ -0,0 +1,56 @@
+#ifndef HAWKTRACER_CLIENT_UTILS_SHM_CLIENT_STREAM_HPP
+#define HAWKTRACER_CLIENT_UTILS_SHM_CLIENT_STREAM_HPP
+
+#include <hawktracer/parser/stream.hpp>
+#include <hawktracer/listeners/shm_listener.h>
+
+#include <atomic>
+#include <vector>
+
+namespace HawkTracer
+{
+namespace ClientUtils
+{
+
+/**
+ * Reads data from the shared memory ring buffer written by HT_ShmListener.
+ * The stream ends when the listener is stopped and all the data has been read.
+ * Not supported on Windows.
+ */
+class ShmClientStream : public parser::Stream
+{
+public:
+    ShmClientStream(const std::string& name, bool wait_for_server = true);
+    ~ShmClientStream();
+
+    bool start() override;
+    void stop() override;
+
+    bool is_connected() const { return _header != nullptr; }
+
+    int read_byte() override;
+    bool read_data(char* buff, size_t size) override;
+
+    bool is_continuous() override { return true; }
+
+private:
+    bool _open();
+    bool _fill_buffer();
+
+    std::string _name;
+    bool _wait_for_server;
+    std::atomic<bool> _running;
+
+    HT_ShmListenerHeader* _header = nullptr;
+    const char* _data = nullptr;
+    size_t _mapping_size = 0;
+    uint64_t _read_position = 0;
+
+    std::vector<char> _buffer;
+    size_t _buffer_pos = 0;
+};
+
+} // namespace ClientUtils
+} // namespace HawkTracer
+
+#endif // HAWKTRACER_CLIENT_UTILS_SHM_CLIENT_STREAM_HPP
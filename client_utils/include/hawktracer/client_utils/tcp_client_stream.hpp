@@ -2,6 +2,7 @@
 #define HAWKTRACER_CLIENT_UTILS_TCP_CLIENT_STREAM_HPP
 
 #include <hawktracer/parser/stream.hpp>
+#include <hawktracer/parser/stream_decoder.hpp>
 
 #include <queue>
 #include <mutex>
@@ -25,11 +26,23 @@ public:
 
     bool is_connected() const;
 
+    /**
+     * Sends a remote control command (e.g. "pause", or "enable-categories io,net")
+     * to the listener. See tcp_listener.h for the list of commands.
+     */
+    bool send_command(const std::string& command);
+
     int read_byte() override;
     bool read_data(char* buff, size_t size) override;
 
     bool is_continuous() override { return true; }
 
+protected:
+    /* Creates a socket and connects it to the server. */
+    virtual bool _connect();
+
+    std::atomic<int> _sock_fd;
+
 private:
     void _run();
 
@@ -41,7 +54,7 @@ private:
     std::condition_variable _datas_cv;
     std::thread _thread;
 
-    std::atomic<int> _sock_fd;
+    parser::StreamDecoder _decoder;
 
     std::string _ip_address;
     uint16_t _port;
@@ -0,0 +1,30 @@
+#ifndef HAWKTRACER_CLIENT_UTILS_UNIX_SOCKET_CLIENT_STREAM_HPP
+#define HAWKTRACER_CLIENT_UTILS_UNIX_SOCKET_CLIENT_STREAM_HPP
+
+#include "hawktracer/client_utils/tcp_client_stream.hpp"
+
+namespace HawkTracer
+{
+namespace ClientUtils
+{
+
+/**
+ * Reads data from a listener created with ht_tcp_listener_create_unix_socket().
+ * Not supported on Windows.
+ */
+class UnixSocketClientStream : public TCPClientStream
+{
+public:
+    UnixSocketClientStream(const std::string& path, bool wait_for_server = true);
+
+protected:
+    bool _connect() override;
+
+private:
+    std::string _path;
+};
+
+} // namespace ClientUtils
+} // namespace HawkTracer
+
+#endif // HAWKTRACER_CLIENT_UTILS_UNIX_SOCKET_CLIENT_STREAM_HPP
@@ -0,0 +1,218 @@
+#include "hawktracer/client_utils/shm_client_stream.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace HawkTracer
+{
+namespace ClientUtils
+{
+
+/* the data is copied from the ring in chunks, so the consumer's position
+ * (shared with the producer) is not updated for every byte */
+#define HT_SHM_CLIENT_STREAM_CHUNK_SIZE (64 * 1024)
+
+/* the header is shared with the producer process, so std::atomic can't be used */
+template<typename T>
+static T load_acquire(T* ptr)
+{
+#ifdef _WIN32
+    return *static_cast<volatile T*>(ptr);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template<typename T>
+static void store_release(T* ptr, T value)
+{
+#ifdef _WIN32
+    *static_cast<volatile T*>(ptr) = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+ShmClientStream::ShmClientStream(const std::string& name, bool wait_for_server) :
+    _name(name.empty() || name[0] != '/' ? "/" + name : name),
+    _wait_for_server(wait_for_server),
+    _running(false)
+{
+}
+
+ShmClientStream::~ShmClientStream()
+{
+    stop();
+}
+
+bool ShmClientStream::start()
+{
+    if (is_connected())
+    {
+        stop();
+    }
+
+    _running = true;
+    while (!_open())
+    {
+        if (!_wait_for_server || !_running)
+        {
+            _running = false;
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    _read_position = load_acquire(&_header->read_position);
+    _buffer.clear();
+    _buffer_pos = 0;
+
+    return true;
+}
+
+bool ShmClientStream::_open()
+{
+#ifdef _WIN32
+    return false;
+#else
+    int fd = shm_open(_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(HT_ShmListenerHeader))
+    {
+        map = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    HT_ShmListenerHeader* header = static_cast<HT_ShmListenerHeader*>(map);
+    /* the listener might still be initializing the segment */
+    if (load_acquire(&header->magic) != HT_SHM_LISTENER_MAGIC
+            || header->version != HT_SHM_LISTENER_VERSION
+            || header->data_offset + header->capacity > (uint64_t)st.st_size)
+    {
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+
+    _header = header;
+    _data = static_cast<const char*>(map) + header->data_offset;
+    _mapping_size = (size_t)st.st_size;
+
+    return true;
+#endif
+}
+
+void ShmClientStream::stop()
+{
+    _running = false;
+
+#ifndef _WIN32
+    if (_header)
+    {
+        munmap(_header, _mapping_size);
+        _header = nullptr;
+        _data = nullptr;
+    }
+#endif
+}
+
+bool ShmClientStream::_fill_buffer()
+{
+    unsigned int idle_count = 0;
+
+    _buffer.clear();
+    _buffer_pos = 0;
+
+    while (_running && is_connected())
+    {
+        uint64_t write_position = load_acquire(&_header->write_position);
+
+        if (write_position != _read_position)
+        {
+            size_t capacity = (size_t)_header->capacity;
+            size_t size = (size_t)std::min<uint64_t>(write_position - _read_position, HT_SHM_CLIENT_STREAM_CHUNK_SIZE);
+            size_t offset = (size_t)(_read_position % capacity);
+            size_t first_part = std::min(size, capacity - offset);
+
+            _buffer.resize(size);
+            memcpy(_buffer.data(), _data + offset, first_part);
+            memcpy(_buffer.data() + first_part, _data, size - first_part);
+
+            _read_position += size;
+            store_release(&_header->read_position, _read_position);
+            return true;
+        }
+
+        if (load_acquire(&_header->closed))
+        {
+            /* the data might have been written just before the ring was closed */
+            if (load_acquire(&_header->write_position) == _read_position)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        /* spin for a while, as the data usually comes in bursts */
+        if (++idle_count < 1000)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    return false;
+}
+
+int ShmClientStream::read_byte()
+{
+    if (_buffer_pos == _buffer.size() && !_fill_buffer())
+    {
+        return -1;
+    }
+
+    return static_cast<unsigned char>(_buffer[_buffer_pos++]);
+}
+
+bool ShmClientStream::read_data(char* buff, size_t size)
+{
+    while (size > 0)
+    {
+        if (_buffer_pos == _buffer.size() && !_fill_buffer())
+        {
+            return false;
+        }
+
+        size_t bytes_count = std::min(size, _buffer.size() - _buffer_pos);
+        memcpy(buff, _buffer.data() + _buffer_pos, bytes_count);
+        _buffer_pos += bytes_count;
+        buff += bytes_count;
+        size -= bytes_count;
+    }
+
+    return true;
+}
+
+} // namespace ClientUtils
+} // namespace HawkTracer
@@ -1,5 +1,7 @@
 #include "hawktracer/client_utils/stream_factory.hpp"
+#include "hawktracer/client_utils/shm_client_stream.hpp"
 #include "hawktracer/client_utils/tcp_client_stream.hpp"
+#include "hawktracer/client_utils/unix_socket_client_stream.hpp"
 
 #include "hawktracer/parser/file_stream.hpp"
 #include "hawktracer/parser/make_unique.hpp"
@@ -26,6 +28,16 @@ static bool scan_ip_address(const std::string& address, std::string& out_ip, uin
     return false;
 }
 
+static bool scan_prefixed_name(const std::string& source_description, const std::string& prefix, std::string& out_name)
+{
+    if (source_description.size() > prefix.size() && source_description.compare(0, prefix.size(), prefix) == 0)
+    {
+        out_name = source_description.substr(prefix.size());
+        return true;
+    }
+    return false;
+}
+
 static bool file_exists(const char* name)
 {
     std::ifstream f(name);
@@ -35,9 +47,18 @@ static bool file_exists(const char* name)
 std::unique_ptr<parser::Stream> make_stream_from_string(const std::string& source_description)
 {
     std::string ip;
+    std::string name;
     uint16_t port;
 
-    if (file_exists(source_description.c_str()))
+    if (scan_prefixed_name(source_description, "unix:", name))
+    {
+        return parser::make_unique<UnixSocketClientStream>(name);
+    }
+    else if (scan_prefixed_name(source_description, "shm:", name))
+    {
+        return parser::make_unique<ShmClientStream>(name);
+    }
+    else if (file_exists(source_description.c_str()))
     {
         return parser::make_unique<parser::FileStream>(source_description);
     }
@@ -48,7 +69,9 @@ std::unique_ptr<parser::Stream> make_stream_from_string(const std::string& sourc
     else
     {
         std::cerr << "Invalid stream: " << source_description << std::endl;
-        std::cerr << "Stream must be either a file name, or IP address (e.g. 127.0.0.1:8765)" << std::endl;
+        std::cerr << "Stream must be either a file name, IP address (e.g. 127.0.0.1:8765), "
+                  << "Unix domain socket (e.g. unix:/tmp/hawktracer.sock) "
+                  << "or shared memory segment (e.g. shm:hawktracer)" << std::endl;
         return nullptr;
     }
 }
@@ -53,10 +53,28 @@ bool TCPClientStream::start()
     }
 #endif
 
+    while (!_connect())
+    {
+        if (!_wait_for_server)
+        {
+            stop();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    _decoder = parser::StreamDecoder();
+    _thread = std::thread([this] { _run(); });
+
+    return true;
+}
+
+bool TCPClientStream::_connect()
+{
     struct sockaddr_in serveraddr;
 
-    _sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (_sock_fd < 0)
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd < 0)
     {
         return false;
     }
@@ -66,24 +84,13 @@ bool TCPClientStream::start()
     serveraddr.sin_addr.s_addr = inet_addr(_ip_address.c_str());
     serveraddr.sin_port = htons(_port);
 
-    if (_wait_for_server)
+    if (connect(sock_fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
     {
-        while (connect(_sock_fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-    }
-    else
-    {
-        if (connect(_sock_fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
-        {
-            stop();
-            return false;
-        }
+        close_socket(sock_fd);
+        return false;
     }
 
-    _thread = std::thread([this] { _run(); });
-
+    _sock_fd = sock_fd;
     return true;
 }
 
@@ -113,19 +120,34 @@ void TCPClientStream::_run()
     {
         int size = recv(_sock_fd, buf, BUFSIZE, 0);
         
+        std::vector<char> data;
+        bool decoded;
+
         if (size == 0 || size == -1)
         {
+            decoded = _decoder.finish(data);
             close_socket(_sock_fd);
             _sock_fd = -1;
         }
-        else if (size > 0)
+        else
+        {
+            decoded = _decoder.decode(buf, size, data);
+        }
+
+        if (!data.empty())
         {
             {
                 std::lock_guard<std::mutex> l(_datas_mtx);
-                _datas.push(std::make_pair(0u, std::vector<char>(buf, buf + size)));
+                _datas.push(std::make_pair(0u, std::move(data)));
             }
             _datas_cv.notify_one();
         }
+
+        if (!decoded && is_connected())
+        {
+            close_socket(_sock_fd);
+            _sock_fd = -1;
+        }
     }
 
     _datas_cv.notify_one();
@@ -142,6 +164,35 @@ bool TCPClientStream::_wait_for_data(std::unique_lock<std::mutex>& l)
      return !_datas.empty();
 }
 
+bool TCPClientStream::send_command(const std::string& command)
+{
+    std::string message = command + "\n";
+    size_t sent = 0;
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    while (sent < message.size())
+    {
+        int fd = _sock_fd;
+        if (fd == -1)
+        {
+            return false;
+        }
+
+        int n = send(fd, message.data() + sent, (int)(message.size() - sent), flags);
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += n;
+    }
+
+    return true;
+}
+
 int TCPClientStream::read_byte()
 {
     std::unique_lock<std::mutex> l(_datas_mtx);
@@ -153,7 +204,7 @@ int TCPClientStream::read_byte()
     else
     {
         auto& buffer = _datas.front();
-        int b = buffer.second[buffer.first++];
+        int b = static_cast<unsigned char>(buffer.second[buffer.first++]);
         _pop_if_used();
         return b;
     }
@@ -0,0 +1,55 @@
+#include "hawktracer/client_utils/unix_socket_client_stream.hpp"
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+
+namespace HawkTracer
+{
+namespace ClientUtils
+{
+
+UnixSocketClientStream::UnixSocketClientStream(const std::string& path, bool wait_for_server) :
+    TCPClientStream("", 0, wait_for_server),
+    _path(path)
+{
+}
+
+bool UnixSocketClientStream::_connect()
+{
+#ifdef _WIN32
+    return false;
+#else
+    struct sockaddr_un serveraddr;
+
+    if (_path.empty() || _path.size() >= sizeof(serveraddr.sun_path))
+    {
+        return false;
+    }
+
+    int sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock_fd < 0)
+    {
+        return false;
+    }
+
+    memset(&serveraddr, 0, sizeof(serveraddr));
+    serveraddr.sun_family = AF_UNIX;
+    memcpy(serveraddr.sun_path, _path.c_str(), _path.size() + 1);
+
+    if (connect(sock_fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
+    {
+        close(sock_fd);
+        return false;
+    }
+
+    _sock_fd = sock_fd;
+    return true;
+#endif
+}
+
+} // namespace ClientUtils
+} // namespace HawkTracer
@@ -0,0 +1,425 @@
+#include "internal/buffer_dispatcher.h"
+#include "internal/error.h"
+#include "internal/mutex.h"
+#include "internal/thread.h"
+
+#include <hawktracer/alloc.h>
+
+#include <assert.h>
+#include <string.h>
+
+typedef struct _HT_DispatcherBuffer HT_DispatcherBuffer;
+
+struct _HT_DispatcherBuffer
+{
+    HT_DispatcherBuffer* next;
+    size_t usage;
+    /* HT_FALSE for copies created by ht_buffer_dispatcher_push_copy() */
+    HT_Boolean from_pool;
+};
+
+#define HT_DISPATCHER_BUFFER_DATA(BUFFER) ((HT_Byte*)((BUFFER) + 1))
+#define HT_DISPATCHER_BUFFER_FROM_DATA(DATA) (((HT_DispatcherBuffer*)(DATA)) - 1)
+
+struct _HT_BufferDispatcher
+{
+    HT_BufferDispatcherCallback callback;
+    void* user_data;
+    HT_AsyncFlushPolicy policy;
+    HT_Mutex* mtx;
+    HT_CondVar* cond_var;
+    HT_Thread* thread;
+    HT_DispatcherBuffer** pool;
+    size_t pool_depth;
+    /* all the fields below are protected by mtx */
+    HT_DispatcherBuffer* free_buffers;
+    HT_DispatcherBuffer* queue_head;
+    HT_DispatcherBuffer* queue_tail;
+    HT_Boolean dispatching;
+    HT_Boolean stop;
+    /* copies created by ht_buffer_dispatcher_push_copy() which haven't been released yet;
+     * limited to pool_depth, so oversized events can't use unbounded amount of memory */
+    size_t queued_copies;
+    uint64_t dropped_count;
+};
+
+static HT_DispatcherBuffer*
+_ht_dispatcher_buffer_create(size_t capacity, HT_Boolean from_pool)
+{
+    HT_DispatcherBuffer* buffer = (HT_DispatcherBuffer*)ht_alloc(sizeof(HT_DispatcherBuffer) + capacity);
+
+    if (buffer)
+    {
+        buffer->next = NULL;
+        buffer->usage = 0;
+        buffer->from_pool = from_pool;
+    }
+
+    return buffer;
+}
+
+static void
+_ht_buffer_dispatcher_destroy_pool(HT_BufferDispatcher* dispatcher)
+{
+    size_t i;
+
+    for (i = 0; i < dispatcher->pool_depth; i++)
+    {
+        ht_free(dispatcher->pool[i]);
+    }
+    ht_free(dispatcher->pool);
+}
+
+/* Must be called with the mutex locked. */
+static void
+_ht_buffer_dispatcher_enqueue(HT_BufferDispatcher* dispatcher, HT_DispatcherBuffer* buffer)
+{
+    buffer->next = NULL;
+    if (dispatcher->queue_tail)
+    {
+        dispatcher->queue_tail->next = buffer;
+    }
+    else
+    {
+        dispatcher->queue_head = buffer;
+    }
+    dispatcher->queue_tail = buffer;
+
+    ht_cond_var_notify_all(dispatcher->cond_var);
+}
+
+/* Must be called with the mutex locked. */
+static void
+_ht_buffer_dispatcher_release(HT_BufferDispatcher* dispatcher, HT_DispatcherBuffer* buffer)
+{
+    if (buffer->from_pool)
+    {
+        buffer->usage = 0;
+        buffer->next = dispatcher->free_buffers;
+        dispatcher->free_buffers = buffer;
+    }
+    else
+    {
+        ht_free(buffer);
+        dispatcher->queued_copies--;
+    }
+}
+
+static void*
+_ht_buffer_dispatcher_run(void* user_data)
+{
+    HT_BufferDispatcher* dispatcher = (HT_BufferDispatcher*)user_data;
+
+    ht_mutex_lock(dispatcher->mtx);
+
+    for (;;)
+    {
+        HT_DispatcherBuffer* buffer;
+
+        while (dispatcher->queue_head == NULL && !dispatcher->stop)
+        {
+            ht_cond_var_wait(dispatcher->cond_var, dispatcher->mtx);
+        }
+
+        buffer = dispatcher->queue_head;
+        if (buffer == NULL)
+        {
+            break;
+        }
+
+        dispatcher->queue_head = buffer->next;
+        if (dispatcher->queue_head == NULL)
+        {
+            dispatcher->queue_tail = NULL;
+        }
+        dispatcher->dispatching = HT_TRUE;
+
+        ht_mutex_unlock(dispatcher->mtx);
+        dispatcher->callback(HT_DISPATCHER_BUFFER_DATA(buffer), buffer->usage, dispatcher->user_data);
+        ht_mutex_lock(dispatcher->mtx);
+
+        _ht_buffer_dispatcher_release(dispatcher, buffer);
+        dispatcher->dispatching = HT_FALSE;
+        ht_cond_var_notify_all(dispatcher->cond_var);
+    }
+
+    ht_mutex_unlock(dispatcher->mtx);
+
+    return NULL;
+}
+
+HT_BufferDispatcher*
+ht_buffer_dispatcher_create(size_t buffer_capacity,
+                            size_t pool_depth,
+                            HT_AsyncFlushPolicy policy,
+                            HT_BufferDispatcherCallback callback,
+                            void* user_data,
+                            HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_BufferDispatcher* dispatcher;
+    size_t i;
+
+    assert(callback);
+
+    if (pool_depth < 2)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    dispatcher = HT_CREATE_TYPE(HT_BufferDispatcher);
+    if (dispatcher == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    dispatcher->callback = callback;
+    dispatcher->user_data = user_data;
+    dispatcher->policy = policy;
+    dispatcher->free_buffers = NULL;
+    dispatcher->queue_head = NULL;
+    dispatcher->queue_tail = NULL;
+    dispatcher->dispatching = HT_FALSE;
+    dispatcher->stop = HT_FALSE;
+    dispatcher->queued_copies = 0;
+    dispatcher->dropped_count = 0;
+    dispatcher->pool_depth = 0;
+
+    dispatcher->pool = (HT_DispatcherBuffer**)ht_alloc(pool_depth * sizeof(HT_DispatcherBuffer*));
+    if (dispatcher->pool == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_pool;
+    }
+
+    for (i = 0; i < pool_depth; i++)
+    {
+        HT_DispatcherBuffer* buffer = _ht_dispatcher_buffer_create(buffer_capacity, HT_TRUE);
+        if (buffer == NULL)
+        {
+            error_code = HT_ERR_OUT_OF_MEMORY;
+            goto error_create_buffers;
+        }
+        buffer->next = dispatcher->free_buffers;
+        dispatcher->free_buffers = buffer;
+        dispatcher->pool[dispatcher->pool_depth++] = buffer;
+    }
+
+    dispatcher->mtx = ht_mutex_create();
+    if (dispatcher->mtx == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_buffers;
+    }
+
+    dispatcher->cond_var = ht_cond_var_create();
+    if (dispatcher->cond_var == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_cond_var;
+    }
+
+    dispatcher->thread = ht_thread_create(_ht_buffer_dispatcher_run, dispatcher);
+    if (dispatcher->thread == NULL)
+    {
+        error_code = HT_ERR_UNKNOWN;
+        goto error_create_thread;
+    }
+
+    goto done;
+
+error_create_thread:
+    ht_cond_var_destroy(dispatcher->cond_var);
+error_create_cond_var:
+    ht_mutex_destroy(dispatcher->mtx);
+error_create_buffers:
+    _ht_buffer_dispatcher_destroy_pool(dispatcher);
+error_create_pool:
+    ht_free(dispatcher);
+    dispatcher = NULL;
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return dispatcher;
+}
+
+void
+ht_buffer_dispatcher_destroy(HT_BufferDispatcher* dispatcher)
+{
+    assert(dispatcher);
+
+    ht_mutex_lock(dispatcher->mtx);
+    dispatcher->stop = HT_TRUE;
+    ht_cond_var_notify_all(dispatcher->cond_var);
+    ht_mutex_unlock(dispatcher->mtx);
+
+    /* the thread delivers all the queued buffers before it exits */
+    ht_thread_destroy(dispatcher->thread);
+
+    _ht_buffer_dispatcher_destroy_pool(dispatcher);
+    ht_cond_var_destroy(dispatcher->cond_var);
+    ht_mutex_destroy(dispatcher->mtx);
+    ht_free(dispatcher);
+}
+
+HT_Byte*
+ht_buffer_dispatcher_get_buffer(HT_BufferDispatcher* dispatcher)
+{
+    HT_DispatcherBuffer* buffer;
+
+    ht_mutex_lock(dispatcher->mtx);
+    buffer = dispatcher->free_buffers;
+    assert(buffer);
+    dispatcher->free_buffers = buffer->next;
+    ht_mutex_unlock(dispatcher->mtx);
+
+    return HT_DISPATCHER_BUFFER_DATA(buffer);
+}
+
+HT_Byte*
+ht_buffer_dispatcher_swap(HT_BufferDispatcher* dispatcher, HT_Byte* buffer, size_t usage)
+{
+    HT_DispatcherBuffer* full_buffer = HT_DISPATCHER_BUFFER_FROM_DATA(buffer);
+    HT_DispatcherBuffer* free_buffer;
+
+    ht_mutex_lock(dispatcher->mtx);
+
+    while (dispatcher->free_buffers == NULL)
+    {
+        if (dispatcher->policy == HT_ASYNC_FLUSH_POLICY_DROP)
+        {
+            dispatcher->dropped_count++;
+            ht_mutex_unlock(dispatcher->mtx);
+            return buffer;
+        }
+        ht_cond_var_wait(dispatcher->cond_var, dispatcher->mtx);
+    }
+
+    free_buffer = dispatcher->free_buffers;
+    dispatcher->free_buffers = free_buffer->next;
+
+    full_buffer->usage = usage;
+    _ht_buffer_dispatcher_enqueue(dispatcher, full_buffer);
+
+    ht_mutex_unlock(dispatcher->mtx);
+
+    return HT_DISPATCHER_BUFFER_DATA(free_buffer);
+}
+
+HT_Byte*
+ht_buffer_dispatcher_flush(HT_BufferDispatcher* dispatcher, HT_Byte* buffer, size_t usage)
+{
+    HT_DispatcherBuffer* full_buffer = HT_DISPATCHER_BUFFER_FROM_DATA(buffer);
+    HT_DispatcherBuffer* free_buffer;
+    HT_DispatcherBuffer* copy;
+
+    ht_mutex_lock(dispatcher->mtx);
+
+    if (dispatcher->free_buffers == NULL)
+    {
+        /* the copy doesn't count towards the limit, as explicit flush must not drop
+         * the data, and it mustn't wait for listeners either */
+        dispatcher->queued_copies++;
+        ht_mutex_unlock(dispatcher->mtx);
+
+        copy = _ht_dispatcher_buffer_create(usage, HT_FALSE);
+        if (copy)
+        {
+            memcpy(HT_DISPATCHER_BUFFER_DATA(copy), buffer, usage);
+            copy->usage = usage;
+        }
+
+        ht_mutex_lock(dispatcher->mtx);
+        if (copy)
+        {
+            _ht_buffer_dispatcher_enqueue(dispatcher, copy);
+            ht_mutex_unlock(dispatcher->mtx);
+            return buffer;
+        }
+        dispatcher->queued_copies--;
+
+        /* out of memory, so the only option is to wait for a free buffer */
+        while (dispatcher->free_buffers == NULL)
+        {
+            ht_cond_var_wait(dispatcher->cond_var, dispatcher->mtx);
+        }
+    }
+
+    free_buffer = dispatcher->free_buffers;
+    dispatcher->free_buffers = free_buffer->next;
+
+    full_buffer->usage = usage;
+    _ht_buffer_dispatcher_enqueue(dispatcher, full_buffer);
+
+    ht_mutex_unlock(dispatcher->mtx);
+
+    return HT_DISPATCHER_BUFFER_DATA(free_buffer);
+}
+
+void
+ht_buffer_dispatcher_push_copy(HT_BufferDispatcher* dispatcher, const HT_Byte* data, size_t size)
+{
+    HT_DispatcherBuffer* buffer;
+
+    ht_mutex_lock(dispatcher->mtx);
+
+    while (dispatcher->queued_copies >= dispatcher->pool_depth)
+    {
+        if (dispatcher->policy == HT_ASYNC_FLUSH_POLICY_DROP)
+        {
+            dispatcher->dropped_count++;
+            ht_mutex_unlock(dispatcher->mtx);
+            return;
+        }
+        ht_cond_var_wait(dispatcher->cond_var, dispatcher->mtx);
+    }
+
+    /* the slot is reserved, so the copy can be allocated without the lock */
+    dispatcher->queued_copies++;
+    ht_mutex_unlock(dispatcher->mtx);
+
+    buffer = _ht_dispatcher_buffer_create(size, HT_FALSE);
+    if (buffer)
+    {
+        memcpy(HT_DISPATCHER_BUFFER_DATA(buffer), data, size);
+        buffer->usage = size;
+    }
+
+    ht_mutex_lock(dispatcher->mtx);
+    if (buffer)
+    {
+        _ht_buffer_dispatcher_enqueue(dispatcher, buffer);
+    }
+    else
+    {
+        dispatcher->queued_copies--;
+        dispatcher->dropped_count++;
+        ht_cond_var_notify_all(dispatcher->cond_var);
+    }
+    ht_mutex_unlock(dispatcher->mtx);
+}
+
+void
+ht_buffer_dispatcher_wait_idle(HT_BufferDispatcher* dispatcher)
+{
+    ht_mutex_lock(dispatcher->mtx);
+    while (dispatcher->queue_head != NULL || dispatcher->dispatching)
+    {
+        ht_cond_var_wait(dispatcher->cond_var, dispatcher->mtx);
+    }
+    ht_mutex_unlock(dispatcher->mtx);
+}
+
+uint64_t
+ht_buffer_dispatcher_get_dropped_count(HT_BufferDispatcher* dispatcher)
+{
+    uint64_t dropped_count;
+
+    ht_mutex_lock(dispatcher->mtx);
+    dropped_count = dispatcher->dropped_count;
+    ht_mutex_unlock(dispatcher->mtx);
+
+    return dropped_count;
+}
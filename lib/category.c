@@ -0,0 +1,126 @@
+#include "hawktracer/category.h"
+#include "internal/atomic.h"
+#include "internal/error.h"
+
+#include <string.h>
+
+volatile HT_Category _ht_category_enabled_mask = HT_CATEGORY_ALL;
+
+/* Categories are registered (also by the command line parser) before ht_init()
+ * creates mutexes, so the registry is protected by a spin lock. Registration
+ * is rare, and readers of the mask never take the lock. */
+static volatile long _ht_category_lock = 0;
+static char _ht_category_names[HT_CATEGORY_MAX_COUNT][HT_CATEGORY_MAX_NAME_LENGTH + 1];
+static size_t _ht_category_count = 0;
+
+#define HT_CATEGORY_LOCK_() while (ht_atomic_long_exchange(&_ht_category_lock, 1)) {}
+#define HT_CATEGORY_UNLOCK_() ht_atomic_long_exchange(&_ht_category_lock, 0)
+
+/* Must be called with the lock held. */
+static HT_Category
+_ht_category_register(const char* name, size_t length, HT_ErrorCode* out_err)
+{
+    size_t i;
+
+    if (length == 0 || length > HT_CATEGORY_MAX_NAME_LENGTH || (length == 3 && strncmp(name, "all", 3) == 0))
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    for (i = 0; i < _ht_category_count; i++)
+    {
+        if (strncmp(_ht_category_names[i], name, length) == 0 && _ht_category_names[i][length] == '\0')
+        {
+            HT_SET_ERROR(out_err, HT_ERR_OK);
+            return (HT_Category)1 << i;
+        }
+    }
+
+    if (_ht_category_count == HT_CATEGORY_MAX_COUNT)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_OUT_OF_RANGE);
+        return 0;
+    }
+
+    memcpy(_ht_category_names[_ht_category_count], name, length);
+    _ht_category_names[_ht_category_count][length] = '\0';
+
+    HT_SET_ERROR(out_err, HT_ERR_OK);
+    return (HT_Category)1 << _ht_category_count++;
+}
+
+/* Must be called with the lock held. */
+static void
+_ht_category_set_enabled(HT_Category categories, HT_Boolean enabled)
+{
+    HT_Category mask = ht_atomic_uint64_load(&_ht_category_enabled_mask);
+
+    ht_atomic_uint64_store(&_ht_category_enabled_mask, enabled ? (mask | categories) : (mask & ~categories));
+}
+
+HT_Category
+ht_category_register(const char* name, HT_ErrorCode* out_err)
+{
+    HT_Category category;
+
+    HT_CATEGORY_LOCK_();
+    category = _ht_category_register(name, strlen(name), out_err);
+    HT_CATEGORY_UNLOCK_();
+
+    return category;
+}
+
+void
+ht_category_set_enabled(HT_Category categories, HT_Boolean enabled)
+{
+    HT_CATEGORY_LOCK_();
+    _ht_category_set_enabled(categories, enabled);
+    HT_CATEGORY_UNLOCK_();
+}
+
+HT_ErrorCode
+ht_category_set_enabled_by_names(const char* names, HT_Boolean enabled)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+
+    HT_CATEGORY_LOCK_();
+
+    while (*names)
+    {
+        const char* end = strchr(names, ',');
+        size_t length = end ? (size_t)(end - names) : strlen(names);
+        HT_ErrorCode err;
+        HT_Category category;
+
+        if (length == 3 && strncmp(names, "all", 3) == 0)
+        {
+            category = HT_CATEGORY_ALL;
+        }
+        else
+        {
+            category = _ht_category_register(names, length, &err);
+            if (err != HT_ERR_OK && error_code == HT_ERR_OK)
+            {
+                error_code = err;
+            }
+        }
+        _ht_category_set_enabled(category, enabled);
+
+        names += length;
+        if (*names == ',')
+        {
+            names++;
+        }
+    }
+
+    HT_CATEGORY_UNLOCK_();
+
+    return error_code;
+}
+
+HT_Category
+ht_category_get_enabled(void)
+{
+    return ht_atomic_uint64_load(&_ht_category_enabled_mask);
+}
@@ -1,5 +1,6 @@
 #include "internal/command_line_parser.h"
 #include "internal/global_timeline.h"
+#include "hawktracer/category.h"
 
 #include <errno.h>
 #include <stdlib.h>
@@ -18,6 +19,9 @@ typedef struct
 
 static HT_ErrorCode print_help(int argc, char** argv, int pos);
 static HT_ErrorCode set_global_timeline_buffer_size(int argc, char** argv, int pos);
+static HT_ErrorCode enable_global_timeline_compact_serialization(int argc, char** argv, int pos);
+static HT_ErrorCode enable_categories(int argc, char** argv, int pos);
+static HT_ErrorCode disable_categories(int argc, char** argv, int pos);
 
 HT_CommandLineArgument arguments[] = {
     {
@@ -26,6 +30,24 @@ HT_CommandLineArgument arguments[] = {
         set_global_timeline_buffer_size,
         HT_FALSE
     },
+    {
+        "--ht-global-timeline-compact-serialization",
+        "Store events of Global Timeline in the compact format",
+        enable_global_timeline_compact_serialization,
+        HT_TRUE
+    },
+    {
+        "--ht-enable-categories",
+        "Enable comma-separated tracepoint categories ('all' for all of them)",
+        enable_categories,
+        HT_FALSE
+    },
+    {
+        "--ht-disable-categories",
+        "Disable comma-separated tracepoint categories ('all' for all of them)",
+        disable_categories,
+        HT_FALSE
+    },
     {
         "--ht-help", "Print this help and exits the process",
         print_help,
@@ -61,6 +83,39 @@ set_global_timeline_buffer_size(int argc, char** argv, int pos)
     return HT_ERR_OK;
 }
 
+static HT_ErrorCode
+enable_global_timeline_compact_serialization(int argc, char** argv, int pos)
+{
+    HT_UNUSED(argc);
+    HT_UNUSED(argv);
+    HT_UNUSED(pos);
+
+    ht_global_timeline_set_compact_serialization(HT_TRUE);
+    return HT_ERR_OK;
+}
+
+static HT_ErrorCode
+enable_categories(int argc, char** argv, int pos)
+{
+    if (pos + 1 >= argc)
+    {
+        return HT_ERR_MISSING_ARGUMENT;
+    }
+
+    return ht_category_set_enabled_by_names(argv[pos + 1], HT_TRUE);
+}
+
+static HT_ErrorCode
+disable_categories(int argc, char** argv, int pos)
+{
+    if (pos + 1 >= argc)
+    {
+        return HT_ERR_MISSING_ARGUMENT;
+    }
+
+    return ht_category_set_enabled_by_names(argv[pos + 1], HT_FALSE);
+}
+
 static HT_ErrorCode
 print_help(int argc, char** argv, int pos)
 {
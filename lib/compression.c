@@ -0,0 +1,353 @@
+#include "hawktracer/compression.h"
+
+#include <string.h>
+
+#define HT_COMPRESSION_MIN_MATCH 4
+/* the last match must start at least 12 bytes before the end of the block,
+ * and the last 5 bytes are always literals (LZ4 block format requirements) */
+#define HT_COMPRESSION_MF_LIMIT 12
+#define HT_COMPRESSION_LAST_LITERALS 5
+#define HT_COMPRESSION_MAX_DISTANCE 65535
+#define HT_COMPRESSION_HASH_LOG 12
+/* the longer the compressor doesn't find a match, the bigger steps it takes */
+#define HT_COMPRESSION_SKIP_TRIGGER 6
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define HT_COMPRESSION_FAST_MATCH
+#endif
+
+HT_INLINE static uint32_t
+_ht_compression_read32(const HT_Byte* ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+HT_INLINE static uint32_t
+_ht_compression_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HT_COMPRESSION_HASH_LOG);
+}
+
+HT_INLINE static HT_Byte*
+_ht_compression_write_length(HT_Byte* op, size_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (HT_Byte)length;
+
+    return op;
+}
+
+/* Returns a number of bytes which are equal in both sequences, up to the limit. */
+HT_INLINE static size_t
+_ht_compression_count_match(const HT_Byte* ip, const HT_Byte* ref, const HT_Byte* limit)
+{
+    const HT_Byte* start = ip;
+
+#ifdef HT_COMPRESSION_FAST_MATCH
+    while (ip + sizeof(uint64_t) <= limit)
+    {
+        uint64_t a, b;
+        memcpy(&a, ip, sizeof(a));
+        memcpy(&b, ref, sizeof(b));
+        if (a != b)
+        {
+            return (size_t)(ip - start) + (__builtin_ctzll(a ^ b) >> 3);
+        }
+        ip += sizeof(uint64_t);
+        ref += sizeof(uint64_t);
+    }
+#endif
+
+    while (ip < limit && *ip == *ref)
+    {
+        ip++;
+        ref++;
+    }
+
+    return (size_t)(ip - start);
+}
+
+size_t
+ht_compression_get_max_compressed_size(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t
+ht_compression_compress(const HT_Byte* src, size_t src_size,
+                        HT_Byte* dst, size_t dst_capacity,
+                        void* work_memory)
+{
+    uint32_t* table = (uint32_t*)work_memory;
+    const HT_Byte* ip = src;
+    const HT_Byte* anchor = src;
+    const HT_Byte* end = src + src_size;
+    const HT_Byte* mf_limit = end - HT_COMPRESSION_MF_LIMIT;
+    const HT_Byte* match_limit = end - HT_COMPRESSION_LAST_LITERALS;
+    HT_Byte* op = dst;
+    HT_Byte* op_end = dst + dst_capacity;
+    size_t literal_count;
+
+    if (src_size <= HT_COMPRESSION_MF_LIMIT)
+    {
+        goto last_literals;
+    }
+
+    memset(table, 0, HT_COMPRESSION_WORK_MEMORY_SIZE);
+
+    for (;;)
+    {
+        const HT_Byte* ref;
+        HT_Byte* token;
+        size_t search = 1 << HT_COMPRESSION_SKIP_TRIGGER;
+        size_t match_length;
+
+        /* find a match */
+        for (;;)
+        {
+            uint32_t hash;
+
+            if (ip > mf_limit)
+            {
+                goto last_literals;
+            }
+
+            hash = _ht_compression_hash(_ht_compression_read32(ip));
+            ref = src + table[hash];
+            table[hash] = (uint32_t)(ip - src);
+
+            if (ref < ip && ip - ref <= HT_COMPRESSION_MAX_DISTANCE
+                    && _ht_compression_read32(ref) == _ht_compression_read32(ip))
+            {
+                break;
+            }
+
+            ip += search++ >> HT_COMPRESSION_SKIP_TRIGGER;
+        }
+
+        while (ip > anchor && ref > src && ip[-1] == ref[-1])
+        {
+            ip--;
+            ref--;
+        }
+
+        /* literals */
+        literal_count = (size_t)(ip - anchor);
+        if ((size_t)(op_end - op) < 1 + literal_count + literal_count / 255 + 1 + 2)
+        {
+            return 0;
+        }
+
+        token = op++;
+        if (literal_count >= 15)
+        {
+            *token = 15 << 4;
+            op = _ht_compression_write_length(op, literal_count - 15);
+        }
+        else
+        {
+            *token = (HT_Byte)(literal_count << 4);
+        }
+        memcpy(op, anchor, literal_count);
+        op += literal_count;
+
+        /* match */
+        op[0] = (HT_Byte)((ip - ref) & 0xFF);
+        op[1] = (HT_Byte)((ip - ref) >> 8);
+        op += 2;
+
+        match_length = _ht_compression_count_match(
+                    ip + HT_COMPRESSION_MIN_MATCH, ref + HT_COMPRESSION_MIN_MATCH, match_limit);
+        ip += HT_COMPRESSION_MIN_MATCH + match_length;
+
+        if ((size_t)(op_end - op) < match_length / 255 + 1)
+        {
+            return 0;
+        }
+
+        if (match_length >= 15)
+        {
+            *token += 15;
+            op = _ht_compression_write_length(op, match_length - 15);
+        }
+        else
+        {
+            *token += (HT_Byte)match_length;
+        }
+
+        anchor = ip;
+
+        if (ip > mf_limit)
+        {
+            break;
+        }
+
+        table[_ht_compression_hash(_ht_compression_read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+    }
+
+last_literals:
+    literal_count = (size_t)(end - anchor);
+    if ((size_t)(op_end - op) < 1 + literal_count + literal_count / 255 + 1)
+    {
+        return 0;
+    }
+
+    if (literal_count >= 15)
+    {
+        *op++ = 15 << 4;
+        op = _ht_compression_write_length(op, literal_count - 15);
+    }
+    else
+    {
+        *op++ = (HT_Byte)(literal_count << 4);
+    }
+    memcpy(op, anchor, literal_count);
+    op += literal_count;
+
+    return (size_t)(op - dst);
+}
+
+HT_INLINE static HT_Boolean
+_ht_compression_read_length(const HT_Byte** ip, const HT_Byte* ip_end, size_t* length)
+{
+    HT_Byte b;
+
+    do
+    {
+        if (*ip >= ip_end)
+        {
+            return HT_FALSE;
+        }
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+
+    return HT_TRUE;
+}
+
+HT_ErrorCode
+ht_compression_decompress(const HT_Byte* src, size_t src_size,
+                          HT_Byte* dst, size_t dst_size)
+{
+    const HT_Byte* ip = src;
+    const HT_Byte* ip_end = src + src_size;
+    HT_Byte* op = dst;
+    HT_Byte* op_end = dst + dst_size;
+
+    while (ip < ip_end)
+    {
+        HT_Byte token = *ip++;
+        size_t literal_count = token >> 4;
+        size_t match_length = token & 15;
+        size_t offset;
+        const HT_Byte* ref;
+
+        if (literal_count == 15 && !_ht_compression_read_length(&ip, ip_end, &literal_count))
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+
+        if (literal_count > (size_t)(ip_end - ip) || literal_count > (size_t)(op_end - op))
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+        if (literal_count <= 16 && ip_end - ip >= 16 && op_end - op >= 16)
+        {
+            /* copying a fixed size is much faster than calling memcpy() for
+             * short literals; the bytes after the literals are overwritten later */
+            memcpy(op, ip, 16);
+        }
+        else
+        {
+            memcpy(op, ip, literal_count);
+        }
+        op += literal_count;
+        ip += literal_count;
+
+        /* the last sequence only contains literals */
+        if (ip == ip_end)
+        {
+            break;
+        }
+
+        if (ip_end - ip < 2)
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t)(op - dst))
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+
+        if (match_length == 15 && !_ht_compression_read_length(&ip, ip_end, &match_length))
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+        match_length += HT_COMPRESSION_MIN_MATCH;
+
+        if (match_length > (size_t)(op_end - op))
+        {
+            return HT_ERR_INVALID_FORMAT;
+        }
+
+        ref = op - offset;
+        if (offset >= 8 && (size_t)(op_end - op) >= match_length + 8)
+        {
+            /* the match might overlap with the output, but every 8-byte
+             * chunk is copied from the data which has already been written */
+            HT_Byte* match_end = op + match_length;
+            do
+            {
+                memcpy(op, ref, 8);
+                op += 8;
+                ref += 8;
+            } while (op < match_end);
+            op = match_end;
+        }
+        else
+        {
+            while (match_length--)
+            {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op == op_end ? HT_ERR_OK : HT_ERR_INVALID_FORMAT;
+}
+
+void
+ht_compression_write_frame_header(HT_Byte* header, uint32_t raw_size, uint32_t compressed_size)
+{
+    int i;
+
+    /* always little endian, so the stream can be read on any platform */
+    for (i = 0; i < 4; i++)
+    {
+        header[i] = (HT_Byte)(raw_size >> (8 * i));
+        header[4 + i] = (HT_Byte)(compressed_size >> (8 * i));
+    }
+}
+
+void
+ht_compression_read_frame_header(const HT_Byte* header, uint32_t* raw_size, uint32_t* compressed_size)
+{
+    int i;
+
+    *raw_size = 0;
+    *compressed_size = 0;
+    for (i = 0; i < 4; i++)
+    {
+        *raw_size |= (uint32_t)header[i] << (8 * i);
+        *compressed_size |= (uint32_t)header[4 + i] << (8 * i);
+    }
+}
@@ -1,5 +1,6 @@
 #include "hawktracer/event_id_provider.h"
 #include "hawktracer/alloc.h"
+#include "internal/atomic.h"
 
 #ifdef HT_CPP11
 #include <atomic>
@@ -11,8 +12,26 @@ typedef volatile HT_EventId HT_AtomicEventId;
 struct _HT_EventIdProvider
 {
     HT_AtomicEventId current_identifier;
+    size_t block_size;
+    /* 0 for the default provider */
+    uint64_t serial;
 };
 
+#define HT_EVENT_ID_PROVIDER_THREAD_CACHE_SIZE 4
+
+/* A block of identifiers claimed by a thread; identifiers [next, end) are
+ * not used yet. */
+typedef struct
+{
+    uint64_t serial;
+    HT_EventId next;
+    HT_EventId end;
+} HT_EventIdBlock;
+
+static HT_THREAD_LOCAL HT_EventIdBlock _ht_event_id_provider_thread_blocks[HT_EVENT_ID_PROVIDER_THREAD_CACHE_SIZE];
+
+static volatile uint64_t _ht_event_id_provider_last_serial = 0;
+
 HT_EventIdProvider*
 ht_event_id_provider_get_default(void)
 {
@@ -26,9 +45,43 @@ ht_event_id_provider_create(void)
 {
     HT_EventIdProvider* provider = HT_CREATE_TYPE(HT_EventIdProvider);
     provider->current_identifier = 0;
+    provider->block_size = 1;
+    provider->serial = ht_atomic_uint64_fetch_add(&_ht_event_id_provider_last_serial, 1) + 1;
     return provider;
 }
 
+void
+ht_event_id_provider_set_block_size(HT_EventIdProvider* provider, size_t block_size)
+{
+    provider->block_size = block_size;
+}
+
+static HT_EventId
+_ht_event_id_provider_claim_block(HT_EventIdProvider* provider, size_t block_size)
+{
+#ifdef HT_CPP11
+    return provider->current_identifier.fetch_add(block_size);
+#else
+    return ht_atomic_uint64_fetch_add(&provider->current_identifier, block_size);
+#endif
+}
+
+static HT_EventId
+_ht_event_id_provider_next_from_block(HT_EventIdProvider* provider, size_t block_size)
+{
+    HT_EventIdBlock* block = &_ht_event_id_provider_thread_blocks[provider->serial % HT_EVENT_ID_PROVIDER_THREAD_CACHE_SIZE];
+
+    /* If the slot is used by other provider, its remaining identifiers are abandoned. */
+    if (HT_UNLIKELY(block->serial != provider->serial || block->next == block->end))
+    {
+        block->serial = provider->serial;
+        block->next = _ht_event_id_provider_claim_block(provider, block_size);
+        block->end = block->next + block_size;
+    }
+
+    return block->next++;
+}
+
 void
 ht_event_id_provider_destroy(HT_EventIdProvider* provider)
 {
@@ -38,6 +91,13 @@ ht_event_id_provider_destroy(HT_EventIdProvider* provider)
 HT_EventId
 ht_event_id_provider_next(HT_EventIdProvider* provider)
 {
+    /* the default provider is zero-initialized, so block size 0 means 1 as well */
+    size_t block_size = provider->block_size;
+    if (block_size > 1)
+    {
+        return _ht_event_id_provider_next_from_block(provider, block_size);
+    }
+
 #ifdef HT_CPP11
     return provider->current_identifier++;
 #elif defined(__GNUC__)
@@ -2,6 +2,14 @@
 
 #include <string.h>
 
+size_t
+ht_event_utils_get_event_size(HT_Event* event, HT_Boolean serialize)
+{
+    HT_EventKlass* klass = HT_EVENT_GET_KLASS(event);
+
+    return serialize ? klass->get_size(event) : klass->type_info->size;
+}
+
 size_t
 ht_event_utils_serialize_event_to_buffer(HT_Event* event, HT_Byte* buffer, HT_Boolean serialize)
 {
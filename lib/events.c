@@ -7,7 +7,8 @@
 
 size_t HT_EVENT_GET_SIZE_FUNCTION(HT_Event)(HT_Event* event)
 {
-    return sizeof(event->klass->klass_id) + sizeof(event->timestamp) + sizeof(event->id);
+    (void)event;
+    return ht_HT_Event_fixed_size;
 }
 
 size_t HT_EVENT_SERIALIZE_FUNCTION(HT_Event)(HT_Event* event, HT_Byte* buffer)
@@ -21,5 +22,25 @@ size_t HT_EVENT_SERIALIZE_FUNCTION(HT_Event)(HT_Event* event, HT_Byte* buffer)
     return offset;
 }
 
+size_t HT_EVENT_TRY_SERIALIZE_FUNCTION(HT_Event)(HT_Event* event, HT_Byte* buffer, size_t capacity)
+{
+    return (size_t)ht_HT_Event_fixed_size <= capacity ?
+        HT_EVENT_SERIALIZE_FUNCTION(HT_Event)(event, buffer) : (size_t)ht_HT_Event_fixed_size;
+}
+
+size_t HT_EVENT_SERIALIZE_COMPACT_FUNCTION(HT_Event)(HT_Event* event, HT_Byte* buffer, HT_CompactContext* context)
+{
+    size_t offset = 0;
+
+    offset += ht_compact_write_uint(buffer + offset, event->klass->klass_id);
+    offset += ht_compact_write_int(buffer + offset, (int64_t)(event->timestamp - context->timestamp));
+    offset += ht_compact_write_int(buffer + offset, (int64_t)(event->id - context->id));
+
+    context->timestamp = event->timestamp;
+    context->id = event->id;
+
+    return offset;
+}
+
 HT_EVENT_GET_KLASS_INSTANCE_FUNCTION_DEF(HT_Event)
 HT_EVENT_REGISTER_KLASS_FUNCTION_DEF(HT_Event)
@@ -5,6 +5,7 @@
 #include "internal/bag.h"
 #include "internal/mutex.h"
 #include "internal/error.h"
+#include "internal/event_utils.h"
 #include "internal/feature.h"
 #include "internal/hash_map.h"
 
@@ -17,7 +18,9 @@ typedef struct
 {
     HT_Feature base;
     HT_Mutex* lock;
-    HT_HashMap dynamic_hashes;
+    /* dynamic labels are looked up on every tracepoint hit, so the map can
+     * be read without the lock; it's only modified under the lock */
+    HT_ConcurrentHashMap dynamic_hashes;
     HT_HashMap static_hashes;
 } HT_FeatureCachedString;
 
@@ -50,7 +53,7 @@ ht_feature_cached_string_create(HT_Boolean thread_safe, HT_ErrorCode* out_err)
     {
         goto static_hashes_failed;
     }
-    error_code = ht_hash_map_init(&feature->dynamic_hashes);
+    error_code = ht_concurrent_hash_map_init(&feature->dynamic_hashes);
     if (error_code != HT_ERR_OK)
     {
         goto dynamic_hashes_failed;
@@ -72,7 +75,7 @@ ht_feature_cached_string_create(HT_Boolean thread_safe, HT_ErrorCode* out_err)
     goto create_finished;
 
 lock_failed:
-    ht_hash_map_deinit(&feature->dynamic_hashes);
+    ht_concurrent_hash_map_deinit(&feature->dynamic_hashes);
 dynamic_hashes_failed:
     ht_hash_map_deinit(&feature->static_hashes);
 static_hashes_failed:
@@ -98,9 +101,9 @@ ht_feature_cached_string_destroy(HT_Feature* f)
 {
     HT_FeatureCachedString* feature = (HT_FeatureCachedString*)f;
 
-    ht_hash_map_for_each(&feature->dynamic_hashes, ht_feature_cached_string_destry_dynamic_labels, NULL);
+    ht_concurrent_hash_map_for_each(&feature->dynamic_hashes, ht_feature_cached_string_destry_dynamic_labels, NULL);
 
-    ht_hash_map_deinit(&feature->dynamic_hashes);
+    ht_concurrent_hash_map_deinit(&feature->dynamic_hashes);
     ht_hash_map_deinit(&feature->static_hashes);
     if (feature->lock)
     {
@@ -109,17 +112,18 @@ ht_feature_cached_string_destroy(HT_Feature* f)
     ht_free(feature);
 }
 
-static uintptr_t
-ht_feature_cached_string_add_mapping_(HT_Timeline* timeline, HT_HashMap* map, uintptr_t hash, const char* label)
+uintptr_t
+ht_feature_cached_string_add_mapping(HT_Timeline* timeline, const char* label)
 {
     HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
     HT_ErrorCode error_code;
+    uintptr_t hash = (uintptr_t)label;
 
     assert(f);
 
     HT_FCS_LOCK_(f);
 
-    const char* ret = ht_hash_map_insert(map, hash, label, &error_code);
+    const char* ret = ht_hash_map_insert(&f->static_hashes, hash, label, &error_code);
 
     HT_FCS_UNLOCK_(f);
     if (error_code != HT_ERR_OK)
@@ -134,61 +138,205 @@ ht_feature_cached_string_add_mapping_(HT_Timeline* timeline, HT_HashMap* map, ui
     return hash;
 }
 
-uintptr_t
-ht_feature_cached_string_add_mapping(HT_Timeline* timeline, const char* label)
+typedef struct
 {
-    HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
-    return ht_feature_cached_string_add_mapping_(timeline, &f->static_hashes, (uintptr_t)label, label);
-}
+    HT_BagUInt64 keys;
+    HT_BagVoidPtr labels;
+    HT_ErrorCode error_code;
+} HT_FeatureCachedStringSnapshot;
 
 static HT_Boolean
-ht_feature_cached_string_push_event(uint64_t key, const char* value, void* ud)
+ht_feature_cached_string_copy_mapping(uint64_t key, const char* value, void* ud)
 {
-    HT_TIMELINE_PUSH_EVENT((HT_Timeline*)ud, HT_StringMappingEvent, (uintptr_t)key, value);
-    return HT_TRUE;
+    HT_FeatureCachedStringSnapshot* snapshot = (HT_FeatureCachedStringSnapshot*)ud;
+
+    snapshot->error_code = ht_bag_uint64_add(&snapshot->keys, key);
+    if (snapshot->error_code == HT_ERR_OK)
+    {
+        snapshot->error_code = ht_bag_void_ptr_add(&snapshot->labels, (void*)value);
+    }
+
+    return snapshot->error_code == HT_ERR_OK;
 }
 
 void
 ht_feature_cached_string_push_map(HT_Timeline* timeline)
 {
     HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
+    HT_FeatureCachedStringSnapshot snapshot;
+    size_t i;
 
     assert(f);
 
+    if (ht_bag_uint64_init(&snapshot.keys, 64) != HT_ERR_OK)
+    {
+        return;
+    }
+    if (ht_bag_void_ptr_init(&snapshot.labels, 64) != HT_ERR_OK)
+    {
+        ht_bag_uint64_deinit(&snapshot.keys);
+        return;
+    }
+    snapshot.error_code = HT_ERR_OK;
+
+    /* Events are pushed after releasing the lock, as pushing an event might
+     * flush the timeline, and listeners might read the map, see
+     * ht_feature_cached_string_push_map_to_listener(). Labels are never
+     * released before the feature is destroyed, so they can be used outside of the lock. */
+    HT_FCS_LOCK_(f);
+    ht_hash_map_for_each(&f->static_hashes, ht_feature_cached_string_copy_mapping, &snapshot);
+    ht_concurrent_hash_map_for_each(&f->dynamic_hashes, ht_feature_cached_string_copy_mapping, &snapshot);
+    HT_FCS_UNLOCK_(f);
+
+    for (i = 0; i < ht_bag_size(snapshot.labels); i++)
+    {
+        HT_TIMELINE_PUSH_EVENT(timeline, HT_StringMappingEvent,
+                               (uintptr_t)ht_bag_nth(snapshot.keys, i),
+                               (const char*)ht_bag_nth(snapshot.labels, i));
+    }
+
+    ht_bag_void_ptr_deinit(&snapshot.labels);
+    ht_bag_uint64_deinit(&snapshot.keys);
+}
+
+typedef struct
+{
+    HT_TimelineListenerCallback callback;
+    void* listener;
+    HT_Boolean serialize;
+    size_t size;
+} HT_FeatureCachedStringListenerContext;
+
+static HT_Boolean
+ht_feature_cached_string_push_event_to_listener(uint64_t key, const char* value, void* ud)
+{
+    HT_FeatureCachedStringListenerContext* context = (HT_FeatureCachedStringListenerContext*)ud;
+    HT_DECL_EVENT(HT_StringMappingEvent, event);
+    HT_Byte buffer[256];
+    HT_Byte* data = buffer;
+    size_t data_size;
+
+    event.base.id = event.base.timestamp = 0;
+    event.identifier = key;
+    event.label = value;
+
+    data_size = context->serialize ? HT_EVENT_GET_KLASS(&event)->get_size(HT_EVENT(&event)) : sizeof(event);
+    if (data_size > sizeof(buffer))
+    {
+        data = (HT_Byte*)ht_alloc(data_size);
+        if (data == NULL)
+        {
+            return HT_FALSE;
+        }
+    }
+
+    data_size = ht_event_utils_serialize_event_to_buffer(HT_EVENT(&event), data, context->serialize);
+    context->callback(data, data_size, context->serialize, context->listener);
+    context->size += data_size;
+
+    if (data != buffer)
+    {
+        ht_free(data);
+    }
+
+    return HT_TRUE;
+}
+
+size_t
+ht_feature_cached_string_push_map_to_listener(HT_Timeline* timeline,
+                                              HT_TimelineListenerCallback callback,
+                                              void* listener,
+                                              HT_Boolean serialize)
+{
+    HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
+    HT_FeatureCachedStringListenerContext context;
+
+    if (f == NULL)
+    {
+        return 0;
+    }
+
+    context.callback = callback;
+    context.listener = listener;
+    context.serialize = serialize;
+    context.size = 0;
+
     HT_FCS_LOCK_(f);
+    ht_hash_map_for_each(&f->static_hashes, ht_feature_cached_string_push_event_to_listener, &context);
+    ht_concurrent_hash_map_for_each(&f->dynamic_hashes, ht_feature_cached_string_push_event_to_listener, &context);
+    HT_FCS_UNLOCK_(f);
+
+    return context.size;
+}
+
+size_t
+ht_feature_cached_string_get_mapping_count(HT_Timeline* timeline)
+{
+    HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
+    size_t count;
 
-    ht_hash_map_for_each(&f->static_hashes, ht_feature_cached_string_push_event, timeline);
-    ht_hash_map_for_each(&f->dynamic_hashes, ht_feature_cached_string_push_event, timeline);
+    if (f == NULL)
+    {
+        return 0;
+    }
 
+    HT_FCS_LOCK_(f);
+    count = f->static_hashes.size + f->dynamic_hashes.size;
     HT_FCS_UNLOCK_(f);
+
+    return count;
 }
 
 uintptr_t
 ht_feature_cached_string_add_mapping_dynamic(HT_Timeline* timeline, const char* label)
+{
+    return ht_feature_cached_string_add_hashed_mapping(timeline, label, djb2_hash(label));
+}
+
+uintptr_t
+ht_feature_cached_string_add_hashed_mapping(HT_Timeline* timeline, const char* label, uintptr_t hash_value)
 {
     HT_FeatureCachedString* f = HT_FeatureCachedString_from_timeline(timeline);
-    uintptr_t hash_value;
+    HT_Boolean inserted = HT_FALSE;
+    char* new_label = NULL;
 
     assert(f);
 
-    hash_value = djb2_hash(label);
+    /* fast path: the label has been mapped already */
+    if (ht_concurrent_hash_map_get_value(&f->dynamic_hashes, hash_value) != NULL)
+    {
+        return hash_value;
+    }
 
     HT_FCS_LOCK_(f);
 
-    if (ht_hash_map_get_value(&f->dynamic_hashes, hash_value) == NULL)
+    /* another thread might have added the label in the meantime */
+    if (ht_concurrent_hash_map_get_value(&f->dynamic_hashes, hash_value) == NULL)
     {
-        HT_FCS_UNLOCK_(f);
-
         size_t label_len = strlen(label);
-        char* new_label = (char*)ht_alloc(label_len + 1);
-        memcpy(new_label, label, label_len);
-        new_label[label_len] = 0;
-
-        ht_feature_cached_string_add_mapping_(timeline, &f->dynamic_hashes, hash_value, new_label);
+        new_label = (char*)ht_alloc(label_len + 1);
+        if (new_label != NULL)
+        {
+            HT_ErrorCode error_code;
+
+            memcpy(new_label, label, label_len + 1);
+            ht_concurrent_hash_map_insert(&f->dynamic_hashes, hash_value, new_label, &error_code);
+            if (error_code == HT_ERR_OK)
+            {
+                inserted = HT_TRUE;
+            }
+            else
+            {
+                ht_free(new_label);
+            }
+        }
     }
-    else
+
+    HT_FCS_UNLOCK_(f);
+
+    if (inserted)
     {
-        HT_FCS_UNLOCK_(f);
+        HT_TIMELINE_PUSH_EVENT(timeline, HT_StringMappingEvent, hash_value, new_label);
     }
 
     return hash_value;
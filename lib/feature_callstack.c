@@ -1,26 +1,171 @@
 #include "hawktracer/feature_callstack.h"
 #include "hawktracer/alloc.h"
 #include "hawktracer/thread.h"
+#include "internal/atomic.h"
 #include "internal/stack.h"
 #include "internal/error.h"
 #include "internal/feature.h"
+#include "internal/thread.h"
+#include "internal/feature_callstack_aggregation.h"
+
+#include <string.h>
+
+typedef struct _HT_FeatureCallstackThreadStack HT_FeatureCallstackThreadStack;
 
 typedef struct
 {
-    HT_Feature base;
+    uint64_t path_id;
+    HT_DurationNs children_duration;
+    /* HT_FALSE if the frame is pushed to the timeline, and its path is the parent's one */
+    HT_Boolean aggregated;
+} HT_FeatureCallstackPathFrame;
+
+#define HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE 32
+
+typedef struct
+{
+    HT_CallstackEventLabel label;
+    /* 0 if the slot is empty */
+    uint64_t count;
+} HT_FeatureCallstackFilteredLabel;
+
+/* States of the thread stack; see HT_TimelineThreadContextState in timeline.c,
+ * thread stacks are released and detached the same way. */
+typedef enum
+{
+    HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE = 0,
+    HT_FEATURE_CALLSTACK_THREAD_STACK_EXITING,
+    HT_FEATURE_CALLSTACK_THREAD_STACK_FREE,
+    HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHING,
+    HT_FEATURE_CALLSTACK_THREAD_STACK_ORPHANED,
+    HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHED
+} HT_FeatureCallstackThreadStackState;
+
+/* Every thread using the feature has its own stack, so scoped tracepoints
+ * from different threads can be used with a single (thread-safe) timeline.
+ * Frames of a stack are released when its thread exits, and the stack can
+ * be taken by another thread. */
+struct _HT_FeatureCallstackThreadStack
+{
+    HT_FeatureCallstackThreadStack* next;
+    /* NULL if the stack is free */
+    void* volatile thread_key;
+    /* Identifies the owner thread, as the key of an exited thread might be re-used. */
+    uint64_t thread_serial;
+    volatile long state;
+    /* Stacks of all the features used by the thread; only accessed by the owner thread. */
+    HT_FeatureCallstackThreadStack* thread_next;
+    HT_Boolean in_thread_list;
+    /* HT_TRUE if the feature has a fixed depth */
+    HT_Boolean fixed_depth;
+    /* Used if the feature doesn't have a fixed depth. */
     HT_Stack stack;
+    /* Used if the feature has a fixed depth: max_depth slots, frame_size bytes each.
+     * A slot of an event which is too big for it has the klass set to NULL. */
+    HT_Byte* frames;
+    /* Number of frames on the stack (in both modes). */
+    size_t depth;
+    /* Number of frames started on top of a full stack, which haven't been stopped yet. */
+    size_t overflow_depth;
+    /* Number of frames dropped since the last overflow event. */
+    uint64_t dropped_count;
+    /* Used if the aggregation feature is enabled. Frames above path_capacity
+     * (i.e. the stack couldn't grow) are not aggregated. */
+    HT_FeatureCallstackPathFrame* path_frames;
+    size_t path_capacity;
+    size_t path_depth;
+    /* Numbers of frames dropped because of the duration threshold since the last
+     * report, per label. Frames without an integer label, and frames which don't
+     * fit into the table, are counted separately and reported with the label 0. */
+    HT_FeatureCallstackFilteredLabel filtered_labels[HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE];
+    uint64_t filtered_other_count;
+    uint64_t filtered_count;
+    HT_TimestampNs filtered_since;
+    /* Sampling is decided for root frames only, all the frames started by a root
+     * frame share its decision. unsampled_depth is a number of frames of a skipped
+     * subtree which haven't been stopped yet, sampled_weight is a weight of the frames
+     * of the current sampled subtree. */
+    size_t unsampled_depth;
+    uint32_t sampled_weight;
+    uint32_t sampling_counter;
+};
+
+typedef struct
+{
+    HT_CallstackEventLabel label;
+    HT_DurationNs threshold;
+} HT_FeatureCallstackLabelThreshold;
+
+typedef struct _HT_FeatureCallstackLabelThresholds HT_FeatureCallstackLabelThresholds;
+
+/* Tables are never modified once published, a new one is created for every
+ * change. Old tables might still be read by other threads, so they're only
+ * released when the feature is destroyed. */
+struct _HT_FeatureCallstackLabelThresholds
+{
+    HT_FeatureCallstackLabelThresholds* next_retired;
+    size_t count;
+    /* sorted by label */
+    HT_FeatureCallstackLabelThreshold* entries;
+};
+
+/* the entries are allocated right after the table */
+#define HT_FEATURE_CALLSTACK_LABEL_THRESHOLDS_HEADER_SIZE \
+    ((sizeof(HT_FeatureCallstackLabelThresholds) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t))
+
+typedef struct
+{
+    HT_Feature base;
+    uint64_t serial;
+    /* 0 if the stacks grow as needed */
+    size_t max_depth;
+    size_t frame_size;
+    HT_FeatureCallstackThreadStack* thread_stacks;
+    /* frames shorter than the threshold are not pushed to the timeline */
+    volatile uint64_t duration_threshold;
+    volatile uint64_t filtered_report_interval;
+    HT_FeatureCallstackLabelThresholds* label_thresholds;
+    HT_FeatureCallstackLabelThresholds* retired_label_thresholds;
+    /* root frames are sampled 1 in sampling_rate, or if they start within
+     * the first sampling_window nanoseconds of every sampling_period */
+    volatile uint64_t sampling_rate;
+    volatile uint64_t sampling_window;
+    volatile uint64_t sampling_period;
 } HT_FeatureCallstack;
 
+#define HT_FEATURE_CALLSTACK_THREAD_CACHE_SIZE 4
+
+typedef struct
+{
+    uint64_t serial;
+    HT_FeatureCallstackThreadStack* thread_stack;
+} HT_FeatureCallstackThreadCacheEntry;
+
+/* The address of the cache is also used as a key identifying the thread. */
+static HT_THREAD_LOCAL HT_FeatureCallstackThreadCacheEntry _ht_feature_callstack_thread_cache[HT_FEATURE_CALLSTACK_THREAD_CACHE_SIZE];
+
+/* Stacks owned by the current thread, linked by thread_next; released when the thread exits. */
+static HT_THREAD_LOCAL HT_FeatureCallstackThreadStack* _ht_feature_callstack_thread_stacks;
+static HT_THREAD_LOCAL HT_Boolean _ht_feature_callstack_thread_exit_registered;
+/* 0 until the thread uses the feature for the first time */
+static HT_THREAD_LOCAL uint64_t _ht_feature_callstack_thread_serial;
+
+static volatile uint64_t _ht_feature_callstack_last_thread_serial = 0;
+
+static volatile uint64_t _ht_feature_callstack_last_serial = 0;
+
 static void
 ht_feature_callstack_destroy(HT_Feature* feature);
 
 HT_FEATURE_DEFINE(HT_FeatureCallstack, ht_feature_callstack_destroy)
 
+static HT_INLINE HT_FeatureCallstackThreadStack*
+_ht_feature_callstack_get_thread_stack(HT_FeatureCallstack* f);
+
 static HT_Feature*
-ht_feature_callstack_create(HT_ErrorCode* out_err)
+ht_feature_callstack_create(size_t max_depth, size_t frame_size, HT_ErrorCode* out_err)
 {
     HT_FeatureCallstack* feature = HT_FeatureCallstack_alloc();
-    HT_ErrorCode error_code = HT_ERR_OK;
 
     if (feature == NULL)
     {
@@ -28,49 +173,753 @@ ht_feature_callstack_create(HT_ErrorCode* out_err)
         return NULL;
     }
 
-    error_code = ht_stack_init(&feature->stack, 1024, 32);
+    /* serials are never 0, so an empty cache entry never matches */
+    feature->serial = ht_atomic_uint64_fetch_add(&_ht_feature_callstack_last_serial, 1) + 1;
+    feature->max_depth = max_depth;
+    /* keep the slots aligned, so events can be accessed in place */
+    feature->frame_size = (frame_size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    feature->thread_stacks = NULL;
+    feature->duration_threshold = 0;
+    feature->filtered_report_interval = 0;
+    feature->label_thresholds = NULL;
+    feature->retired_label_thresholds = NULL;
+    feature->sampling_rate = 0;
+    feature->sampling_window = 0;
+    feature->sampling_period = 0;
 
-    if (error_code != HT_ERR_OK)
+    /* the stack for the thread enabling the feature is created right away,
+     * so the lack of memory is reported early */
+    if (_ht_feature_callstack_get_thread_stack(feature) == NULL)
     {
         ht_free(feature);
-        feature = NULL;
+        HT_SET_ERROR(out_err, HT_ERR_OUT_OF_MEMORY);
+        return NULL;
     }
 
-    HT_SET_ERROR(out_err, error_code);
+    HT_SET_ERROR(out_err, HT_ERR_OK);
 
     return (HT_Feature*)feature;
 }
 
+static HT_Boolean
+_ht_feature_callstack_thread_stack_alloc_frames(HT_FeatureCallstack* f, HT_FeatureCallstackThreadStack* thread_stack)
+{
+    thread_stack->fixed_depth = f->max_depth ? HT_TRUE : HT_FALSE;
+    thread_stack->frames = NULL;
+    thread_stack->path_frames = NULL;
+    thread_stack->path_capacity = 0;
+    if (thread_stack->fixed_depth)
+    {
+        thread_stack->frames = (HT_Byte*)ht_alloc(f->max_depth * f->frame_size);
+        return thread_stack->frames != NULL;
+    }
+
+    return ht_stack_init(&thread_stack->stack, 1024, 32) == HT_ERR_OK;
+}
+
+static void
+_ht_feature_callstack_thread_stack_free_frames(HT_FeatureCallstackThreadStack* thread_stack)
+{
+    ht_free(thread_stack->path_frames);
+    thread_stack->path_frames = NULL;
+    if (thread_stack->fixed_depth)
+    {
+        ht_free(thread_stack->frames);
+        thread_stack->frames = NULL;
+    }
+    else
+    {
+        ht_stack_deinit(&thread_stack->stack);
+    }
+}
+
+/* Drops all the frames and the statistics, so the stack can be used by a new thread. */
+static void
+_ht_feature_callstack_thread_stack_reset(HT_FeatureCallstackThreadStack* thread_stack)
+{
+    if (!thread_stack->fixed_depth)
+    {
+        while (thread_stack->stack.sizes_stack.size > 0)
+        {
+            ht_stack_pop(&thread_stack->stack);
+        }
+    }
+    thread_stack->depth = 0;
+    thread_stack->overflow_depth = 0;
+    thread_stack->dropped_count = 0;
+    thread_stack->path_depth = 0;
+    memset(thread_stack->filtered_labels, 0, sizeof(thread_stack->filtered_labels));
+    thread_stack->filtered_other_count = 0;
+    thread_stack->filtered_count = 0;
+    thread_stack->filtered_since = 0;
+    thread_stack->unsampled_depth = 0;
+    thread_stack->sampled_weight = 1;
+    thread_stack->sampling_counter = 0;
+}
+
+/* Called by the thread when it exits; releases the frames of its stacks. */
+static void
+_ht_feature_callstack_thread_exit(void* user_data)
+{
+    HT_FeatureCallstackThreadStack* thread_stack = _ht_feature_callstack_thread_stacks;
+    (void)user_data;
+
+    /* the thread might still use the feature (e.g. in destructors of other thread-local objects),
+     * it must not use the released stacks then */
+    memset(_ht_feature_callstack_thread_cache, 0, sizeof(_ht_feature_callstack_thread_cache));
+    _ht_feature_callstack_thread_stacks = NULL;
+    _ht_feature_callstack_thread_exit_registered = HT_FALSE;
+
+    while (thread_stack)
+    {
+        HT_FeatureCallstackThreadStack* next = thread_stack->thread_next;
+
+        thread_stack->thread_next = NULL;
+        if (ht_atomic_long_compare_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE, HT_FEATURE_CALLSTACK_THREAD_STACK_EXITING))
+        {
+            _ht_feature_callstack_thread_stack_free_frames(thread_stack);
+            thread_stack->in_thread_list = HT_FALSE;
+            ht_atomic_ptr_store(&thread_stack->thread_key, NULL);
+            ht_atomic_long_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_FREE);
+        }
+        else if (!ht_atomic_long_compare_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHING, HT_FEATURE_CALLSTACK_THREAD_STACK_ORPHANED))
+        {
+            /* HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHED */
+            ht_free(thread_stack);
+        }
+
+        thread_stack = next;
+    }
+}
+
+/* Frees stacks of destroyed features, so the list doesn't grow if the thread uses many features. */
+static void
+_ht_feature_callstack_prune_thread_stacks(void)
+{
+    HT_FeatureCallstackThreadStack** thread_stack = &_ht_feature_callstack_thread_stacks;
+
+    while (*thread_stack)
+    {
+        HT_FeatureCallstackThreadStack* current = *thread_stack;
+        if (ht_atomic_long_load(&current->state) == HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHED)
+        {
+            *thread_stack = current->thread_next;
+            ht_free(current);
+        }
+        else
+        {
+            thread_stack = &current->thread_next;
+        }
+    }
+}
+
+/* Detaches the stack from its thread (if the thread is still running). */
+static void
+_ht_feature_callstack_thread_stack_detach(HT_FeatureCallstackThreadStack* thread_stack)
+{
+    for (;;)
+    {
+        long state = ht_atomic_long_load(&thread_stack->state);
+
+        if (state == HT_FEATURE_CALLSTACK_THREAD_STACK_EXITING)
+        {
+            /* the thread is just releasing the frames */
+            continue;
+        }
+
+        if (state != HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE || !thread_stack->in_thread_list
+                || ht_atomic_long_compare_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE, HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHING))
+        {
+            return;
+        }
+    }
+}
+
 static void
 ht_feature_callstack_destroy(HT_Feature* feature)
 {
     HT_FeatureCallstack* f = (HT_FeatureCallstack*)feature;
-    ht_stack_deinit(&f->stack);
+
+    while (f->thread_stacks)
+    {
+        HT_FeatureCallstackThreadStack* next = f->thread_stacks->next;
+        _ht_feature_callstack_thread_stack_detach(f->thread_stacks);
+        /* frames of free stacks are already released */
+        if (ht_atomic_long_load(&f->thread_stacks->state) != HT_FEATURE_CALLSTACK_THREAD_STACK_FREE)
+        {
+            _ht_feature_callstack_thread_stack_free_frames(f->thread_stacks);
+        }
+        /* if the thread is still running, it frees the stack once it exits */
+        if (!ht_atomic_long_compare_exchange(&f->thread_stacks->state, HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHING, HT_FEATURE_CALLSTACK_THREAD_STACK_DETACHED))
+        {
+            ht_free(f->thread_stacks);
+        }
+        f->thread_stacks = next;
+    }
+    while (f->retired_label_thresholds)
+    {
+        HT_FeatureCallstackLabelThresholds* next = f->retired_label_thresholds->next_retired;
+        ht_free(f->retired_label_thresholds);
+        f->retired_label_thresholds = next;
+    }
+    ht_free(f->label_thresholds);
     ht_free(f);
 }
 
-void
-ht_feature_callstack_start(HT_Timeline* timeline, HT_CallstackBaseEvent* event)
+static void
+_ht_feature_callstack_thread_stack_attach(HT_FeatureCallstackThreadStack* thread_stack, const void* thread_key)
 {
-    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+    ht_atomic_ptr_store(&thread_stack->thread_key, (void*)thread_key);
+    thread_stack->thread_serial = _ht_feature_callstack_thread_serial;
+    thread_stack->in_thread_list = _ht_feature_callstack_thread_exit_registered;
+    if (thread_stack->in_thread_list)
+    {
+        thread_stack->thread_next = _ht_feature_callstack_thread_stacks;
+        _ht_feature_callstack_thread_stacks = thread_stack;
+    }
+}
+
+/* Takes a stack released by an exited thread. */
+static HT_FeatureCallstackThreadStack*
+_ht_feature_callstack_take_free_thread_stack(HT_FeatureCallstack* f, const void* thread_key)
+{
+    HT_FeatureCallstackThreadStack* thread_stack = (HT_FeatureCallstackThreadStack*)ht_atomic_ptr_load((void* volatile*)&f->thread_stacks);
+
+    for (; thread_stack; thread_stack = thread_stack->next)
+    {
+        if (ht_atomic_long_load(&thread_stack->state) != HT_FEATURE_CALLSTACK_THREAD_STACK_FREE
+                || !ht_atomic_long_compare_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_FREE, HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE))
+        {
+            continue;
+        }
+
+        if (!_ht_feature_callstack_thread_stack_alloc_frames(f, thread_stack))
+        {
+            ht_atomic_long_exchange(&thread_stack->state, HT_FEATURE_CALLSTACK_THREAD_STACK_FREE);
+            return NULL;
+        }
+
+        _ht_feature_callstack_thread_stack_reset(thread_stack);
+        _ht_feature_callstack_thread_stack_attach(thread_stack, thread_key);
+        return thread_stack;
+    }
+
+    return NULL;
+}
+
+static HT_FeatureCallstackThreadStack*
+_ht_feature_callstack_find_or_create_thread_stack(HT_FeatureCallstack* f, const void* thread_key)
+{
+    HT_FeatureCallstackThreadStack* thread_stack = (HT_FeatureCallstackThreadStack*)ht_atomic_ptr_load((void* volatile*)&f->thread_stacks);
+
+    if (_ht_feature_callstack_thread_serial == 0)
+    {
+        _ht_feature_callstack_thread_serial = ht_atomic_uint64_fetch_add(&_ht_feature_callstack_last_thread_serial, 1) + 1;
+    }
+
+    /* If the thread exit callback couldn't be registered, the key of an exited thread
+     * might be re-used by a new one; in that case the new thread takes over the stack,
+     * and the frames left by the exited thread are dropped. */
+    for (; thread_stack; thread_stack = thread_stack->next)
+    {
+        if (ht_atomic_ptr_load(&thread_stack->thread_key) == thread_key
+                && ht_atomic_long_load(&thread_stack->state) == HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE)
+        {
+            if (thread_stack->thread_serial != _ht_feature_callstack_thread_serial)
+            {
+                _ht_feature_callstack_thread_stack_reset(thread_stack);
+                thread_stack->thread_serial = _ht_feature_callstack_thread_serial;
+            }
+            return thread_stack;
+        }
+    }
+
+    _ht_feature_callstack_prune_thread_stacks();
+
+    if (!_ht_feature_callstack_thread_exit_registered)
+    {
+        _ht_feature_callstack_thread_exit_registered = ht_thread_register_exit_callback(_ht_feature_callstack_thread_exit, NULL);
+    }
+
+    if (_ht_feature_callstack_thread_exit_registered)
+    {
+        thread_stack = _ht_feature_callstack_take_free_thread_stack(f, thread_key);
+        if (thread_stack != NULL)
+        {
+            return thread_stack;
+        }
+    }
+
+    thread_stack = HT_CREATE_TYPE(HT_FeatureCallstackThreadStack);
+    if (thread_stack == NULL)
+    {
+        return NULL;
+    }
+
+    thread_stack->state = HT_FEATURE_CALLSTACK_THREAD_STACK_ACTIVE;
+    thread_stack->thread_next = NULL;
+    if (!_ht_feature_callstack_thread_stack_alloc_frames(f, thread_stack))
+    {
+        ht_free(thread_stack);
+        return NULL;
+    }
+    _ht_feature_callstack_thread_stack_reset(thread_stack);
+    _ht_feature_callstack_thread_stack_attach(thread_stack, thread_key);
+
+    do
+    {
+        thread_stack->next = (HT_FeatureCallstackThreadStack*)ht_atomic_ptr_load((void* volatile*)&f->thread_stacks);
+    } while (!ht_atomic_ptr_compare_exchange((void* volatile*)&f->thread_stacks, thread_stack->next, thread_stack));
+
+    return thread_stack;
+}
+
+static HT_INLINE HT_FeatureCallstackThreadStack*
+_ht_feature_callstack_get_thread_stack(HT_FeatureCallstack* f)
+{
+    HT_FeatureCallstackThreadCacheEntry* entry = &_ht_feature_callstack_thread_cache[f->serial % HT_FEATURE_CALLSTACK_THREAD_CACHE_SIZE];
+
+    if (HT_UNLIKELY(entry->serial != f->serial))
+    {
+        HT_FeatureCallstackThreadStack* thread_stack = _ht_feature_callstack_find_or_create_thread_stack(f, _ht_feature_callstack_thread_cache);
+        if (thread_stack == NULL)
+        {
+            return NULL;
+        }
+        entry->serial = f->serial;
+        entry->thread_stack = thread_stack;
+    }
+
+    return entry->thread_stack;
+}
+
+/* Frames with an integer label (sampled or not) can be aggregated and filtered per label. */
+static HT_INLINE HT_Boolean
+_ht_feature_callstack_has_int_label(HT_CallstackBaseEvent* event)
+{
+    HT_EventKlass* klass = HT_EVENT(event)->klass;
+
+    return klass == ht_HT_CallstackIntEvent_get_event_klass_instance()
+            || klass == ht_HT_CallstackSampledIntEvent_get_event_klass_instance();
+}
+
+/* Returns a number of frames the event stands for. */
+static HT_INLINE uint32_t
+_ht_feature_callstack_get_weight(HT_CallstackBaseEvent* event)
+{
+    HT_EventKlass* klass = HT_EVENT(event)->klass;
+
+    if (klass == ht_HT_CallstackSampledIntEvent_get_event_klass_instance())
+    {
+        return ((HT_CallstackSampledIntEvent*)event)->weight;
+    }
+    if (klass == ht_HT_CallstackSampledStringEvent_get_event_klass_instance())
+    {
+        return ((HT_CallstackSampledStringEvent*)event)->weight;
+    }
+
+    return 1;
+}
+
+static void
+_ht_feature_callstack_push_overflow_event(HT_Timeline* timeline, HT_FeatureCallstackThreadStack* thread_stack)
+{
+    HT_DECL_EVENT(HT_CallstackOverflowEvent, event);
+
+    ht_timeline_init_event(timeline, HT_EVENT(&event));
+    event.thread_id = ht_thread_get_current_thread_id();
+    event.dropped_count = thread_stack->dropped_count;
+    thread_stack->dropped_count = 0;
+
+    ht_timeline_push_event(timeline, HT_EVENT(&event));
+}
+
+static void
+_ht_feature_callstack_push_path(HT_FeatureCallstack* f, HT_FeatureCallstackThreadStack* thread_stack, HT_CallstackBaseEvent* event)
+{
+    size_t depth = thread_stack->path_depth++;
+    HT_FeatureCallstackPathFrame* frame;
+    uint64_t parent_path_id;
+
+    if (depth >= thread_stack->path_capacity)
+    {
+        /* in the fixed depth mode, the stack is allocated once with the maximum depth */
+        size_t capacity = f->max_depth ? f->max_depth : (thread_stack->path_capacity ? thread_stack->path_capacity * 2 : 32);
+        HT_FeatureCallstackPathFrame* path_frames;
+
+        /* frames between the capacity and the depth haven't been stored, the stack
+         * can't grow until they're stopped */
+        if (depth > thread_stack->path_capacity || depth >= capacity)
+        {
+            return;
+        }
+        path_frames = (HT_FeatureCallstackPathFrame*)ht_realloc(
+                    thread_stack->path_frames, capacity * sizeof(HT_FeatureCallstackPathFrame));
+        if (path_frames == NULL)
+        {
+            return;
+        }
+        thread_stack->path_frames = path_frames;
+        thread_stack->path_capacity = capacity;
+    }
+
+    parent_path_id = depth ? thread_stack->path_frames[depth - 1].path_id : 0;
+    frame = &thread_stack->path_frames[depth];
+    frame->children_duration = 0;
+    frame->aggregated = _ht_feature_callstack_has_int_label(event);
+    frame->path_id = frame->aggregated ?
+                ht_feature_callstack_aggregation_get_path_id(parent_path_id, ((HT_CallstackIntEvent*)event)->label) :
+                parent_path_id;
+}
+
+/* Returns HT_TRUE if the frame has been aggregated, so it must not be pushed to the timeline. */
+static HT_Boolean
+_ht_feature_callstack_pop_path(HT_Timeline* timeline, HT_FeatureCallstackAggregation* aggregation,
+                               HT_FeatureCallstackThreadStack* thread_stack, HT_CallstackBaseEvent* event)
+{
+    size_t depth;
+    HT_FeatureCallstackPathFrame* frame;
+    uint64_t parent_path_id = 0;
+
+    if (thread_stack->path_depth == 0)
+    {
+        /* the frame has been started before enabling the aggregation */
+        return HT_FALSE;
+    }
+
+    depth = --thread_stack->path_depth;
+    if (depth > 0 && depth - 1 < thread_stack->path_capacity)
+    {
+        thread_stack->path_frames[depth - 1].children_duration += event->duration;
+        parent_path_id = thread_stack->path_frames[depth - 1].path_id;
+    }
+    if (depth >= thread_stack->path_capacity || !thread_stack->path_frames[depth].aggregated)
+    {
+        return HT_FALSE;
+    }
+
+    frame = &thread_stack->path_frames[depth];
+    return ht_feature_callstack_aggregation_add(timeline, aggregation, frame->path_id, parent_path_id,
+                                                ((HT_CallstackIntEvent*)event)->label, event->duration,
+                                                event->duration > frame->children_duration ? event->duration - frame->children_duration : 0,
+                                                _ht_feature_callstack_get_weight(event), HT_EVENT(event)->timestamp + event->duration);
+}
+
+static HT_DurationNs
+_ht_feature_callstack_get_duration_threshold(HT_FeatureCallstack* f, HT_CallstackBaseEvent* event)
+{
+    HT_DurationNs threshold = ht_atomic_uint64_load(&f->duration_threshold);
+    HT_FeatureCallstackLabelThresholds* thresholds =
+            (HT_FeatureCallstackLabelThresholds*)ht_atomic_ptr_load((void* volatile*)&f->label_thresholds);
+    HT_CallstackEventLabel label;
+    size_t begin = 0, end;
+
+    if (thresholds == NULL || !_ht_feature_callstack_has_int_label(event))
+    {
+        return threshold;
+    }
+
+    label = ((HT_CallstackIntEvent*)event)->label;
+    end = thresholds->count;
+    while (begin < end)
+    {
+        size_t middle = begin + (end - begin) / 2;
+        if (thresholds->entries[middle].label < label)
+        {
+            begin = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return (begin < thresholds->count && thresholds->entries[begin].label == label) ?
+                thresholds->entries[begin].threshold : threshold;
+}
+
+static void
+_ht_feature_callstack_count_filtered(HT_FeatureCallstackThreadStack* thread_stack,
+                                     HT_CallstackBaseEvent* event, HT_TimestampNs timestamp)
+{
+    uint32_t weight = _ht_feature_callstack_get_weight(event);
+    HT_CallstackEventLabel label;
+    size_t slot, i;
+
+    if (thread_stack->filtered_count++ == 0)
+    {
+        thread_stack->filtered_since = timestamp;
+    }
+
+    if (!_ht_feature_callstack_has_int_label(event))
+    {
+        thread_stack->filtered_other_count += weight;
+        return;
+    }
+
+    label = ((HT_CallstackIntEvent*)event)->label;
+    slot = (size_t)(label % HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE);
+    for (i = 0; i < HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE; i++)
+    {
+        HT_FeatureCallstackFilteredLabel* entry = &thread_stack->filtered_labels[(slot + i) % HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE];
+        if (entry->count == 0 || entry->label == label)
+        {
+            entry->label = label;
+            entry->count += weight;
+            return;
+        }
+    }
+
+    thread_stack->filtered_other_count += weight;
+}
+
+static void
+_ht_feature_callstack_push_filtered_events(HT_Timeline* timeline, HT_FeatureCallstackThreadStack* thread_stack)
+{
+    HT_ThreadId thread_id = ht_thread_get_current_thread_id();
+    size_t i;
+
+    for (i = 0; i < HT_FEATURE_CALLSTACK_FILTERED_LABELS_SIZE; i++)
+    {
+        HT_FeatureCallstackFilteredLabel* entry = &thread_stack->filtered_labels[i];
+        if (entry->count)
+        {
+            HT_TIMELINE_PUSH_EVENT(timeline, HT_CallstackFilteredEvent, thread_id, entry->label, entry->count);
+            entry->count = 0;
+        }
+    }
+    if (thread_stack->filtered_other_count)
+    {
+        HT_TIMELINE_PUSH_EVENT(timeline, HT_CallstackFilteredEvent, thread_id, 0, thread_stack->filtered_other_count);
+        thread_stack->filtered_other_count = 0;
+    }
+
+    thread_stack->filtered_count = 0;
+}
+
+/* Returns a weight of the root frame, or 0 if it's not sampled. */
+static HT_INLINE uint32_t
+_ht_feature_callstack_sample_root(HT_FeatureCallstack* f, HT_FeatureCallstackThreadStack* thread_stack)
+{
+    uint64_t rate = ht_atomic_uint64_load(&f->sampling_rate);
+    HT_DurationNs period, window;
+    HT_Boolean sampled;
+
+    if (rate > 1)
+    {
+        sampled = thread_stack->sampling_counter == 0;
+        if (++thread_stack->sampling_counter >= rate)
+        {
+            thread_stack->sampling_counter = 0;
+        }
+        return sampled ? (uint32_t)rate : 0;
+    }
+
+    period = ht_atomic_uint64_load(&f->sampling_period);
+    if (period == 0)
+    {
+        return 1;
+    }
+
+    /* windows are aligned to the clock, so all the threads sample the same time slices */
+    window = ht_atomic_uint64_load(&f->sampling_window);
+    if (ht_monotonic_clock_get_timestamp() % period >= window)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((period + window / 2) / window);
+}
+
+static HT_INLINE void
+_ht_feature_callstack_start_fixed(HT_Timeline* timeline, HT_FeatureCallstack* f,
+                                  HT_FeatureCallstackThreadStack* thread_stack, HT_CallstackBaseEvent* event)
+{
+    size_t size = event->base.klass->type_info->size;
+    HT_Byte* frame;
+
+    if (HT_UNLIKELY(thread_stack->depth == f->max_depth))
+    {
+        thread_stack->overflow_depth++;
+        thread_stack->dropped_count++;
+        return;
+    }
+
+    frame = thread_stack->frames + thread_stack->depth++ * f->frame_size;
+    if (HT_UNLIKELY(size > f->frame_size))
+    {
+        HT_EVENT(frame)->klass = NULL;
+        thread_stack->dropped_count++;
+        return;
+    }
+
+    ht_timeline_init_event(timeline, HT_EVENT(event));
+    memcpy(frame, event, size);
+
+    if (ht_feature_callstack_aggregation_get(timeline))
+    {
+        _ht_feature_callstack_push_path(f, thread_stack, event);
+    }
+}
+
+static void
+_ht_feature_callstack_push_frame(HT_Timeline* timeline, HT_FeatureCallstack* f,
+                                 HT_FeatureCallstackThreadStack* thread_stack, HT_CallstackBaseEvent* event)
+{
+    if (f->max_depth)
+    {
+        _ht_feature_callstack_start_fixed(timeline, f, thread_stack, event);
+        return;
+    }
 
     ht_timeline_init_event(timeline, HT_EVENT(event));
     /* TODO: handle ht_stack_push() error */
-    ht_stack_push(&f->stack, event, event->base.klass->type_info->size);
+    ht_stack_push(&thread_stack->stack, event, event->base.klass->type_info->size);
+    thread_stack->depth++;
+
+    if (ht_feature_callstack_aggregation_get(timeline))
+    {
+        _ht_feature_callstack_push_path(f, thread_stack, event);
+    }
+}
+
+static void
+_ht_feature_callstack_start_weighted(HT_Timeline* timeline, HT_CallstackBaseEvent* event, uint32_t weight)
+{
+    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+    HT_FeatureCallstackThreadStack* thread_stack = _ht_feature_callstack_get_thread_stack(f);
+
+    if (HT_UNLIKELY(thread_stack == NULL))
+    {
+        return;
+    }
+
+    if (HT_UNLIKELY(thread_stack->unsampled_depth > 0))
+    {
+        thread_stack->unsampled_depth++;
+        return;
+    }
+    if (thread_stack->depth == 0 && thread_stack->overflow_depth == 0)
+    {
+        thread_stack->sampled_weight = _ht_feature_callstack_sample_root(f, thread_stack);
+        if (thread_stack->sampled_weight == 0)
+        {
+            thread_stack->unsampled_depth = 1;
+            return;
+        }
+    }
+    weight *= thread_stack->sampled_weight;
+
+    /* the weight is only recorded (in a sampled klass) if it's not 1, so unsampled frames
+     * don't pay for it. Frames of other klasses can't carry the weight, and neither can
+     * frames which would only fit into the fixed-depth stack without it. */
+    if (HT_UNLIKELY(weight > 1))
+    {
+        if (HT_EVENT(event)->klass == ht_HT_CallstackIntEvent_get_event_klass_instance()
+                && (f->max_depth == 0 || sizeof(HT_CallstackSampledIntEvent) <= f->frame_size))
+        {
+            HT_DECL_EVENT(HT_CallstackSampledIntEvent, sampled_event);
+            sampled_event.base.label = ((HT_CallstackIntEvent*)event)->label;
+            sampled_event.weight = weight;
+            _ht_feature_callstack_push_frame(timeline, f, thread_stack, (HT_CallstackBaseEvent*)&sampled_event);
+            return;
+        }
+        if (HT_EVENT(event)->klass == ht_HT_CallstackStringEvent_get_event_klass_instance()
+                && (f->max_depth == 0 || sizeof(HT_CallstackSampledStringEvent) <= f->frame_size))
+        {
+            HT_DECL_EVENT(HT_CallstackSampledStringEvent, sampled_event);
+            sampled_event.base.label = ((HT_CallstackStringEvent*)event)->label;
+            sampled_event.weight = weight;
+            _ht_feature_callstack_push_frame(timeline, f, thread_stack, (HT_CallstackBaseEvent*)&sampled_event);
+            return;
+        }
+    }
+
+    _ht_feature_callstack_push_frame(timeline, f, thread_stack, event);
+}
+
+void
+ht_feature_callstack_start(HT_Timeline* timeline, HT_CallstackBaseEvent* event)
+{
+    _ht_feature_callstack_start_weighted(timeline, event, 1);
 }
 
 void
 ht_feature_callstack_stop(HT_Timeline* timeline)
 {
     HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
-    HT_CallstackBaseEvent* event = (HT_CallstackBaseEvent*)ht_stack_top(&f->stack);
+    HT_FeatureCallstackThreadStack* thread_stack = _ht_feature_callstack_get_thread_stack(f);
+    HT_FeatureCallstackAggregation* aggregation;
+    HT_CallstackBaseEvent* event;
+    HT_TimestampNs now;
+
+    if (HT_UNLIKELY(thread_stack == NULL))
+    {
+        return;
+    }
+
+    if (HT_UNLIKELY(thread_stack->unsampled_depth > 0))
+    {
+        thread_stack->unsampled_depth--;
+        return;
+    }
+
+    if (f->max_depth)
+    {
+        if (HT_UNLIKELY(thread_stack->overflow_depth > 0))
+        {
+            /* the overflow is reported once the stack unwinds below the limit */
+            if (--thread_stack->overflow_depth == 0)
+            {
+                _ht_feature_callstack_push_overflow_event(timeline, thread_stack);
+            }
+            return;
+        }
+
+        event = (HT_CallstackBaseEvent*)(thread_stack->frames + --thread_stack->depth * f->frame_size);
+        if (HT_UNLIKELY(HT_EVENT(event)->klass == NULL))
+        {
+            _ht_feature_callstack_push_overflow_event(timeline, thread_stack);
+            return;
+        }
+    }
+    else
+    {
+        event = (HT_CallstackBaseEvent*)ht_stack_top(&thread_stack->stack);
+    }
 
-    event->duration = ht_monotonic_clock_get_timestamp() - HT_EVENT(event)->timestamp;
+    now = ht_monotonic_clock_get_timestamp();
+    event->duration = now - HT_EVENT(event)->timestamp;
     event->thread_id = ht_thread_get_current_thread_id();
 
-    ht_timeline_push_event((HT_Timeline*)timeline, HT_EVENT(event));
+    /* aggregated frames are not filtered, as the statistics would be incomplete */
+    aggregation = ht_feature_callstack_aggregation_get(timeline);
+    if (aggregation == NULL || !_ht_feature_callstack_pop_path(timeline, aggregation, thread_stack, event))
+    {
+        if (event->duration >= _ht_feature_callstack_get_duration_threshold(f, event))
+        {
+            ht_timeline_push_event((HT_Timeline*)timeline, HT_EVENT(event));
+        }
+        else
+        {
+            _ht_feature_callstack_count_filtered(thread_stack, event, now);
+        }
+    }
+
+    if (HT_UNLIKELY(thread_stack->filtered_count > 0))
+    {
+        HT_DurationNs interval = ht_atomic_uint64_load(&f->filtered_report_interval);
+        if (interval && now - thread_stack->filtered_since >= interval)
+        {
+            _ht_feature_callstack_push_filtered_events(timeline, thread_stack);
+        }
+    }
 
-    ht_stack_pop(&f->stack);
+    if (!f->max_depth)
+    {
+        ht_stack_pop(&thread_stack->stack);
+        thread_stack->depth--;
+    }
 }
 
 void
@@ -90,11 +939,29 @@ void ht_feature_callstack_start_string(HT_Timeline* timeline, const char* label)
     ht_feature_callstack_start(timeline, (HT_CallstackBaseEvent*)&event);
 }
 
-HT_ErrorCode
-ht_feature_callstack_enable(HT_Timeline* timeline)
+void
+ht_feature_callstack_start_int_weighted(HT_Timeline* timeline, HT_CallstackEventLabel label, uint32_t weight)
+{
+    HT_DECL_EVENT(HT_CallstackIntEvent, event);
+    event.label = label;
+
+    _ht_feature_callstack_start_weighted(timeline, (HT_CallstackBaseEvent*)&event, weight ? weight : 1);
+}
+
+void
+ht_feature_callstack_start_string_weighted(HT_Timeline* timeline, const char* label, uint32_t weight)
+{
+    HT_DECL_EVENT(HT_CallstackStringEvent, event);
+    event.label = label;
+
+    _ht_feature_callstack_start_weighted(timeline, (HT_CallstackBaseEvent*)&event, weight ? weight : 1);
+}
+
+static HT_ErrorCode
+_ht_feature_callstack_enable(HT_Timeline* timeline, size_t max_depth, size_t frame_size)
 {
     HT_ErrorCode error_code;
-    HT_Feature* feature = ht_feature_callstack_create(&error_code);
+    HT_Feature* feature = ht_feature_callstack_create(max_depth, frame_size, &error_code);
 
     if (!feature)
     {
@@ -103,3 +970,141 @@ ht_feature_callstack_enable(HT_Timeline* timeline)
 
     return ht_timeline_set_feature(timeline, feature);
 }
+
+HT_ErrorCode
+ht_feature_callstack_enable(HT_Timeline* timeline)
+{
+    return _ht_feature_callstack_enable(timeline, 0, 0);
+}
+
+HT_ErrorCode
+ht_feature_callstack_enable_fixed_depth(HT_Timeline* timeline, size_t max_depth, size_t frame_size)
+{
+    if (max_depth == 0 || frame_size < sizeof(HT_CallstackBaseEvent))
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    return _ht_feature_callstack_enable(timeline, max_depth, frame_size);
+}
+
+HT_ErrorCode
+ht_feature_callstack_set_duration_threshold(HT_Timeline* timeline, HT_DurationNs threshold, HT_DurationNs report_interval)
+{
+    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+
+    if (f == NULL)
+    {
+        return HT_ERR_FEATURE_NOT_REGISTERED;
+    }
+
+    ht_atomic_uint64_store(&f->filtered_report_interval, report_interval);
+    ht_atomic_uint64_store(&f->duration_threshold, threshold);
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_feature_callstack_set_label_duration_threshold(HT_Timeline* timeline, HT_CallstackEventLabel label, HT_DurationNs threshold)
+{
+    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+    HT_FeatureCallstackLabelThresholds* old_thresholds;
+    HT_FeatureCallstackLabelThresholds* thresholds;
+
+    if (f == NULL)
+    {
+        return HT_ERR_FEATURE_NOT_REGISTERED;
+    }
+
+    for (;;)
+    {
+        size_t old_count, i, j = 0;
+
+        old_thresholds = (HT_FeatureCallstackLabelThresholds*)ht_atomic_ptr_load((void* volatile*)&f->label_thresholds);
+        old_count = old_thresholds ? old_thresholds->count : 0;
+
+        thresholds = (HT_FeatureCallstackLabelThresholds*)ht_alloc(
+                    HT_FEATURE_CALLSTACK_LABEL_THRESHOLDS_HEADER_SIZE + (old_count + 1) * sizeof(HT_FeatureCallstackLabelThreshold));
+        if (thresholds == NULL)
+        {
+            return HT_ERR_OUT_OF_MEMORY;
+        }
+        thresholds->next_retired = NULL;
+        thresholds->entries = (HT_FeatureCallstackLabelThreshold*)((HT_Byte*)thresholds + HT_FEATURE_CALLSTACK_LABEL_THRESHOLDS_HEADER_SIZE);
+
+        for (i = 0; i < old_count && old_thresholds->entries[i].label < label; i++)
+        {
+            thresholds->entries[j++] = old_thresholds->entries[i];
+        }
+        thresholds->entries[j].label = label;
+        thresholds->entries[j++].threshold = threshold;
+        if (i < old_count && old_thresholds->entries[i].label == label)
+        {
+            i++;
+        }
+        for (; i < old_count; i++)
+        {
+            thresholds->entries[j++] = old_thresholds->entries[i];
+        }
+        thresholds->count = j;
+
+        if (ht_atomic_ptr_compare_exchange((void* volatile*)&f->label_thresholds, old_thresholds, thresholds))
+        {
+            break;
+        }
+        ht_free(thresholds);
+    }
+
+    if (old_thresholds)
+    {
+        do
+        {
+            old_thresholds->next_retired = (HT_FeatureCallstackLabelThresholds*)ht_atomic_ptr_load((void* volatile*)&f->retired_label_thresholds);
+        } while (!ht_atomic_ptr_compare_exchange((void* volatile*)&f->retired_label_thresholds, old_thresholds->next_retired, old_thresholds));
+    }
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_feature_callstack_set_sampling_rate(HT_Timeline* timeline, uint64_t rate)
+{
+    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+
+    if (f == NULL)
+    {
+        return HT_ERR_FEATURE_NOT_REGISTERED;
+    }
+    if (rate > (uint32_t)-1)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    ht_atomic_uint64_store(&f->sampling_period, 0);
+    ht_atomic_uint64_store(&f->sampling_rate, rate);
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_feature_callstack_set_sampling_window(HT_Timeline* timeline, HT_DurationNs window, HT_DurationNs period)
+{
+    HT_FeatureCallstack* f = HT_FeatureCallstack_from_timeline(timeline);
+
+    if (f == NULL)
+    {
+        return HT_ERR_FEATURE_NOT_REGISTERED;
+    }
+    if (period && (window == 0 || window > period || period / window > (uint32_t)-1))
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    /* the period is reset first, so the new window is never used with the old period */
+    ht_atomic_uint64_store(&f->sampling_rate, 0);
+    ht_atomic_uint64_store(&f->sampling_period, 0);
+    ht_atomic_uint64_store(&f->sampling_window, window);
+    ht_atomic_uint64_store(&f->sampling_period, period);
+
+    return HT_ERR_OK;
+}
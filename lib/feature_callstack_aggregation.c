@@ -0,0 +1,420 @@
+#include "internal/feature_callstack_aggregation.h"
+#include "hawktracer/alloc.h"
+#include "internal/atomic.h"
+#include "internal/error.h"
+#include "internal/feature.h"
+#include "internal/mutex.h"
+
+#include <string.h>
+
+typedef struct
+{
+    /* 0 if the entry is empty */
+    uint64_t path_id;
+    uint64_t parent_path_id;
+    HT_CallstackEventLabel label;
+    uint64_t count;
+    HT_DurationNs total_duration;
+    HT_DurationNs self_duration;
+    HT_DurationNs min_duration;
+    HT_DurationNs max_duration;
+    uint32_t histogram[HT_CALLSTACK_AGGREGATION_HISTOGRAM_SIZE];
+} HT_CallstackAggregationEntry;
+
+struct _HT_FeatureCallstackAggregation
+{
+    HT_Feature base;
+    HT_Mutex* lock;
+    HT_DurationNs summary_interval;
+    HT_TimestampNs last_summary_timestamp;
+    /* set by ht_feature_callstack_aggregation_set_paused() from any thread */
+    volatile uint32_t paused;
+    /* Open addressing table of paths. Entries are kept after the summary
+     * (with the statistics reset), as the same paths are usually hit again. */
+    HT_CallstackAggregationEntry* entries;
+    size_t capacity;
+    size_t size;
+};
+
+static void
+ht_feature_callstack_aggregation_destroy(HT_Feature* feature);
+
+HT_FEATURE_DEFINE(HT_FeatureCallstackAggregation, ht_feature_callstack_aggregation_destroy)
+
+#define HT_FCA_MIN_CAPACITY 64
+
+#define HT_FCA_LOCK_(feature) \
+    do { \
+        if (feature->lock) ht_mutex_lock(feature->lock); \
+    } while (0)
+
+#define HT_FCA_UNLOCK_(feature) \
+    do { \
+        if (feature->lock) ht_mutex_unlock(feature->lock); \
+    } while (0)
+
+size_t
+ht_feature_callstack_aggregation_get_bucket(HT_DurationNs duration)
+{
+    /* the last bucket covers [2^40 + 3 * 2^38, 2^41), and everything above */
+    const HT_DurationNs max_duration = ((HT_DurationNs)1 << 41) - 1;
+    size_t exponent = 0;
+#ifndef __GNUC__
+    size_t shift;
+#endif
+
+    if (duration < 4)
+    {
+        return (size_t)duration;
+    }
+    if (duration > max_duration)
+    {
+        duration = max_duration;
+    }
+
+#ifdef __GNUC__
+    exponent = 63 - (size_t)__builtin_clzll(duration);
+#else
+    for (shift = 32; shift > 0; shift /= 2)
+    {
+        if (duration >> (exponent + shift))
+        {
+            exponent += shift;
+        }
+    }
+#endif
+
+    return (exponent - 1) * 4 + (size_t)((duration >> (exponent - 2)) & 3);
+}
+
+HT_DurationNs
+ht_feature_callstack_aggregation_get_bucket_min_duration(size_t bucket)
+{
+    if (bucket < 4)
+    {
+        return (HT_DurationNs)bucket;
+    }
+
+    return (HT_DurationNs)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+static HT_Feature*
+ht_feature_callstack_aggregation_create(HT_DurationNs summary_interval, HT_Boolean thread_safe, HT_ErrorCode* out_err)
+{
+    HT_FeatureCallstackAggregation* feature = HT_FeatureCallstackAggregation_alloc();
+    HT_ErrorCode error_code = HT_ERR_OK;
+
+    if (feature == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto create_finished;
+    }
+
+    feature->entries = (HT_CallstackAggregationEntry*)ht_alloc(HT_FCA_MIN_CAPACITY * sizeof(HT_CallstackAggregationEntry));
+    if (feature->entries == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto entries_failed;
+    }
+    memset(feature->entries, 0, HT_FCA_MIN_CAPACITY * sizeof(HT_CallstackAggregationEntry));
+    feature->capacity = HT_FCA_MIN_CAPACITY;
+    feature->size = 0;
+    feature->summary_interval = summary_interval;
+    feature->last_summary_timestamp = ht_monotonic_clock_get_timestamp();
+    feature->paused = 0;
+
+    if (thread_safe)
+    {
+        feature->lock = ht_mutex_create();
+        if (feature->lock == NULL)
+        {
+            error_code = HT_ERR_OUT_OF_MEMORY;
+            goto lock_failed;
+        }
+    }
+    else
+    {
+        feature->lock = NULL;
+    }
+
+    goto create_finished;
+
+lock_failed:
+    ht_free(feature->entries);
+entries_failed:
+    ht_free(feature);
+    feature = NULL;
+create_finished:
+    HT_SET_ERROR(out_err, error_code);
+    return (HT_Feature*)feature;
+}
+
+static void
+ht_feature_callstack_aggregation_destroy(HT_Feature* feature)
+{
+    HT_FeatureCallstackAggregation* f = (HT_FeatureCallstackAggregation*)feature;
+
+    if (f->lock)
+    {
+        ht_mutex_destroy(f->lock);
+    }
+    ht_free(f->entries);
+    ht_free(f);
+}
+
+HT_FeatureCallstackAggregation*
+ht_feature_callstack_aggregation_get(HT_Timeline* timeline)
+{
+    return HT_FeatureCallstackAggregation_from_timeline(timeline);
+}
+
+static HT_CallstackAggregationEntry*
+_ht_feature_callstack_aggregation_find_slot(HT_CallstackAggregationEntry* entries, size_t capacity, uint64_t path_id)
+{
+    size_t slot = (size_t)(path_id & (capacity - 1));
+
+    while (entries[slot].path_id != 0 && entries[slot].path_id != path_id)
+    {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return &entries[slot];
+}
+
+static HT_ErrorCode
+_ht_feature_callstack_aggregation_grow(HT_FeatureCallstackAggregation* f)
+{
+    size_t new_capacity = f->capacity * 2;
+    HT_CallstackAggregationEntry* entries = (HT_CallstackAggregationEntry*)ht_alloc(new_capacity * sizeof(HT_CallstackAggregationEntry));
+    size_t i;
+
+    if (entries == NULL)
+    {
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+    memset(entries, 0, new_capacity * sizeof(HT_CallstackAggregationEntry));
+
+    for (i = 0; i < f->capacity; i++)
+    {
+        if (f->entries[i].path_id != 0)
+        {
+            *_ht_feature_callstack_aggregation_find_slot(entries, new_capacity, f->entries[i].path_id) = f->entries[i];
+        }
+    }
+
+    ht_free(f->entries);
+    f->entries = entries;
+    f->capacity = new_capacity;
+
+    return HT_ERR_OK;
+}
+
+/* Moves the statistics of the entries hit since the last summary to a newly allocated
+ * array, so the summary can be pushed without holding the lock. Must be called with
+ * the lock held. Returns NULL if there's nothing to push, or if the array can't be
+ * allocated; in that case the statistics are kept for the next summary. */
+static HT_CallstackAggregationEntry*
+_ht_feature_callstack_aggregation_take_summary(HT_FeatureCallstackAggregation* f, HT_TimestampNs timestamp, size_t* out_count)
+{
+    HT_CallstackAggregationEntry* summary = NULL;
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < f->capacity; i++)
+    {
+        if (f->entries[i].count != 0)
+        {
+            count++;
+        }
+    }
+
+    if (count > 0)
+    {
+        summary = (HT_CallstackAggregationEntry*)ht_alloc(count * sizeof(HT_CallstackAggregationEntry));
+        if (summary == NULL)
+        {
+            count = 0;
+            goto take_finished;
+        }
+
+        count = 0;
+        for (i = 0; i < f->capacity; i++)
+        {
+            HT_CallstackAggregationEntry* entry = &f->entries[i];
+            if (entry->count == 0)
+            {
+                continue;
+            }
+
+            summary[count++] = *entry;
+
+            entry->count = 0;
+            entry->total_duration = 0;
+            entry->self_duration = 0;
+            memset(entry->histogram, 0, sizeof(entry->histogram));
+        }
+    }
+
+    /* frames of different threads might complete out of order, so the timestamp is never moved back */
+    if (timestamp > f->last_summary_timestamp)
+    {
+        f->last_summary_timestamp = timestamp;
+    }
+
+take_finished:
+    *out_count = count;
+    return summary;
+}
+
+/* Pushes (and releases) the array taken by _ht_feature_callstack_aggregation_take_summary().
+ * Must be called without the lock held, as pushing an event might flush the timeline. */
+static void
+_ht_feature_callstack_aggregation_push_summary(HT_Timeline* timeline, HT_CallstackAggregationEntry* summary, size_t count)
+{
+    size_t i, bucket;
+
+    for (i = 0; i < count; i++)
+    {
+        HT_CallstackAggregationEntry* entry = &summary[i];
+
+        HT_TIMELINE_PUSH_EVENT(timeline, HT_CallstackSummaryEvent,
+                               entry->path_id, entry->parent_path_id, entry->label, entry->count,
+                               entry->total_duration, entry->self_duration,
+                               entry->min_duration, entry->max_duration);
+
+        for (bucket = 0; bucket < HT_CALLSTACK_AGGREGATION_HISTOGRAM_SIZE; bucket++)
+        {
+            if (entry->histogram[bucket])
+            {
+                HT_TIMELINE_PUSH_EVENT(timeline, HT_CallstackSummaryHistogramEvent,
+                                       entry->path_id, (uint16_t)bucket, entry->histogram[bucket]);
+            }
+        }
+    }
+
+    ht_free(summary);
+}
+
+HT_Boolean
+ht_feature_callstack_aggregation_add(HT_Timeline* timeline,
+                                     HT_FeatureCallstackAggregation* aggregation,
+                                     uint64_t path_id,
+                                     uint64_t parent_path_id,
+                                     HT_CallstackEventLabel label,
+                                     HT_DurationNs duration,
+                                     HT_DurationNs self_duration,
+                                     uint32_t weight,
+                                     HT_TimestampNs timestamp)
+{
+    HT_CallstackAggregationEntry* entry;
+    HT_CallstackAggregationEntry* summary = NULL;
+    size_t summary_count = 0;
+    HT_Boolean aggregated = HT_FALSE;
+
+    if (ht_atomic_uint32_load(&aggregation->paused))
+    {
+        return HT_FALSE;
+    }
+
+    HT_FCA_LOCK_(aggregation);
+
+    entry = _ht_feature_callstack_aggregation_find_slot(aggregation->entries, aggregation->capacity, path_id);
+    if (HT_UNLIKELY(entry->path_id == 0))
+    {
+        if ((aggregation->size + 1) * 4 > aggregation->capacity * 3)
+        {
+            if (_ht_feature_callstack_aggregation_grow(aggregation) != HT_ERR_OK)
+            {
+                goto add_finished;
+            }
+            entry = _ht_feature_callstack_aggregation_find_slot(aggregation->entries, aggregation->capacity, path_id);
+        }
+        entry->path_id = path_id;
+        entry->parent_path_id = parent_path_id;
+        entry->label = label;
+        aggregation->size++;
+    }
+
+    if (entry->count == 0 || duration < entry->min_duration)
+    {
+        entry->min_duration = duration;
+    }
+    if (entry->count == 0 || duration > entry->max_duration)
+    {
+        entry->max_duration = duration;
+    }
+    /* a sampled frame stands for weight frames */
+    entry->count += weight;
+    entry->total_duration += duration * weight;
+    entry->self_duration += self_duration * weight;
+    entry->histogram[ht_feature_callstack_aggregation_get_bucket(duration)] += weight;
+
+    aggregated = HT_TRUE;
+
+    if (aggregation->summary_interval && timestamp > aggregation->last_summary_timestamp
+            && timestamp - aggregation->last_summary_timestamp >= aggregation->summary_interval)
+    {
+        summary = _ht_feature_callstack_aggregation_take_summary(aggregation, timestamp, &summary_count);
+    }
+
+add_finished:
+    HT_FCA_UNLOCK_(aggregation);
+
+    if (summary != NULL)
+    {
+        _ht_feature_callstack_aggregation_push_summary(timeline, summary, summary_count);
+    }
+
+    return aggregated;
+}
+
+void
+ht_feature_callstack_aggregation_flush(HT_Timeline* timeline)
+{
+    HT_FeatureCallstackAggregation* f = HT_FeatureCallstackAggregation_from_timeline(timeline);
+    HT_CallstackAggregationEntry* summary;
+    size_t summary_count;
+
+    if (f == NULL)
+    {
+        return;
+    }
+
+    HT_FCA_LOCK_(f);
+    summary = _ht_feature_callstack_aggregation_take_summary(f, ht_monotonic_clock_get_timestamp(), &summary_count);
+    HT_FCA_UNLOCK_(f);
+
+    if (summary != NULL)
+    {
+        _ht_feature_callstack_aggregation_push_summary(timeline, summary, summary_count);
+    }
+}
+
+HT_ErrorCode
+ht_feature_callstack_aggregation_set_paused(HT_Timeline* timeline, HT_Boolean paused)
+{
+    HT_FeatureCallstackAggregation* f = HT_FeatureCallstackAggregation_from_timeline(timeline);
+
+    if (f == NULL)
+    {
+        return HT_ERR_FEATURE_NOT_REGISTERED;
+    }
+
+    ht_atomic_uint32_store(&f->paused, paused ? 1 : 0);
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_feature_callstack_aggregation_enable(HT_Timeline* timeline, HT_DurationNs summary_interval, HT_Boolean thread_safe)
+{
+    HT_ErrorCode error_code;
+    HT_Feature* feature = ht_feature_callstack_aggregation_create(summary_interval, thread_safe, &error_code);
+
+    if (!feature)
+    {
+        return error_code;
+    }
+
+    return ht_timeline_set_feature(timeline, feature);
+}
@@ -1,24 +1,56 @@
 #include "internal/global_timeline.h"
+#include "internal/atomic.h"
 #include "hawktracer/global_timeline.h"
 
-static size_t global_timeline_buffer_size = 1024;
+#define HT_GLOBAL_TIMELINE_DEFAULT_BUFFER_SIZE 1024
+
+/* can be changed by a remote client, while threads create their timelines */
+static volatile uint64_t global_timeline_buffer_size = HT_GLOBAL_TIMELINE_DEFAULT_BUFFER_SIZE;
+
+static HT_Boolean global_timeline_compact_serialization = HT_FALSE;
 
 void
 ht_global_timeline_set_buffer_size(size_t buffer_size)
 {
-    global_timeline_buffer_size = buffer_size;
+    ht_atomic_uint64_store(&global_timeline_buffer_size, (uint64_t)buffer_size);
 }
 
 size_t
 ht_global_timeline_get_buffer_size(void)
 {
-    return global_timeline_buffer_size;
+    return (size_t)ht_atomic_uint64_load(&global_timeline_buffer_size);
+}
+
+void
+ht_global_timeline_set_compact_serialization(HT_Boolean enabled)
+{
+    global_timeline_compact_serialization = enabled;
+}
+
+HT_Boolean
+ht_global_timeline_get_compact_serialization(void)
+{
+    return global_timeline_compact_serialization;
 }
 
 static HT_Timeline* _ht_global_timeline_create(void)
 {
-    HT_Timeline* c_timeline = ht_timeline_create(global_timeline_buffer_size, HT_FALSE, HT_TRUE, "HT_GlobalTimeline", NULL);
+    HT_Timeline* c_timeline = ht_timeline_create(ht_global_timeline_get_buffer_size(), HT_FALSE, HT_TRUE, "HT_GlobalTimeline", NULL);
 
+    if (!c_timeline)
+    {
+        /* the configured buffer might be too big to allocate */
+        c_timeline = ht_timeline_create(HT_GLOBAL_TIMELINE_DEFAULT_BUFFER_SIZE, HT_FALSE, HT_TRUE, "HT_GlobalTimeline", NULL);
+        if (!c_timeline)
+        {
+            return NULL;
+        }
+    }
+
+    if (ht_global_timeline_get_compact_serialization())
+    {
+        ht_timeline_enable_compact_serialization(c_timeline);
+    }
     ht_feature_callstack_enable(c_timeline);
     ht_feature_cached_string_enable(c_timeline, HT_FALSE);
 
@@ -30,13 +62,15 @@ struct GlobalTimeline
 {
     GlobalTimeline()
     {
-        /* TODO: handle ht_timeline_create() error? */
         c_timeline = _ht_global_timeline_create();
     }
 
     ~GlobalTimeline()
     {
-        ht_timeline_destroy(c_timeline);
+        if (c_timeline)
+        {
+            ht_timeline_destroy(c_timeline);
+        }
     }
 
     HT_Timeline* c_timeline;
@@ -75,6 +109,10 @@ HT_Timeline* ht_global_timeline_get(void)
     if (!c_timeline)
     {
         c_timeline = _ht_global_timeline_create();
+        if (!c_timeline)
+        {
+            return NULL;
+        }
         pthread_once(&timeline_once_control, create_key);
         pthread_setspecific(timeline_key, c_timeline);
     }
@@ -1,146 +1,378 @@
 #include "hawktracer/alloc.h"
-#include "internal/bag.h"
-#include "internal/hash.h"
+#include "internal/atomic.h"
 #include "internal/hash_map.h"
 #include "internal/error.h"
 
 #include <string.h>
 
-#define BUCKET_COUNT(hash_map) (sizeof(hash_map->buckets)/sizeof(hash_map->buckets[0]))
+#define HT_HASH_MAP_MIN_CAPACITY 64
 
-static HT_ErrorCode
-ht_hash_bucket_init(HT_HashBucket* bucket)
+/* Keys are hashes already, but static labels are keyed by their addresses,
+ * so the lowest bits are mostly zero; Fibonacci hashing spreads them. */
+HT_INLINE static size_t
+_ht_hash_map_slot(uint64_t key, size_t capacity)
 {
-    const size_t min_capacity = 4;
-    HT_ErrorCode err = ht_bag_void_ptr_init(&bucket->value_bag, min_capacity);
-    if (err != HT_ERR_OK)
-    {
-        return err;
-    }
+    return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
 
-    err = ht_bag_uint64_init(&bucket->key_bag, min_capacity);
-    if (err != HT_ERR_OK)
-    {
-        ht_bag_void_ptr_deinit(&bucket->value_bag);
-    }
+HT_INLINE static size_t
+_ht_hash_map_home(HT_HashMap* map, uint64_t key)
+{
+    return _ht_hash_map_slot(key, map->capacity);
+}
 
-    return err;
+HT_INLINE static size_t
+_ht_hash_map_distance(HT_HashMap* map, size_t position, uint64_t key)
+{
+    return (position - _ht_hash_map_home(map, key)) & (map->capacity - 1);
 }
 
-static void
-ht_hash_bucket_deinit(HT_HashBucket* bucket)
+static HT_HashMapEntry*
+_ht_hash_map_find(HT_HashMap* map, uint64_t key)
 {
-    ht_bag_void_ptr_deinit(&bucket->value_bag);
-    ht_bag_uint64_deinit(&bucket->key_bag);
+    size_t mask = map->capacity - 1;
+    size_t position = _ht_hash_map_home(map, key);
+    size_t distance = 0;
+
+    for (;;)
+    {
+        HT_HashMapEntry* entry = &map->entries[position];
+        if (entry->value == NULL)
+        {
+            return NULL;
+        }
+        if (entry->key == key)
+        {
+            return entry;
+        }
+        /* the key would have displaced this entry if it was in the map */
+        if (_ht_hash_map_distance(map, position, entry->key) < distance)
+        {
+            return NULL;
+        }
+        position = (position + 1) & mask;
+        distance++;
+    }
 }
 
-static HT_Boolean
-ht_hash_bucket_find_value(HT_HashBucket* bucket, uint64_t key, size_t* out_index)
+/* Inserts the value, or replaces it if the key is already in the map; the map
+ * must have a free slot. Returns the previous value. */
+static const char*
+_ht_hash_map_put(HT_HashMap* map, uint64_t key, const char* value)
 {
-    for (size_t i = 0; i < ht_bag_size(bucket->key_bag); i++)
+    size_t mask = map->capacity - 1;
+    size_t position = _ht_hash_map_home(map, key);
+    size_t distance = 0;
+    HT_Boolean displaced = HT_FALSE;
+    HT_HashMapEntry entry;
+
+    entry.key = key;
+    entry.value = value;
+
+    for (;;)
     {
-        if (ht_bag_nth(bucket->key_bag, i) == key)
+        HT_HashMapEntry* slot = &map->entries[position];
+        size_t slot_distance;
+
+        if (slot->value == NULL)
+        {
+            *slot = entry;
+            map->size++;
+            return NULL;
+        }
+
+        /* once the key has been placed, the rest of the loop only moves
+         * entries which are already in the map */
+        if (!displaced && slot->key == key)
         {
-            *out_index = i;
-            return HT_TRUE;
+            const char* prev = slot->value;
+            slot->value = value;
+            return prev;
         }
+
+        /* take the slot from an entry which is closer to its home position */
+        slot_distance = _ht_hash_map_distance(map, position, slot->key);
+        if (slot_distance < distance)
+        {
+            HT_HashMapEntry tmp = *slot;
+            *slot = entry;
+            entry = tmp;
+            distance = slot_distance;
+            displaced = HT_TRUE;
+        }
+
+        position = (position + 1) & mask;
+        distance++;
     }
-    return HT_FALSE;
 }
 
-static HT_Boolean
-ht_hash_bucket_for_each(HT_HashBucket* bucket, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud)
+static HT_ErrorCode
+_ht_hash_map_resize(HT_HashMap* map, size_t capacity)
 {
-    for (size_t i = 0; i < ht_bag_size(bucket->key_bag); i++)
+    HT_HashMapEntry* old_entries = map->entries;
+    size_t old_capacity = map->capacity;
+    HT_HashMapEntry* entries = (HT_HashMapEntry*)ht_alloc(capacity * sizeof(HT_HashMapEntry));
+    size_t i;
+
+    if (entries == NULL)
     {
-        if (!callback(ht_bag_nth(bucket->key_bag, i), (const char*)ht_bag_nth(bucket->value_bag, i), ud))
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+
+    memset(entries, 0, capacity * sizeof(HT_HashMapEntry));
+    map->entries = entries;
+    map->capacity = capacity;
+    map->size = 0;
+
+    for (i = 0; i < old_capacity; i++)
+    {
+        if (old_entries[i].value != NULL)
         {
-            return HT_FALSE;
+            _ht_hash_map_put(map, old_entries[i].key, old_entries[i].value);
         }
     }
-    return HT_TRUE;
+
+    ht_free(old_entries);
+
+    return HT_ERR_OK;
 }
 
 HT_ErrorCode
 ht_hash_map_init(HT_HashMap* hash_map)
 {
-    size_t i = 0;
+    hash_map->entries = NULL;
+    hash_map->capacity = 0;
+    hash_map->size = 0;
+
+    return _ht_hash_map_resize(hash_map, HT_HASH_MAP_MIN_CAPACITY);
+}
+
+void
+ht_hash_map_deinit(HT_HashMap* hash_map)
+{
+    ht_free(hash_map->entries);
+    hash_map->entries = NULL;
+    hash_map->capacity = 0;
+    hash_map->size = 0;
+}
+
+const char*
+ht_hash_map_insert(HT_HashMap* map, uint64_t key, const char* value, HT_ErrorCode* out_err)
+{
+    HT_HashMapEntry* entry;
     HT_ErrorCode err;
-    for (i = 0; i < BUCKET_COUNT(hash_map); i++)
+
+    if (value == NULL)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    if ((map->size + 1) * 4 > map->capacity * 3)
     {
-        err = ht_hash_bucket_init(&hash_map->buckets[i]);
+        err = _ht_hash_map_resize(map, map->capacity * 2);
         if (err != HT_ERR_OK)
         {
-            break;
+            /* the value can still be replaced if the key is in the map */
+            entry = _ht_hash_map_find(map, key);
+            if (entry == NULL)
+            {
+                HT_SET_ERROR(out_err, err);
+                return NULL;
+            }
         }
     }
-    if (err != HT_ERR_OK)
+
+    HT_SET_ERROR(out_err, HT_ERR_OK);
+    return _ht_hash_map_put(map, key, value);
+}
+
+const char*
+ht_hash_map_get_value(HT_HashMap* map, uint64_t key)
+{
+    HT_HashMapEntry* entry = _ht_hash_map_find(map, key);
+
+    return entry ? entry->value : NULL;
+}
+
+void ht_hash_map_for_each(HT_HashMap* hash_map, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud)
+{
+    size_t i;
+
+    for (i = 0; i < hash_map->capacity; i++)
     {
-        for (size_t j = 0; j < i; j++)
+        if (hash_map->entries[i].value != NULL
+                && !callback(hash_map->entries[i].key, hash_map->entries[i].value, ud))
         {
-            ht_hash_bucket_deinit(&hash_map->buckets[j]);
+            return;
         }
     }
-    return err;
 }
 
-void
-ht_hash_map_deinit(HT_HashMap* hash_map)
+struct _HT_ConcurrentHashMapTable
+{
+    size_t capacity;
+    HT_HashMapEntry* entries;
+    HT_ConcurrentHashMapTable* next_retired;
+};
+
+/* the entries are allocated right after the table (aligned for uint64_t keys) */
+#define HT_CONCURRENT_HASH_MAP_TABLE_HEADER_SIZE \
+    ((sizeof(HT_ConcurrentHashMapTable) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t))
+
+HT_INLINE static const char*
+_ht_concurrent_hash_map_load_value(HT_HashMapEntry* entry)
+{
+    return (const char*)ht_atomic_ptr_load((void* volatile*)&entry->value);
+}
+
+static HT_ConcurrentHashMapTable*
+_ht_concurrent_hash_map_table_create(size_t capacity)
 {
-    for (size_t i = 0; i < BUCKET_COUNT(hash_map); i++)
+    HT_ConcurrentHashMapTable* table = (HT_ConcurrentHashMapTable*)ht_alloc(
+                HT_CONCURRENT_HASH_MAP_TABLE_HEADER_SIZE + capacity * sizeof(HT_HashMapEntry));
+
+    if (table == NULL)
     {
-        ht_hash_bucket_deinit(&hash_map->buckets[i]);
+        return NULL;
     }
+
+    table->capacity = capacity;
+    table->entries = (HT_HashMapEntry*)((HT_Byte*)table + HT_CONCURRENT_HASH_MAP_TABLE_HEADER_SIZE);
+    table->next_retired = NULL;
+    memset(table->entries, 0, capacity * sizeof(HT_HashMapEntry));
+
+    return table;
 }
 
-const char*
-ht_hash_map_insert(HT_HashMap* map, uint64_t key, const char* value, HT_ErrorCode* out_err)
+/* Returns the entry with the key, or the empty slot where the key should be inserted. */
+static HT_HashMapEntry*
+_ht_concurrent_hash_map_table_find(HT_ConcurrentHashMapTable* table, uint64_t key)
 {
-    // TODO:
-    // 1) static assert for size of uintptr_t (feature cached string)
-    size_t index;
-    HT_HashBucket* bucket = &map->buckets[key % BUCKET_COUNT(map)];
-    if (ht_hash_bucket_find_value(bucket, key, &index))
+    size_t mask = table->capacity - 1;
+    size_t position = _ht_hash_map_slot(key, table->capacity);
+
+    for (;;)
     {
-        const char* prev = (const char*)ht_bag_nth(bucket->value_bag, index);
-        ht_bag_nth(bucket->value_bag, index) = (void*)value;
-        HT_SET_ERROR(out_err, HT_ERR_OK);
-        return prev;
+        HT_HashMapEntry* entry = &table->entries[position];
+        /* the key is written before the value is published */
+        if (_ht_concurrent_hash_map_load_value(entry) == NULL || entry->key == key)
+        {
+            return entry;
+        }
+        position = (position + 1) & mask;
     }
+}
 
-    HT_ErrorCode err = ht_bag_uint64_add(&bucket->key_bag, key);
-    if (err != HT_ERR_OK)
+static HT_ErrorCode
+_ht_concurrent_hash_map_grow(HT_ConcurrentHashMap* map)
+{
+    HT_ConcurrentHashMapTable* old_table = map->table;
+    HT_ConcurrentHashMapTable* table = _ht_concurrent_hash_map_table_create(old_table->capacity * 2);
+    size_t i;
+
+    if (table == NULL)
     {
-        HT_SET_ERROR(out_err, err);
-        return NULL;
+        return HT_ERR_OUT_OF_MEMORY;
     }
-    err = ht_bag_void_ptr_add(&bucket->value_bag, (void*)value);
-    if (err != HT_ERR_OK)
+
+    /* the new table is not visible to readers yet */
+    for (i = 0; i < old_table->capacity; i++)
     {
-        ht_bag_uint64_remove_nth(&bucket->key_bag, ht_bag_size(bucket->key_bag));
+        if (old_table->entries[i].value != NULL)
+        {
+            *_ht_concurrent_hash_map_table_find(table, old_table->entries[i].key) = old_table->entries[i];
+        }
     }
 
-    HT_SET_ERROR(out_err, err);
-    return NULL;
+    ht_atomic_ptr_store((void* volatile*)&map->table, table);
+
+    old_table->next_retired = map->retired_tables;
+    map->retired_tables = old_table;
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_concurrent_hash_map_init(HT_ConcurrentHashMap* hash_map)
+{
+    hash_map->table = _ht_concurrent_hash_map_table_create(HT_HASH_MAP_MIN_CAPACITY);
+    hash_map->retired_tables = NULL;
+    hash_map->size = 0;
+
+    return hash_map->table ? HT_ERR_OK : HT_ERR_OUT_OF_MEMORY;
+}
+
+void
+ht_concurrent_hash_map_deinit(HT_ConcurrentHashMap* hash_map)
+{
+    while (hash_map->retired_tables)
+    {
+        HT_ConcurrentHashMapTable* next = hash_map->retired_tables->next_retired;
+        ht_free(hash_map->retired_tables);
+        hash_map->retired_tables = next;
+    }
+
+    ht_free(hash_map->table);
+    hash_map->table = NULL;
+    hash_map->size = 0;
 }
 
 const char*
-ht_hash_map_get_value(HT_HashMap* map, uint64_t key)
+ht_concurrent_hash_map_insert(HT_ConcurrentHashMap* map, uint64_t key, const char* value, HT_ErrorCode* out_err)
 {
-    HT_HashBucket* bucket = &map->buckets[key % BUCKET_COUNT(map)];
-    size_t index;
-    if (ht_hash_bucket_find_value(bucket, key, &index))
+    HT_HashMapEntry* entry;
+    const char* prev;
+
+    if (value == NULL)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    entry = _ht_concurrent_hash_map_table_find(map->table, key);
+    prev = entry->value;
+    if (prev == NULL)
     {
-        return (const char*)ht_bag_nth(bucket->value_bag, index);
+        /* keep the load factor low, as the table can't use Robin Hood probing */
+        if ((map->size + 1) * 2 > map->table->capacity)
+        {
+            HT_ErrorCode err = _ht_concurrent_hash_map_grow(map);
+            if (err != HT_ERR_OK)
+            {
+                HT_SET_ERROR(out_err, err);
+                return NULL;
+            }
+            entry = _ht_concurrent_hash_map_table_find(map->table, key);
+        }
+        entry->key = key;
+        map->size++;
     }
-    return NULL;
+
+    ht_atomic_ptr_store((void* volatile*)&entry->value, (void*)value);
+
+    HT_SET_ERROR(out_err, HT_ERR_OK);
+    return prev;
 }
 
-void ht_hash_map_for_each(HT_HashMap* hash_map, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud)
+const char*
+ht_concurrent_hash_map_get_value(HT_ConcurrentHashMap* map, uint64_t key)
 {
-    for (size_t i = 0; i < BUCKET_COUNT(hash_map); i++)
+    HT_ConcurrentHashMapTable* table = (HT_ConcurrentHashMapTable*)ht_atomic_ptr_load((void* volatile*)&map->table);
+
+    return _ht_concurrent_hash_map_load_value(_ht_concurrent_hash_map_table_find(table, key));
+}
+
+void
+ht_concurrent_hash_map_for_each(HT_ConcurrentHashMap* hash_map, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud)
+{
+    HT_ConcurrentHashMapTable* table = hash_map->table;
+    size_t i;
+
+    for (i = 0; i < table->capacity; i++)
     {
-        if (!ht_hash_bucket_for_each(&hash_map->buckets[i], callback, ud))
+        if (table->entries[i].value != NULL
+                && !callback(table->entries[i].key, table->entries[i].value, ud))
         {
             return;
         }
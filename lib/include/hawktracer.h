@@ -4,6 +4,7 @@
 #include <hawktracer/ht_config.h>
 #include <hawktracer/alloc.h>
 #include <hawktracer/base_types.h>
+#include <hawktracer/category.h>
 #include <hawktracer/core_events.h>
 #include <hawktracer/duration_conversion.h>
 #include <hawktracer/event_id_provider.h>
@@ -12,6 +13,7 @@
 #include <hawktracer/feature.h>
 #include <hawktracer/feature_cached_string.h>
 #include <hawktracer/feature_callstack.h>
+#include <hawktracer/feature_callstack_aggregation.h>
 #include <hawktracer/global_timeline.h>
 #include <hawktracer/init.h>
 #include <hawktracer/listeners.h>
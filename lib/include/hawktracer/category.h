@@ -0,0 +1,89 @@
+#ifndef HAWKTRACER_CATEGORY_H
+#define HAWKTRACER_CATEGORY_H
+
+#include <hawktracer/base_types.h>
+
+HT_DECLS_BEGIN
+
+/**
+ * A set of tracepoint categories.
+ *
+ * Every category is a single bit of the value, so a category can be checked with
+ * a single load and a single branch (see HT_CATEGORY_IS_ENABLED()). All the
+ * categories are enabled by default; they can be disabled with the
+ * `--ht-disable-categories` option of ht_init(), or at runtime.
+ */
+typedef uint64_t HT_Category;
+
+/** A maximum number of registered categories. */
+#define HT_CATEGORY_MAX_COUNT 64
+
+/** A maximum length of a category name. */
+#define HT_CATEGORY_MAX_NAME_LENGTH 31
+
+/** All the categories (also the ones which will be registered later). */
+#define HT_CATEGORY_ALL ((HT_Category)-1)
+
+/* Don't use it directly, use HT_CATEGORY_IS_ENABLED() instead. */
+HT_API extern volatile HT_Category _ht_category_enabled_mask;
+
+/**
+ * Checks if any of the @a categories is enabled.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+/* The mask can be changed by other threads (e.g. by a remote client), a relaxed load
+ * makes it explicit, but it's still a plain load on all the common architectures. */
+#  define HT_CATEGORY_IS_ENABLED(categories) \
+    ((__atomic_load_n(&_ht_category_enabled_mask, __ATOMIC_RELAXED) & (categories)) != 0)
+#else
+#  define HT_CATEGORY_IS_ENABLED(categories) ((_ht_category_enabled_mask & (categories)) != 0)
+#endif
+
+/**
+ * Registers a category.
+ *
+ * Registering a name which has already been registered (or enabled/disabled with
+ * ht_category_set_enabled_by_names()) returns the same category, so the category
+ * can be registered in many places, and its state can be set before it's registered.
+ * The category should be stored and re-used, as the registration is relatively slow.
+ *
+ * @param name a name of the category; `all` is reserved.
+ * @param out_err a pointer to the error code variable where the error is stored if the registration fails.
+ *
+ * @return the category, or 0 if it can't be registered (0 is never enabled).
+ * The error code is set to #HT_ERR_INVALID_ARGUMENT if the @a name is empty, longer
+ * than #HT_CATEGORY_MAX_NAME_LENGTH, or reserved; #HT_ERR_OUT_OF_RANGE if there are
+ * already #HT_CATEGORY_MAX_COUNT categories registered.
+ */
+HT_API HT_Category ht_category_register(const char* name, HT_ErrorCode* out_err);
+
+/**
+ * Enables or disables categories.
+ *
+ * @param categories the categories (e.g. a combination of registered categories, or #HT_CATEGORY_ALL).
+ * @param enabled #HT_TRUE to enable the categories; #HT_FALSE to disable them.
+ */
+HT_API void ht_category_set_enabled(HT_Category categories, HT_Boolean enabled);
+
+/**
+ * Enables or disables categories by names.
+ *
+ * Names which haven't been registered yet are registered by the function.
+ *
+ * @param names a comma-separated list of category names; `all` stands for all the categories.
+ * @param enabled #HT_TRUE to enable the categories; #HT_FALSE to disable them.
+ *
+ * @return #HT_ERR_OK if the state of all the categories has been set; otherwise,
+ * the error of ht_category_register() for the first invalid name (the state of
+ * other categories is set anyway).
+ */
+HT_API HT_ErrorCode ht_category_set_enabled_by_names(const char* names, HT_Boolean enabled);
+
+/**
+ * Gets enabled categories.
+ */
+HT_API HT_Category ht_category_get_enabled(void);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_CATEGORY_H */
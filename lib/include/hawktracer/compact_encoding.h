@@ -0,0 +1,77 @@
+/** @file compact_encoding.h
+ * Compact serialization format of events.
+ *
+ * Timelines with compact serialization enabled (see ht_timeline_enable_compact_serialization())
+ * write events in blocks. A block starts with the regular #HT_CompactBlockEvent (which specifies
+ * the size of the block, and the timestamp and the identifier the deltas in the block start from),
+ * followed by compact events. A compact event is encoded as follows:
+ *  - the klass identifier, as an unsigned LEB128 varint;
+ *  - the timestamp and the identifier, as signed (zigzag) varint deltas from the previous event
+ *    in the block;
+ *  - integer fields, as unsigned (or, for signed types, zigzag) varints;
+ *  - other fields, exactly as in the regular format.
+ *
+ * An event never takes more than twice as much space as in the regular format.
+ */
+#ifndef HAWKTRACER_COMPACT_ENCODING_H
+#define HAWKTRACER_COMPACT_ENCODING_H
+
+#include <hawktracer/base_types.h>
+
+HT_DECLS_BEGIN
+
+/** A maximum size of a single varint. */
+#define HT_COMPACT_VARINT_MAX_SIZE 10
+
+/**
+ * A state of the compact serialization.
+ *
+ * The values of the previously serialized event, which the deltas are computed from.
+ */
+typedef struct
+{
+    HT_TimestampNs timestamp;
+    HT_EventId id;
+} HT_CompactContext;
+
+/**
+ * Writes an unsigned integer as a LEB128 varint.
+ *
+ * @param buffer the output buffer; it must have at least #HT_COMPACT_VARINT_MAX_SIZE bytes available.
+ * @param value the value.
+ *
+ * @return a number of bytes written.
+ */
+static HT_INLINE size_t
+ht_compact_write_uint(HT_Byte* buffer, uint64_t value)
+{
+    size_t size = 0;
+
+    while (value >= 0x80)
+    {
+        buffer[size++] = (HT_Byte)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (HT_Byte)value;
+
+    return size;
+}
+
+/**
+ * Writes a signed integer as a zigzag-encoded LEB128 varint, so values close to 0
+ * (either positive or negative) take only a few bytes.
+ *
+ * @param buffer the output buffer; it must have at least #HT_COMPACT_VARINT_MAX_SIZE bytes available.
+ * @param value the value.
+ *
+ * @return a number of bytes written.
+ */
+static HT_INLINE size_t
+ht_compact_write_int(HT_Byte* buffer, int64_t value)
+{
+    return ht_compact_write_uint(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_COMPACT_ENCODING_H */
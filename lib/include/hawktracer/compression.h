@@ -0,0 +1,95 @@
+/** @file compression.h
+ * Fast block compression used by listeners to reduce the size of the event stream.
+ *
+ * Blocks are encoded in LZ4 block format. A compressed stream starts with
+ * #HT_COMPRESSION_STREAM_MAGIC, followed by frames. Each frame consists of
+ * a header (see ht_compression_write_frame_header()) and a payload, which is
+ * either a compressed block or, if the data couldn't be compressed, the raw data.
+ * Frames are independent of each other, so the stream can be decoded
+ * from any frame boundary.
+ */
+#ifndef HAWKTRACER_COMPRESSION_H
+#define HAWKTRACER_COMPRESSION_H
+
+#include <hawktracer/base_types.h>
+
+#include <stddef.h>
+
+HT_DECLS_BEGIN
+
+/** A marker at the beginning of the compressed stream. */
+#define HT_COMPRESSION_STREAM_MAGIC "HTLZ"
+
+/** A size of the #HT_COMPRESSION_STREAM_MAGIC marker. */
+#define HT_COMPRESSION_STREAM_MAGIC_SIZE 4
+
+/** A size of the frame header. */
+#define HT_COMPRESSION_FRAME_HEADER_SIZE 8
+
+/** A maximum size of the data stored in a single frame. Decoders reject bigger frames. */
+#define HT_COMPRESSION_MAX_FRAME_SIZE (64 * 1024 * 1024)
+
+/** A size of the memory required by ht_compression_compress(). */
+#define HT_COMPRESSION_WORK_MEMORY_SIZE (4096 * sizeof(uint32_t))
+
+/**
+ * Gets the maximum size of the compressed block.
+ *
+ * @param size a size of the data to compress.
+ *
+ * @return the maximum number of bytes ht_compression_compress() writes for @a size bytes of input.
+ */
+HT_API size_t ht_compression_get_max_compressed_size(size_t size);
+
+/**
+ * Compresses a block of data.
+ *
+ * @param src the data to compress.
+ * @param src_size a size of the data. Must be smaller than 4GB.
+ * @param dst a buffer for the compressed block.
+ * @param dst_capacity a size of the @a dst buffer.
+ * @param work_memory a memory of #HT_COMPRESSION_WORK_MEMORY_SIZE bytes used by the compressor.
+ * It can be reused between calls, but not by multiple threads at the same time.
+ *
+ * @return a size of the compressed block, or 0 if it doesn't fit into @a dst buffer.
+ */
+HT_API size_t ht_compression_compress(const HT_Byte* src, size_t src_size,
+                                      HT_Byte* dst, size_t dst_capacity,
+                                      void* work_memory);
+
+/**
+ * Decompresses a block of data.
+ *
+ * @param src the compressed block.
+ * @param src_size a size of the compressed block.
+ * @param dst a buffer for the decompressed data.
+ * @param dst_size an exact size of the decompressed data.
+ *
+ * @return #HT_ERR_OK if the block has been decompressed; #HT_ERR_INVALID_FORMAT if
+ * the block is malformed or its decompressed size is different than @a dst_size.
+ */
+HT_API HT_ErrorCode ht_compression_decompress(const HT_Byte* src, size_t src_size,
+                                              HT_Byte* dst, size_t dst_size);
+
+/**
+ * Writes a frame header.
+ *
+ * @param header a buffer of #HT_COMPRESSION_FRAME_HEADER_SIZE bytes.
+ * @param raw_size a size of the data stored in the frame.
+ * @param compressed_size a size of the compressed block, or 0 if the data
+ * is stored without compression.
+ */
+HT_API void ht_compression_write_frame_header(HT_Byte* header, uint32_t raw_size, uint32_t compressed_size);
+
+/**
+ * Reads a frame header.
+ *
+ * @param header a buffer of #HT_COMPRESSION_FRAME_HEADER_SIZE bytes.
+ * @param raw_size a pointer to a variable where the size of the data stored in the frame is written to.
+ * @param compressed_size a pointer to a variable where the size of the compressed block is written to.
+ */
+HT_API void ht_compression_read_frame_header(const HT_Byte* header, uint32_t* raw_size, uint32_t* compressed_size);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_COMPRESSION_H */
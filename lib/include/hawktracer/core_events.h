@@ -31,6 +31,15 @@ HT_DECLARE_EVENT_KLASS(HT_CallstackIntEvent, HT_CallstackBaseEvent,
 HT_DECLARE_EVENT_KLASS(HT_CallstackStringEvent, HT_CallstackBaseEvent,
                        (STRING, const char*, label))
 
+/* Callstack frames which stand for weight frames (e.g. frames sampled 1 in weight times,
+ * see ht_feature_callstack_set_sampling_rate()). The callstack feature only pushes them
+ * instead of HT_CallstackIntEvent and HT_CallstackStringEvent if the weight is not 1. */
+HT_DECLARE_EVENT_KLASS(HT_CallstackSampledIntEvent, HT_CallstackIntEvent,
+                       (INTEGER, uint32_t, weight))
+
+HT_DECLARE_EVENT_KLASS(HT_CallstackSampledStringEvent, HT_CallstackStringEvent,
+                       (INTEGER, uint32_t, weight))
+
 HT_DECLARE_EVENT_KLASS(HT_StringMappingEvent, HT_Event,
                        (INTEGER, uint64_t, identifier),
                        (STRING, const char*, label))
@@ -40,6 +49,45 @@ HT_DECLARE_EVENT_KLASS(HT_SystemInfoEvent, HT_Event,
                        (INTEGER, uint8_t, version_minor),
                        (INTEGER, uint8_t, version_patch))
 
+/* Describes the time stamp counter calibration of the traced process. Event timestamps
+ * are already converted to nanoseconds, so the event is informational only (e.g. to check
+ * the tick frequency the timestamps were derived from); it's not needed to decode the stream. */
+HT_DECLARE_EVENT_KLASS(HT_ClockCalibrationEvent, HT_Event,
+                       (INTEGER, uint64_t, tick_frequency),
+                       (INTEGER, uint64_t, tick_base),
+                       (INTEGER, uint64_t, timestamp_base),
+                       (INTEGER, uint32_t, mult),
+                       (INTEGER, uint8_t, shift))
+
+HT_DECLARE_EVENT_KLASS(HT_CallstackOverflowEvent, HT_Event,
+                       (INTEGER, HT_ThreadId, thread_id),
+                       (INTEGER, uint64_t, dropped_count))
+
+HT_DECLARE_EVENT_KLASS(HT_CallstackFilteredEvent, HT_Event,
+                       (INTEGER, HT_ThreadId, thread_id),
+                       (INTEGER, HT_CallstackEventLabel, frame_label),
+                       (INTEGER, uint64_t, dropped_count))
+
+HT_DECLARE_EVENT_KLASS(HT_CallstackSummaryEvent, HT_Event,
+                       (INTEGER, uint64_t, path_id),
+                       (INTEGER, uint64_t, parent_path_id),
+                       (INTEGER, HT_CallstackEventLabel, frame_label),
+                       (INTEGER, uint64_t, count),
+                       (INTEGER, HT_DurationNs, total_duration),
+                       (INTEGER, HT_DurationNs, self_duration),
+                       (INTEGER, HT_DurationNs, min_duration),
+                       (INTEGER, HT_DurationNs, max_duration))
+
+HT_DECLARE_EVENT_KLASS(HT_CallstackSummaryHistogramEvent, HT_Event,
+                       (INTEGER, uint64_t, path_id),
+                       (INTEGER, uint16_t, bucket),
+                       (INTEGER, uint32_t, count))
+
+/* A header of a block of events in the compact format (see compact_encoding.h);
+ * the size is the number of bytes of the block following the header. */
+HT_DECLARE_EVENT_KLASS(HT_CompactBlockEvent, HT_Event,
+                       (INTEGER, uint32_t, size))
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_CORE_EVENTS_H */
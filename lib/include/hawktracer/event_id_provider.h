@@ -34,6 +34,22 @@ HT_API HT_EventIdProvider* ht_event_id_provider_create(void);
  */
 HT_API void ht_event_id_provider_destroy(HT_EventIdProvider* provider);
 
+/**
+ * Sets a number of identifiers each thread claims from the provider at once.
+ *
+ * By default (@a block_size equal to 1), every call of ht_event_id_provider_next()
+ * atomically increments the identifier shared by all the threads. For bigger @a block_size,
+ * each thread reserves a block of @a block_size identifiers, and hands them out without
+ * accessing the shared identifier until the block is used up. Identifiers remain unique,
+ * but they are no longer ordered between threads, and the sequence might contain gaps.
+ *
+ * The block size should be set before the provider is used by multiple threads.
+ *
+ * @param provider a provider.
+ * @param block_size a number of identifiers claimed by a thread at once.
+ */
+HT_API void ht_event_id_provider_set_block_size(HT_EventIdProvider* provider, size_t block_size);
+
 /**
  * Gets next identifier.
  *
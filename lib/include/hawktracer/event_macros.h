@@ -9,6 +9,11 @@
 
 #define HT_EVENT_GET_SIZE_FUNCTION(C_TYPE) ht_##C_TYPE##_get_size
 #define HT_EVENT_SERIALIZE_FUNCTION(C_TYPE) ht_##C_TYPE##_fnc_serialize
+#define HT_EVENT_SERIALIZE_COMPACT_FUNCTION(C_TYPE) ht_##C_TYPE##_fnc_serialize_compact
+#define HT_EVENT_TRY_SERIALIZE_FUNCTION(C_TYPE) ht_##C_TYPE##_fnc_try_serialize
+#define HT_EVENT_FIXED_SIZE(C_TYPE) ht_##C_TYPE##_fixed_size
+#define HT_EVENT_BASE_TYPE(C_TYPE) ht_##C_TYPE##_base_type
+#define HT_EVENT_PUSH_FIELDS_FUNCTION(C_TYPE) ht_##C_TYPE##_fnc_push_fields
 #define HT_EVENT_REGISTER_KLASS_FUNCTION(C_TYPE) ht_##C_TYPE##_register_event_klass
 #define HT_EVENT_GET_KLASS_INSTANCE_FUNCTION(C_TYPE) ht_##C_TYPE##_get_event_klass_instance
 
@@ -21,6 +26,44 @@
 #define HT_EVENT_RUNTIME_SIZEOF_(...) MKCREFLECT_EXPAND_(HT_EVENT_RUNTIME_SIZEOF__(__VA_ARGS__, 0))
 #define HT_EVENT_RUNTIME_SIZEOF(X, USER_DATA) HT_EVENT_RUNTIME_SIZEOF_(USER_DATA, MKCREFLECT_EXPAND_VA_ X)
 
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_STRUCT(C_TYPE) (HT_EVENT_FIXED_SIZE(C_TYPE) != 0)
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_INTEGER(C_TYPE) 1
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_POINTER(C_TYPE) 1
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_DOUBLE(C_TYPE) 1
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_STRING(C_TYPE) 0
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE__(DATA_TYPE, C_TYPE, FIELD, ...) && HT_EVENT_FIELD_HAS_FIXED_SIZE_##DATA_TYPE(C_TYPE)
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_HAS_FIXED_SIZE__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_HAS_FIXED_SIZE(X, USER_DATA) HT_EVENT_FIELD_HAS_FIXED_SIZE_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_FIXED_SIZEOF_STRUCT(C_TYPE) HT_EVENT_FIXED_SIZE(C_TYPE)
+#define HT_EVENT_FIELD_FIXED_SIZEOF_INTEGER(C_TYPE) sizeof(C_TYPE)
+#define HT_EVENT_FIELD_FIXED_SIZEOF_POINTER(C_TYPE) sizeof(C_TYPE)
+#define HT_EVENT_FIELD_FIXED_SIZEOF_DOUBLE(C_TYPE) sizeof(C_TYPE)
+#define HT_EVENT_FIELD_FIXED_SIZEOF_STRING(C_TYPE) 0
+#define HT_EVENT_FIELD_FIXED_SIZEOF__(DATA_TYPE, C_TYPE, FIELD, ...) +HT_EVENT_FIELD_FIXED_SIZEOF_##DATA_TYPE(C_TYPE)
+#define HT_EVENT_FIELD_FIXED_SIZEOF_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_FIXED_SIZEOF__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_FIXED_SIZEOF(X, USER_DATA) HT_EVENT_FIELD_FIXED_SIZEOF_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_IS_STRUCT_STRUCT 1
+#define HT_EVENT_FIELD_IS_STRUCT_INTEGER 0
+#define HT_EVENT_FIELD_IS_STRUCT_POINTER 0
+#define HT_EVENT_FIELD_IS_STRUCT_DOUBLE 0
+#define HT_EVENT_FIELD_IS_STRUCT_STRING 0
+#define HT_EVENT_FIELD_STRUCT_COUNT__(DATA_TYPE, C_TYPE, FIELD, ...) +HT_EVENT_FIELD_IS_STRUCT_##DATA_TYPE
+#define HT_EVENT_FIELD_STRUCT_COUNT_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_STRUCT_COUNT__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_STRUCT_COUNT(X, USER_DATA) HT_EVENT_FIELD_STRUCT_COUNT_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_MEMORY_SIZEOF__(DATA_TYPE, C_TYPE, FIELD, ...) +sizeof(C_TYPE)
+#define HT_EVENT_FIELD_MEMORY_SIZEOF_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_MEMORY_SIZEOF__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_MEMORY_SIZEOF(X, USER_DATA) HT_EVENT_FIELD_MEMORY_SIZEOF_(MKCREFLECT_EXPAND_VA_ X)
+
+/* Fields of a fixed-size event, which has no padding and no other structures than the base,
+ * are laid out in memory exactly as they're serialized (just after the base). */
+#define HT_EVENT_HAS_SERIALIZED_LAYOUT_(TYPE_NAME, BASE_TYPE, ...) \
+    (HT_EVENT_FIXED_SIZE(TYPE_NAME) != 0 && \
+     (0 MKCREFLECT_FOREACH(HT_EVENT_FIELD_STRUCT_COUNT, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__)) == 1 && \
+     sizeof(TYPE_NAME) == (0 MKCREFLECT_FOREACH(HT_EVENT_FIELD_MEMORY_SIZEOF, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__)))
+
 #define HT_EVENT_RUNTIME_SERIALIZE_BASE_TYPE_(C_TYPE, FIELD) memcpy(buffer + offset, (char*)&VAR_NAME->FIELD, sizeof(VAR_NAME->FIELD)), offset += sizeof(VAR_NAME->FIELD);
 
 #define HT_EVENT_RUNTIME_SERIALIZE_STRUCT(C_TYPE, FIELD) offset += HT_EVENT_SERIALIZE_FUNCTION(C_TYPE)(((HT_Event*)&VAR_NAME->FIELD), buffer);
@@ -36,10 +79,49 @@
 #define HT_EVENT_RUNTIME_SERIALIZE_(...) MKCREFLECT_EXPAND_(HT_EVENT_RUNTIME_SERIALIZE__(__VA_ARGS__, 0))
 #define HT_EVENT_RUNTIME_SERIALIZE(X, USER_DATA) HT_EVENT_RUNTIME_SERIALIZE_ (MKCREFLECT_EXPAND_VA_ X)
 
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_BASE_TYPE_(C_TYPE, FIELD) \
+    if (offset + sizeof(VAR_NAME->FIELD) <= capacity) memcpy(buffer + offset, (char*)&VAR_NAME->FIELD, sizeof(VAR_NAME->FIELD)); \
+    offset += sizeof(VAR_NAME->FIELD);
+
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_STRUCT(C_TYPE, FIELD) \
+    offset += HT_EVENT_TRY_SERIALIZE_FUNCTION(C_TYPE)(((HT_Event*)&VAR_NAME->FIELD), buffer + offset, offset < capacity ? capacity - offset : 0);
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_INTEGER(C_TYPE, FIELD) HT_EVENT_RUNTIME_TRY_SERIALIZE_BASE_TYPE_(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_POINTER(C_TYPE, FIELD) HT_EVENT_RUNTIME_TRY_SERIALIZE_BASE_TYPE_(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_DOUBLE(C_TYPE, FIELD) HT_EVENT_RUNTIME_TRY_SERIALIZE_BASE_TYPE_(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_STRING(C_TYPE, FIELD) do {\
+    size_t len = (VAR_NAME->FIELD) ? strlen(VAR_NAME->FIELD) + 1 : 0; \
+    if (offset + len <= capacity) memcpy(buffer + offset, VAR_NAME->FIELD, len); \
+    offset += len; \
+} while (0);
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE__(DATA_TYPE, C_TYPE, FIELD, ...) HT_EVENT_RUNTIME_TRY_SERIALIZE_##DATA_TYPE(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE_(...) MKCREFLECT_EXPAND_(HT_EVENT_RUNTIME_TRY_SERIALIZE__(__VA_ARGS__, 0))
+#define HT_EVENT_RUNTIME_TRY_SERIALIZE(X, USER_DATA) HT_EVENT_RUNTIME_TRY_SERIALIZE_ (MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_STRUCT(C_TYPE, FIELD) offset += HT_EVENT_SERIALIZE_COMPACT_FUNCTION(C_TYPE)(((HT_Event*)&VAR_NAME->FIELD), buffer + offset, context);
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_INTEGER(C_TYPE, FIELD) \
+    offset += (MKCREFLECT_IS_TYPE_SIGNED_(C_TYPE)) ? \
+        ht_compact_write_int(buffer + offset, (int64_t)VAR_NAME->FIELD) : \
+        ht_compact_write_uint(buffer + offset, (uint64_t)VAR_NAME->FIELD);
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_POINTER(C_TYPE, FIELD) HT_EVENT_RUNTIME_SERIALIZE_POINTER(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_DOUBLE(C_TYPE, FIELD) HT_EVENT_RUNTIME_SERIALIZE_DOUBLE(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_STRING(C_TYPE, FIELD) HT_EVENT_RUNTIME_SERIALIZE_STRING(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT__(DATA_TYPE, C_TYPE, FIELD, ...) HT_EVENT_RUNTIME_SERIALIZE_COMPACT_##DATA_TYPE(C_TYPE, FIELD)
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT_(...) MKCREFLECT_EXPAND_(HT_EVENT_RUNTIME_SERIALIZE_COMPACT__(__VA_ARGS__, 0))
+#define HT_EVENT_RUNTIME_SERIALIZE_COMPACT(X, USER_DATA) HT_EVENT_RUNTIME_SERIALIZE_COMPACT_ (MKCREFLECT_EXPAND_VA_ X)
+
+
+#define HT_EVENT_FIXED_SIZE_DECL(TYPE_NAME, BASE_TYPE, ...) \
+    enum { HT_EVENT_FIXED_SIZE(TYPE_NAME) = \
+        (1 MKCREFLECT_FOREACH(HT_EVENT_FIELD_HAS_FIXED_SIZE, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__)) ? \
+        (0 MKCREFLECT_FOREACH(HT_EVENT_FIELD_FIXED_SIZEOF, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__)) : 0 };
 
 #define HT_EVENT_GET_SIZE_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, ...) \
     size_t HT_EVENT_GET_SIZE_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME) \
     { \
+        if (HT_EVENT_FIXED_SIZE(TYPE_NAME) != 0) \
+        { \
+            return HT_EVENT_FIXED_SIZE(TYPE_NAME); \
+        } \
         return MKCREFLECT_FOREACH(HT_EVENT_RUNTIME_SIZEOF, ((TYPE_NAME*)VAR_NAME), (STRUCT, BASE_TYPE, base), __VA_ARGS__); \
     }
 #define HT_EVENT_GET_SIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, ...) \
@@ -50,12 +132,44 @@
     { \
         size_t offset = 0; \
         TYPE_NAME* VAR_NAME = (TYPE_NAME*)VAR_NAME_; \
+        if (HT_EVENT_HAS_SERIALIZED_LAYOUT_(TYPE_NAME, BASE_TYPE, __VA_ARGS__)) \
+        { \
+            offset = HT_EVENT_SERIALIZE_FUNCTION(BASE_TYPE)(VAR_NAME_, buffer); \
+            memcpy(buffer + offset, (char*)VAR_NAME + sizeof(BASE_TYPE), sizeof(TYPE_NAME) - sizeof(BASE_TYPE)); \
+            return offset + sizeof(TYPE_NAME) - sizeof(BASE_TYPE); \
+        } \
         MKCREFLECT_FOREACH(HT_EVENT_RUNTIME_SERIALIZE, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__) \
         return offset; \
     }
 #define HT_EVENT_SERIALIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, ...) \
     HT_API size_t HT_EVENT_SERIALIZE_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME_, HT_Byte* buffer);
 
+#define HT_EVENT_TRY_SERIALIZE_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, ...) \
+    size_t HT_EVENT_TRY_SERIALIZE_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME_, HT_Byte* buffer, size_t capacity) \
+    { \
+        size_t offset = HT_EVENT_FIXED_SIZE(TYPE_NAME); \
+        TYPE_NAME* VAR_NAME = (TYPE_NAME*)VAR_NAME_; \
+        if (offset != 0) \
+        { \
+            return offset <= capacity ? HT_EVENT_SERIALIZE_FUNCTION(TYPE_NAME)(VAR_NAME_, buffer) : offset; \
+        } \
+        MKCREFLECT_FOREACH(HT_EVENT_RUNTIME_TRY_SERIALIZE, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__) \
+        return offset; \
+    }
+#define HT_EVENT_TRY_SERIALIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, ...) \
+    HT_API size_t HT_EVENT_TRY_SERIALIZE_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME_, HT_Byte* buffer, size_t capacity);
+
+#define HT_EVENT_SERIALIZE_COMPACT_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, ...) \
+    size_t HT_EVENT_SERIALIZE_COMPACT_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME_, HT_Byte* buffer, HT_CompactContext* context) \
+    { \
+        size_t offset = 0; \
+        TYPE_NAME* VAR_NAME = (TYPE_NAME*)VAR_NAME_; \
+        MKCREFLECT_FOREACH(HT_EVENT_RUNTIME_SERIALIZE_COMPACT, 0, (STRUCT, BASE_TYPE, base), __VA_ARGS__) \
+        return offset; \
+    }
+#define HT_EVENT_SERIALIZE_COMPACT_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, ...) \
+    HT_API size_t HT_EVENT_SERIALIZE_COMPACT_FUNCTION(TYPE_NAME)(HT_Event* VAR_NAME_, HT_Byte* buffer, HT_CompactContext* context);
+
 #define HT_EVENT_GET_KLASS_INSTANCE_FUNCTION_DEF(TYPE_NAME) \
     HT_EventKlass* HT_EVENT_GET_KLASS_INSTANCE_FUNCTION(TYPE_NAME)(void) \
     { \
@@ -63,7 +177,9 @@
             NULL, \
             HT_EVENT_SERIALIZE_FUNCTION(TYPE_NAME), \
             HT_EVENT_GET_SIZE_FUNCTION(TYPE_NAME), \
-            HT_INVALID_KLASS_ID \
+            HT_INVALID_KLASS_ID, \
+            HT_EVENT_SERIALIZE_COMPACT_FUNCTION(TYPE_NAME), \
+            HT_EVENT_TRY_SERIALIZE_FUNCTION(TYPE_NAME) \
         }; \
         return &klass_instance; \
     }
@@ -79,20 +195,116 @@
 #define HT_EVENT_REGISTER_KLASS_FUNCTION_DECL(TYPE_NAME) \
     HT_API HT_EventKlassId HT_EVENT_REGISTER_KLASS_FUNCTION(TYPE_NAME)(void);
 
+/* The push function's parameters skip the base, which is passed as a pseudo-field of type BASE
+ * (so MKCREFLECT_FOREACH() never gets a single argument). */
+#define HT_EVENT_IF_FIELD_BASE(...)
+#define HT_EVENT_IF_FIELD_STRUCT(...) __VA_ARGS__
+#define HT_EVENT_IF_FIELD_INTEGER(...) __VA_ARGS__
+#define HT_EVENT_IF_FIELD_POINTER(...) __VA_ARGS__
+#define HT_EVENT_IF_FIELD_DOUBLE(...) __VA_ARGS__
+#define HT_EVENT_IF_FIELD_STRING(...) __VA_ARGS__
+
+#define HT_EVENT_FIELD_PARAM__(DATA_TYPE, C_TYPE, FIELD, ...) HT_EVENT_IF_FIELD_##DATA_TYPE(, C_TYPE FIELD)
+#define HT_EVENT_FIELD_PARAM_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_PARAM__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_PARAM(X, USER_DATA) HT_EVENT_FIELD_PARAM_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_PARAM_SIZEOF_STRUCT(C_TYPE, FIELD) HT_EVENT_GET_SIZE_FUNCTION(C_TYPE)((HT_Event*)&FIELD)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_INTEGER(C_TYPE, FIELD) sizeof(FIELD)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_POINTER(C_TYPE, FIELD) sizeof(FIELD)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_DOUBLE(C_TYPE, FIELD) sizeof(FIELD)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_STRING(C_TYPE, FIELD) (FIELD ? strlen(FIELD) + 1 : 0)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_BASE(C_TYPE, FIELD) 0
+#define HT_EVENT_FIELD_PARAM_SIZEOF__(DATA_TYPE, C_TYPE, FIELD, ...) +HT_EVENT_FIELD_PARAM_SIZEOF_##DATA_TYPE(C_TYPE, FIELD)
+#define HT_EVENT_FIELD_PARAM_SIZEOF_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_PARAM_SIZEOF__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_PARAM_SIZEOF(X, USER_DATA) HT_EVENT_FIELD_PARAM_SIZEOF_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_BASE_TYPE_(FIELD) \
+    memcpy(ht_buffer_ + ht_offset_, (char*)&FIELD, sizeof(FIELD)); \
+    ht_offset_ += sizeof(FIELD);
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_STRUCT(C_TYPE, FIELD) \
+    ht_offset_ += HT_EVENT_SERIALIZE_FUNCTION(C_TYPE)((HT_Event*)&FIELD, ht_buffer_ + ht_offset_);
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_INTEGER(C_TYPE, FIELD) HT_EVENT_FIELD_PARAM_SERIALIZE_BASE_TYPE_(FIELD)
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_POINTER(C_TYPE, FIELD) HT_EVENT_FIELD_PARAM_SERIALIZE_BASE_TYPE_(FIELD)
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_DOUBLE(C_TYPE, FIELD) HT_EVENT_FIELD_PARAM_SERIALIZE_BASE_TYPE_(FIELD)
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_STRING(C_TYPE, FIELD) do { \
+    size_t len = FIELD ? strlen(FIELD) + 1 : 0; \
+    memcpy(ht_buffer_ + ht_offset_, FIELD, len); \
+    ht_offset_ += len; \
+} while (0);
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_BASE(C_TYPE, FIELD)
+#define HT_EVENT_FIELD_PARAM_SERIALIZE__(DATA_TYPE, C_TYPE, FIELD, ...) HT_EVENT_FIELD_PARAM_SERIALIZE_##DATA_TYPE(C_TYPE, FIELD)
+#define HT_EVENT_FIELD_PARAM_SERIALIZE_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_PARAM_SERIALIZE__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_PARAM_SERIALIZE(X, USER_DATA) HT_EVENT_FIELD_PARAM_SERIALIZE_(MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_PARAM_WRITE__(TYPE_NAME, DATA_TYPE, C_TYPE, FIELD, ...) \
+    HT_EVENT_IF_FIELD_##DATA_TYPE(memcpy(ht_buffer_ + offsetof(TYPE_NAME, FIELD), (char*)&FIELD, sizeof(FIELD));)
+#define HT_EVENT_FIELD_PARAM_WRITE_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_PARAM_WRITE__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_PARAM_WRITE(X, USER_DATA) HT_EVENT_FIELD_PARAM_WRITE_(USER_DATA, MKCREFLECT_EXPAND_VA_ X)
+
+#define HT_EVENT_FIELD_PARAM_ASSIGN__(DATA_TYPE, C_TYPE, FIELD, ...) HT_EVENT_IF_FIELD_##DATA_TYPE(ht_event_.FIELD = FIELD;)
+#define HT_EVENT_FIELD_PARAM_ASSIGN_(...) MKCREFLECT_EXPAND_(HT_EVENT_FIELD_PARAM_ASSIGN__(__VA_ARGS__, 0))
+#define HT_EVENT_FIELD_PARAM_ASSIGN(X, USER_DATA) HT_EVENT_FIELD_PARAM_ASSIGN_(MKCREFLECT_EXPAND_VA_ X)
+
+/* Pushes the event given as the base and the values of the rest of the fields
+ * (see HT_TIMELINE_PUSH_EVENT_IN_PLACE()); the fields are written straight to the space
+ * reserved in the timeline's buffer, either serialized or as the C structure. */
+#define HT_EVENT_PUSH_FIELDS_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, ...) \
+    typedef BASE_TYPE HT_EVENT_BASE_TYPE(TYPE_NAME); \
+    static HT_INLINE void HT_EVENT_PUSH_FIELDS_FUNCTION(TYPE_NAME)( \
+        HT_Timeline* ht_timeline_, const BASE_TYPE* ht_base_ MKCREFLECT_FOREACH(HT_EVENT_FIELD_PARAM, 0, (BASE, BASE_TYPE, base), __VA_ARGS__)) \
+    { \
+        HT_Boolean ht_serialize_ = ht_timeline_get_serialize_events(ht_timeline_); \
+        size_t ht_size_ = sizeof(TYPE_NAME); \
+        size_t ht_offset_ = 0; \
+        HT_Byte* ht_buffer_; \
+        if (ht_serialize_) \
+        { \
+            ht_size_ = HT_EVENT_FIXED_SIZE(TYPE_NAME) != 0 ? (size_t)HT_EVENT_FIXED_SIZE(TYPE_NAME) : \
+                HT_EVENT_GET_SIZE_FUNCTION(BASE_TYPE)((HT_Event*)ht_base_) \
+                MKCREFLECT_FOREACH(HT_EVENT_FIELD_PARAM_SIZEOF, 0, (BASE, BASE_TYPE, base), __VA_ARGS__); \
+        } \
+        ht_buffer_ = ht_timeline_reserve(ht_timeline_, ht_size_); \
+        if (ht_buffer_ == NULL) \
+        { \
+            TYPE_NAME ht_event_; \
+            ht_event_.base = *ht_base_; \
+            MKCREFLECT_FOREACH(HT_EVENT_FIELD_PARAM_ASSIGN, 0, (BASE, BASE_TYPE, base), __VA_ARGS__) \
+            ht_timeline_push_event(ht_timeline_, HT_EVENT(&ht_event_)); \
+            return; \
+        } \
+        if (ht_serialize_) \
+        { \
+            ht_offset_ = HT_EVENT_SERIALIZE_FUNCTION(BASE_TYPE)((HT_Event*)ht_base_, ht_buffer_); \
+            MKCREFLECT_FOREACH(HT_EVENT_FIELD_PARAM_SERIALIZE, 0, (BASE, BASE_TYPE, base), __VA_ARGS__) \
+        } \
+        else \
+        { \
+            memcpy(ht_buffer_, ht_base_, sizeof(BASE_TYPE)); \
+            MKCREFLECT_FOREACH(HT_EVENT_FIELD_PARAM_WRITE, TYPE_NAME, (BASE, BASE_TYPE, base), __VA_ARGS__) \
+        } \
+        ht_timeline_commit(ht_timeline_, ht_size_); \
+    }
+
 #define HT_EVENT_DEFINE_STRUCTURE(TYPE_NAME, BASE_TYPE, ...) \
     MKCREFLECT_DEFINE_STRUCT(TYPE_NAME, \
                          (STRUCT, BASE_TYPE, base), \
                          MKCREFLECT_EXPAND_VA_(__VA_ARGS__))
 
 #define HT_EVENT_DECLARATIONS(TYPE_NAME, BASE_TYPE, ...) \
+    HT_EVENT_FIXED_SIZE_DECL(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
     HT_EVENT_GET_SIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
     HT_EVENT_SERIALIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
+    HT_EVENT_TRY_SERIALIZE_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
+    HT_EVENT_SERIALIZE_COMPACT_FUNCTION_DECL(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
     HT_EVENT_GET_KLASS_INSTANCE_FUNCTION_DECL(TYPE_NAME) \
-    HT_EVENT_REGISTER_KLASS_FUNCTION_DECL(TYPE_NAME)
+    HT_EVENT_REGISTER_KLASS_FUNCTION_DECL(TYPE_NAME) \
+    HT_EVENT_PUSH_FIELDS_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, __VA_ARGS__)
 
 #define HT_EVENT_DEFINITIONS_(TYPE_NAME, BASE_TYPE, ...) \
     HT_EVENT_GET_SIZE_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
     HT_EVENT_SERIALIZE_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
+    HT_EVENT_TRY_SERIALIZE_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
+    HT_EVENT_SERIALIZE_COMPACT_FUNCTION_DEF(TYPE_NAME, BASE_TYPE, __VA_ARGS__) \
     HT_EVENT_GET_KLASS_INSTANCE_FUNCTION_DEF(TYPE_NAME) \
     HT_EVENT_REGISTER_KLASS_FUNCTION_DEF(TYPE_NAME)
 
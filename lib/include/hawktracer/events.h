@@ -2,6 +2,7 @@
 #define HAWKTRACER_EVENTS_H
 
 #include <hawktracer/base_types.h>
+#include <hawktracer/compact_encoding.h>
 #include <hawktracer/mkcreflect.h>
 
 #include <stddef.h>
@@ -15,10 +16,15 @@ MKCREFLECT_DEFINE_STRUCT(HT_Event,
                          (INTEGER, HT_TimestampNs, timestamp),
                          (INTEGER, HT_EventId, id))
 
+/* A size of the serialized HT_Event (see HT_EVENT_FIXED_SIZE()). */
+enum { ht_HT_Event_fixed_size = sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs) + sizeof(HT_EventId) };
+
 HT_API HT_EventKlass* ht_HT_Event_get_event_klass_instance(void);
 HT_API HT_EventKlassId ht_HT_Event_register_event_klass(void);
 HT_API size_t ht_HT_Event_get_size(HT_Event* event);
 HT_API size_t ht_HT_Event_fnc_serialize(HT_Event* event, HT_Byte* buffer);
+HT_API size_t ht_HT_Event_fnc_try_serialize(HT_Event* event, HT_Byte* buffer, size_t capacity);
+HT_API size_t ht_HT_Event_fnc_serialize_compact(HT_Event* event, HT_Byte* buffer, HT_CompactContext* context);
 
 #define HT_EVENT(event) ((HT_Event*)(event))
 
@@ -28,6 +34,12 @@ struct _HT_EventKlass
     size_t (*serialize)(HT_Event* event, HT_Byte* buffer);
     size_t (*get_size)(HT_Event* event);
     HT_EventKlassId klass_id;
+    /* Serializes the event in the compact format (see compact_encoding.h). */
+    size_t (*serialize_compact)(HT_Event* event, HT_Byte* buffer, HT_CompactContext* context);
+    /* Serializes the event if it fits into @a capacity bytes of the buffer, and returns
+     * the size of the serialized event in both cases, so the size and the content of
+     * the event are computed in a single pass. */
+    size_t (*try_serialize)(HT_Event* event, HT_Byte* buffer, size_t capacity);
 };
 
 #define HT_REGISTER_EVENT_KLASS(EVENT_TYPE) ht_##EVENT_TYPE##_register_event_klass()
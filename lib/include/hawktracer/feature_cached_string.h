@@ -9,6 +9,7 @@
 #define HAWKTRACER_FEATURE_CACHED_STRING_H
 
 #include <hawktracer/timeline.h>
+#include <hawktracer/timeline_listener.h>
 
 HT_DECLS_BEGIN
 
@@ -42,6 +43,57 @@ HT_API void ht_feature_cached_string_push_map(HT_Timeline* timeline);
 
 HT_API uintptr_t ht_feature_cached_string_add_mapping_dynamic(HT_Timeline* timeline, const char* label);
 
+/**
+ * Adds a mapping of a label which hash value is already known.
+ *
+ * Works like ht_feature_cached_string_add_mapping_dynamic(), but doesn't compute the hash,
+ * so the mapping can be checked cheaply every time the label is used (e.g. with the hash
+ * computed at compile time). The mapping event is only pushed if the label is not
+ * mapped in the timeline yet.
+ *
+ * @param timeline the timeline.
+ * @param label a string to map.
+ * @param hash_value the hash of the @a label; it must be the same value
+ * ht_feature_cached_string_add_mapping_dynamic() returns for the @a label.
+ *
+ * @return @a hash_value.
+ */
+HT_API uintptr_t ht_feature_cached_string_add_hashed_mapping(HT_Timeline* timeline, const char* label, uintptr_t hash_value);
+
+/**
+ * Passes mapping events of all the strings registered in the feature directly to a listener.
+ *
+ * Unlike ht_feature_cached_string_push_map(), the events are not pushed to the timeline,
+ * so they're only received by the @a listener. The function can be called from
+ * a listener callback, e.g. when the listener needs to write the mappings
+ * again to a new output.
+ *
+ * @param timeline the timeline.
+ * @param callback the listener callback.
+ * @param listener the listener (passed as a user data to the @a callback).
+ * @param serialize #HT_TRUE if events should be serialized before passing them to the @a callback.
+ *
+ * @return a total size (in bytes) of the events passed to the listener. If the feature
+ * is not enabled for the @a timeline, no events are passed and the function returns 0.
+ */
+HT_API size_t ht_feature_cached_string_push_map_to_listener(HT_Timeline* timeline,
+                                                            HT_TimelineListenerCallback callback,
+                                                            void* listener,
+                                                            HT_Boolean serialize);
+
+/**
+ * Gets a number of strings registered in the feature.
+ *
+ * The number only grows, so listeners which keep a copy of the map
+ * (see ht_feature_cached_string_push_map_to_listener()) can use it
+ * to check whether the copy is still up to date.
+ *
+ * @param timeline the timeline.
+ *
+ * @return a number of mapped strings, or 0 if the feature is not enabled for the @a timeline.
+ */
+HT_API size_t ht_feature_cached_string_get_mapping_count(HT_Timeline* timeline);
+
 HT_DECLS_END
 
 
@@ -14,8 +14,126 @@ HT_API void ht_feature_callstack_start_int(HT_Timeline* timeline, HT_CallstackEv
 
 HT_API void ht_feature_callstack_start_string(HT_Timeline* timeline, const char* label);
 
+/**
+ * Starts a frame which stands for @a weight frames (e.g. a frame sampled 1 in @a weight times).
+ *
+ * The weight is multiplied by the weight of the sampled root frame if sampling
+ * of the feature is enabled. If the result is not 1, the frame is pushed as
+ * an HT_CallstackSampledIntEvent (or HT_CallstackSampledStringEvent), which stores
+ * the weight. Weight 0 is treated as 1.
+ */
+HT_API void ht_feature_callstack_start_int_weighted(HT_Timeline* timeline, HT_CallstackEventLabel label, uint32_t weight);
+
+HT_API void ht_feature_callstack_start_string_weighted(HT_Timeline* timeline, const char* label, uint32_t weight);
+
 HT_API HT_ErrorCode ht_feature_callstack_enable(HT_Timeline* timeline);
 
+/**
+ * Enables the callstack feature with stacks of a fixed size.
+ *
+ * Every thread gets a stack of @a max_depth frames, @a frame_size bytes each,
+ * allocated the first time the thread uses the timeline; starting and stopping
+ * a frame never allocates memory afterwards. Frames started when the stack is
+ * full, and events bigger than @a frame_size, are dropped; the number of dropped
+ * frames is reported with an HT_CallstackOverflowEvent once they're stopped.
+ *
+ * @param timeline the timeline.
+ * @param max_depth a maximum depth of the callstack.
+ * @param frame_size a maximum size of a callstack event (e.g. sizeof(HT_CallstackIntEvent)).
+ *
+ * @return #HT_ERR_OK, if the feature has been enabled; #HT_ERR_INVALID_ARGUMENT, if
+ * @a max_depth is 0 or @a frame_size is too small for any callstack event; otherwise,
+ * appropriate error code.
+ */
+HT_API HT_ErrorCode ht_feature_callstack_enable_fixed_depth(HT_Timeline* timeline, size_t max_depth, size_t frame_size);
+
+/**
+ * Sets a minimum duration of frames pushed to the timeline.
+ *
+ * Frames shorter than the @a threshold are dropped when they're stopped, so they
+ * never reach the timeline buffer. Every thread counts the dropped frames per
+ * label, and pushes an HT_CallstackFilteredEvent for every label once per
+ * @a report_interval (when a frame is stopped on the thread). Frames without
+ * an integer label are reported with the label 0.
+ *
+ * Frames aggregated by the callstack aggregation feature are not filtered.
+ * The function can be called at any time, also when other threads use the timeline.
+ *
+ * @param timeline the timeline.
+ * @param threshold a minimum duration of a frame; 0 disables filtering.
+ * @param report_interval an interval between reports of dropped frames; 0 disables reporting.
+ *
+ * @return #HT_ERR_OK, if the threshold has been set; #HT_ERR_FEATURE_NOT_REGISTERED,
+ * if the callstack feature is not enabled for the @a timeline.
+ */
+HT_API HT_ErrorCode ht_feature_callstack_set_duration_threshold(HT_Timeline* timeline,
+                                                                HT_DurationNs threshold,
+                                                                HT_DurationNs report_interval);
+
+/**
+ * Sets a minimum duration of frames with an integer @a label.
+ *
+ * The threshold overrides the one set with ht_feature_callstack_set_duration_threshold()
+ * (e.g. 0 makes sure frames of the label are never dropped).
+ *
+ * @param timeline the timeline.
+ * @param label the label.
+ * @param threshold a minimum duration of a frame.
+ *
+ * @return #HT_ERR_OK, if the threshold has been set; #HT_ERR_FEATURE_NOT_REGISTERED,
+ * if the callstack feature is not enabled for the @a timeline; otherwise, appropriate error code.
+ */
+HT_API HT_ErrorCode ht_feature_callstack_set_label_duration_threshold(HT_Timeline* timeline,
+                                                                      HT_CallstackEventLabel label,
+                                                                      HT_DurationNs threshold);
+
+/**
+ * Enables sampling of 1 in @a rate root frames.
+ *
+ * Every thread counts its own root frames (frames started when the thread's
+ * callstack is empty), and records the first one of every @a rate frames. All
+ * the frames started by a root frame share its sampling decision, so recorded
+ * callstacks are always complete. Recorded frames are pushed as
+ * HT_CallstackSampledIntEvent (or HT_CallstackSampledStringEvent) events with
+ * the weight multiplied by @a rate, so converters can scale counts and durations
+ * back up. Frames of other klasses are recorded without the weight.
+ *
+ * The function disables the sampling window set with ht_feature_callstack_set_sampling_window().
+ * It can be called at any time, also when other threads use the timeline.
+ *
+ * @param timeline the timeline.
+ * @param rate a sampling rate; 0 and 1 disable sampling.
+ *
+ * @return #HT_ERR_OK, if the rate has been set; #HT_ERR_FEATURE_NOT_REGISTERED,
+ * if the callstack feature is not enabled for the @a timeline; #HT_ERR_INVALID_ARGUMENT,
+ * if the @a rate doesn't fit into the weight field (uint32_t).
+ */
+HT_API HT_ErrorCode ht_feature_callstack_set_sampling_rate(HT_Timeline* timeline, uint64_t rate);
+
+/**
+ * Enables time-based sampling of root frames.
+ *
+ * Root frames are recorded if they start within the first @a window nanoseconds
+ * of every @a period (periods are aligned to the monotonic clock, so all the
+ * threads record the same time slices). As with ht_feature_callstack_set_sampling_rate(),
+ * the decision applies to the whole callstack of the root frame; recorded frames
+ * have the weight multiplied by @a period / @a window (rounded).
+ *
+ * The function disables the sampling rate set with ht_feature_callstack_set_sampling_rate().
+ *
+ * @param timeline the timeline.
+ * @param window a duration of the sampling window.
+ * @param period a sampling period; 0 disables sampling.
+ *
+ * @return #HT_ERR_OK, if the window has been set; #HT_ERR_FEATURE_NOT_REGISTERED,
+ * if the callstack feature is not enabled for the @a timeline; #HT_ERR_INVALID_ARGUMENT,
+ * if the @a window is 0 or longer than the @a period, or the weight doesn't fit into
+ * the weight field (uint32_t).
+ */
+HT_API HT_ErrorCode ht_feature_callstack_set_sampling_window(HT_Timeline* timeline,
+                                                             HT_DurationNs window,
+                                                             HT_DurationNs period);
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_FEATURE_CALLSTACK_H */
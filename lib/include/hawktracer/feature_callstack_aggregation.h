@@ -0,0 +1,95 @@
+/** @file feature_callstack_aggregation.h
+ * Aggregates callstack frames in the process.
+ *
+ * When the feature is enabled for a timeline, frames of #HT_CallstackIntEvent
+ * events completed by ht_feature_callstack_stop() are not pushed to the timeline.
+ * Instead, statistics of every call path (i.e. the label of the frame, and labels
+ * of all its parents) are collected: the number of calls, total and self time,
+ * minimum and maximum duration, and a histogram of durations. The statistics are
+ * periodically pushed to the timeline as #HT_CallstackSummaryEvent events, followed
+ * by #HT_CallstackSummaryHistogramEvent events for non-empty buckets of the histogram,
+ * and reset.
+ *
+ * Frames of other callstack event klasses are pushed to the timeline as usual, and so are
+ * frames of new call paths if there's not enough memory to aggregate them.
+ *
+ * The histogram is log-linear: durations below 4ns have their own buckets, and
+ * every power of two above is split into 4 buckets of equal width, up to 2^41ns
+ * (longer durations are counted in the last bucket).
+ */
+#ifndef HAWKTRACER_FEATURE_CALLSTACK_AGGREGATION_H
+#define HAWKTRACER_FEATURE_CALLSTACK_AGGREGATION_H
+
+#include <hawktracer/core_events.h>
+#include <hawktracer/timeline.h>
+
+HT_DECLS_BEGIN
+
+/** A number of buckets of the duration histogram. */
+#define HT_CALLSTACK_AGGREGATION_HISTOGRAM_SIZE 160
+
+/**
+ * Enables a feature for the timeline.
+ *
+ * The callstack feature must be enabled for the timeline as well, otherwise
+ * no frames are aggregated.
+ *
+ * @param timeline the timeline.
+ * @param summary_interval an interval between pushing summaries to the timeline.
+ * The summary is pushed when a frame completes after the interval has elapsed.
+ * If 0, summaries are only pushed by ht_feature_callstack_aggregation_flush().
+ * @param thread_safe wether the feature should be thread-safe (i.e. will be used across different threads) or not.
+ *
+ * @return #HT_ERR_OK if enabling the feature completes successfully; otherwise, appropriate error code.
+ */
+HT_API HT_ErrorCode ht_feature_callstack_aggregation_enable(HT_Timeline* timeline,
+                                                            HT_DurationNs summary_interval,
+                                                            HT_Boolean thread_safe);
+
+/**
+ * Pushes a summary of the frames aggregated since the last summary to the timeline.
+ *
+ * The function should be called before destroying the timeline, otherwise statistics
+ * collected since the last summary are lost.
+ *
+ * @param timeline the timeline.
+ */
+HT_API void ht_feature_callstack_aggregation_flush(HT_Timeline* timeline);
+
+/**
+ * Pauses or resumes aggregating frames.
+ *
+ * When the aggregation is paused, frames are pushed to the timeline as if the feature
+ * wasn't enabled (so they can be filtered, see ht_feature_callstack_set_duration_threshold()).
+ * Statistics collected before are kept until the next summary. The function can be called
+ * at any time, also when other threads use the timeline.
+ *
+ * @param timeline the timeline.
+ * @param paused #HT_TRUE to pause the aggregation; #HT_FALSE to resume it.
+ *
+ * @return #HT_ERR_OK, if the state has been changed; #HT_ERR_FEATURE_NOT_REGISTERED,
+ * if the feature is not enabled for the @a timeline.
+ */
+HT_API HT_ErrorCode ht_feature_callstack_aggregation_set_paused(HT_Timeline* timeline, HT_Boolean paused);
+
+/**
+ * Gets a bucket of the duration histogram.
+ *
+ * @param duration the duration of a frame.
+ *
+ * @return an index of the histogram bucket (smaller than #HT_CALLSTACK_AGGREGATION_HISTOGRAM_SIZE).
+ */
+HT_API size_t ht_feature_callstack_aggregation_get_bucket(HT_DurationNs duration);
+
+/**
+ * Gets the lowest duration counted in a histogram bucket.
+ *
+ * @param bucket an index of the bucket.
+ *
+ * @return the lowest duration of the bucket.
+ */
+HT_API HT_DurationNs ht_feature_callstack_aggregation_get_bucket_min_duration(size_t bucket);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_FEATURE_CALLSTACK_AGGREGATION_H */
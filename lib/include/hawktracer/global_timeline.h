@@ -10,7 +10,8 @@ HT_DECLS_BEGIN
 /**
  * Gets a Global Timeline for the current thread.
  *
- * @return a pointer to the Global Timeline of the current thread.
+ * @return a pointer to the Global Timeline of the current thread, or NULL
+ * if the timeline can't be created.
  */
 HT_API HT_Timeline* ht_global_timeline_get(void);
 
@@ -43,6 +44,16 @@ HT_DECLS_END
  */
 #define HT_G_TRACE(string_label) HT_TRACE(ht_global_timeline_get(), string_label)
 
+/**
+ * Simplified version of the HT_TRACE_SAMPLED() macro for the Global Timeline.
+ */
+#define HT_G_TRACE_SAMPLED(rate, string_label) HT_TRACE_SAMPLED(ht_global_timeline_get(), rate, string_label)
+
+/**
+ * Simplified version of the HT_TRACE_CATEGORY() macro for the Global Timeline.
+ */
+#define HT_G_TRACE_CATEGORY(categories, string_label) HT_TRACE_CATEGORY(ht_global_timeline_get(), categories, string_label)
+
 #ifdef HT_TP_STRACEPOINT
     /**
      * Simplified version of the HT_TRACE_FUNCTION() (or HT_TRACE_FUNCTION_OPT(), depending
@@ -57,6 +68,13 @@ HT_DECLS_END
     #define HT_G_TRACE_FUNCTION() HT_TRACE_FUNCTION(ht_global_timeline_get())
 #endif
 
+#ifdef HT_TRACE_OPT_CONSTEXPR
+    /**
+     * Simplified version of the HT_TRACE_OPT_CONSTEXPR() macro for the Global Timeline.
+     */
+    #define HT_G_TRACE_OPT_CONSTEXPR(string_literal_label) HT_TRACE_OPT_CONSTEXPR(ht_global_timeline_get(), string_literal_label)
+#endif
+
 /**
  * Simplified version of the HT_G_TRACE_OPT_DYNAMIC() macro for the Global Timeline.
  */
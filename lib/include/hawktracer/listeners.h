@@ -2,6 +2,9 @@
 #define HAWKTRACER_LISTENERS_H
 
 #include <hawktracer/listeners/file_dump_listener.h>
+#include <hawktracer/listeners/flight_recorder_listener.h>
+#include <hawktracer/listeners/mmap_file_dump_listener.h>
+#include <hawktracer/listeners/shm_listener.h>
 #include <hawktracer/listeners/tcp_listener.h>
 
 #endif /* HAWKTRACER_LISTENERS_H */
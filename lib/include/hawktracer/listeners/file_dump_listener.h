@@ -2,6 +2,13 @@
  * The listener creates a new file and stores all the incomming
  * events in it. The listener can handle both serialized and
  * unserialized event streams.
+ *
+ * Optionally, the listener can split the stream into multiple files (segments),
+ * so a long-running application doesn't produce a single huge file. Every
+ * segment starts with its own metadata, so it can be parsed independently.
+ *
+ * The listener can also compress the data (see compression.h) to reduce
+ * the size of the files.
  */
 
 #ifndef HAWKTRACER_LISTENERS_FILE_DUMP_LISTENER_H
@@ -59,6 +66,128 @@ HT_API HT_FileDumpListener* ht_file_dump_listener_register(
  */
 HT_API HT_FileDumpListener* ht_file_dump_listener_create(const char* filename, size_t buffer_size, HT_ErrorCode *out_err);
 
+/**
+ * Defines when the file dump listener starts writing to a new file.
+ *
+ * A new segment is started when either of the limits is reached; the limit
+ * set to 0 is disabled. Limits are checked when the listener receives events,
+ * so the segment might be slightly bigger (or longer) than specified.
+ */
+typedef struct
+{
+    /** Maximum number of bytes written to a single segment. */
+    size_t max_segment_size;
+    /** Maximum time (in nanoseconds) since the segment has been created. */
+    HT_DurationNs max_segment_duration;
+    /** Maximum number of segments kept on the disk; the oldest ones are removed.
+     * If set to 0, segments are never removed. */
+    size_t max_segment_count;
+} HT_FileDumpListenerRotation;
+
+/**
+ * Creates an instance of a file dump listener which splits data into multiple files.
+ *
+ * Segments are named `<filename>.<N>`, where N is a sequence number of the segment, starting from 0.
+ * Each segment starts with the metadata (see ht_timeline_listener_push_metadata()); if
+ * @a string_mapping_timeline has the cached string feature enabled, the metadata also contains
+ * all the mappings registered in the feature (see ht_feature_cached_string_push_map_to_listener()).
+ *
+ * Files are opened (ahead of time) and closed by a dedicated thread, so switching to
+ * a new segment doesn't block the thread which pushes events. If the next segment is not
+ * ready yet, events are written to the current one.
+ *
+ * @param filename a base name of segment files.
+ * @param buffer_size a size of the internal buffer.
+ * @param rotation the rotation settings.
+ * @param string_mapping_timeline a timeline which provides string mappings. Can be NULL.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FileDumpListener* ht_file_dump_listener_create_rotating(const char* filename,
+                                                                  size_t buffer_size,
+                                                                  const HT_FileDumpListenerRotation* rotation,
+                                                                  HT_Timeline* string_mapping_timeline,
+                                                                  HT_ErrorCode* out_err);
+
+/**
+ * Creates a rotating file dump listener and registers it to a timeline.
+ *
+ * This is a helper function that wraps ht_file_dump_listener_create_rotating() and
+ * ht_timeline_register_listener_full(). String mappings are taken from @a timeline.
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param filename a base name of segment files.
+ * @param buffer_size a size of the internal buffer.
+ * @param rotation the rotation settings.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FileDumpListener* ht_file_dump_listener_register_rotating(HT_Timeline* timeline,
+                                                                    const char* filename,
+                                                                    size_t buffer_size,
+                                                                    const HT_FileDumpListenerRotation* rotation,
+                                                                    HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a file dump listener with all the options available.
+ *
+ * If @a compress is set to #HT_TRUE, the content of the internal buffer is
+ * compressed every time the buffer is flushed, and the file (or every segment)
+ * is stored in the compressed stream format described in compression.h.
+ * Compression requires the internal buffer, so @a buffer_size must not be 0;
+ * bigger buffers usually give better compression ratio.
+ *
+ * @param filename a name of the file (or a base name of segment files) to store the data in.
+ * @param buffer_size a size of the internal buffer.
+ * @param rotation the rotation settings (see ht_file_dump_listener_create_rotating()),
+ * or NULL if data should be stored in a single file.
+ * @param string_mapping_timeline a timeline which provides string mappings for new segments. Can be NULL.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FileDumpListener* ht_file_dump_listener_create_full(const char* filename,
+                                                              size_t buffer_size,
+                                                              const HT_FileDumpListenerRotation* rotation,
+                                                              HT_Timeline* string_mapping_timeline,
+                                                              HT_Boolean compress,
+                                                              HT_ErrorCode* out_err);
+
+/**
+ * Creates a file dump listener with all the options available and registers it to a timeline.
+ *
+ * This is a helper function that wraps ht_file_dump_listener_create_full() and
+ * ht_timeline_register_listener_full(). String mappings are taken from @a timeline.
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param filename a name of the file (or a base name of segment files) to store the data in.
+ * @param buffer_size a size of the internal buffer.
+ * @param rotation the rotation settings, or NULL if data should be stored in a single file.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FileDumpListener* ht_file_dump_listener_register_full(HT_Timeline* timeline,
+                                                                const char* filename,
+                                                                size_t buffer_size,
+                                                                const HT_FileDumpListenerRotation* rotation,
+                                                                HT_Boolean compress,
+                                                                HT_ErrorCode* out_err);
+
+/**
+ * Gets a sequence number of the segment the listener currently writes to.
+ *
+ * @param listener the listener.
+ *
+ * @return the sequence number of the current segment. For listeners created by
+ * ht_file_dump_listener_create() the function always returns 0.
+ */
+HT_API size_t ht_file_dump_listener_get_segment_number(HT_FileDumpListener* listener);
+
 /**
  * Destroys an instance of the listener.
  *
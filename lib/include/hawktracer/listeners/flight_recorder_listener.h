@@ -0,0 +1,121 @@
+/** @file
+ * The listener keeps the most recent events in a fixed-size in-memory
+ * ring buffer, overwriting the oldest ones, and writes them to a file
+ * only when requested (e.g. when the application detects an error, or on a signal).
+ * The snapshot has the same format as the file created by the file dump
+ * listener, so it can be parsed by any HawkTracer client.
+ */
+
+#ifndef HAWKTRACER_LISTENERS_FLIGHT_RECORDER_LISTENER_H
+#define HAWKTRACER_LISTENERS_FLIGHT_RECORDER_LISTENER_H
+
+#include <hawktracer/timeline.h>
+
+HT_DECLS_BEGIN
+
+typedef struct _HT_FlightRecorderListener HT_FlightRecorderListener;
+
+/**
+ * Creates a flight recorder listener and registers it to a timeline.
+ *
+ * This is a helper function that wraps ht_flight_recorder_listener_create() and
+ * ht_timeline_register_listener_full().
+ *
+ * String mappings of the @a timeline (see ht_feature_cached_string_enable()) are
+ * kept by the listener, see ht_flight_recorder_listener_create_full().
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param capacity a size (in bytes) of the ring buffer.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FlightRecorderListener* ht_flight_recorder_listener_register(
+        HT_Timeline* timeline, size_t capacity, HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a flight recorder listener.
+ *
+ * The ring buffer is allocated upfront. The metadata (see ht_timeline_listener_push_metadata())
+ * and the string mappings are stored outside of the ring buffer, so they're never overwritten;
+ * the listener only allocates memory to update them when new klasses or mappings are registered.
+ * Events are stored in chunks delivered by the timeline; a chunk bigger than
+ * @a capacity is discarded.
+ *
+ * @param capacity a size (in bytes) of the ring buffer.
+ * @param string_mapping_timeline a timeline which string mappings (see ht_feature_cached_string_enable())
+ * are written to the snapshot, or NULL. The timeline must outlive the listener.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FlightRecorderListener* ht_flight_recorder_listener_create_full(
+        size_t capacity, HT_Timeline* string_mapping_timeline, HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a flight recorder listener without string mappings.
+ *
+ * The same as ht_flight_recorder_listener_create_full() with NULL string_mapping_timeline.
+ *
+ * @param capacity a size (in bytes) of the ring buffer.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_FlightRecorderListener* ht_flight_recorder_listener_create(size_t capacity, HT_ErrorCode* out_err);
+
+/**
+ * Destroys an instance of the listener.
+ *
+ * @param listener a pointer to the listener to be destroyed.
+ */
+HT_API void ht_flight_recorder_listener_destroy(HT_FlightRecorderListener* listener);
+
+/**
+ * A listener callback.
+ *
+ * This callback should be used for the ht_timeline_register_listener() function.
+ */
+HT_API void ht_flight_recorder_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data);
+
+/**
+ * Writes the metadata and all the events currently stored in the listener to a file.
+ *
+ * @param listener the listener.
+ * @param filename a name of the file to store the snapshot in.
+ *
+ * @return #HT_ERR_OK if the snapshot has been written; otherwise, appropriate error code.
+ */
+HT_API HT_ErrorCode ht_flight_recorder_listener_dump(HT_FlightRecorderListener* listener, const char* filename);
+
+/**
+ * Installs a signal handler which writes a snapshot of the listener to a file.
+ *
+ * The handler only uses async-signal-safe functions and doesn't take the listener's lock,
+ * so it can be used for crash signals (e.g. SIGSEGV, SIGABRT); in that case, the default
+ * action of the signal is executed after the snapshot is written. For other signals
+ * (e.g. SIGUSR1) the application continues after writing the snapshot. Only one
+ * listener can be dumped by the signal handlers at a time; the function is only
+ * available on POSIX systems.
+ *
+ * @param listener the listener.
+ * @param signal_number the signal.
+ * @param filename a name of the file to store the snapshot in.
+ *
+ * @return #HT_ERR_OK if the handler has been installed; otherwise, appropriate error code.
+ */
+HT_API HT_ErrorCode ht_flight_recorder_listener_dump_on_signal(
+        HT_FlightRecorderListener* listener, int signal_number, const char* filename);
+
+/**
+ * Gets a number of event chunks discarded because they didn't fit into the ring buffer.
+ *
+ * @param listener the listener.
+ *
+ * @return a number of discarded chunks.
+ */
+HT_API size_t ht_flight_recorder_listener_get_dropped_count(HT_FlightRecorderListener* listener);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_LISTENERS_FLIGHT_RECORDER_LISTENER_H */
@@ -0,0 +1,92 @@
+/** @file
+ * The listener creates a new file and stores all the incomming
+ * events in it. Unlike the file dump listener, events are written
+ * directly to a memory-mapped region of the file, so they're not
+ * copied to an intermediate buffer. The file grows in preallocated
+ * extents, and it's truncated to the actual size of the data when
+ * the listener is stopped. The listener can handle both serialized and
+ * unserialized event streams.
+ *
+ * The listener is only available on POSIX systems.
+ */
+
+#ifndef HAWKTRACER_LISTENERS_MMAP_FILE_DUMP_LISTENER_H
+#define HAWKTRACER_LISTENERS_MMAP_FILE_DUMP_LISTENER_H
+
+#include <hawktracer/timeline.h>
+
+HT_DECLS_BEGIN
+
+typedef struct _HT_MmapFileDumpListener HT_MmapFileDumpListener;
+
+/**
+ * Creates a memory-mapped file dump listener and registers it to a timeline.
+ *
+ * This is a helper function that wraps ht_mmap_file_dump_listener_create() and
+ * ht_timeline_register_listener_full().
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param filename a name of the file to store the data in.
+ * @param extent_size a size of the file extent mapped to the memory at a time.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_MmapFileDumpListener* ht_mmap_file_dump_listener_register(
+        HT_Timeline* timeline, const char* filename, size_t extent_size, HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a memory-mapped file dump listener.
+ *
+ * The file is extended by @a extent_size bytes (rounded up to the page size)
+ * every time the currently mapped extent is full. Bigger extents reduce
+ * a number of map/unmap operations, but increase the amount of disk space
+ * allocated upfront.
+ *
+ * @param filename a name of the file to store the data in.
+ * @param extent_size a size of the file extent mapped to the memory at a time.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_MmapFileDumpListener* ht_mmap_file_dump_listener_create(
+        const char* filename, size_t extent_size, HT_ErrorCode* out_err);
+
+/**
+ * Destroys an instance of the listener.
+ *
+ * @param listener a pointer to the listener to be destroyed.
+ */
+HT_API void ht_mmap_file_dump_listener_destroy(HT_MmapFileDumpListener* listener);
+
+/**
+ * A listener callback.
+ *
+ * This callback should be used for the ht_timeline_register_listener() function.
+ */
+HT_API void ht_mmap_file_dump_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data);
+
+/**
+ * Schedules writing the data stored in the mapped region to the disk.
+ *
+ * @param listener a pointer to the listener.
+ * @param wait #HT_TRUE if the function should wait until the data is written; otherwise, #HT_FALSE.
+ *
+ * @return #HT_ERR_OK if the operation completed successfully; otherwise, appropriate error code.
+ */
+HT_API HT_ErrorCode ht_mmap_file_dump_listener_flush(HT_MmapFileDumpListener* listener, HT_Boolean wait);
+
+/**
+ * Stops listening to new events.
+ *
+ * Unmaps the file and truncates it to the size of the data written.
+ * The function is very similar to ht_mmap_file_dump_listener_destroy() except it does not
+ * release the memory allocated for @a listener object.
+ *
+ * @param listener the listener.
+ */
+HT_API void ht_mmap_file_dump_listener_stop(HT_MmapFileDumpListener* listener);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_LISTENERS_MMAP_FILE_DUMP_LISTENER_H */
@@ -0,0 +1,137 @@
+/** @file
+ * The listener writes events to a ring buffer in a named shared memory
+ * segment, which a client running on the same host maps and reads directly.
+ * Data is only copied once on each side, so the throughput is close to
+ * the one of memcpy().
+ *
+ * The ring has a single consumer. If the consumer can't keep up (or it
+ * hasn't been attached yet), and the data passed to the listener in a single
+ * callback doesn't fit into the ring, the data is dropped as a whole, so the
+ * stream can still be parsed.
+ *
+ * The listener is only available on POSIX systems.
+ */
+
+#ifndef HAWKTRACER_LISTENERS_SHM_LISTENER_H
+#define HAWKTRACER_LISTENERS_SHM_LISTENER_H
+
+#include <hawktracer/timeline.h>
+
+HT_DECLS_BEGIN
+
+/** A value of HT_ShmListenerHeader::magic ("HTSR" in the memory). */
+#define HT_SHM_LISTENER_MAGIC 0x52535448u
+/** A version of the shared memory layout. */
+#define HT_SHM_LISTENER_VERSION 1u
+
+/**
+ * The header at the beginning of the shared memory segment.
+ *
+ * The data area starts at @a data_offset from the beginning of the segment,
+ * and it's @a capacity bytes long. @a write_position and @a read_position
+ * are total numbers of bytes written and read; the next byte is at
+ * `position % capacity` in the data area. The producer only updates
+ * @a write_position (after the data is written), and the consumer only
+ * updates @a read_position (after the data is read); both should be
+ * accessed with acquire/release semantics.
+ *
+ * The positions are placed in separate cache lines, so the producer and
+ * the consumer don't invalidate each other's caches.
+ */
+typedef struct
+{
+    /** #HT_SHM_LISTENER_MAGIC; set when the segment is initialized. */
+    uint32_t magic;
+    /** #HT_SHM_LISTENER_VERSION */
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t data_offset;
+    /** Total number of bytes dropped because the ring was full. */
+    uint64_t dropped_size;
+    /** Non-zero if the listener has been stopped, so no more data will be written. */
+    uint32_t closed;
+    uint32_t reserved;
+    uint8_t padding1[24];
+    uint64_t write_position;
+    uint8_t padding2[56];
+    uint64_t read_position;
+    uint8_t padding3[56];
+} HT_ShmListenerHeader;
+
+typedef struct _HT_ShmListener HT_ShmListener;
+
+/**
+ * Creates a shared memory listener and registers it to a timeline.
+ *
+ * This is a helper function that wraps ht_shm_listener_create() and
+ * ht_timeline_register_listener_full().
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param name a name of the shared memory segment.
+ * @param ring_size a size of the ring buffer.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_ShmListener* ht_shm_listener_register(
+        HT_Timeline* timeline, const char* name, size_t ring_size, HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a shared memory listener.
+ *
+ * The listener creates a new shared memory segment @a name (see shm_open()).
+ * If the segment already exists (e.g. it's used by another process, or it's been
+ * left by a process which crashed), the function fails with #HT_ERR_CANT_OPEN_FILE;
+ * a stale segment has to be removed with shm_unlink() first. The segment is removed
+ * when the listener stops, so the client must attach to it before that.
+ *
+ * The metadata (see ht_timeline_listener_push_metadata()) is written to the ring
+ * only once, when the listener is created, so the ring must be big enough to hold it;
+ * otherwise, the function fails with #HT_ERR_INVALID_ARGUMENT.
+ *
+ * @param name a name of the shared memory segment.
+ * @param ring_size a size of the ring buffer; it's rounded up to the page size.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_ShmListener* ht_shm_listener_create(const char* name, size_t ring_size, HT_ErrorCode* out_err);
+
+/**
+ * Destroys an instance of the listener.
+ *
+ * @param listener a pointer to the listener to be destroyed.
+ */
+HT_API void ht_shm_listener_destroy(HT_ShmListener* listener);
+
+/**
+ * A listener callback.
+ *
+ * This callback should be used for the ht_timeline_register_listener() function.
+ */
+HT_API void ht_shm_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data);
+
+/**
+ * Gets a number of bytes which haven't been written to the ring because it was full.
+ *
+ * @param listener the listener.
+ *
+ * @return the number of bytes dropped.
+ */
+HT_API size_t ht_shm_listener_get_dropped_size(HT_ShmListener* listener);
+
+/**
+ * Stops listening to new events.
+ *
+ * Marks the ring as closed, so the client can read the remaining data and stop,
+ * and removes the shared memory segment.
+ * The function is very similar to ht_shm_listener_destroy() except it does not
+ * release the memory allocated for @a listener object.
+ *
+ * @param listener the listener.
+ */
+HT_API void ht_shm_listener_stop(HT_ShmListener* listener);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_LISTENERS_SHM_LISTENER_H */
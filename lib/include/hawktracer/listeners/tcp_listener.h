@@ -9,6 +9,74 @@ HT_DECLS_BEGIN
 
 typedef struct _HT_TCPListener HT_TCPListener;
 
+/**
+ * Defines what the listener does if a client can't receive data
+ * as fast as it is produced, and its send queue is full.
+ */
+typedef enum
+{
+    /** The oldest data which hasn't been sent yet is dropped. Data is dropped at
+     * event boundaries, so the client can still parse the stream. Metadata
+     * sent when the client connects is never dropped. */
+    HT_TCP_LISTENER_SLOW_CLIENT_DROP_OLDEST = 0,
+    /** The client is disconnected. */
+    HT_TCP_LISTENER_SLOW_CLIENT_DISCONNECT = 1,
+    /** The thread pushing events waits until there's enough space in the queue.
+     * Please note this blocks all the threads pushing events to the timeline. */
+    HT_TCP_LISTENER_SLOW_CLIENT_BLOCK = 2
+} HT_TCPListenerSlowClientPolicy;
+
+/** A default size (in bytes) of the client's send queue. */
+#define HT_TCP_LISTENER_DEFAULT_CLIENT_QUEUE_SIZE (4 * 1024 * 1024)
+
+/*
+ * Remote control commands.
+ *
+ * Clients can control the traced process by sending commands over the same
+ * connection they receive the data from. Commands are disabled by default, as
+ * anyone who can connect to the listener could use them; they have to be enabled
+ * with ht_tcp_listener_set_remote_commands_enabled(). A command is a single line of text terminated
+ * with `'\n'`; the command name and the argument (if any) are separated with a space.
+ * Commands are executed by a separate thread of the listener, in the order they're received;
+ * there's no response, but the effect of the command is visible in the data sent to clients.
+ * Invalid commands, and lines longer than 256 characters, are ignored.
+ *
+ * Commands changing timeline features apply to all the timelines which exist when
+ * the command is executed, and have the feature enabled.
+ *
+ * Commands are only handled on platforms which support non-blocking server
+ * (currently, only Linux).
+ */
+/** Stops sending events to clients (see ht_tcp_listener_set_paused()). */
+#define HT_TCP_LISTENER_COMMAND_PAUSE "pause"
+/** Resumes sending events to clients. */
+#define HT_TCP_LISTENER_COMMAND_RESUME "resume"
+/** Flushes all the timelines (see ht_timeline_flush_all()). */
+#define HT_TCP_LISTENER_COMMAND_FLUSH "flush"
+/** Enables the comma-separated list of categories passed as an argument (see ht_category_set_enabled_by_names()). */
+#define HT_TCP_LISTENER_COMMAND_ENABLE_CATEGORIES "enable-categories"
+/** Disables the comma-separated list of categories passed as an argument. */
+#define HT_TCP_LISTENER_COMMAND_DISABLE_CATEGORIES "disable-categories"
+/** Sets the buffer size (in bytes, passed as an argument) of Global Timelines created
+ * afterwards, i.e. by threads which haven't used the Global Timeline yet. Existing
+ * Global Timelines keep their buffers. The size is clamped to the range between
+ * #HT_TCP_LISTENER_MIN_GLOBAL_TIMELINE_BUFFER_SIZE and #HT_TCP_LISTENER_MAX_GLOBAL_TIMELINE_BUFFER_SIZE. */
+#define HT_TCP_LISTENER_COMMAND_NEW_GLOBAL_TIMELINE_BUFFER_SIZE "new-global-timeline-buffer-size"
+/** The smallest Global Timeline buffer size (in bytes) which can be set by clients. */
+#define HT_TCP_LISTENER_MIN_GLOBAL_TIMELINE_BUFFER_SIZE 1024
+/** The biggest Global Timeline buffer size (in bytes) which can be set by clients;
+ * each thread allocates its own buffer. */
+#define HT_TCP_LISTENER_MAX_GLOBAL_TIMELINE_BUFFER_SIZE (16 * 1024 * 1024)
+/** Sets the sampling rate passed as an argument (see ht_feature_callstack_set_sampling_rate()). */
+#define HT_TCP_LISTENER_COMMAND_SAMPLING_RATE "sampling-rate"
+/** Sets the duration threshold and the report interval (in nanoseconds, passed as two
+ * arguments separated with a space; see ht_feature_callstack_set_duration_threshold()). */
+#define HT_TCP_LISTENER_COMMAND_DURATION_THRESHOLD "duration-threshold"
+/** Pauses the callstack aggregation (see ht_feature_callstack_aggregation_set_paused()). */
+#define HT_TCP_LISTENER_COMMAND_PAUSE_AGGREGATION "pause-aggregation"
+/** Resumes the callstack aggregation. */
+#define HT_TCP_LISTENER_COMMAND_RESUME_AGGREGATION "resume-aggregation"
+
 /**
  * Creates a tcp listener and registers it to a timeline.
  *
@@ -40,10 +108,146 @@ HT_API HT_TCPListener* ht_tcp_listener_register(
 
 HT_API HT_TCPListener* ht_tcp_listener_create(int port, size_t buffer_size, HT_ErrorCode* out_err);
 
+/**
+ * Creates an instance of a tcp listener with all the options available.
+ *
+ * If @a compress is set to #HT_TRUE, the listener sends data to clients
+ * in the compressed stream format described in compression.h. Compression
+ * requires the internal buffer, so @a buffer_size must not be 0.
+ *
+ * @param port the port of the TCP server.
+ * @param buffer_size a size of the internal buffer.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_TCPListener* ht_tcp_listener_create_full(int port, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err);
+
+/**
+ * Creates a tcp listener with all the options available and registers it to a timeline.
+ *
+ * See ht_tcp_listener_register() and ht_tcp_listener_create_full() for details.
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param port the port of the TCP server.
+ * @param buffer_size a size of the internal buffer.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_TCPListener* ht_tcp_listener_register_full(
+        HT_Timeline* timeline, int port, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err);
+
+/**
+ * Creates an instance of a listener which sends data to clients through
+ * a Unix domain socket.
+ *
+ * The listener works exactly like the TCP listener, but it's cheaper for clients
+ * running on the same host, as the data doesn't go through the TCP stack. An existing
+ * socket file at @a path is replaced; the file is removed when the listener stops.
+ * Not supported on Windows.
+ *
+ * @param path a path of the socket file.
+ * @param buffer_size a size of the internal buffer.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_TCPListener* ht_tcp_listener_create_unix_socket(
+        const char* path, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err);
+
+/**
+ * Creates a Unix domain socket listener and registers it to a timeline.
+ *
+ * See ht_tcp_listener_create_unix_socket() for details.
+ *
+ * @param timeline the timeline where the listener will be attached to.
+ * @param path a path of the socket file.
+ * @param buffer_size a size of the internal buffer.
+ * @param compress #HT_TRUE if the data should be compressed; otherwise, #HT_FALSE.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to a new instance of the listener.
+ */
+HT_API HT_TCPListener* ht_tcp_listener_register_unix_socket(
+        HT_Timeline* timeline, const char* path, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err);
+
 HT_API void ht_tcp_listener_destroy(HT_TCPListener* listener);
 
 HT_API void ht_tcp_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data);
 
+/**
+ * Configures the send queue of each client.
+ *
+ * Data is sent to clients by a separate thread, so a slow client doesn't
+ * stall the threads pushing events; instead, the data is queued. When the queue
+ * grows bigger than @a max_queue_size, the @a policy is applied. By default, the queue size
+ * is #HT_TCP_LISTENER_DEFAULT_CLIENT_QUEUE_SIZE and the policy is #HT_TCP_LISTENER_SLOW_CLIENT_DROP_OLDEST.
+ *
+ * On platforms which don't support non-blocking server (currently, all except Linux),
+ * data is sent directly and the settings are ignored.
+ *
+ * @param listener the listener.
+ * @param max_queue_size a maximum number of bytes queued for a single client.
+ * @param policy the policy for slow clients.
+ *
+ * @return #HT_ERR_OK if the settings have been applied; #HT_ERR_INVALID_ARGUMENT if
+ * @a max_queue_size is 0 or @a policy is invalid.
+ */
+HT_API HT_ErrorCode ht_tcp_listener_set_slow_client_policy(HT_TCPListener* listener,
+                                                           size_t max_queue_size,
+                                                           HT_TCPListenerSlowClientPolicy policy);
+
+/**
+ * Gets a number of bytes which haven't been sent to clients because of
+ * the slow client policy.
+ *
+ * @param listener the listener.
+ *
+ * @return the total number of bytes dropped (for all the clients).
+ */
+HT_API size_t ht_tcp_listener_get_dropped_size(HT_TCPListener* listener);
+
+/**
+ * Pauses or resumes sending events to clients.
+ *
+ * Events pushed to the listener while it's paused are dropped. Clients are still
+ * accepted, and receive the metadata when they connect. If the listener has been
+ * registered with ht_tcp_listener_register() (or its variants), string mappings
+ * of the timeline (see ht_feature_cached_string_add_mapping()) are sent again after
+ * resuming, so labels mapped while the listener was paused can be resolved. The listener
+ * can also be paused and resumed by clients (see #HT_TCP_LISTENER_COMMAND_PAUSE), if
+ * remote commands are enabled.
+ *
+ * @param listener the listener.
+ * @param paused #HT_TRUE to pause the listener; #HT_FALSE to resume it.
+ */
+HT_API void ht_tcp_listener_set_paused(HT_TCPListener* listener, HT_Boolean paused);
+
+/**
+ * Checks if the listener is paused.
+ *
+ * @param listener the listener.
+ *
+ * @return #HT_TRUE if the listener is paused; otherwise, #HT_FALSE.
+ */
+HT_API HT_Boolean ht_tcp_listener_is_paused(HT_TCPListener* listener);
+
+/**
+ * Enables or disables remote control commands sent by clients.
+ *
+ * Commands are disabled by default; commands received while they're disabled are
+ * dropped. Please note the listener doesn't authenticate clients, so commands should
+ * only be enabled if the port can't be reached by untrusted peers.
+ *
+ * @param listener the listener.
+ * @param enabled #HT_TRUE to execute commands sent by clients; #HT_FALSE to ignore them.
+ */
+HT_API void ht_tcp_listener_set_remote_commands_enabled(HT_TCPListener* listener, HT_Boolean enabled);
+
 /**
  * Stops listening to new events.
  *
@@ -1,6 +1,7 @@
 #ifndef HAWKTRACER_SCOPED_TRACEPOINT_H
 #define HAWKTRACER_SCOPED_TRACEPOINT_H
 
+#include <hawktracer/category.h>
 #include <hawktracer/feature_callstack.h>
 
 #if defined (__cplusplus)
@@ -11,6 +12,15 @@
 #define HT_TP_SCOPED_GENERIC_(type, c_type, timeline, label) \
     HawkTracer::ScopedTracepoint<c_type> HT_UNIQUE_VAR_NAME(ht_tp_scoped_tracepoint)(timeline, ht_feature_callstack_start_##type, label)
 
+#define HT_TP_SAMPLED_SCOPED_GENERIC_(type, c_type, timeline, rate, label) \
+    static HT_THREAD_LOCAL uint32_t HT_UNIQUE_VAR_NAME(ht_tp_sampling_counter) = 0; \
+    HawkTracer::SampledScopedTracepoint<c_type> HT_UNIQUE_VAR_NAME(ht_tp_scoped_tracepoint)( \
+        timeline, HT_UNIQUE_VAR_NAME(ht_tp_sampling_counter), rate, ht_feature_callstack_start_##type##_weighted, label)
+
+#define HT_TP_CATEGORY_SCOPED_GENERIC_(type, c_type, timeline, categories, label) \
+    HawkTracer::CategoryScopedTracepoint<c_type> HT_UNIQUE_VAR_NAME(ht_tp_scoped_tracepoint)( \
+        timeline, categories, ht_feature_callstack_start_##type, label)
+
 #elif defined(__GNUC__)
 #define HT_SCOPED_TRACEPOINT_MACRO_ENABLED
 
@@ -18,12 +28,23 @@ HT_DECLS_BEGIN
 void _ht_callstack_timeline_scoped_cleanup(HT_Timeline** timeline);
 HT_Timeline* _ht_callstack_timeline_int_start_and_ret(HT_Timeline* t, HT_CallstackEventLabel l);
 HT_Timeline* _ht_callstack_timeline_string_start_and_ret(HT_Timeline* t, const char* l);
+HT_Timeline* _ht_callstack_timeline_int_sampled_start_and_ret(HT_Timeline* t, uint32_t* counter, uint32_t rate, HT_CallstackEventLabel l);
+HT_Timeline* _ht_callstack_timeline_string_sampled_start_and_ret(HT_Timeline* t, uint32_t* counter, uint32_t rate, const char* l);
 HT_DECLS_END
 
 #define HT_TP_SCOPED_GENERIC_(type, c_type, callstack_timeline, label) \
     HT_Timeline* _ht_callstack_timeline __attribute__ ((__cleanup__(_ht_callstack_timeline_scoped_cleanup))) \
         = _ht_callstack_timeline_##type##_start_and_ret(callstack_timeline, label)
 
+#define HT_TP_SAMPLED_SCOPED_GENERIC_(type, c_type, callstack_timeline, rate, label) \
+    static HT_THREAD_LOCAL uint32_t HT_UNIQUE_VAR_NAME(ht_tp_sampling_counter) = 0; \
+    HT_Timeline* _ht_callstack_timeline __attribute__ ((__cleanup__(_ht_callstack_timeline_scoped_cleanup))) \
+        = _ht_callstack_timeline_##type##_sampled_start_and_ret(callstack_timeline, &HT_UNIQUE_VAR_NAME(ht_tp_sampling_counter), rate, label)
+
+#define HT_TP_CATEGORY_SCOPED_GENERIC_(type, c_type, callstack_timeline, categories, label) \
+    HT_Timeline* _ht_callstack_timeline __attribute__ ((__cleanup__(_ht_callstack_timeline_scoped_cleanup))) \
+        = HT_CATEGORY_IS_ENABLED(categories) ? _ht_callstack_timeline_##type##_start_and_ret(callstack_timeline, label) : NULL
+
 #endif
 
 #ifdef HT_SCOPED_TRACEPOINT_MACRO_ENABLED
@@ -31,6 +52,14 @@ HT_DECLS_END
 #define HT_TP_SCOPED_INT(timeline, label) HT_TP_SCOPED_GENERIC_(int, HT_CallstackEventLabel, timeline, label)
 #define HT_TP_SCOPED_STRING(timeline, label) HT_TP_SCOPED_GENERIC_(string, const char*, timeline, label)
 
+/* Record the first of every rate hits of the tracepoint on every thread, with a weight rate. */
+#define HT_TP_SAMPLED_SCOPED_INT(timeline, rate, label) HT_TP_SAMPLED_SCOPED_GENERIC_(int, HT_CallstackEventLabel, timeline, rate, label)
+#define HT_TP_SAMPLED_SCOPED_STRING(timeline, rate, label) HT_TP_SAMPLED_SCOPED_GENERIC_(string, const char*, timeline, rate, label)
+
+/* Record the scope only if any of the categories is enabled (see category.h). */
+#define HT_TP_CATEGORY_SCOPED_INT(timeline, categories, label) HT_TP_CATEGORY_SCOPED_GENERIC_(int, HT_CallstackEventLabel, timeline, categories, label)
+#define HT_TP_CATEGORY_SCOPED_STRING(timeline, categories, label) HT_TP_CATEGORY_SCOPED_GENERIC_(string, const char*, timeline, categories, label)
+
 #endif /* HT_HAS_SCOPED_TRACEPOINT */
 
 #endif /* HAWKTRACER_SCOPED_TRACEPOINT_H */
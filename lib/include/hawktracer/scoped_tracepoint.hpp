@@ -3,6 +3,7 @@
 
 #ifdef __cplusplus
 
+#include <hawktracer/category.h>
 #include <hawktracer/feature_callstack.h>
 
 namespace HawkTracer
@@ -42,6 +43,70 @@ private:
     HT_Timeline* _timeline;
 };
 
+/* Records the scope only if any of the @a categories is enabled when the scope starts. */
+template<typename T>
+class CategoryScopedTracepoint
+{
+public:
+    CategoryScopedTracepoint(
+            HT_Timeline* timeline, HT_Category categories,
+            void (*start_fnc)(HT_Timeline*, T), T label):
+        _timeline(NULL)
+    {
+        if (HT_CATEGORY_IS_ENABLED(categories))
+        {
+            _timeline = timeline;
+            start_fnc(_timeline, label);
+        }
+    }
+
+    ~CategoryScopedTracepoint()
+    {
+        if (_timeline)
+        {
+            ht_feature_callstack_stop(_timeline);
+        }
+    }
+
+private:
+    HT_Timeline* _timeline;
+};
+
+/* Records the first of every @a rate hits of a tracepoint, counted with @a counter
+ * (a thread-local variable of the call site). The recorded frame has a weight @a rate. */
+template<typename T>
+class SampledScopedTracepoint
+{
+public:
+    SampledScopedTracepoint(
+            HT_Timeline* timeline, uint32_t& counter, uint32_t rate,
+            void (*start_fnc)(HT_Timeline*, T, uint32_t), T label):
+        _timeline(NULL)
+    {
+        bool sampled = counter == 0;
+        if (++counter >= rate)
+        {
+            counter = 0;
+        }
+        if (sampled)
+        {
+            _timeline = timeline;
+            start_fnc(_timeline, label, rate);
+        }
+    }
+
+    ~SampledScopedTracepoint()
+    {
+        if (_timeline)
+        {
+            ht_feature_callstack_stop(_timeline);
+        }
+    }
+
+private:
+    HT_Timeline* _timeline;
+};
+
 } /* namespace HawkTracer */
 
 #endif /* __cplusplus */
@@ -19,6 +19,54 @@
     static HT_THREAD_LOCAL uintptr_t HT_UNIQUE_VAR_NAME(fnc_track) = ht_feature_cached_string_add_mapping(timeline, label); \
     HT_TP_SCOPED_INT(timeline, (uintptr_t)HT_UNIQUE_VAR_NAME(fnc_track));
 
+#ifdef HT_CPP11
+
+namespace HawkTracer
+{
+namespace ConstexprLabel
+{
+
+/**
+ * Computes an identifier of the label at compile time.
+ *
+ * The function gives the same value as the hash function used by
+ * ht_feature_cached_string_add_mapping_dynamic(), so the label has the
+ * same identifier in both static and dynamic tracepoints.
+ */
+constexpr uint32_t hash(const char* label, uint32_t value = 5381)
+{
+    return *label ? hash(label + 1, value * 33 + (unsigned int)*label) : value;
+}
+
+inline uintptr_t add_mapping(HT_Timeline* timeline, const char* label, uintptr_t label_id)
+{
+    return ht_feature_cached_string_add_hashed_mapping(timeline, label, label_id);
+}
+
+} /* namespace ConstexprLabel */
+} /* namespace HawkTracer */
+
+/**
+ * Creates a tracepoint that measures time spent in the scope.
+ *
+ * The identifier of the label is computed at compile time. The mapping is checked
+ * in the @a timeline every time the tracepoint is hit (a lock-free lookup, without
+ * hashing the label), and only added the first time the tracepoint is used with that
+ * timeline, so every timeline (including every thread's Global Timeline) gets its own mapping.
+ *
+ * The label must be a string literal. Labels are identified by a 32-bit hash,
+ * just like in HT_TP_DYN_STRACEPOINT().
+ *
+ * @param timeline a timeline where the event will be posted to.
+ * @param label a string literal label of the tracepoint.
+ */
+#define HT_TP_CONSTEXPR_STRACEPOINT(timeline, label) \
+    static constexpr uintptr_t HT_UNIQUE_VAR_NAME(ht_label_id) = HawkTracer::ConstexprLabel::hash(label); \
+    HawkTracer::ConstexprLabel::add_mapping(timeline, label, HT_UNIQUE_VAR_NAME(ht_label_id)); \
+    HT_TP_SCOPED_INT(timeline, HT_UNIQUE_VAR_NAME(ht_label_id));
+
+#endif /* HT_CPP11 */
+
 #elif defined(HT_USE_PTHREADS) && defined(HT_SCOPED_TRACEPOINT_MACRO_ENABLED)
 
 #include <hawktracer/posix_mapped_tracepoint.h>
@@ -1,6 +1,7 @@
 #ifndef HAWKTRACER_TIMELINE_H
 #define HAWKTRACER_TIMELINE_H
 
+#include <hawktracer/category.h>
 #include <hawktracer/events.h>
 #include <hawktracer/monotonic_clock.h>
 #include <hawktracer/timeline_listener.h>
@@ -22,12 +23,64 @@ HT_DECLS_BEGIN
 
 typedef struct _HT_Timeline HT_Timeline;
 
+/** Defines how a timeline handles events pushed from multiple threads. */
+typedef enum
+{
+    /** The timeline must only be used from a single thread at a time. */
+    HT_TIMELINE_THREAD_SAFETY_NONE = 0,
+    /** All the threads share one buffer, every push locks the timeline's mutex. */
+    HT_TIMELINE_THREAD_SAFETY_LOCK = 1,
+    /**
+     * Each thread pushes events to its own buffer without taking any lock. Full buffers
+     * are passed to listeners through a lock-free queue, and listeners are notified
+     * by one thread at a time. Events of a single thread are delivered in order,
+     * but there's no ordering between events pushed from different threads.
+     */
+    HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER = 2
+} HT_TimelineThreadSafety;
+
+/** Defines what happens when an asynchronous timeline runs out of free buffers. */
+typedef enum
+{
+    /** The pushing thread waits until the dispatcher thread releases one of the buffers. */
+    HT_ASYNC_FLUSH_POLICY_BLOCK = 0,
+    /** Events from the full buffer are discarded, and the buffer is re-used. */
+    HT_ASYNC_FLUSH_POLICY_DROP = 1
+} HT_AsyncFlushPolicy;
+
+/**
+ * Creates a timeline.
+ *
+ * The function is equivalent of ht_timeline_create_full() called with
+ * #HT_TIMELINE_THREAD_SAFETY_LOCK (if @a thread_safe is #HT_TRUE) or
+ * #HT_TIMELINE_THREAD_SAFETY_NONE (if @a thread_safe is #HT_FALSE).
+ */
 HT_API HT_Timeline* ht_timeline_create(size_t buffer_capacity,
                                        HT_Boolean thread_safe,
                                        HT_Boolean serialize_events,
                                        const char* listeners,
                                        HT_ErrorCode* out_err);
 
+/**
+ * Creates a timeline.
+ *
+ * For #HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER timelines, @a buffer_capacity
+ * is a capacity of the buffer of each thread pushing events to the timeline.
+ *
+ * @param buffer_capacity a size of the internal buffer.
+ * @param thread_safety the way the timeline handles events pushed from multiple threads.
+ * @param serialize_events indicates whether events should be serialized before storing them in the buffer.
+ * @param listeners a name of the shared listener container, or NULL if the timeline should have its own listeners.
+ * @param out_err a pointer to an error code variable where the error will be stored if the operation fails.
+ *
+ * @return a pointer to the new timeline, or NULL if the operation fails.
+ */
+HT_API HT_Timeline* ht_timeline_create_full(size_t buffer_capacity,
+                                            HT_TimelineThreadSafety thread_safety,
+                                            HT_Boolean serialize_events,
+                                            const char* listeners,
+                                            HT_ErrorCode* out_err);
+
 /**
  * Destroys a timeline
  *
@@ -100,13 +153,177 @@ HT_API void ht_timeline_init_event(HT_Timeline* timeline, HT_Event* event);
  */
 HT_API void ht_timeline_push_event(HT_Timeline* timeline, HT_Event* event);
 
+/**
+ * Pushes many events of the same klass to a timeline.
+ *
+ * The events are stored exactly as if they were pushed one by one with ht_timeline_push_event(),
+ * but the timeline is locked only once, and (if the timeline doesn't serialize events)
+ * all the events which fit into the buffer are copied at once.
+ *
+ * @param timeline the timeline.
+ * @param klass the klass of all the events.
+ * @param events an array of @a count events of the @a klass.
+ * @param count a number of events.
+ */
+HT_API void ht_timeline_push_events(HT_Timeline* timeline, HT_EventKlass* klass, HT_Event* events, size_t count);
+
+/**
+ * Pushes many events of the same klass, given as parallel arrays of field values.
+ *
+ * The base of every event is copied from the @a prototype, which should be initialized
+ * with ht_timeline_init_event(); only the identifier is unique for every event. The rest
+ * of the fields are taken from the @a columns, e.g. for the event declared as
+ * `HT_DECLARE_EVENT_KLASS(QueueDepthEvent, HT_Event, (INTEGER, uint32_t, queue), (INTEGER, uint64_t, depth))`,
+ * @a columns are an array of `uint32_t` queues and an array of `uint64_t` depths.
+ * The timeline is locked only once for all the events.
+ *
+ * Please note that fields of the base are not taken from the @a columns, so all the events
+ * have the same timestamp (and e.g. the same duration and thread_id for klasses based on
+ * HT_CallstackBaseEvent). Events which differ in the base fields should be pushed with
+ * ht_timeline_push_events() instead.
+ *
+ * @param timeline the timeline.
+ * @param prototype the event which specifies the klass and the base of the events.
+ * @param columns arrays of @a count values, one for every field of the klass (in the order of
+ * declaration), except the base.
+ * @param count a number of events.
+ */
+HT_API void ht_timeline_push_event_columns(HT_Timeline* timeline, HT_Event* prototype, const void* const* columns, size_t count);
+
+/**
+ * Reserves space for an event directly in the timeline's buffer.
+ *
+ * The function allows writing an event straight to the timeline's buffer instead of
+ * constructing it first and then copying it with ht_timeline_push_event(). The event
+ * must be written in the format the timeline stores events in; i.e. serialized,
+ * if ht_timeline_get_serialize_events() returns #HT_TRUE, or as a C structure otherwise.
+ * Every successful call must be followed by ht_timeline_commit() called from the same thread;
+ * for #HT_TIMELINE_THREAD_SAFETY_LOCK timelines, the timeline stays locked until then,
+ * so no other timeline function must be called in between.
+ *
+ * The buffer might be flushed by this function if there's not enough space for the event.
+ *
+ * @param timeline the timeline.
+ * @param size a maximum size of the event.
+ *
+ * @return a pointer to the reserved space, or NULL if @a size exceeds the capacity of the
+ * timeline's buffer, or the timeline uses the compact serialization (ht_timeline_push_event()
+ * must be used in both cases).
+ */
+HT_API HT_Byte* ht_timeline_reserve(HT_Timeline* timeline, size_t size);
+
+/**
+ * Commits an event written to a space reserved by ht_timeline_reserve().
+ *
+ * @param timeline the timeline.
+ * @param size a number of bytes actually written; can't be greater than the reserved size.
+ */
+HT_API void ht_timeline_commit(HT_Timeline* timeline, size_t size);
+
+/**
+ * Checks whether the timeline stores events in a serialized form.
+ *
+ * @param timeline the timeline.
+ *
+ * @return #HT_TRUE if events are serialized; otherwise, #HT_FALSE.
+ */
+HT_API HT_Boolean ht_timeline_get_serialize_events(HT_Timeline* timeline);
+
 /**
  * Transfers all the events from internal buffer to listeners.
  *
+ * For #HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER timelines, only the buffer of the
+ * calling thread is flushed (buffers of other threads are flushed when they're full, or
+ * when the timeline is destroyed). If another thread is notifying listeners at the same time,
+ * the events are delivered by that thread.
+ *
+ * For timelines with asynchronous flush enabled, the function blocks until
+ * all the pending buffers are delivered to listeners.
+ *
  * @param timeline the timeline.
  */
 HT_API void ht_timeline_flush(HT_Timeline* timeline);
 
+/**
+ * Requests flushing all the timelines.
+ *
+ * Timelines are not flushed immediately; instead, every timeline flushes its buffer
+ * (see ht_timeline_flush()) when the next event is pushed to it, so the flush is
+ * done by a thread which is allowed to use the timeline. Therefore, the function
+ * can be called from any thread, e.g. when a remote client requests a flush.
+ */
+HT_API void ht_timeline_request_flush_all(void);
+
+/**
+ * Flushes all the timelines.
+ *
+ * Thread-safe timelines (#HT_TIMELINE_THREAD_SAFETY_LOCK) are flushed immediately
+ * (see ht_timeline_flush()), so the events are delivered even if no thread
+ * pushes events to them anymore. For #HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER
+ * timelines, full buffers waiting for delivery are delivered immediately. Other
+ * timelines can only be flushed by the thread using them, so they're flushed
+ * when the next event is pushed (see ht_timeline_request_flush_all()).
+ *
+ * Only timelines created after ht_init() are flushed immediately. The function
+ * blocks until the timelines are flushed, so it must not be called from a listener callback,
+ * or from any thread which listeners of the timelines wait for.
+ */
+HT_API void ht_timeline_flush_all(void);
+
+/**
+ * Moves notifying listeners to a background thread.
+ *
+ * Once enabled, a full buffer is not passed to listeners by the thread pushing
+ * the event; instead, it's swapped for a free buffer from a pool, and
+ * delivered to listeners by a dedicated dispatcher thread. If all the buffers
+ * in the pool are waiting for being delivered, the timeline behaves according to @a policy.
+ * ht_timeline_flush() blocks until all the pending buffers are delivered.
+ *
+ * The mode can't be enabled for #HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER timelines.
+ *
+ * @param timeline the timeline.
+ * @param pool_depth a number of buffers in the pool (including the one currently being filled); must be at least 2.
+ * @param policy the behavior when there's no free buffer in the pool.
+ *
+ * @return #HT_ERR_OK if the mode has been enabled; otherwise, error code.
+ */
+HT_API HT_ErrorCode ht_timeline_enable_async_flush(HT_Timeline* timeline,
+                                                   size_t pool_depth,
+                                                   HT_AsyncFlushPolicy policy);
+
+/**
+ * Gets a number of buffers discarded by the timeline.
+ *
+ * Buffers are only discarded by timelines with asynchronous flush enabled
+ * with #HT_ASYNC_FLUSH_POLICY_DROP policy. Events bigger than the timeline's buffer
+ * are queued as separate copies; they're counted as discarded buffers when too many
+ * copies are waiting for delivery, or when the copy can't be allocated (regardless of the policy).
+ *
+ * @param timeline the timeline.
+ *
+ * @return a number of discarded buffers.
+ */
+HT_API uint64_t ht_timeline_get_dropped_buffer_count(HT_Timeline* timeline);
+
+/**
+ * Enables the compact serialization format.
+ *
+ * Once enabled, events pushed to the timeline are stored in blocks, where the timestamp
+ * and the identifier are encoded as deltas from the previous event, and integer fields
+ * are encoded as varints (see compact_encoding.h for details). Consecutive events of
+ * a thread usually differ only slightly, so the stream is a few times smaller.
+ * Events which don't fit into the buffer in the compact format are stored in the
+ * regular format. The format is decoded by the parser library.
+ *
+ * The function must be called before any event is pushed to the timeline.
+ *
+ * @param timeline the timeline.
+ *
+ * @return #HT_ERR_OK if the format has been enabled; #HT_ERR_INVALID_ARGUMENT if the timeline
+ * doesn't serialize events.
+ */
+HT_API HT_ErrorCode ht_timeline_enable_compact_serialization(HT_Timeline* timeline);
+
 /**
  * Enables a specific feature in the timeline.
  *
@@ -182,6 +399,56 @@ HT_API HT_EventIdProvider* ht_timeline_get_id_provider(HT_Timeline* timeline);
         ht_timeline_push_event(TIMELINE, HT_EVENT(&ev)); \
     } while (0)
 
+/**
+ * Pushes an event to the timeline if any of the @a CATEGORIES is enabled.
+ *
+ * The macro is equivalent of HT_TIMELINE_PUSH_EVENT(), but if the categories
+ * are disabled, neither the event nor its parameters are evaluated.
+ *
+ * @param TIMELINE the timeline.
+ * @param CATEGORIES the categories of the event (see category.h).
+ * @param EVENT_TYPE a type of the event to push.
+ * @param ... a list of parameters of the event.
+ */
+#define HT_TIMELINE_PUSH_EVENT_IN_CATEGORY(TIMELINE, CATEGORIES, EVENT_TYPE, ...) \
+    do { \
+        if (HT_CATEGORY_IS_ENABLED(CATEGORIES)) \
+        { \
+            HT_TIMELINE_PUSH_EVENT(TIMELINE, EVENT_TYPE, __VA_ARGS__); \
+        } \
+    } while (0)
+
+/**
+ * Pushes an event to the timeline, writing it directly to the timeline's buffer.
+ *
+ * Unlike HT_TIMELINE_PUSH_EVENT_PEDANTIC(), the macro doesn't construct the event first;
+ * the base of the event and the values of the rest of the fields are passed to a function
+ * generated for the event klass, which writes (or serializes) them straight to the space
+ * reserved by ht_timeline_reserve(). Events which don't fit into the timeline's buffer
+ * are constructed and pushed using ht_timeline_push_event().
+ * The initializer of the base must be enclosed in parentheses, e.g.:
+ * @code
+ * HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, MyEvent, (ht_base_event), field1, field2);
+ * HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, HT_CallstackIntEvent, ({ht_base_event, duration, thread_id}), label);
+ * @endcode
+ *
+ * @param TIMELINE the timeline.
+ * @param EVENT_TYPE a type of the event to push.
+ * @param BASE the initializer of the base of the event, in parentheses.
+ * @param ... values of the rest of the fields of the event (all of them, in the order of declaration).
+ */
+#define HT_TIMELINE_PUSH_EVENT_IN_PLACE(TIMELINE, EVENT_TYPE, BASE, ...) \
+    do { \
+        HT_Timeline* ht_timeline_ = (TIMELINE); \
+        HT_Event ht_base_event = { \
+            ht_##EVENT_TYPE##_get_event_klass_instance(), \
+            ht_monotonic_clock_get_timestamp(), \
+            ht_event_id_provider_next(ht_timeline_get_id_provider(ht_timeline_)) \
+        }; \
+        struct { ht_##EVENT_TYPE##_base_type base; } ht_base_ = {MKCREFLECT_EXPAND_VA_ BASE}; \
+        ht_##EVENT_TYPE##_fnc_push_fields(ht_timeline_, &ht_base_.base, __VA_ARGS__); \
+    } while (0)
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_TIMELINE_H */
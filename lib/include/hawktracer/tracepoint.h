@@ -14,12 +14,23 @@
     #define HT_TRACE_OPT_DYNAMIC(timeline, dynamic_string_label) \
         HT_TP_DYN_STRACEPOINT(timeline, dynamic_string_label)
 
+    #define HT_TRACE_SAMPLED(timeline, rate, string_label) \
+        HT_TP_SAMPLED_SCOPED_STRING(timeline, rate, string_label)
+
+    #define HT_TRACE_CATEGORY(timeline, categories, string_label) \
+        HT_TP_CATEGORY_SCOPED_STRING(timeline, categories, string_label)
+
     #define HT_TRACE_FUNCTION(timeline) \
         HT_TRACE(timeline, __func__)
 
     #define HT_TRACE_FUNCTION_OPT(timeline) \
         HT_TP_FUNCTION(timeline)
 
+#ifdef HT_TP_CONSTEXPR_STRACEPOINT
+    #define HT_TRACE_OPT_CONSTEXPR(timeline, string_literal_label) \
+        HT_TP_CONSTEXPR_STRACEPOINT(timeline, string_literal_label)
+#endif
+
 #endif /* HT_SCOPED_TRACEPOINT_MACRO_ENABLED */
 
 #endif /* HAWKTRACER_TACEPOINT_H */
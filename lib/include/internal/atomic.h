@@ -0,0 +1,162 @@
+#ifndef HAWKTRACER_INTERNAL_ATOMIC_H
+#define HAWKTRACER_INTERNAL_ATOMIC_H
+
+/**
+ * Minimal set of atomic operations used by lock-free parts of the library.
+ *
+ * The library can be compiled both as C and C++ code (see amalgamation),
+ * so the operations are implemented on top of compiler intrinsics instead
+ * of <stdatomic.h> or <atomic>. All the operations are sequentially consistent.
+ */
+
+#include <hawktracer/base_types.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define HT_ATOMIC_IMPL_GNUC
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define HT_ATOMIC_IMPL_MSVC
+#else
+#  error "Atomic operations are not supported by the compiler."
+#endif
+
+HT_DECLS_BEGIN
+
+static HT_INLINE void*
+ht_atomic_ptr_load(void* volatile* ptr)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#else
+    return _InterlockedCompareExchangePointer(ptr, NULL, NULL);
+#endif
+}
+
+static HT_INLINE void
+ht_atomic_ptr_store(void* volatile* ptr, void* value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    _InterlockedExchangePointer(ptr, value);
+#endif
+}
+
+static HT_INLINE void*
+ht_atomic_ptr_exchange(void* volatile* ptr, void* value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    return _InterlockedExchangePointer(ptr, value);
+#endif
+}
+
+/**
+ * Replaces the value pointed by @a ptr with @a desired if it's equal to @a expected.
+ *
+ * @return #HT_TRUE if the value has been replaced; otherwise, #HT_FALSE.
+ */
+static HT_INLINE HT_Boolean
+ht_atomic_ptr_compare_exchange(void* volatile* ptr, void* expected, void* desired)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? HT_TRUE : HT_FALSE;
+#else
+    return _InterlockedCompareExchangePointer(ptr, desired, expected) == expected ? HT_TRUE : HT_FALSE;
+#endif
+}
+
+static HT_INLINE long
+ht_atomic_long_exchange(volatile long* ptr, long value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    return _InterlockedExchange(ptr, value);
+#endif
+}
+
+static HT_INLINE long
+ht_atomic_long_load(volatile long* ptr)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#else
+    return _InterlockedCompareExchange(ptr, 0, 0);
+#endif
+}
+
+static HT_INLINE HT_Boolean
+ht_atomic_long_compare_exchange(volatile long* ptr, long expected, long desired)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? HT_TRUE : HT_FALSE;
+#else
+    return _InterlockedCompareExchange(ptr, desired, expected) == expected ? HT_TRUE : HT_FALSE;
+#endif
+}
+
+static HT_INLINE uint64_t
+ht_atomic_uint64_fetch_add(volatile uint64_t* ptr, uint64_t value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64*)ptr, (__int64)value);
+#endif
+}
+
+static HT_INLINE uint64_t
+ht_atomic_uint64_load(volatile uint64_t* ptr)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#else
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)ptr, 0, 0);
+#endif
+}
+
+static HT_INLINE void
+ht_atomic_uint64_store(volatile uint64_t* ptr, uint64_t value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    _InterlockedExchange64((volatile __int64*)ptr, (__int64)value);
+#endif
+}
+
+static HT_INLINE uint32_t
+ht_atomic_uint32_fetch_add(volatile uint32_t* ptr, uint32_t value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    return (uint32_t)_InterlockedExchangeAdd((volatile long*)ptr, (long)value);
+#endif
+}
+
+static HT_INLINE uint32_t
+ht_atomic_uint32_load(volatile uint32_t* ptr)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+#else
+    return (uint32_t)_InterlockedCompareExchange((volatile long*)ptr, 0, 0);
+#endif
+}
+
+static HT_INLINE void
+ht_atomic_uint32_store(volatile uint32_t* ptr, uint32_t value)
+{
+#ifdef HT_ATOMIC_IMPL_GNUC
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+#else
+    _InterlockedExchange((volatile long*)ptr, (long)value);
+#endif
+}
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_INTERNAL_ATOMIC_H */
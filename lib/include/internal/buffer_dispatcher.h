@@ -0,0 +1,93 @@
+#ifndef HAWKTRACER_INTERNAL_BUFFER_DISPATCHER_H
+#define HAWKTRACER_INTERNAL_BUFFER_DISPATCHER_H
+
+#include <hawktracer/timeline.h>
+
+#include <stddef.h>
+
+HT_DECLS_BEGIN
+
+/**
+ * Passes full buffers to a dedicated thread which delivers them to a callback.
+ *
+ * The dispatcher owns a fixed pool of buffers; the producer writes to one of them,
+ * and once it's full, swaps it for a free one. If there's no free buffer, the
+ * producer either waits until the dispatcher thread releases one
+ * (#HT_ASYNC_FLUSH_POLICY_BLOCK), or the content of the full buffer is discarded
+ * (#HT_ASYNC_FLUSH_POLICY_DROP).
+ *
+ * All the functions except ht_buffer_dispatcher_get_dropped_count() must be called
+ * by one producer thread at a time.
+ */
+typedef struct _HT_BufferDispatcher HT_BufferDispatcher;
+
+typedef void(*HT_BufferDispatcherCallback)(HT_Byte* data, size_t size, void* user_data);
+
+HT_BufferDispatcher* ht_buffer_dispatcher_create(size_t buffer_capacity,
+                                                 size_t pool_depth,
+                                                 HT_AsyncFlushPolicy policy,
+                                                 HT_BufferDispatcherCallback callback,
+                                                 void* user_data,
+                                                 HT_ErrorCode* out_err);
+
+/**
+ * Flushes all the pending buffers, stops the dispatcher thread and releases the pool.
+ *
+ * Buffers returned by ht_buffer_dispatcher_get_buffer() and ht_buffer_dispatcher_swap()
+ * are released as well, so they must not be used after this call.
+ */
+void ht_buffer_dispatcher_destroy(HT_BufferDispatcher* dispatcher);
+
+/**
+ * Takes a buffer from the pool. Should only be called once, for getting the very first buffer;
+ * following buffers should be obtained by ht_buffer_dispatcher_swap().
+ */
+HT_Byte* ht_buffer_dispatcher_get_buffer(HT_BufferDispatcher* dispatcher);
+
+/**
+ * Queues a buffer for delivery and returns a free one.
+ *
+ * @param dispatcher the dispatcher.
+ * @param buffer the full buffer obtained from the dispatcher.
+ * @param usage a number of bytes written to the @a buffer.
+ *
+ * @return a buffer which can be used for writing new data. For #HT_ASYNC_FLUSH_POLICY_DROP
+ * dispatchers this might be the same @a buffer, if there was no free buffer in the pool.
+ */
+HT_Byte* ht_buffer_dispatcher_swap(HT_BufferDispatcher* dispatcher, HT_Byte* buffer, size_t usage);
+
+/**
+ * Queues a buffer for delivery regardless of the policy, without waiting for listeners.
+ *
+ * If there's no free buffer in the pool, a copy of the data is queued instead, and
+ * the @a buffer is returned, so it can be re-used straight away. Meant for explicit flushes,
+ * which must not drop the data, and which can be called with locks that listeners might need.
+ *
+ * @param dispatcher the dispatcher.
+ * @param buffer the buffer obtained from the dispatcher.
+ * @param usage a number of bytes written to the @a buffer.
+ *
+ * @return a buffer which can be used for writing new data.
+ */
+HT_Byte* ht_buffer_dispatcher_flush(HT_BufferDispatcher* dispatcher, HT_Byte* buffer, size_t usage);
+
+/**
+ * Queues a copy of the data for delivery. The copy doesn't come from the pool, so
+ * the function should only be used for data which doesn't fit into pool buffers.
+ *
+ * At most pool_depth copies can be queued at a time; above that, the data is handled
+ * according to the dispatcher's policy, the same way as in ht_buffer_dispatcher_swap().
+ * The data is also discarded (and counted as dropped) if the copy can't be allocated.
+ */
+void ht_buffer_dispatcher_push_copy(HT_BufferDispatcher* dispatcher, const HT_Byte* data, size_t size);
+
+/**
+ * Blocks the calling thread until all the queued buffers are delivered.
+ */
+void ht_buffer_dispatcher_wait_idle(HT_BufferDispatcher* dispatcher);
+
+uint64_t ht_buffer_dispatcher_get_dropped_count(HT_BufferDispatcher* dispatcher);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_INTERNAL_BUFFER_DISPATCHER_H */
@@ -5,6 +5,8 @@
 
 HT_DECLS_BEGIN
 
+size_t ht_event_utils_get_event_size(HT_Event* event, HT_Boolean serialize);
+
 size_t ht_event_utils_serialize_event_to_buffer(HT_Event* event, HT_Byte* buffer, HT_Boolean serialize);
 
 HT_DECLS_END
@@ -9,6 +9,7 @@ void ht_feature_register_core_features(void);
 
 HT_ErrorCode HT_FeatureCachedString_register(void);
 HT_ErrorCode HT_FeatureCallstack_register(void);
+HT_ErrorCode HT_FeatureCallstackAggregation_register(void);
 
 HT_DECLS_END
 
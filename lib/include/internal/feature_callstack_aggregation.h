@@ -0,0 +1,38 @@
+#ifndef HAWKTRACER_INTERNAL_FEATURE_CALLSTACK_AGGREGATION_H
+#define HAWKTRACER_INTERNAL_FEATURE_CALLSTACK_AGGREGATION_H
+
+#include <hawktracer/feature_callstack_aggregation.h>
+
+HT_DECLS_BEGIN
+
+typedef struct _HT_FeatureCallstackAggregation HT_FeatureCallstackAggregation;
+
+/* Returns NULL if the feature is not enabled for the timeline. */
+HT_FeatureCallstackAggregation* ht_feature_callstack_aggregation_get(HT_Timeline* timeline);
+
+/* Path of a root frame has a parent path 0; path identifiers are never 0. */
+HT_INLINE static uint64_t
+ht_feature_callstack_aggregation_get_path_id(uint64_t parent_path_id, HT_CallstackEventLabel label)
+{
+    uint64_t path_id = (parent_path_id ^ label) * 0x9E3779B97F4A7C15ull + parent_path_id;
+    path_id ^= path_id >> 32;
+
+    return path_id ? path_id : 1;
+}
+
+/* Returns HT_FALSE if the frame couldn't be aggregated (the aggregation is paused,
+ * or there's not enough memory for a new path); the frame should be pushed
+ * to the timeline instead. */
+HT_Boolean ht_feature_callstack_aggregation_add(HT_Timeline* timeline,
+                                                HT_FeatureCallstackAggregation* aggregation,
+                                                uint64_t path_id,
+                                                uint64_t parent_path_id,
+                                                HT_CallstackEventLabel label,
+                                                HT_DurationNs duration,
+                                                HT_DurationNs self_duration,
+                                                uint32_t weight,
+                                                HT_TimestampNs timestamp);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_INTERNAL_FEATURE_CALLSTACK_AGGREGATION_H */
@@ -1,7 +1,7 @@
 #ifndef HAWKTRACER_INTERNAL_GLOBAL_TIMELINE_H
 #define HAWKTRACER_INTERNAL_GLOBAL_TIMELINE_H
 
-#include <hawktracer/macros.h>
+#include <hawktracer/base_types.h>
 
 #include <stddef.h>
 
@@ -11,6 +11,10 @@ void ht_global_timeline_set_buffer_size(size_t buffer_size);
 
 size_t ht_global_timeline_get_buffer_size(void);
 
+void ht_global_timeline_set_compact_serialization(HT_Boolean enabled);
+
+HT_Boolean ht_global_timeline_get_compact_serialization(void);
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_INTERNAL_GLOBAL_TIMELINE_H */
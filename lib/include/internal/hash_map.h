@@ -6,9 +6,11 @@
  * which perfectly fits the cached string feature needs - this might change
  * when we need hash map for different purposes.
  *
- * For now it's just a basic hash map implementation - we've added benchmarks
- * (only CPU benchmarks for now, memory benchmarks will be added in the future),
- * so any performance improvements are very welcome.
+ * The map is an open addressing table with Robin Hood linear probing; keys
+ * and values are stored next to each other in a single array, so a lookup
+ * usually touches one cache line. The capacity is always a power of two, and
+ * the table grows twice when it's 3/4 full. NULL values are not allowed, as
+ * they mark empty slots.
  */
 
 #include "internal/bag.h"
@@ -17,13 +19,15 @@ HT_DECLS_BEGIN
 
 typedef struct
 {
-    HT_BagUInt64 key_bag;
-    HT_BagVoidPtr value_bag;
-} HT_HashBucket;
+    uint64_t key;
+    const char* value;
+} HT_HashMapEntry;
 
 typedef struct
 {
-    HT_HashBucket buckets[1024];
+    HT_HashMapEntry* entries;
+    size_t capacity;
+    size_t size;
 } HT_HashMap;
 
 HT_ErrorCode ht_hash_map_init(HT_HashMap* hash_map);
@@ -36,6 +40,39 @@ const char* ht_hash_map_get_value(HT_HashMap* map, uint64_t key);
 
 void ht_hash_map_for_each(HT_HashMap* hash_map, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud);
 
+typedef struct _HT_ConcurrentHashMapTable HT_ConcurrentHashMapTable;
+
+/**
+ * A hash map with lock-free lookups, for maps which are read very often
+ * and only modified occasionally.
+ *
+ * Lookups (ht_concurrent_hash_map_get_value()) can be called from any thread
+ * at any time. All the other functions must be serialized by the user (e.g.
+ * called under a lock), but they can run concurrently with lookups.
+ *
+ * Entries never move, so the map uses linear probing instead of Robin Hood,
+ * and a slot is published by setting its value. When the table grows, a new
+ * table is published and the old one is kept until the map is deinitialized,
+ * as there might still be readers using it (the old tables take less memory
+ * than the current one in total).
+ */
+typedef struct
+{
+    HT_ConcurrentHashMapTable* volatile table;
+    HT_ConcurrentHashMapTable* retired_tables;
+    size_t size;
+} HT_ConcurrentHashMap;
+
+HT_ErrorCode ht_concurrent_hash_map_init(HT_ConcurrentHashMap* hash_map);
+
+void ht_concurrent_hash_map_deinit(HT_ConcurrentHashMap* hash_map);
+
+const char* ht_concurrent_hash_map_insert(HT_ConcurrentHashMap* map, uint64_t key, const char* value, HT_ErrorCode* out_err);
+
+const char* ht_concurrent_hash_map_get_value(HT_ConcurrentHashMap* map, uint64_t key);
+
+void ht_concurrent_hash_map_for_each(HT_ConcurrentHashMap* hash_map, HT_Boolean(*callback)(uint64_t, const char*, void* ud), void* ud);
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_INTERNAL_HASH_MAP_H */
@@ -12,6 +12,9 @@ typedef struct
     HT_Byte* data;
     size_t max_size;
     size_t usage;
+    /* frame header and compressed block; NULL if compression is disabled */
+    HT_Byte* compressed_data;
+    void* compression_work_memory;
 } HT_ListenerBuffer;
 
 typedef void(*HT_ListenerFlushCallback)(void* listener, HT_Byte* data, size_t size);
@@ -20,6 +23,16 @@ HT_API HT_ErrorCode ht_listener_buffer_init(HT_ListenerBuffer* buffer, size_t ma
 
 HT_API void ht_listener_buffer_deinit(HT_ListenerBuffer* buffer);
 
+/* Makes the buffer emit compressed frames (see compression.h) on flush.
+ * Not supported in bypass mode (buffer of size 0), or if the buffer is
+ * bigger than HT_COMPRESSION_MAX_FRAME_SIZE. */
+HT_API HT_ErrorCode ht_listener_buffer_enable_compression(HT_ListenerBuffer* buffer);
+
+/* Writes the compressed stream marker if compression is enabled; otherwise does nothing. */
+HT_API void ht_listener_buffer_write_stream_header(HT_ListenerBuffer* buffer,
+                                                   HT_ListenerFlushCallback flush_callback,
+                                                   void* listener);
+
 HT_API void ht_listener_buffer_flush(HT_ListenerBuffer* buffer,
                                      HT_ListenerFlushCallback flush_callback,
                                      void* listener);
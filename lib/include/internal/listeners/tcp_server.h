@@ -2,24 +2,51 @@
 #define HAWKTRACER_INTERNAL_LISTENERS_TCP_SERVER_H
 
 #include "hawktracer/base_types.h"
+#include "hawktracer/listeners/tcp_listener.h"
 
 HT_DECLS_BEGIN
 
 typedef struct _HT_TCPServer HT_TCPServer;
 typedef void(*OnClientConnected)(int, void*);
+/* Called for every line (without the '\n' terminator) received from a client. */
+typedef void(*OnClientMessage)(int, const char*, size_t, void*);
+
+/* A maximum length of a line received from a client; longer lines are discarded. */
+#define HT_TCP_SERVER_MAX_CLIENT_MESSAGE_SIZE 256
 
 HT_TCPServer* ht_tcp_server_create(void);
 
 void ht_tcp_server_destroy(HT_TCPServer* server);
 
+/* Sends data to all the clients. Data written between two calls to
+ * ht_tcp_server_end_message() is a message; when data has to be dropped
+ * for a slow client, the whole message is dropped. */
 void ht_tcp_server_write(HT_TCPServer* server, char* buffer, size_t size);
 
+void ht_tcp_server_end_message(HT_TCPServer* server);
+
+void ht_tcp_server_set_client_queue(HT_TCPServer* server, size_t max_queue_size, HT_TCPListenerSlowClientPolicy policy);
+
+size_t ht_tcp_server_get_dropped_size(HT_TCPServer* server);
+
+/* Sets the callback for messages sent by clients. It must be set before the server is started.
+ * The callback is called by the server thread while the server is locked, so it must not
+ * call any server function. Messages are only received by the non-blocking server (Linux). */
+void ht_tcp_server_set_client_message_callback(HT_TCPServer* server, OnClientMessage client_message_cb, void* user_data);
+
 HT_Boolean ht_tcp_server_start(HT_TCPServer* server, int port, OnClientConnected client_connected_cb, void* user_data);
 
+/* Starts the server on a Unix domain socket; the socket file is removed when the server stops.
+ * Not supported on Windows. */
+HT_Boolean ht_tcp_server_start_unix_socket(HT_TCPServer* server, const char* path, OnClientConnected client_connected_cb, void* user_data);
+
 void ht_tcp_server_stop(HT_TCPServer* server);
 
 HT_Boolean ht_tcp_server_is_running(const HT_TCPServer* server);
 
+/* Sends data to a single client; meant to be used from the OnClientConnected callback,
+ * before the client starts receiving data written by ht_tcp_server_write().
+ * The data is never dropped. */
 HT_Boolean ht_tcp_server_write_to_socket(HT_TCPServer* server, int sock_fd, char* buffer, size_t size);
 
 HT_DECLS_END
@@ -0,0 +1,61 @@
+#ifndef HAWKTRACER_INTERNAL_MONOTONIC_CLOCK_H
+#define HAWKTRACER_INTERNAL_MONOTONIC_CLOCK_H
+
+#include <hawktracer/monotonic_clock.h>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#  define HT_MONOTONIC_CLOCK_TSC_SUPPORTED
+#endif
+
+HT_DECLS_BEGIN
+
+/**
+ * Parameters for converting time stamp counter ticks to nanoseconds:
+ * timestamp = timestamp_base + (((ticks - tick_base) * mult) >> shift)
+ */
+typedef struct
+{
+    uint64_t tick_frequency;
+    uint64_t tick_base;
+    HT_TimestampNs timestamp_base;
+    uint32_t mult;
+    uint32_t shift;
+} HT_TscCalibration;
+
+/**
+ * Measures the frequency of the time stamp counter against the system clock.
+ *
+ * The function blocks the calling thread for a few milliseconds. Until the calibration
+ * is completed, #HT_MONOTONIC_CLOCK_IMPL_TSC clock falls back to the system clock.
+ *
+ * @return #HT_TRUE if the calibration completed successfully; #HT_FALSE if the CPU
+ * doesn't have an invariant time stamp counter.
+ */
+HT_Boolean ht_monotonic_clock_calibrate_tsc(void);
+
+/**
+ * Gets the result of the last ht_monotonic_clock_calibrate_tsc() call.
+ *
+ * @return the calibration, or NULL if the clock hasn't been calibrated.
+ */
+const HT_TscCalibration* ht_monotonic_clock_get_tsc_calibration(void);
+
+/**
+ * Checks whether ht_monotonic_clock_get_timestamp() is based on the time stamp counter.
+ */
+HT_Boolean ht_monotonic_clock_is_tsc_used(void);
+
+/** Gets a timestamp of the system clock (regardless of selected implementation). */
+HT_API HT_TimestampNs ht_monotonic_clock_get_system_timestamp(void);
+
+#ifdef HT_MONOTONIC_CLOCK_TSC_SUPPORTED
+/**
+ * Gets a timestamp based on the time stamp counter (regardless of selected implementation).
+ * Returns the system clock's timestamp if the counter hasn't been calibrated.
+ */
+HT_API HT_TimestampNs ht_monotonic_clock_get_tsc_timestamp(void);
+#endif
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_INTERNAL_MONOTONIC_CLOCK_H */
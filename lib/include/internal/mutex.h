@@ -15,6 +15,34 @@ HT_ErrorCode ht_mutex_lock(HT_Mutex* mtx);
 
 HT_ErrorCode ht_mutex_unlock(HT_Mutex* mtx);
 
+typedef struct _HT_CondVar HT_CondVar;
+
+HT_CondVar* ht_cond_var_create(void);
+
+HT_ErrorCode ht_cond_var_destroy(HT_CondVar* cond_var);
+
+/**
+ * Blocks the current thread until the condition variable is notified.
+ *
+ * The @a mtx must be locked by the current thread; it's atomically unlocked
+ * for the time of waiting, and locked again before the function returns.
+ * The function might return spuriously, so it should always be called in a loop
+ * checking the actual condition.
+ *
+ * @param cond_var the condition variable.
+ * @param mtx the mutex protecting the condition.
+ */
+HT_ErrorCode ht_cond_var_wait(HT_CondVar* cond_var, HT_Mutex* mtx);
+
+/**
+ * Wakes up all the threads waiting for the condition variable.
+ *
+ * The function must be called with the mutex used for waiting locked.
+ *
+ * @param cond_var the condition variable.
+ */
+HT_ErrorCode ht_cond_var_notify_all(HT_CondVar* cond_var);
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_MUTEX_H */
@@ -15,6 +15,25 @@ HT_API HT_TimelineListenerContainer* ht_registry_find_listener_container(const c
 
 HT_API HT_ErrorCode ht_registry_register_listener_container(const char* name, HT_TimelineListenerContainer* container);
 
+typedef void(*HT_RegistryTimelineCallback)(HT_Timeline* timeline, void* user_data);
+
+/* Timelines register themselves when they're created, so other threads can
+ * access all of them (e.g. to flush them). Timelines created before ht_init()
+ * are not registered. */
+HT_ErrorCode ht_registry_register_timeline(HT_Timeline* timeline);
+
+void ht_registry_unregister_timeline(HT_Timeline* timeline);
+
+/* Calls the @a callback for every registered timeline. Timelines can't be created
+ * or destroyed until the function returns, so the @a callback must not do that. */
+void ht_registry_for_each_timeline(HT_RegistryTimelineCallback callback, void* user_data);
+
+/* Calls the @a callback for every registered timeline without holding the registry lock,
+ * so the @a callback can block, and create or destroy other timelines. Timelines destroyed
+ * before their turn are skipped; ht_timeline_destroy() waits until the @a callback
+ * using the timeline returns. */
+HT_ErrorCode ht_registry_for_each_timeline_unlocked(HT_RegistryTimelineCallback callback, void* user_data);
+
 HT_DECLS_END
 
 #endif /* HAWKTRACER_INTERNAL_REGISTRY_H */
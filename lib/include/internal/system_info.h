@@ -7,4 +7,12 @@ size_t ht_system_info_push_endianness_info_to_listener(HT_TimelineListenerCallba
 
 size_t ht_system_info_push_system_info_to_listener(HT_TimelineListenerCallback callback, void* listener, HT_Boolean serialize);
 
+/**
+ * Pushes #HT_ClockCalibrationEvent to the listener, if timestamps are based on the time stamp counter.
+ * The event is informational only; timestamps in the stream are always in nanoseconds.
+ *
+ * @return a size of the pushed event, or 0 if nothing has been pushed.
+ */
+size_t ht_system_info_push_clock_calibration_to_listener(HT_TimelineListenerCallback callback, void* listener, HT_Boolean serialize);
+
 #endif /* HAWKTRACER_INTERNAL_SYSTEM_INFO_H */
@@ -0,0 +1,56 @@
+#ifndef HAWKTRACER_INTERNAL_THREAD_H
+#define HAWKTRACER_INTERNAL_THREAD_H
+
+#include <hawktracer/base_types.h>
+
+HT_DECLS_BEGIN
+
+typedef struct _HT_Thread HT_Thread;
+
+typedef void*(*HT_ThreadCallback)(void*);
+
+/**
+ * Creates a new thread and starts executing @a callback in it.
+ *
+ * @param callback a function executed by the thread.
+ * @param user_data a value passed to the @a callback.
+ *
+ * @return a pointer to the new thread, or NULL if the thread couldn't be created.
+ */
+HT_Thread* ht_thread_create(HT_ThreadCallback callback, void* user_data);
+
+/**
+ * Waits for the thread to finish.
+ *
+ * @param th the thread.
+ */
+void ht_thread_join(HT_Thread* th);
+
+/**
+ * Joins the thread (if it's still running) and releases its resources.
+ *
+ * @param th the thread.
+ */
+void ht_thread_destroy(HT_Thread* th);
+
+typedef void(*HT_ThreadExitCallback)(void* user_data);
+
+/**
+ * Registers a callback which is called by the current thread when it exits.
+ *
+ * Callbacks are called in reversed order of registration, and they can't be unregistered,
+ * so anything the callback uses must stay valid until the thread exits.
+ * Callbacks are not called for the main thread if the process exits without
+ * returning from the main function.
+ *
+ * @param callback the callback.
+ * @param user_data a value passed to the @a callback.
+ *
+ * @return #HT_TRUE if the callback has been registered; #HT_FALSE if there's not enough
+ * memory, or if the platform doesn't support thread exit callbacks.
+ */
+HT_Boolean ht_thread_register_exit_callback(HT_ThreadExitCallback callback, void* user_data);
+
+HT_DECLS_END
+
+#endif /* HAWKTRACER_INTERNAL_THREAD_H */
@@ -4,6 +4,7 @@
 #include "internal/registry.h"
 #include "internal/feature.h"
 #include "internal/command_line_parser.h"
+#include "internal/monotonic_clock.h"
 
 #ifdef HT_USE_PTHREADS
 #  include "hawktracer/posix_mapped_tracepoint.h"
@@ -17,6 +18,13 @@ ht_init(int argc, char** argv)
 {
     ht_command_line_parse_args(argc, argv);
 
+#ifdef HT_MONOTONIC_CLOCK_IMPL_TSC
+    if (_ht_init_counter == 0)
+    {
+        ht_monotonic_clock_calibrate_tsc();
+    }
+#endif
+
     ht_registry_init();
 
     HT_REGISTER_EVENT_KLASS(HT_EndiannessInfoEvent);
@@ -26,8 +34,16 @@ ht_init(int argc, char** argv)
     HT_REGISTER_EVENT_KLASS(HT_CallstackBaseEvent);
     HT_REGISTER_EVENT_KLASS(HT_CallstackIntEvent);
     HT_REGISTER_EVENT_KLASS(HT_CallstackStringEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackSampledIntEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackSampledStringEvent);
     HT_REGISTER_EVENT_KLASS(HT_StringMappingEvent);
     HT_REGISTER_EVENT_KLASS(HT_SystemInfoEvent);
+    HT_REGISTER_EVENT_KLASS(HT_ClockCalibrationEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackOverflowEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackFilteredEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackSummaryEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CallstackSummaryHistogramEvent);
+    HT_REGISTER_EVENT_KLASS(HT_CompactBlockEvent);
 
     ht_feature_register_core_features();
 
@@ -1,4 +1,5 @@
 #include "hawktracer/alloc.h"
+#include "hawktracer/compression.h"
 #include "hawktracer/events.h"
 #include "internal/listener_buffer.h"
 
@@ -27,6 +28,8 @@ ht_listener_buffer_init(HT_ListenerBuffer* buffer, size_t max_size)
 
     buffer->max_size = max_size;
     buffer->usage = 0;
+    buffer->compressed_data = NULL;
+    buffer->compression_work_memory = NULL;
 
     return HT_ERR_OK;
 }
@@ -35,6 +38,51 @@ void
 ht_listener_buffer_deinit(HT_ListenerBuffer* buffer)
 {
     ht_free(buffer->data);
+    ht_free(buffer->compressed_data);
+    ht_free(buffer->compression_work_memory);
+    buffer->data = NULL;
+    buffer->compressed_data = NULL;
+    buffer->compression_work_memory = NULL;
+}
+
+HT_ErrorCode
+ht_listener_buffer_enable_compression(HT_ListenerBuffer* buffer)
+{
+    if (HT_IS_BYPASS_MODE(buffer) || buffer->max_size > HT_COMPRESSION_MAX_FRAME_SIZE)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    if (buffer->compressed_data != NULL)
+    {
+        return HT_ERR_OK;
+    }
+
+    buffer->compressed_data = (HT_Byte*)ht_alloc(
+                HT_COMPRESSION_FRAME_HEADER_SIZE + ht_compression_get_max_compressed_size(buffer->max_size));
+    buffer->compression_work_memory = ht_alloc(HT_COMPRESSION_WORK_MEMORY_SIZE);
+
+    if (buffer->compressed_data == NULL || buffer->compression_work_memory == NULL)
+    {
+        ht_free(buffer->compressed_data);
+        ht_free(buffer->compression_work_memory);
+        buffer->compressed_data = NULL;
+        buffer->compression_work_memory = NULL;
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+
+    return HT_ERR_OK;
+}
+
+void
+ht_listener_buffer_write_stream_header(HT_ListenerBuffer* buffer,
+                                       HT_ListenerFlushCallback flush_callback,
+                                       void* listener)
+{
+    if (buffer->compressed_data != NULL)
+    {
+        flush_callback(listener, (HT_Byte*)HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC_SIZE);
+    }
 }
 
 void
@@ -80,13 +128,16 @@ ht_listener_buffer_process_unserialized_events(HT_ListenerBuffer* buffer,
     for (i = 0; i < size;)
     {
         HT_Event* event = HT_EVENT(events + i);
+        size_t event_size = HT_EVENT_GET_KLASS(event)->try_serialize(
+                    event, buffer->data + buffer->usage, buffer->max_size - buffer->usage);
 
-        if (HT_EVENT_GET_KLASS(event)->get_size(event) + buffer->usage > buffer->max_size)
+        if (event_size + buffer->usage > buffer->max_size)
         {
             ht_listener_buffer_flush(buffer, flush_callback, listener);
+            HT_EVENT_GET_KLASS(event)->serialize(event, buffer->data + buffer->usage);
         }
 
-        buffer->usage += HT_EVENT_GET_KLASS(event)->serialize(event, buffer->data + buffer->usage);
+        buffer->usage += event_size;
         i += HT_EVENT_GET_KLASS(event)->type_info->size;
     }
 }
@@ -96,6 +147,38 @@ ht_listener_buffer_flush(HT_ListenerBuffer* buffer,
                         HT_ListenerFlushCallback flush_callback,
                         void* listener)
 {
-    flush_callback(listener, buffer->data, buffer->usage);
+    size_t compressed_size;
+
+    if (buffer->compressed_data == NULL)
+    {
+        flush_callback(listener, buffer->data, buffer->usage);
+        buffer->usage = 0;
+        return;
+    }
+
+    if (buffer->usage == 0)
+    {
+        return;
+    }
+
+    compressed_size = ht_compression_compress(
+                buffer->data, buffer->usage,
+                buffer->compressed_data + HT_COMPRESSION_FRAME_HEADER_SIZE,
+                ht_compression_get_max_compressed_size(buffer->max_size),
+                buffer->compression_work_memory);
+
+    if (compressed_size > 0 && compressed_size < buffer->usage)
+    {
+        ht_compression_write_frame_header(buffer->compressed_data, (uint32_t)buffer->usage, (uint32_t)compressed_size);
+        flush_callback(listener, buffer->compressed_data, HT_COMPRESSION_FRAME_HEADER_SIZE + compressed_size);
+    }
+    else
+    {
+        /* data can't be compressed, so it's stored as is */
+        ht_compression_write_frame_header(buffer->compressed_data, (uint32_t)buffer->usage, 0);
+        flush_callback(listener, buffer->compressed_data, HT_COMPRESSION_FRAME_HEADER_SIZE);
+        flush_callback(listener, buffer->data, buffer->usage);
+    }
+
     buffer->usage = 0;
 }
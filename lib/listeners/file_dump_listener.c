@@ -1,16 +1,46 @@
 #include "hawktracer/listeners/file_dump_listener.h"
 #include "hawktracer/alloc.h"
+#include "hawktracer/feature_cached_string.h"
+#include "hawktracer/monotonic_clock.h"
 #include "hawktracer/timeline_listener.h"
 
 #include "internal/error.h"
 #include "internal/listener_buffer.h"
 #include "internal/mutex.h"
+#include "internal/thread.h"
+
+#include <string.h>
+
+/* Opens segment files ahead of time and closes the ones which are no longer
+ * used, so the thread pushing events doesn't have to wait for the file system. */
+typedef struct
+{
+    HT_FileDumpListenerRotation settings;
+    char* filename;
+    char* path;
+    size_t path_size;
+    HT_Mutex* mtx;
+    HT_CondVar* cond_var;
+    HT_Thread* thread;
+    /* all the fields below are protected by mtx */
+    FILE* next_file;
+    size_t next_number;
+    FILE* retired_file;
+    size_t retired_number;
+    HT_Boolean open_failed;
+    HT_Boolean stop;
+} HT_FileDumpRotator;
 
 struct _HT_FileDumpListener
 {
     HT_ListenerBuffer buffer;
     FILE* p_file;
     HT_Mutex* mtx;
+    HT_FileDumpRotator* rotator;
+    HT_Timeline* string_mapping_timeline;
+    size_t segment_number;
+    size_t segment_written;
+    HT_TimestampNs segment_start;
 };
 
 HT_INLINE static HT_Boolean
@@ -25,26 +55,292 @@ _ht_file_dump_listener_flush(void* listener, HT_Byte* data, size_t size)
     HT_FileDumpListener* fd_listener = (HT_FileDumpListener*) listener;
 
     fwrite(data, sizeof(HT_Byte), size, fd_listener->p_file);
+    fd_listener->segment_written += size;
 }
 
-HT_FileDumpListener*
-ht_file_dump_listener_create(const char* filename, size_t buffer_size, HT_ErrorCode* out_err)
+static void
+_ht_file_dump_listener_process_events(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_FileDumpListener* listener = (HT_FileDumpListener*)user_data;
+
+    if (serialized)
+    {
+        ht_listener_buffer_process_serialized_events(&listener->buffer, events, size, _ht_file_dump_listener_flush, listener);
+    }
+    else
+    {
+        ht_listener_buffer_process_unserialized_events(&listener->buffer, events, size, _ht_file_dump_listener_flush, listener);
+    }
+}
+
+static void
+_ht_file_dump_rotator_make_path(HT_FileDumpRotator* rotator, size_t number)
+{
+    snprintf(rotator->path, rotator->path_size, "%s.%lu", rotator->filename, (unsigned long)number);
+}
+
+static void*
+_ht_file_dump_rotator_run(void* user_data)
+{
+    HT_FileDumpRotator* rotator = (HT_FileDumpRotator*)user_data;
+
+    ht_mutex_lock(rotator->mtx);
+
+    for (;;)
+    {
+        while (!rotator->stop && rotator->retired_file == NULL
+               && (rotator->next_file != NULL || rotator->open_failed))
+        {
+            ht_cond_var_wait(rotator->cond_var, rotator->mtx);
+        }
+
+        if (rotator->retired_file != NULL)
+        {
+            FILE* retired_file = rotator->retired_file;
+            size_t retired_number = rotator->retired_number;
+            size_t max_count = rotator->settings.max_segment_count;
+
+            rotator->retired_file = NULL;
+            ht_mutex_unlock(rotator->mtx);
+
+            fclose(retired_file);
+            /* segment retired_number + 1 is the one being written now */
+            if (max_count > 0 && retired_number + 1 >= max_count)
+            {
+                _ht_file_dump_rotator_make_path(rotator, retired_number + 1 - max_count);
+                remove(rotator->path);
+            }
+
+            ht_mutex_lock(rotator->mtx);
+        }
+        else if (rotator->stop)
+        {
+            break;
+        }
+        else
+        {
+            FILE* next_file;
+
+            _ht_file_dump_rotator_make_path(rotator, rotator->next_number);
+            ht_mutex_unlock(rotator->mtx);
+            next_file = fopen(rotator->path, "wb");
+            ht_mutex_lock(rotator->mtx);
+
+            rotator->next_file = next_file;
+            rotator->open_failed = next_file == NULL;
+        }
+    }
+
+    if (rotator->next_file != NULL)
+    {
+        /* the segment has been created ahead of time, but it's never been used */
+        fclose(rotator->next_file);
+        rotator->next_file = NULL;
+        _ht_file_dump_rotator_make_path(rotator, rotator->next_number);
+        remove(rotator->path);
+    }
+
+    ht_mutex_unlock(rotator->mtx);
+
+    return NULL;
+}
+
+static void
+_ht_file_dump_rotator_destroy(HT_FileDumpRotator* rotator)
+{
+    if (rotator->thread != NULL)
+    {
+        ht_mutex_lock(rotator->mtx);
+        rotator->stop = HT_TRUE;
+        ht_cond_var_notify_all(rotator->cond_var);
+        ht_mutex_unlock(rotator->mtx);
+
+        ht_thread_destroy(rotator->thread);
+    }
+
+    if (rotator->cond_var != NULL)
+    {
+        ht_cond_var_destroy(rotator->cond_var);
+    }
+    if (rotator->mtx != NULL)
+    {
+        ht_mutex_destroy(rotator->mtx);
+    }
+    ht_free(rotator->path);
+    ht_free(rotator->filename);
+    ht_free(rotator);
+}
+
+/* Creates a rotator and opens the first segment. */
+static HT_FileDumpRotator*
+_ht_file_dump_rotator_create(const char* filename,
+                             const HT_FileDumpListenerRotation* rotation,
+                             FILE** out_first_file,
+                             HT_ErrorCode* out_err)
 {
     HT_ErrorCode error_code = HT_ERR_OK;
-    HT_FileDumpListener* listener = HT_CREATE_TYPE(HT_FileDumpListener);
+    size_t filename_length = strlen(filename);
+    HT_FileDumpRotator* rotator = HT_CREATE_TYPE(HT_FileDumpRotator);
 
-    if (listener == NULL)
+    if (rotator == NULL)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    rotator->settings = *rotation;
+    rotator->mtx = NULL;
+    rotator->cond_var = NULL;
+    rotator->thread = NULL;
+    rotator->next_file = NULL;
+    rotator->next_number = 1;
+    rotator->retired_file = NULL;
+    rotator->retired_number = 0;
+    rotator->open_failed = HT_FALSE;
+    rotator->stop = HT_FALSE;
+    /* enough for the separator and any number */
+    rotator->path_size = filename_length + 24;
+    rotator->filename = (char*)ht_alloc(filename_length + 1);
+    rotator->path = (char*)ht_alloc(rotator->path_size);
+    if (rotator->filename == NULL || rotator->path == NULL)
     {
         error_code = HT_ERR_OUT_OF_MEMORY;
-        goto done;
+        goto error;
+    }
+    memcpy(rotator->filename, filename, filename_length + 1);
+
+    rotator->mtx = ht_mutex_create();
+    rotator->cond_var = ht_cond_var_create();
+    if (rotator->mtx == NULL || rotator->cond_var == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error;
     }
 
-    listener->p_file = fopen(filename, "wb");
-    if (listener->p_file == NULL)
+    _ht_file_dump_rotator_make_path(rotator, 0);
+    *out_first_file = fopen(rotator->path, "wb");
+    if (*out_first_file == NULL)
     {
         error_code = HT_ERR_CANT_OPEN_FILE;
-        goto error_open_file;
+        goto error;
+    }
+
+    rotator->thread = ht_thread_create(_ht_file_dump_rotator_run, rotator);
+    if (rotator->thread == NULL)
+    {
+        fclose(*out_first_file);
+        *out_first_file = NULL;
+        error_code = HT_ERR_UNKNOWN;
+        goto error;
+    }
+
+    goto done;
+
+error:
+    _ht_file_dump_rotator_destroy(rotator);
+    rotator = NULL;
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return rotator;
+}
+
+static void
+_ht_file_dump_listener_push_preamble(HT_FileDumpListener* listener)
+{
+    ht_listener_buffer_write_stream_header(&listener->buffer, _ht_file_dump_listener_flush, listener);
+    ht_timeline_listener_push_metadata(_ht_file_dump_listener_process_events, listener, HT_TRUE);
+
+    if (listener->string_mapping_timeline != NULL)
+    {
+        ht_feature_cached_string_push_map_to_listener(
+                    listener->string_mapping_timeline, _ht_file_dump_listener_process_events, listener, HT_TRUE);
+    }
+}
+
+static HT_Boolean
+_ht_file_dump_listener_should_rotate(HT_FileDumpListener* listener)
+{
+    const HT_FileDumpListenerRotation* settings = &listener->rotator->settings;
+
+    if (settings->max_segment_size > 0
+            && listener->segment_written + listener->buffer.usage >= settings->max_segment_size)
+    {
+        return HT_TRUE;
+    }
+
+    return settings->max_segment_duration > 0
+            && ht_monotonic_clock_get_timestamp() - listener->segment_start >= settings->max_segment_duration;
+}
+
+/* Switches to the segment opened by the rotator thread. If it's not available yet,
+ * the listener keeps writing to the current segment; if the rotator couldn't open it,
+ * it's asked to retry. */
+static void
+_ht_file_dump_listener_rotate(HT_FileDumpListener* listener)
+{
+    HT_FileDumpRotator* rotator = listener->rotator;
+    FILE* next_file = NULL;
+
+    ht_mutex_lock(rotator->mtx);
+    if (rotator->next_file != NULL && rotator->retired_file == NULL)
+    {
+        next_file = rotator->next_file;
+        rotator->next_file = NULL;
+        rotator->next_number++;
+    }
+    else if (rotator->open_failed)
+    {
+        /* try again, the file system might have recovered in the meantime */
+        rotator->open_failed = HT_FALSE;
+        ht_cond_var_notify_all(rotator->cond_var);
     }
+    ht_mutex_unlock(rotator->mtx);
+
+    if (next_file == NULL)
+    {
+        return;
+    }
+
+    ht_listener_buffer_flush(&listener->buffer, _ht_file_dump_listener_flush, listener);
+
+    ht_mutex_lock(rotator->mtx);
+    rotator->retired_file = listener->p_file;
+    rotator->retired_number = listener->segment_number;
+    ht_cond_var_notify_all(rotator->cond_var);
+    ht_mutex_unlock(rotator->mtx);
+
+    listener->p_file = next_file;
+    listener->segment_number++;
+    listener->segment_written = 0;
+    listener->segment_start = ht_monotonic_clock_get_timestamp();
+
+    _ht_file_dump_listener_push_preamble(listener);
+}
+
+static HT_FileDumpListener*
+_ht_file_dump_listener_create(FILE* p_file,
+                              size_t buffer_size,
+                              HT_FileDumpRotator* rotator,
+                              HT_Timeline* string_mapping_timeline,
+                              HT_Boolean compress,
+                              HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_FileDumpListener* listener = HT_CREATE_TYPE(HT_FileDumpListener);
+
+    if (listener == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    listener->p_file = p_file;
+    listener->rotator = rotator;
+    listener->string_mapping_timeline = string_mapping_timeline;
+    listener->segment_number = 0;
+    listener->segment_written = 0;
+    listener->segment_start = ht_monotonic_clock_get_timestamp();
 
     listener->mtx = ht_mutex_create();
     if (listener->mtx == NULL)
@@ -56,18 +352,26 @@ ht_file_dump_listener_create(const char* filename, size_t buffer_size, HT_ErrorC
     error_code = ht_listener_buffer_init(&listener->buffer, buffer_size);
     if (error_code != HT_ERR_OK)
     {
-        ht_mutex_destroy(listener->mtx);
+        goto error_init_buffer;
     }
-    else
+
+    if (compress)
     {
-        ht_timeline_listener_push_metadata(ht_file_dump_listener_callback, listener, HT_TRUE);
-        goto done;
+        error_code = ht_listener_buffer_enable_compression(&listener->buffer);
+        if (error_code != HT_ERR_OK)
+        {
+            goto error_enable_compression;
+        }
     }
 
-error_create_mutex:
-    fclose(listener->p_file);
+    _ht_file_dump_listener_push_preamble(listener);
+    goto done;
 
-error_open_file:
+error_enable_compression:
+    ht_listener_buffer_deinit(&listener->buffer);
+error_init_buffer:
+    ht_mutex_destroy(listener->mtx);
+error_create_mutex:
     ht_free(listener);
     listener = NULL;
 
@@ -77,6 +381,77 @@ done:
     return listener;
 }
 
+HT_FileDumpListener*
+ht_file_dump_listener_create_full(const char* filename,
+                                  size_t buffer_size,
+                                  const HT_FileDumpListenerRotation* rotation,
+                                  HT_Timeline* string_mapping_timeline,
+                                  HT_Boolean compress,
+                                  HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_FileDumpListener* listener = NULL;
+    HT_FileDumpRotator* rotator = NULL;
+    FILE* p_file = NULL;
+
+    if (compress && buffer_size == 0)
+    {
+        error_code = HT_ERR_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    if (rotation != NULL)
+    {
+        rotator = _ht_file_dump_rotator_create(filename, rotation, &p_file, &error_code);
+        if (rotator == NULL)
+        {
+            goto done;
+        }
+    }
+    else
+    {
+        p_file = fopen(filename, "wb");
+        if (p_file == NULL)
+        {
+            error_code = HT_ERR_CANT_OPEN_FILE;
+            goto done;
+        }
+    }
+
+    listener = _ht_file_dump_listener_create(
+                p_file, buffer_size, rotator, string_mapping_timeline, compress, &error_code);
+    if (listener == NULL)
+    {
+        if (rotator != NULL)
+        {
+            _ht_file_dump_rotator_destroy(rotator);
+        }
+        fclose(p_file);
+    }
+
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return listener;
+}
+
+HT_FileDumpListener*
+ht_file_dump_listener_create(const char* filename, size_t buffer_size, HT_ErrorCode* out_err)
+{
+    return ht_file_dump_listener_create_full(filename, buffer_size, NULL, NULL, HT_FALSE, out_err);
+}
+
+HT_FileDumpListener*
+ht_file_dump_listener_create_rotating(const char* filename,
+                                      size_t buffer_size,
+                                      const HT_FileDumpListenerRotation* rotation,
+                                      HT_Timeline* string_mapping_timeline,
+                                      HT_ErrorCode* out_err)
+{
+    return ht_file_dump_listener_create_full(
+                filename, buffer_size, rotation, string_mapping_timeline, HT_FALSE, out_err);
+}
+
 void
 ht_file_dump_listener_destroy(HT_FileDumpListener* listener)
 {
@@ -135,15 +510,13 @@ ht_file_dump_listener_callback(TEventPtr events, size_t size, HT_Boolean seriali
         return;
     }
 
-    if (serialized)
-    {
-        ht_listener_buffer_process_serialized_events(&listener->buffer, events, size, _ht_file_dump_listener_flush, listener);
-    }
-    else
+    if (listener->rotator != NULL && _ht_file_dump_listener_should_rotate(listener))
     {
-        ht_listener_buffer_process_unserialized_events(&listener->buffer, events, size, _ht_file_dump_listener_flush, listener);
+        _ht_file_dump_listener_rotate(listener);
     }
 
+    _ht_file_dump_listener_process_events(events, size, serialized, listener);
+
     ht_mutex_unlock(listener->mtx);
 }
 
@@ -163,16 +536,30 @@ ht_file_dump_listener_stop(HT_FileDumpListener* listener)
     fclose(listener->p_file);
     listener->p_file = NULL;
 
+    if (listener->rotator != NULL)
+    {
+        _ht_file_dump_rotator_destroy(listener->rotator);
+        listener->rotator = NULL;
+    }
+
     ht_mutex_unlock(listener->mtx);
 }
 
-HT_FileDumpListener*
-ht_file_dump_listener_register(
-        HT_Timeline* timeline, const char* filename, size_t buffer_size, HT_ErrorCode *out_err)
+size_t
+ht_file_dump_listener_get_segment_number(HT_FileDumpListener* listener)
 {
-    HT_ErrorCode err = HT_ERR_OK;
-    HT_FileDumpListener* listener = ht_file_dump_listener_create(filename, buffer_size, &err);
+    size_t segment_number;
 
+    ht_mutex_lock(listener->mtx);
+    segment_number = listener->segment_number;
+    ht_mutex_unlock(listener->mtx);
+
+    return segment_number;
+}
+
+static HT_FileDumpListener*
+_ht_file_dump_listener_register(HT_Timeline* timeline, HT_FileDumpListener* listener, HT_ErrorCode err, HT_ErrorCode* out_err)
+{
     if (!listener)
     {
         goto register_done;
@@ -193,3 +580,42 @@ register_done:
     HT_SET_ERROR(out_err, err);
     return listener;
 }
+
+HT_FileDumpListener*
+ht_file_dump_listener_register(
+        HT_Timeline* timeline, const char* filename, size_t buffer_size, HT_ErrorCode *out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_FileDumpListener* listener = ht_file_dump_listener_create(filename, buffer_size, &err);
+
+    return _ht_file_dump_listener_register(timeline, listener, err, out_err);
+}
+
+HT_FileDumpListener*
+ht_file_dump_listener_register_rotating(HT_Timeline* timeline,
+                                        const char* filename,
+                                        size_t buffer_size,
+                                        const HT_FileDumpListenerRotation* rotation,
+                                        HT_ErrorCode* out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_FileDumpListener* listener = ht_file_dump_listener_create_rotating(
+                filename, buffer_size, rotation, timeline, &err);
+
+    return _ht_file_dump_listener_register(timeline, listener, err, out_err);
+}
+
+HT_FileDumpListener*
+ht_file_dump_listener_register_full(HT_Timeline* timeline,
+                                    const char* filename,
+                                    size_t buffer_size,
+                                    const HT_FileDumpListenerRotation* rotation,
+                                    HT_Boolean compress,
+                                    HT_ErrorCode* out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_FileDumpListener* listener = ht_file_dump_listener_create_full(
+                filename, buffer_size, rotation, timeline, compress, &err);
+
+    return _ht_file_dump_listener_register(timeline, listener, err, out_err);
+}
@@ -0,0 +1,631 @@
+#include "hawktracer/listeners/flight_recorder_listener.h"
+#include "hawktracer/alloc.h"
+#include "hawktracer/feature_cached_string.h"
+#include "hawktracer/registry.h"
+#include "hawktracer/timeline_listener.h"
+
+#include "internal/error.h"
+#include "internal/mutex.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HT_HAVE_UNISTD_H
+#  include <fcntl.h>
+#  include <signal.h>
+#  include <unistd.h>
+#endif
+
+/* Every chunk of events is stored as a record: a size header followed by
+ * the serialized events. A record is never split between the end and the
+ * beginning of the ring buffer, so when it doesn't fit at the end, the tail
+ * is left unused (up to the 'end' offset) and writing continues from the beginning.
+ *
+ * Records are stored in [first, next) range, or in [first, end) and [0, next)
+ * ranges if the buffer is wrapped. The region being written to is never part of
+ * those ranges, so the snapshot can be taken from a signal handler. */
+typedef uint32_t HT_FlightRecorderRecordHeader;
+
+#define HT_FLIGHT_RECORDER_HEADER_SIZE sizeof(HT_FlightRecorderRecordHeader)
+
+/* The metadata and the string mappings, stored outside of the ring buffer so they're
+ * never overwritten. The blob is rebuilt when a klass or a mapping is added, and
+ * replaced as a whole, so the signal handler sees either the old or the new one.
+ * The handler might still be reading the old one, so while the listener is attached
+ * to a signal, replaced blobs are kept on the retired list until the listener is destroyed. */
+typedef struct _HT_FlightRecorderMetadata
+{
+    HT_Byte* data;
+    size_t size;
+    size_t capacity;
+    HT_ErrorCode error_code;
+    struct _HT_FlightRecorderMetadata* next_retired;
+} HT_FlightRecorderMetadata;
+
+struct _HT_FlightRecorderListener
+{
+    HT_FlightRecorderMetadata* volatile metadata;
+    HT_FlightRecorderMetadata* retired_metadata;
+    size_t metadata_klass_count;
+    size_t metadata_mapping_count;
+    HT_Timeline* string_mapping_timeline;
+    HT_Byte* data;
+    size_t capacity;
+    size_t first;
+    size_t next;
+    size_t end;
+    HT_Boolean wrapped;
+    size_t dropped_count;
+    HT_Mutex* mtx;
+};
+
+static void _ht_flight_recorder_listener_detach_signal(HT_FlightRecorderListener* listener);
+static HT_Boolean _ht_flight_recorder_listener_is_attached_to_signal(HT_FlightRecorderListener* listener);
+
+typedef void(*HT_FlightRecorderWriteCallback)(const HT_Byte* data, size_t size, void* user_data);
+
+static void
+_ht_flight_recorder_listener_append_metadata(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_FlightRecorderMetadata* metadata = (HT_FlightRecorderMetadata*)user_data;
+    (void)serialized;
+
+    if (metadata->error_code != HT_ERR_OK)
+    {
+        return;
+    }
+
+    if (metadata->size + size > metadata->capacity)
+    {
+        size_t new_capacity = metadata->capacity ? metadata->capacity : 1024;
+        HT_Byte* new_data;
+
+        while (new_capacity < metadata->size + size)
+        {
+            new_capacity *= 2;
+        }
+
+        new_data = (HT_Byte*)ht_realloc(metadata->data, new_capacity);
+        if (new_data == NULL)
+        {
+            metadata->error_code = HT_ERR_OUT_OF_MEMORY;
+            return;
+        }
+
+        metadata->data = new_data;
+        metadata->capacity = new_capacity;
+    }
+
+    memcpy(metadata->data + metadata->size, events, size);
+    metadata->size += size;
+}
+
+static void
+_ht_flight_recorder_metadata_destroy(HT_FlightRecorderMetadata* metadata)
+{
+    if (metadata != NULL)
+    {
+        ht_free(metadata->data);
+        ht_free(metadata);
+    }
+}
+
+/* Rebuilds the metadata blob if klasses or string mappings have been added since
+ * the last time. If it fails, the listener keeps the old blob. Must be called with
+ * the listener's lock held (or before the listener is used). */
+static HT_ErrorCode
+_ht_flight_recorder_listener_refresh_metadata(HT_FlightRecorderListener* listener)
+{
+    HT_FlightRecorderMetadata* metadata;
+    HT_FlightRecorderMetadata* old_metadata = listener->metadata;
+    size_t klass_count;
+    size_t mapping_count = 0;
+
+    ht_registry_get_event_klasses(&klass_count);
+    if (listener->string_mapping_timeline != NULL)
+    {
+        mapping_count = ht_feature_cached_string_get_mapping_count(listener->string_mapping_timeline);
+    }
+
+    if (old_metadata != NULL
+            && klass_count == listener->metadata_klass_count
+            && mapping_count == listener->metadata_mapping_count)
+    {
+        return HT_ERR_OK;
+    }
+
+    metadata = HT_CREATE_TYPE(HT_FlightRecorderMetadata);
+    if (metadata == NULL)
+    {
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+    metadata->data = NULL;
+    metadata->size = 0;
+    metadata->capacity = 0;
+    metadata->error_code = HT_ERR_OK;
+    metadata->next_retired = NULL;
+
+    ht_timeline_listener_push_metadata(_ht_flight_recorder_listener_append_metadata, metadata, HT_TRUE);
+    if (listener->string_mapping_timeline != NULL)
+    {
+        ht_feature_cached_string_push_map_to_listener(
+                    listener->string_mapping_timeline, _ht_flight_recorder_listener_append_metadata, metadata, HT_TRUE);
+    }
+
+    if (metadata->error_code != HT_ERR_OK)
+    {
+        HT_ErrorCode error_code = metadata->error_code;
+        _ht_flight_recorder_metadata_destroy(metadata);
+        return error_code;
+    }
+
+    listener->metadata = metadata;
+    listener->metadata_klass_count = klass_count;
+    listener->metadata_mapping_count = mapping_count;
+
+    /* the blob is swapped before the check, so a handler invoked after the
+     * check reads the new one */
+    if (old_metadata != NULL && _ht_flight_recorder_listener_is_attached_to_signal(listener))
+    {
+        old_metadata->next_retired = listener->retired_metadata;
+        listener->retired_metadata = old_metadata;
+    }
+    else
+    {
+        _ht_flight_recorder_metadata_destroy(old_metadata);
+    }
+
+    return HT_ERR_OK;
+}
+
+HT_INLINE static size_t
+_ht_flight_recorder_listener_get_record_size(HT_FlightRecorderListener* listener, size_t position)
+{
+    HT_FlightRecorderRecordHeader header;
+
+    memcpy(&header, listener->data + position, HT_FLIGHT_RECORDER_HEADER_SIZE);
+
+    return HT_FLIGHT_RECORDER_HEADER_SIZE + header;
+}
+
+/* Evicts the oldest records until there's enough space for a new record,
+ * and returns a position of the free space. */
+static size_t
+_ht_flight_recorder_listener_make_space(HT_FlightRecorderListener* listener, size_t record_size)
+{
+    assert(record_size <= listener->capacity);
+
+    for (;;)
+    {
+        if (!listener->wrapped)
+        {
+            if (listener->next + record_size <= listener->capacity)
+            {
+                return listener->next;
+            }
+
+            if (listener->first == listener->next)
+            {
+                listener->first = listener->next = 0;
+                continue;
+            }
+
+            listener->end = listener->next;
+            listener->next = 0;
+            listener->wrapped = HT_TRUE;
+        }
+
+        if (listener->first == listener->end)
+        {
+            listener->first = 0;
+            listener->wrapped = HT_FALSE;
+            continue;
+        }
+
+        if (listener->next + record_size <= listener->first)
+        {
+            return listener->next;
+        }
+
+        listener->first += _ht_flight_recorder_listener_get_record_size(listener, listener->first);
+    }
+}
+
+static void
+_ht_flight_recorder_listener_write_records(
+        HT_FlightRecorderListener* listener, size_t position, size_t end,
+        HT_FlightRecorderWriteCallback write_cb, void* user_data)
+{
+    while (position < end)
+    {
+        size_t record_size = _ht_flight_recorder_listener_get_record_size(listener, position);
+        write_cb(listener->data + position + HT_FLIGHT_RECORDER_HEADER_SIZE,
+                 record_size - HT_FLIGHT_RECORDER_HEADER_SIZE,
+                 user_data);
+        position += record_size;
+    }
+}
+
+static void
+_ht_flight_recorder_listener_write_snapshot(
+        HT_FlightRecorderListener* listener, HT_FlightRecorderWriteCallback write_cb, void* user_data)
+{
+    const HT_FlightRecorderMetadata* metadata = listener->metadata;
+
+    write_cb(metadata->data, metadata->size, user_data);
+
+    if (listener->wrapped)
+    {
+        _ht_flight_recorder_listener_write_records(listener, listener->first, listener->end, write_cb, user_data);
+        _ht_flight_recorder_listener_write_records(listener, 0, listener->next, write_cb, user_data);
+    }
+    else
+    {
+        _ht_flight_recorder_listener_write_records(listener, listener->first, listener->next, write_cb, user_data);
+    }
+}
+
+HT_FlightRecorderListener*
+ht_flight_recorder_listener_create_full(size_t capacity, HT_Timeline* string_mapping_timeline, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_FlightRecorderListener* listener;
+
+    if (capacity <= HT_FLIGHT_RECORDER_HEADER_SIZE)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    listener = HT_CREATE_TYPE(HT_FlightRecorderListener);
+    if (listener == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    listener->capacity = capacity;
+    listener->first = 0;
+    listener->next = 0;
+    listener->end = 0;
+    listener->wrapped = HT_FALSE;
+    listener->dropped_count = 0;
+    listener->metadata = NULL;
+    listener->retired_metadata = NULL;
+    listener->string_mapping_timeline = string_mapping_timeline;
+
+    listener->data = (HT_Byte*)ht_alloc(capacity);
+    if (listener->data == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_alloc_data;
+    }
+
+    error_code = _ht_flight_recorder_listener_refresh_metadata(listener);
+    if (error_code != HT_ERR_OK)
+    {
+        goto error_alloc_metadata;
+    }
+
+    listener->mtx = ht_mutex_create();
+    if (listener->mtx == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_mutex;
+    }
+
+    goto done;
+
+error_create_mutex:
+    _ht_flight_recorder_metadata_destroy(listener->metadata);
+error_alloc_metadata:
+    ht_free(listener->data);
+error_alloc_data:
+    ht_free(listener);
+    listener = NULL;
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return listener;
+}
+
+HT_FlightRecorderListener*
+ht_flight_recorder_listener_create(size_t capacity, HT_ErrorCode* out_err)
+{
+    return ht_flight_recorder_listener_create_full(capacity, NULL, out_err);
+}
+
+void
+ht_flight_recorder_listener_destroy(HT_FlightRecorderListener* listener)
+{
+    if (listener == NULL)
+    {
+        return;
+    }
+
+    _ht_flight_recorder_listener_detach_signal(listener);
+
+    ht_mutex_destroy(listener->mtx);
+    _ht_flight_recorder_metadata_destroy(listener->metadata);
+    while (listener->retired_metadata != NULL)
+    {
+        HT_FlightRecorderMetadata* next_retired = listener->retired_metadata->next_retired;
+        _ht_flight_recorder_metadata_destroy(listener->retired_metadata);
+        listener->retired_metadata = next_retired;
+    }
+    ht_free(listener->data);
+    ht_free(listener);
+}
+
+void
+ht_flight_recorder_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_FlightRecorderListener* listener = (HT_FlightRecorderListener*)user_data;
+    HT_FlightRecorderRecordHeader header;
+    size_t payload_size = 0;
+    size_t position;
+    HT_Byte* payload;
+    size_t i;
+
+    if (serialized)
+    {
+        payload_size = size;
+    }
+    else
+    {
+        for (i = 0; i < size;)
+        {
+            HT_Event* event = HT_EVENT(events + i);
+            payload_size += HT_EVENT_GET_KLASS(event)->get_size(event);
+            i += HT_EVENT_GET_KLASS(event)->type_info->size;
+        }
+    }
+
+    if (payload_size == 0)
+    {
+        return;
+    }
+
+    ht_mutex_lock(listener->mtx);
+
+    /* klasses and mappings used by the chunk have been registered before it was pushed,
+     * so they're in the blob once it's refreshed; if it fails, it's retried with the next chunk */
+    _ht_flight_recorder_listener_refresh_metadata(listener);
+
+    if (payload_size > listener->capacity - HT_FLIGHT_RECORDER_HEADER_SIZE
+            || payload_size > (HT_FlightRecorderRecordHeader)-1)
+    {
+        listener->dropped_count++;
+        ht_mutex_unlock(listener->mtx);
+        return;
+    }
+
+    position = _ht_flight_recorder_listener_make_space(listener, HT_FLIGHT_RECORDER_HEADER_SIZE + payload_size);
+
+    header = (HT_FlightRecorderRecordHeader)payload_size;
+    memcpy(listener->data + position, &header, HT_FLIGHT_RECORDER_HEADER_SIZE);
+    payload = listener->data + position + HT_FLIGHT_RECORDER_HEADER_SIZE;
+
+    if (serialized)
+    {
+        memcpy(payload, events, size);
+    }
+    else
+    {
+        for (i = 0; i < size;)
+        {
+            HT_Event* event = HT_EVENT(events + i);
+            payload += HT_EVENT_GET_KLASS(event)->serialize(event, payload);
+            i += HT_EVENT_GET_KLASS(event)->type_info->size;
+        }
+    }
+
+    listener->next = position + HT_FLIGHT_RECORDER_HEADER_SIZE + payload_size;
+
+    ht_mutex_unlock(listener->mtx);
+}
+
+static void
+_ht_flight_recorder_listener_write_to_file(const HT_Byte* data, size_t size, void* user_data)
+{
+    fwrite(data, sizeof(HT_Byte), size, (FILE*)user_data);
+}
+
+HT_ErrorCode
+ht_flight_recorder_listener_dump(HT_FlightRecorderListener* listener, const char* filename)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    FILE* p_file = fopen(filename, "wb");
+
+    if (p_file == NULL)
+    {
+        return HT_ERR_CANT_OPEN_FILE;
+    }
+
+    ht_mutex_lock(listener->mtx);
+    _ht_flight_recorder_listener_refresh_metadata(listener);
+    _ht_flight_recorder_listener_write_snapshot(listener, _ht_flight_recorder_listener_write_to_file, p_file);
+    ht_mutex_unlock(listener->mtx);
+
+    if (ferror(p_file))
+    {
+        error_code = HT_ERR_UNKNOWN;
+    }
+
+    if (fclose(p_file) != 0)
+    {
+        error_code = HT_ERR_UNKNOWN;
+    }
+
+    return error_code;
+}
+
+size_t
+ht_flight_recorder_listener_get_dropped_count(HT_FlightRecorderListener* listener)
+{
+    size_t dropped_count;
+
+    ht_mutex_lock(listener->mtx);
+    dropped_count = listener->dropped_count;
+    ht_mutex_unlock(listener->mtx);
+
+    return dropped_count;
+}
+
+#ifdef HT_HAVE_UNISTD_H
+
+#define HT_FLIGHT_RECORDER_MAX_PATH_LENGTH 1024
+
+static HT_FlightRecorderListener* volatile _ht_flight_recorder_signal_listener;
+static char _ht_flight_recorder_signal_filename[HT_FLIGHT_RECORDER_MAX_PATH_LENGTH];
+
+static void
+_ht_flight_recorder_listener_write_to_fd(const HT_Byte* data, size_t size, void* user_data)
+{
+    int fd = *(int*)user_data;
+
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0)
+        {
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+static HT_Boolean
+_ht_flight_recorder_is_crash_signal(int signal_number)
+{
+    return signal_number == SIGSEGV || signal_number == SIGABRT || signal_number == SIGBUS
+            || signal_number == SIGILL || signal_number == SIGFPE;
+}
+
+static void
+_ht_flight_recorder_signal_handler(int signal_number)
+{
+    HT_FlightRecorderListener* listener = _ht_flight_recorder_signal_listener;
+
+    if (listener != NULL)
+    {
+        int fd = open(_ht_flight_recorder_signal_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            _ht_flight_recorder_listener_write_snapshot(listener, _ht_flight_recorder_listener_write_to_fd, &fd);
+            close(fd);
+        }
+    }
+
+    if (_ht_flight_recorder_is_crash_signal(signal_number))
+    {
+        /* the handler has been reset to the default one (SA_RESETHAND),
+         * so the signal terminates the process once it's unblocked. */
+        raise(signal_number);
+    }
+}
+
+static void
+_ht_flight_recorder_listener_detach_signal(HT_FlightRecorderListener* listener)
+{
+    if (_ht_flight_recorder_signal_listener == listener)
+    {
+        _ht_flight_recorder_signal_listener = NULL;
+    }
+}
+
+static HT_Boolean
+_ht_flight_recorder_listener_is_attached_to_signal(HT_FlightRecorderListener* listener)
+{
+    return _ht_flight_recorder_signal_listener == listener ? HT_TRUE : HT_FALSE;
+}
+
+HT_ErrorCode
+ht_flight_recorder_listener_dump_on_signal(
+        HT_FlightRecorderListener* listener, int signal_number, const char* filename)
+{
+    struct sigaction action;
+    size_t filename_length = strlen(filename);
+
+    if (filename_length >= HT_FLIGHT_RECORDER_MAX_PATH_LENGTH)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _ht_flight_recorder_signal_handler;
+    sigemptyset(&action.sa_mask);
+    if (_ht_flight_recorder_is_crash_signal(signal_number))
+    {
+        action.sa_flags = SA_RESETHAND;
+    }
+
+    _ht_flight_recorder_signal_listener = NULL;
+    memcpy(_ht_flight_recorder_signal_filename, filename, filename_length + 1);
+    _ht_flight_recorder_signal_listener = listener;
+
+    if (sigaction(signal_number, &action, NULL) != 0)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    return HT_ERR_OK;
+}
+
+#else
+
+static void
+_ht_flight_recorder_listener_detach_signal(HT_FlightRecorderListener* listener)
+{
+    (void)listener;
+}
+
+static HT_Boolean
+_ht_flight_recorder_listener_is_attached_to_signal(HT_FlightRecorderListener* listener)
+{
+    (void)listener;
+    return HT_FALSE;
+}
+
+HT_ErrorCode
+ht_flight_recorder_listener_dump_on_signal(
+        HT_FlightRecorderListener* listener, int signal_number, const char* filename)
+{
+    (void)listener;
+    (void)signal_number;
+    (void)filename;
+
+    return HT_ERR_UNKNOWN;
+}
+
+#endif /* HT_HAVE_UNISTD_H */
+
+HT_FlightRecorderListener*
+ht_flight_recorder_listener_register(
+        HT_Timeline* timeline, size_t capacity, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_create_full(capacity, timeline, &err);
+
+    if (!listener)
+    {
+        goto register_done;
+    }
+
+    err = ht_timeline_register_listener_full(
+                timeline,
+                ht_flight_recorder_listener_callback,
+                listener,
+                (HT_DestroyCallback)ht_flight_recorder_listener_destroy);
+    if (err != HT_ERR_OK)
+    {
+        ht_flight_recorder_listener_destroy(listener);
+        listener = NULL;
+    }
+
+register_done:
+    HT_SET_ERROR(out_err, err);
+    return listener;
+}
@@ -0,0 +1,345 @@
+#include "hawktracer/listeners/mmap_file_dump_listener.h"
+#include "hawktracer/alloc.h"
+#include "hawktracer/timeline_listener.h"
+
+#include "internal/error.h"
+#include "internal/mutex.h"
+
+#ifdef HT_HAVE_UNISTD_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct _HT_MmapFileDumpListener
+{
+    int fd;
+    /* currently mapped extent of the file; NULL if nothing is mapped */
+    HT_Byte* map;
+    size_t map_offset;
+    size_t map_size;
+    /* number of bytes written to the file */
+    size_t file_size;
+    /* number of bytes preallocated for the file */
+    size_t allocated_size;
+    size_t extent_size;
+    size_t page_size;
+    HT_Mutex* mtx;
+};
+
+HT_INLINE static HT_Boolean
+_ht_mmap_file_dump_listener_is_stopped(HT_MmapFileDumpListener* listener)
+{
+    return listener->fd < 0;
+}
+
+static void
+_ht_mmap_file_dump_listener_unmap(HT_MmapFileDumpListener* listener)
+{
+    if (listener->map != NULL)
+    {
+        munmap(listener->map, listener->map_size);
+        listener->map = NULL;
+    }
+}
+
+static HT_Boolean
+_ht_mmap_file_dump_listener_allocate(HT_MmapFileDumpListener* listener, size_t size)
+{
+#ifdef __linux__
+    int error_code = posix_fallocate(listener->fd, (off_t)listener->allocated_size,
+                                     (off_t)(size - listener->allocated_size));
+    if (error_code == 0)
+    {
+        listener->allocated_size = size;
+        return HT_TRUE;
+    }
+
+    /* a sparse file would make writes to the mapping crash with SIGBUS once
+     * the disk is full, so any other error (e.g. ENOSPC) drops the data */
+    if (error_code != EOPNOTSUPP && error_code != EINVAL)
+    {
+        return HT_FALSE;
+    }
+#endif
+    /* file system doesn't support preallocation; extend the file instead */
+    if (ftruncate(listener->fd, (off_t)size) == 0)
+    {
+        listener->allocated_size = size;
+        return HT_TRUE;
+    }
+
+    return HT_FALSE;
+}
+
+/* Returns a pointer to the mapped memory where the next @a size bytes
+ * should be written, or NULL if the file couldn't be extended or mapped. */
+static HT_Byte*
+_ht_mmap_file_dump_listener_get_write_ptr(HT_MmapFileDumpListener* listener, size_t size)
+{
+    size_t offset;
+    size_t map_size;
+    void* map;
+
+    if (listener->map != NULL && listener->file_size + size <= listener->map_offset + listener->map_size)
+    {
+        return listener->map + (listener->file_size - listener->map_offset);
+    }
+
+    _ht_mmap_file_dump_listener_unmap(listener);
+
+    /* the new extent starts at the page of the current position, so the part of
+     * the last page which hasn't been used yet is not wasted */
+    offset = listener->file_size - listener->file_size % listener->page_size;
+    map_size = listener->file_size - offset + size;
+    map_size = (map_size + listener->extent_size - 1) / listener->extent_size * listener->extent_size;
+
+    if (offset + map_size > listener->allocated_size
+            && !_ht_mmap_file_dump_listener_allocate(listener, offset + map_size))
+    {
+        return NULL;
+    }
+
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, listener->fd, (off_t)offset);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    listener->map = (HT_Byte*)map;
+    listener->map_offset = offset;
+    listener->map_size = map_size;
+
+    return listener->map + (listener->file_size - offset);
+}
+
+HT_MmapFileDumpListener*
+ht_mmap_file_dump_listener_create(const char* filename, size_t extent_size, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_MmapFileDumpListener* listener;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    if (extent_size == 0 || page_size <= 0)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    listener = HT_CREATE_TYPE(HT_MmapFileDumpListener);
+    if (listener == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    listener->map = NULL;
+    listener->map_offset = 0;
+    listener->map_size = 0;
+    listener->file_size = 0;
+    listener->allocated_size = 0;
+    listener->page_size = (size_t)page_size;
+    listener->extent_size = (extent_size + listener->page_size - 1) / listener->page_size * listener->page_size;
+
+    listener->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (listener->fd < 0)
+    {
+        error_code = HT_ERR_CANT_OPEN_FILE;
+        goto error_open_file;
+    }
+
+    listener->mtx = ht_mutex_create();
+    if (listener->mtx == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_mutex;
+    }
+
+    ht_timeline_listener_push_metadata(ht_mmap_file_dump_listener_callback, listener, HT_TRUE);
+    goto done;
+
+error_create_mutex:
+    close(listener->fd);
+error_open_file:
+    ht_free(listener);
+    listener = NULL;
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return listener;
+}
+
+void
+ht_mmap_file_dump_listener_destroy(HT_MmapFileDumpListener* listener)
+{
+    if (listener == NULL)
+    {
+        return;
+    }
+
+    ht_mmap_file_dump_listener_stop(listener);
+
+    ht_mutex_destroy(listener->mtx);
+    ht_free(listener);
+}
+
+void
+ht_mmap_file_dump_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_MmapFileDumpListener* listener = (HT_MmapFileDumpListener*)user_data;
+    HT_Byte* ptr;
+    size_t i;
+
+    ht_mutex_lock(listener->mtx);
+
+    if (_ht_mmap_file_dump_listener_is_stopped(listener))
+    {
+        ht_mutex_unlock(listener->mtx);
+        return;
+    }
+
+    if (serialized)
+    {
+        ptr = _ht_mmap_file_dump_listener_get_write_ptr(listener, size);
+        if (ptr != NULL)
+        {
+            memcpy(ptr, events, size);
+            listener->file_size += size;
+        }
+    }
+    else
+    {
+        for (i = 0; i < size;)
+        {
+            HT_Event* event = HT_EVENT(events + i);
+
+            ptr = _ht_mmap_file_dump_listener_get_write_ptr(listener, HT_EVENT_GET_KLASS(event)->get_size(event));
+            if (ptr == NULL)
+            {
+                break;
+            }
+
+            listener->file_size += HT_EVENT_GET_KLASS(event)->serialize(event, ptr);
+            i += HT_EVENT_GET_KLASS(event)->type_info->size;
+        }
+    }
+
+    ht_mutex_unlock(listener->mtx);
+}
+
+HT_ErrorCode
+ht_mmap_file_dump_listener_flush(HT_MmapFileDumpListener* listener, HT_Boolean wait)
+{
+    HT_ErrorCode ret = HT_ERR_OK;
+
+    ht_mutex_lock(listener->mtx);
+
+    if (!_ht_mmap_file_dump_listener_is_stopped(listener) && listener->map != NULL
+            && msync(listener->map, listener->file_size - listener->map_offset, wait ? MS_SYNC : MS_ASYNC) != 0)
+    {
+        ret = HT_ERR_UNKNOWN;
+    }
+
+    ht_mutex_unlock(listener->mtx);
+
+    return ret;
+}
+
+void
+ht_mmap_file_dump_listener_stop(HT_MmapFileDumpListener* listener)
+{
+    ht_mutex_lock(listener->mtx);
+
+    if (_ht_mmap_file_dump_listener_is_stopped(listener))
+    {
+        ht_mutex_unlock(listener->mtx);
+        return;
+    }
+
+    _ht_mmap_file_dump_listener_unmap(listener);
+    /* remove the preallocated space which hasn't been used. There's no way
+     * to report the failure here; the data is in the file anyway. */
+    if (ftruncate(listener->fd, (off_t)listener->file_size) == 0)
+    {
+        listener->allocated_size = listener->file_size;
+    }
+    close(listener->fd);
+    listener->fd = -1;
+
+    ht_mutex_unlock(listener->mtx);
+}
+
+#else
+
+HT_MmapFileDumpListener*
+ht_mmap_file_dump_listener_create(const char* filename, size_t extent_size, HT_ErrorCode* out_err)
+{
+    (void)filename;
+    (void)extent_size;
+
+    HT_SET_ERROR(out_err, HT_ERR_UNKNOWN);
+
+    return NULL;
+}
+
+void
+ht_mmap_file_dump_listener_destroy(HT_MmapFileDumpListener* listener)
+{
+    (void)listener;
+}
+
+void
+ht_mmap_file_dump_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    (void)events;
+    (void)size;
+    (void)serialized;
+    (void)user_data;
+}
+
+HT_ErrorCode
+ht_mmap_file_dump_listener_flush(HT_MmapFileDumpListener* listener, HT_Boolean wait)
+{
+    (void)listener;
+    (void)wait;
+
+    return HT_ERR_UNKNOWN;
+}
+
+void
+ht_mmap_file_dump_listener_stop(HT_MmapFileDumpListener* listener)
+{
+    (void)listener;
+}
+
+#endif /* HT_HAVE_UNISTD_H */
+
+HT_MmapFileDumpListener*
+ht_mmap_file_dump_listener_register(
+        HT_Timeline* timeline, const char* filename, size_t extent_size, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_create(filename, extent_size, &err);
+
+    if (!listener)
+    {
+        goto register_done;
+    }
+
+    err = ht_timeline_register_listener_full(
+                timeline,
+                ht_mmap_file_dump_listener_callback,
+                listener,
+                (HT_DestroyCallback)ht_mmap_file_dump_listener_destroy);
+    if (err != HT_ERR_OK)
+    {
+        ht_mmap_file_dump_listener_destroy(listener);
+        listener = NULL;
+    }
+
+register_done:
+    HT_SET_ERROR(out_err, err);
+    return listener;
+}
@@ -0,0 +1,385 @@
+#include "hawktracer/listeners/shm_listener.h"
+#include "hawktracer/alloc.h"
+#include "hawktracer/timeline_listener.h"
+
+#include "internal/atomic.h"
+#include "internal/error.h"
+#include "internal/mutex.h"
+
+#ifdef HT_HAVE_UNISTD_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct _HT_ShmListener
+{
+    /* name of the segment, with the leading slash; NULL if the listener is stopped */
+    char* name;
+    HT_ShmListenerHeader* header;
+    /* the data area is mapped twice, one mapping right after another, so data
+     * can be written to the ring with a single copy even if it wraps around */
+    HT_Byte* data;
+    size_t mapping_size;
+    uint64_t capacity;
+    /* cached value of header->read_position; the consumer's position is only
+     * loaded again if the ring looks full */
+    uint64_t read_position;
+    uint64_t write_position;
+    size_t dropped_size;
+    HT_Mutex* mtx;
+};
+
+HT_INLINE static HT_Boolean
+_ht_shm_listener_is_stopped(HT_ShmListener* listener)
+{
+    return listener->name == NULL;
+}
+
+static void
+_ht_shm_listener_skip_events(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    (void)events;
+    (void)size;
+    (void)serialized;
+    (void)user_data;
+}
+
+/* Returns a pointer where @a size bytes can be written, or NULL if the ring is full. */
+static HT_Byte*
+_ht_shm_listener_reserve(HT_ShmListener* listener, size_t size)
+{
+    if (listener->write_position + size - listener->read_position > listener->capacity)
+    {
+        listener->read_position = ht_atomic_uint64_load(&listener->header->read_position);
+        if (listener->write_position + size - listener->read_position > listener->capacity)
+        {
+            listener->dropped_size += size;
+            ht_atomic_uint64_store(&listener->header->dropped_size, listener->dropped_size);
+            return NULL;
+        }
+    }
+
+    return listener->data + listener->write_position % listener->capacity;
+}
+
+static void
+_ht_shm_listener_commit(HT_ShmListener* listener, size_t size)
+{
+    listener->write_position += size;
+    ht_atomic_uint64_store(&listener->header->write_position, listener->write_position);
+}
+
+static HT_ErrorCode
+_ht_shm_listener_map(HT_ShmListener* listener, int fd, size_t page_size)
+{
+    size_t segment_size = page_size + (size_t)listener->capacity;
+    HT_Byte* reserved;
+
+    /* reserve the address space for the header and two copies of the data area */
+    listener->mapping_size = segment_size + (size_t)listener->capacity;
+    reserved = (HT_Byte*)mmap(NULL, listener->mapping_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+
+    if (mmap(reserved, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+            || mmap(reserved + segment_size, (size_t)listener->capacity, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED, fd, (off_t)page_size) == MAP_FAILED)
+    {
+        munmap(reserved, listener->mapping_size);
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+
+    listener->header = (HT_ShmListenerHeader*)reserved;
+    listener->data = reserved + page_size;
+
+    return HT_ERR_OK;
+}
+
+HT_ShmListener*
+ht_shm_listener_create(const char* name, size_t ring_size, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_ShmListener* listener;
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t name_length;
+    int fd;
+
+    if (name == NULL || name[0] == '\0' || ring_size == 0 || page_size <= 0)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    listener = HT_CREATE_TYPE(HT_ShmListener);
+    if (listener == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    /* shm_open() requires names starting with a slash */
+    if (name[0] == '/')
+    {
+        name++;
+    }
+    name_length = strlen(name);
+    listener->name = (char*)ht_alloc(name_length + 2);
+    if (listener->name == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_alloc_name;
+    }
+    listener->name[0] = '/';
+    memcpy(listener->name + 1, name, name_length + 1);
+
+    listener->capacity = (ring_size + (size_t)page_size - 1) / (size_t)page_size * (size_t)page_size;
+    listener->read_position = 0;
+    listener->write_position = 0;
+    listener->dropped_size = 0;
+
+    /* the metadata is written only once, so the stream can't be parsed if it doesn't fit */
+    if (ht_timeline_listener_push_metadata(_ht_shm_listener_skip_events, NULL, HT_TRUE) > listener->capacity)
+    {
+        error_code = HT_ERR_INVALID_ARGUMENT;
+        goto error_open;
+    }
+
+    fd = shm_open(listener->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        error_code = HT_ERR_CANT_OPEN_FILE;
+        goto error_open;
+    }
+
+    if (ftruncate(fd, (off_t)(page_size + listener->capacity)) != 0)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_map;
+    }
+
+    error_code = _ht_shm_listener_map(listener, fd, (size_t)page_size);
+    if (error_code != HT_ERR_OK)
+    {
+        goto error_map;
+    }
+    /* the mappings keep the segment alive */
+    close(fd);
+
+    listener->mtx = ht_mutex_create();
+    if (listener->mtx == NULL)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_create_mutex;
+    }
+
+    listener->header->version = HT_SHM_LISTENER_VERSION;
+    listener->header->capacity = listener->capacity;
+    listener->header->data_offset = (uint64_t)page_size;
+
+    ht_timeline_listener_push_metadata(ht_shm_listener_callback, listener, HT_TRUE);
+    if (listener->dropped_size > 0)
+    {
+        /* klasses registered in the meantime made the metadata bigger than the ring */
+        error_code = HT_ERR_INVALID_ARGUMENT;
+        goto error_push_metadata;
+    }
+
+    /* the consumer doesn't use the segment until the magic is set */
+    ht_atomic_uint32_store(&listener->header->magic, HT_SHM_LISTENER_MAGIC);
+    goto done;
+
+error_push_metadata:
+    ht_mutex_destroy(listener->mtx);
+error_create_mutex:
+    munmap(listener->header, listener->mapping_size);
+    fd = -1;
+error_map:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    shm_unlink(listener->name);
+error_open:
+    ht_free(listener->name);
+error_alloc_name:
+    ht_free(listener);
+    listener = NULL;
+done:
+    HT_SET_ERROR(out_err, error_code);
+
+    return listener;
+}
+
+void
+ht_shm_listener_destroy(HT_ShmListener* listener)
+{
+    if (listener == NULL)
+    {
+        return;
+    }
+
+    ht_shm_listener_stop(listener);
+
+    ht_mutex_destroy(listener->mtx);
+    ht_free(listener);
+}
+
+void
+ht_shm_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_ShmListener* listener = (HT_ShmListener*)user_data;
+    HT_Byte* ptr;
+    size_t total_size = 0;
+    size_t i;
+
+    ht_mutex_lock(listener->mtx);
+
+    if (_ht_shm_listener_is_stopped(listener))
+    {
+        ht_mutex_unlock(listener->mtx);
+        return;
+    }
+
+    if (serialized)
+    {
+        ptr = _ht_shm_listener_reserve(listener, size);
+        if (ptr != NULL)
+        {
+            memcpy(ptr, events, size);
+            _ht_shm_listener_commit(listener, size);
+        }
+    }
+    else
+    {
+        /* all the events are dropped if they don't fit into the ring */
+        for (i = 0; i < size; i += HT_EVENT_GET_KLASS(HT_EVENT(events + i))->type_info->size)
+        {
+            HT_Event* event = HT_EVENT(events + i);
+            total_size += HT_EVENT_GET_KLASS(event)->get_size(event);
+        }
+
+        ptr = _ht_shm_listener_reserve(listener, total_size);
+        if (ptr != NULL)
+        {
+            for (i = 0; i < size; i += HT_EVENT_GET_KLASS(HT_EVENT(events + i))->type_info->size)
+            {
+                HT_Event* event = HT_EVENT(events + i);
+                ptr += HT_EVENT_GET_KLASS(event)->serialize(event, ptr);
+            }
+            _ht_shm_listener_commit(listener, total_size);
+        }
+    }
+
+    ht_mutex_unlock(listener->mtx);
+}
+
+size_t
+ht_shm_listener_get_dropped_size(HT_ShmListener* listener)
+{
+    size_t dropped_size;
+
+    ht_mutex_lock(listener->mtx);
+    dropped_size = listener->dropped_size;
+    ht_mutex_unlock(listener->mtx);
+
+    return dropped_size;
+}
+
+void
+ht_shm_listener_stop(HT_ShmListener* listener)
+{
+    ht_mutex_lock(listener->mtx);
+
+    if (_ht_shm_listener_is_stopped(listener))
+    {
+        ht_mutex_unlock(listener->mtx);
+        return;
+    }
+
+    ht_atomic_uint32_store(&listener->header->closed, 1);
+    munmap(listener->header, listener->mapping_size);
+    listener->header = NULL;
+    listener->data = NULL;
+
+    shm_unlink(listener->name);
+    ht_free(listener->name);
+    listener->name = NULL;
+
+    ht_mutex_unlock(listener->mtx);
+}
+
+#else
+
+HT_ShmListener*
+ht_shm_listener_create(const char* name, size_t ring_size, HT_ErrorCode* out_err)
+{
+    (void)name;
+    (void)ring_size;
+
+    HT_SET_ERROR(out_err, HT_ERR_UNKNOWN);
+
+    return NULL;
+}
+
+void
+ht_shm_listener_destroy(HT_ShmListener* listener)
+{
+    (void)listener;
+}
+
+void
+ht_shm_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    (void)events;
+    (void)size;
+    (void)serialized;
+    (void)user_data;
+}
+
+size_t
+ht_shm_listener_get_dropped_size(HT_ShmListener* listener)
+{
+    (void)listener;
+
+    return 0;
+}
+
+void
+ht_shm_listener_stop(HT_ShmListener* listener)
+{
+    (void)listener;
+}
+
+#endif /* HT_HAVE_UNISTD_H */
+
+HT_ShmListener*
+ht_shm_listener_register(
+        HT_Timeline* timeline, const char* name, size_t ring_size, HT_ErrorCode* out_err)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+    HT_ShmListener* listener = ht_shm_listener_create(name, ring_size, &err);
+
+    if (!listener)
+    {
+        goto register_done;
+    }
+
+    err = ht_timeline_register_listener_full(
+                timeline,
+                ht_shm_listener_callback,
+                listener,
+                (HT_DestroyCallback)ht_shm_listener_destroy);
+    if (err != HT_ERR_OK)
+    {
+        ht_shm_listener_destroy(listener);
+        listener = NULL;
+    }
+
+register_done:
+    HT_SET_ERROR(out_err, err);
+    return listener;
+}
@@ -1,13 +1,24 @@
 #include "hawktracer/listeners/tcp_listener.h"
 #include "hawktracer/alloc.h"
+#include "hawktracer/category.h"
+#include "hawktracer/compression.h"
+#include "hawktracer/feature_cached_string.h"
+#include "hawktracer/feature_callstack.h"
+#include "hawktracer/feature_callstack_aggregation.h"
 #include "hawktracer/timeline_listener.h"
 
+#include "internal/atomic.h"
 #include "internal/error.h"
+#include "internal/global_timeline.h"
 #include "internal/listener_buffer.h"
 #include "internal/listeners/tcp_server.h"
 #include "internal/mutex.h"
+#include "internal/registry.h"
+#include "internal/thread.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 struct _HT_TCPListener
 {
@@ -18,6 +29,25 @@ struct _HT_TCPListener
     /* TODO: This is just a hack to prevent from sending half-events.
      * We should revisit this for next release */
     HT_Boolean _was_flushed;
+    /* set by ht_tcp_listener_set_paused() and by remote clients, so it's accessed atomically */
+    volatile uint32_t _paused;
+    /* set by ht_tcp_listener_set_remote_commands_enabled(), read by the server thread */
+    volatile uint32_t _commands_enabled;
+    /* String mappings pushed while the listener was paused have been dropped, so all
+     * the mappings of _string_mapping_timeline are sent again with the next events. */
+    volatile uint32_t _string_mappings_outdated;
+    HT_Timeline* _string_mapping_timeline;
+    /* Commands received by the server thread are executed by the command thread,
+     * as the server thread can't wait for listeners which write data to the server
+     * (e.g. when flushing timelines). The thread is started by the first command. */
+    HT_Mutex* _command_mutex;
+    HT_CondVar* _command_cond_var;
+    HT_Thread* _command_thread;
+    /* NUL-terminated commands waiting for the command thread */
+    char* _commands;
+    size_t _commands_size;
+    size_t _commands_capacity;
+    HT_Boolean _commands_stopped;
 };
 
 HT_INLINE static HT_Boolean
@@ -47,6 +77,14 @@ ht_tcp_listener_metadata_pusher(TEventPtr e, size_t c, HT_Boolean serialized, vo
     (void) serialized;
     HT_TCPListener* listener = (HT_TCPListener*)user_data;
     ht_mutex_lock(listener->_push_action_mutex);
+    if (listener->_buffer.compressed_data != NULL)
+    {
+        /* metadata is sent in a stored (uncompressed) frame */
+        HT_Byte header[HT_COMPRESSION_FRAME_HEADER_SIZE];
+        ht_compression_write_frame_header(header, (uint32_t)c, 0);
+        ht_tcp_server_write_to_socket(listener->_tcp_server, listener->_last_client_sock_fd,
+                                      (char*)header, sizeof(header));
+    }
     ht_tcp_server_write_to_socket(listener->_tcp_server, listener->_last_client_sock_fd, (char*)e, c);
     ht_mutex_unlock(listener->_push_action_mutex);
 }
@@ -56,26 +94,322 @@ ht_tcp_listener_client_connected(int sock_fd, void* user_data)
 {
     HT_TCPListener* listener = (HT_TCPListener*)user_data;
     listener->_last_client_sock_fd = sock_fd;
+    if (listener->_buffer.compressed_data != NULL)
+    {
+        ht_tcp_server_write_to_socket(listener->_tcp_server, sock_fd,
+                                      (char*)HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC_SIZE);
+    }
     ht_timeline_listener_push_metadata(ht_tcp_listener_metadata_pusher, user_data, HT_TRUE);
 }
 
+static void
+_ht_tcp_listener_process_events(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    HT_TCPListener* listener = (HT_TCPListener*)user_data;
+
+    if (serialized)
+    {
+        ht_listener_buffer_process_serialized_events(&listener->_buffer, events, size, ht_tcp_listener_f_flush, listener);
+    }
+    else
+    {
+        ht_listener_buffer_process_unserialized_events(&listener->_buffer, events, size, ht_tcp_listener_f_flush, listener);
+    }
+}
+
+/* Parses a decimal number; @a end points to the character following the number. */
+static HT_Boolean
+_ht_tcp_listener_parse_number(const char* str, char** end, uint64_t* out_value)
+{
+    if (str[0] < '0' || str[0] > '9')
+    {
+        return HT_FALSE;
+    }
+
+    *out_value = (uint64_t)strtoull(str, end, 10);
+    return HT_TRUE;
+}
+
+typedef struct
+{
+    uint64_t first;
+    uint64_t second;
+} HT_TCPListenerCommandArgs;
+
+static void
+_ht_tcp_listener_set_sampling_rate(HT_Timeline* timeline, void* user_data)
+{
+    ht_feature_callstack_set_sampling_rate(timeline, ((HT_TCPListenerCommandArgs*)user_data)->first);
+}
+
+static void
+_ht_tcp_listener_set_duration_threshold(HT_Timeline* timeline, void* user_data)
+{
+    HT_TCPListenerCommandArgs* args = (HT_TCPListenerCommandArgs*)user_data;
+    ht_feature_callstack_set_duration_threshold(timeline, args->first, args->second);
+}
+
+static void
+_ht_tcp_listener_set_aggregation_paused(HT_Timeline* timeline, void* user_data)
+{
+    ht_feature_callstack_aggregation_set_paused(timeline, *(HT_Boolean*)user_data);
+}
+
+/* Executes a command sent by a client (see the protocol description in tcp_listener.h).
+ * Invalid commands are ignored. */
+static void
+_ht_tcp_listener_execute_command(HT_TCPListener* listener, char* command)
+{
+    HT_TCPListenerCommandArgs args;
+    HT_Boolean paused;
+    char* argument;
+    char* end;
+
+    argument = strchr(command, ' ');
+    if (argument != NULL)
+    {
+        *argument++ = '\0';
+    }
+
+    if (strcmp(command, HT_TCP_LISTENER_COMMAND_PAUSE) == 0 && argument == NULL)
+    {
+        ht_tcp_listener_set_paused(listener, HT_TRUE);
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_RESUME) == 0 && argument == NULL)
+    {
+        ht_tcp_listener_set_paused(listener, HT_FALSE);
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_FLUSH) == 0 && argument == NULL)
+    {
+        ht_timeline_flush_all();
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_ENABLE_CATEGORIES) == 0 && argument != NULL)
+    {
+        ht_category_set_enabled_by_names(argument, HT_TRUE);
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_DISABLE_CATEGORIES) == 0 && argument != NULL)
+    {
+        ht_category_set_enabled_by_names(argument, HT_FALSE);
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_NEW_GLOBAL_TIMELINE_BUFFER_SIZE) == 0 && argument != NULL)
+    {
+        if (_ht_tcp_listener_parse_number(argument, &end, &args.first) && *end == '\0' && args.first > 0)
+        {
+            if (args.first < HT_TCP_LISTENER_MIN_GLOBAL_TIMELINE_BUFFER_SIZE)
+            {
+                args.first = HT_TCP_LISTENER_MIN_GLOBAL_TIMELINE_BUFFER_SIZE;
+            }
+            else if (args.first > HT_TCP_LISTENER_MAX_GLOBAL_TIMELINE_BUFFER_SIZE)
+            {
+                args.first = HT_TCP_LISTENER_MAX_GLOBAL_TIMELINE_BUFFER_SIZE;
+            }
+            ht_global_timeline_set_buffer_size((size_t)args.first);
+        }
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_SAMPLING_RATE) == 0 && argument != NULL)
+    {
+        if (_ht_tcp_listener_parse_number(argument, &end, &args.first) && *end == '\0')
+        {
+            ht_registry_for_each_timeline(_ht_tcp_listener_set_sampling_rate, &args);
+        }
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_DURATION_THRESHOLD) == 0 && argument != NULL)
+    {
+        if (_ht_tcp_listener_parse_number(argument, &end, &args.first) && *end == ' '
+                && _ht_tcp_listener_parse_number(end + 1, &end, &args.second) && *end == '\0')
+        {
+            ht_registry_for_each_timeline(_ht_tcp_listener_set_duration_threshold, &args);
+        }
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_PAUSE_AGGREGATION) == 0 && argument == NULL)
+    {
+        paused = HT_TRUE;
+        ht_registry_for_each_timeline(_ht_tcp_listener_set_aggregation_paused, &paused);
+    }
+    else if (strcmp(command, HT_TCP_LISTENER_COMMAND_RESUME_AGGREGATION) == 0 && argument == NULL)
+    {
+        paused = HT_FALSE;
+        ht_registry_for_each_timeline(_ht_tcp_listener_set_aggregation_paused, &paused);
+    }
+}
+
+static void*
+_ht_tcp_listener_run_commands(void* user_data)
+{
+    HT_TCPListener* listener = (HT_TCPListener*)user_data;
+
+    ht_mutex_lock(listener->_command_mutex);
+
+    for (;;)
+    {
+        char* commands;
+        size_t size;
+        size_t offset;
+
+        while (!listener->_commands_stopped && listener->_commands_size == 0)
+        {
+            ht_cond_var_wait(listener->_command_cond_var, listener->_command_mutex);
+        }
+
+        if (listener->_commands_stopped)
+        {
+            break;
+        }
+
+        commands = listener->_commands;
+        size = listener->_commands_size;
+        listener->_commands = NULL;
+        listener->_commands_size = 0;
+        listener->_commands_capacity = 0;
+        ht_mutex_unlock(listener->_command_mutex);
+
+        for (offset = 0; offset < size; offset += strlen(commands + offset) + 1)
+        {
+            _ht_tcp_listener_execute_command(listener, commands + offset);
+        }
+        ht_free(commands);
+
+        ht_mutex_lock(listener->_command_mutex);
+    }
+
+    ht_mutex_unlock(listener->_command_mutex);
+
+    return NULL;
+}
+
+/* Queues a command sent by a client. It's called by the server thread while the server
+ * is locked, so commands are executed by the command thread. */
+static void
+ht_tcp_listener_client_message(int sock_fd, const char* message, size_t size, void* user_data)
+{
+    HT_TCPListener* listener = (HT_TCPListener*)user_data;
+
+    (void)sock_fd;
+
+    if (!ht_atomic_uint32_load(&listener->_commands_enabled))
+    {
+        return;
+    }
+
+    while (size > 0 && (message[size - 1] == '\r' || message[size - 1] == ' '))
+    {
+        size--;
+    }
+
+    ht_mutex_lock(listener->_command_mutex);
+
+    if (listener->_commands_stopped)
+    {
+        goto client_message_done;
+    }
+
+    if (listener->_command_thread == NULL)
+    {
+        listener->_command_thread = ht_thread_create(_ht_tcp_listener_run_commands, listener);
+        if (listener->_command_thread == NULL)
+        {
+            goto client_message_done;
+        }
+    }
+
+    if (listener->_commands_size + size + 1 > listener->_commands_capacity)
+    {
+        size_t capacity = listener->_commands_size + size + 1 + HT_TCP_SERVER_MAX_CLIENT_MESSAGE_SIZE;
+        char* commands = (char*)ht_realloc(listener->_commands, capacity);
+        if (commands == NULL)
+        {
+            goto client_message_done;
+        }
+        listener->_commands = commands;
+        listener->_commands_capacity = capacity;
+    }
+
+    memcpy(listener->_commands + listener->_commands_size, message, size);
+    listener->_commands[listener->_commands_size + size] = '\0';
+    listener->_commands_size += size + 1;
+    ht_cond_var_notify_all(listener->_command_cond_var);
+
+client_message_done:
+    ht_mutex_unlock(listener->_command_mutex);
+}
+
+/* Stops the command thread; commands which haven't been executed yet are dropped. */
+static void
+_ht_tcp_listener_stop_commands(HT_TCPListener* listener)
+{
+    if (listener->_command_mutex == NULL || listener->_command_cond_var == NULL)
+    {
+        return;
+    }
+
+    ht_mutex_lock(listener->_command_mutex);
+    listener->_commands_stopped = HT_TRUE;
+    ht_cond_var_notify_all(listener->_command_cond_var);
+    ht_mutex_unlock(listener->_command_mutex);
+
+    if (listener->_command_thread != NULL)
+    {
+        ht_thread_destroy(listener->_command_thread);
+        listener->_command_thread = NULL;
+    }
+
+    ht_free(listener->_commands);
+    listener->_commands = NULL;
+    listener->_commands_size = 0;
+    listener->_commands_capacity = 0;
+}
+
+/* Starts the server on the Unix domain socket @a unix_socket_path, or on the TCP @a port
+ * if the path is NULL. */
 static HT_ErrorCode
-ht_tcp_listener_init(HT_TCPListener* listener, int port, size_t buffer_size)
+ht_tcp_listener_init(HT_TCPListener* listener, int port, const char* unix_socket_path, size_t buffer_size, HT_Boolean compress)
 {
-    HT_ErrorCode error_code = ht_listener_buffer_init(&listener->_buffer, buffer_size);
+    HT_ErrorCode error_code;
+
+    // TODO handle if return null
+    listener->_push_action_mutex = ht_mutex_create();
+    listener->_tcp_server = NULL;
+    listener->_string_mapping_timeline = NULL;
+    listener->_command_thread = NULL;
+    listener->_commands = NULL;
+    listener->_commands_size = 0;
+    listener->_commands_capacity = 0;
+    listener->_commands_stopped = HT_FALSE;
+    listener->_command_mutex = ht_mutex_create();
+    listener->_command_cond_var = ht_cond_var_create();
+    if (listener->_command_mutex == NULL || listener->_command_cond_var == NULL)
+    {
+        return HT_ERR_OUT_OF_MEMORY;
+    }
+
+    error_code = ht_listener_buffer_init(&listener->_buffer, buffer_size);
     if (error_code != HT_ERR_OK)
     {
         return error_code;
     }
 
+    if (compress)
+    {
+        error_code = ht_listener_buffer_enable_compression(&listener->_buffer);
+        if (error_code != HT_ERR_OK)
+        {
+            ht_listener_buffer_deinit(&listener->_buffer);
+            return error_code;
+        }
+    }
+
     listener->_last_client_sock_fd = 0;
     listener->_was_flushed = HT_FALSE;
+    listener->_paused = 0;
+    listener->_commands_enabled = 0;
+    listener->_string_mappings_outdated = 0;
 
-    // TODO handle if return null
-    listener->_push_action_mutex = ht_mutex_create();
     listener->_tcp_server = ht_tcp_server_create();
+    ht_tcp_server_set_client_message_callback(listener->_tcp_server, ht_tcp_listener_client_message, listener);
 
-    if (ht_tcp_server_start(listener->_tcp_server, port, ht_tcp_listener_client_connected, listener))
+    if (unix_socket_path != NULL
+            ? ht_tcp_server_start_unix_socket(listener->_tcp_server, unix_socket_path, ht_tcp_listener_client_connected, listener)
+            : ht_tcp_server_start(listener->_tcp_server, port, ht_tcp_listener_client_connected, listener))
     {
         return HT_ERR_OK;
     }
@@ -98,18 +432,27 @@ ht_tcp_listener_push_events(HT_TCPListener* listener, TEventPtr events, size_t s
         goto push_event_done;
     }
 
-    if (serialized)
+    if (ht_atomic_uint32_load(&listener->_paused))
     {
-        ht_listener_buffer_process_serialized_events(&listener->_buffer, events, size, ht_tcp_listener_f_flush, listener);
+        goto push_event_done;
     }
-    else
+
+    if (HT_UNLIKELY(ht_atomic_uint32_load(&listener->_string_mappings_outdated)))
     {
-        ht_listener_buffer_process_unserialized_events(&listener->_buffer, events, size, ht_tcp_listener_f_flush, listener);
+        ht_atomic_uint32_store(&listener->_string_mappings_outdated, 0);
+        if (listener->_string_mapping_timeline != NULL)
+        {
+            ht_feature_cached_string_push_map_to_listener(
+                        listener->_string_mapping_timeline, _ht_tcp_listener_process_events, listener, HT_TRUE);
+        }
     }
 
+    _ht_tcp_listener_process_events(events, size, serialized, listener);
+
     if (listener->_was_flushed)
     {
         ht_tcp_listener_flush(listener);
+        ht_tcp_server_end_message(listener->_tcp_server);
         listener->_was_flushed = HT_FALSE;
     }
 
@@ -119,6 +462,12 @@ push_event_done:
 
 HT_TCPListener*
 ht_tcp_listener_create(int port, size_t buffer_size, HT_ErrorCode* out_err)
+{
+    return ht_tcp_listener_create_full(port, buffer_size, HT_FALSE, out_err);
+}
+
+static HT_TCPListener*
+_ht_tcp_listener_create(int port, const char* unix_socket_path, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err)
 {
     HT_TCPListener* listener = HT_CREATE_TYPE(HT_TCPListener);
     if (!listener)
@@ -127,7 +476,7 @@ ht_tcp_listener_create(int port, size_t buffer_size, HT_ErrorCode* out_err)
         return NULL;
     }
 
-    HT_ErrorCode error_code = ht_tcp_listener_init(listener, port, buffer_size);
+    HT_ErrorCode error_code = ht_tcp_listener_init(listener, port, unix_socket_path, buffer_size, compress);
     if (error_code != HT_ERR_OK)
     {
         ht_tcp_listener_destroy(listener);
@@ -138,15 +487,14 @@ ht_tcp_listener_create(int port, size_t buffer_size, HT_ErrorCode* out_err)
     return listener;
 }
 
-HT_TCPListener*
-ht_tcp_listener_register(HT_Timeline* timeline, int port, size_t buffer_size, HT_ErrorCode* out_err)
+static HT_TCPListener*
+_ht_tcp_listener_register(HT_Timeline* timeline, HT_TCPListener* listener, HT_ErrorCode* out_err)
 {
     HT_ErrorCode err = HT_ERR_OK;
-    HT_TCPListener* listener = ht_tcp_listener_create(port, buffer_size, &err);
 
     if (!listener)
     {
-        goto register_done;
+        return NULL;
     }
 
     err = ht_timeline_register_listener_full(
@@ -159,12 +507,53 @@ ht_tcp_listener_register(HT_Timeline* timeline, int port, size_t buffer_size, HT
         ht_tcp_listener_destroy(listener);
         listener = NULL;
     }
+    else
+    {
+        listener->_string_mapping_timeline = timeline;
+    }
 
-register_done:
     HT_SET_ERROR(out_err, err);
     return listener;
 }
 
+HT_TCPListener*
+ht_tcp_listener_create_full(int port, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err)
+{
+    return _ht_tcp_listener_create(port, NULL, buffer_size, compress, out_err);
+}
+
+HT_TCPListener*
+ht_tcp_listener_create_unix_socket(const char* path, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err)
+{
+    if (path == NULL)
+    {
+        HT_SET_ERROR(out_err, HT_ERR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    return _ht_tcp_listener_create(0, path, buffer_size, compress, out_err);
+}
+
+HT_TCPListener*
+ht_tcp_listener_register(HT_Timeline* timeline, int port, size_t buffer_size, HT_ErrorCode* out_err)
+{
+    return ht_tcp_listener_register_full(timeline, port, buffer_size, HT_FALSE, out_err);
+}
+
+HT_TCPListener*
+ht_tcp_listener_register_full(HT_Timeline* timeline, int port, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err)
+{
+    return _ht_tcp_listener_register(
+                timeline, ht_tcp_listener_create_full(port, buffer_size, compress, out_err), out_err);
+}
+
+HT_TCPListener*
+ht_tcp_listener_register_unix_socket(HT_Timeline* timeline, const char* path, size_t buffer_size, HT_Boolean compress, HT_ErrorCode* out_err)
+{
+    return _ht_tcp_listener_register(
+                timeline, ht_tcp_listener_create_unix_socket(path, buffer_size, compress, out_err), out_err);
+}
+
 void
 ht_tcp_listener_destroy(HT_TCPListener* listener)
 {
@@ -172,6 +561,15 @@ ht_tcp_listener_destroy(HT_TCPListener* listener)
     {
         ht_tcp_listener_stop(listener);
     }
+    _ht_tcp_listener_stop_commands(listener);
+    if (listener->_command_cond_var != NULL)
+    {
+        ht_cond_var_destroy(listener->_command_cond_var);
+    }
+    if (listener->_command_mutex != NULL)
+    {
+        ht_mutex_destroy(listener->_command_mutex);
+    }
     ht_mutex_destroy(listener->_push_action_mutex);
     ht_free(listener);
 }
@@ -182,14 +580,85 @@ ht_tcp_listener_callback(TEventPtr events, size_t size, HT_Boolean serialized, v
     ht_tcp_listener_push_events((HT_TCPListener*)user_data, events, size, serialized);
 }
 
+HT_ErrorCode
+ht_tcp_listener_set_slow_client_policy(HT_TCPListener* listener,
+                                      size_t max_queue_size,
+                                      HT_TCPListenerSlowClientPolicy policy)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+
+    if (max_queue_size == 0
+            || (policy != HT_TCP_LISTENER_SLOW_CLIENT_DROP_OLDEST
+                && policy != HT_TCP_LISTENER_SLOW_CLIENT_DISCONNECT
+                && policy != HT_TCP_LISTENER_SLOW_CLIENT_BLOCK))
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    ht_mutex_lock(listener->_push_action_mutex);
+    if (_ht_tcp_listener_is_stopped(listener))
+    {
+        error_code = HT_ERR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        ht_tcp_server_set_client_queue(listener->_tcp_server, max_queue_size, policy);
+    }
+    ht_mutex_unlock(listener->_push_action_mutex);
+
+    return error_code;
+}
+
+size_t
+ht_tcp_listener_get_dropped_size(HT_TCPListener* listener)
+{
+    size_t dropped_size = 0;
+
+    ht_mutex_lock(listener->_push_action_mutex);
+    if (!_ht_tcp_listener_is_stopped(listener))
+    {
+        dropped_size = ht_tcp_server_get_dropped_size(listener->_tcp_server);
+    }
+    ht_mutex_unlock(listener->_push_action_mutex);
+
+    return dropped_size;
+}
+
+void
+ht_tcp_listener_set_paused(HT_TCPListener* listener, HT_Boolean paused)
+{
+    if (!paused && ht_atomic_uint32_load(&listener->_paused))
+    {
+        /* set before resuming, so the next events are preceded by the mappings */
+        ht_atomic_uint32_store(&listener->_string_mappings_outdated, 1);
+    }
+    ht_atomic_uint32_store(&listener->_paused, paused ? 1 : 0);
+}
+
+HT_Boolean
+ht_tcp_listener_is_paused(HT_TCPListener* listener)
+{
+    return ht_atomic_uint32_load(&listener->_paused) ? HT_TRUE : HT_FALSE;
+}
+
+void
+ht_tcp_listener_set_remote_commands_enabled(HT_TCPListener* listener, HT_Boolean enabled)
+{
+    ht_atomic_uint32_store(&listener->_commands_enabled, enabled ? 1 : 0);
+}
+
 void
 ht_tcp_listener_stop(HT_TCPListener* listener)
 {
+    /* the command thread might be waiting for the listener (e.g. when flushing timelines) */
+    _ht_tcp_listener_stop_commands(listener);
+
     ht_mutex_lock(listener->_push_action_mutex);
 
-    if (!_ht_tcp_listener_is_stopped(listener))
+    if (_ht_tcp_listener_is_stopped(listener))
     {
         ht_mutex_unlock(listener->_push_action_mutex);
+        return;
     }
 
     ht_tcp_listener_flush(listener);
@@ -199,6 +668,4 @@ ht_tcp_listener_stop(HT_TCPListener* listener)
     listener->_tcp_server = NULL;
 
     ht_mutex_unlock(listener->_push_action_mutex);
-
-    ht_mutex_unlock(listener->_push_action_mutex);
 }
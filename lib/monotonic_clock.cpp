@@ -1,8 +1,22 @@
 #include "hawktracer/monotonic_clock.h"
 #include "hawktracer/duration_conversion.h"
+#include "internal/monotonic_clock.h"
+
+#if defined(HT_MONOTONIC_CLOCK_IMPL_TSC) && defined(HT_MONOTONIC_CLOCK_IMPL_CUSTOM)
+#  error HT_MONOTONIC_CLOCK_IMPL_TSC can not be used together with custom clock implementation.
+#endif
+
+#if defined(HT_MONOTONIC_CLOCK_IMPL_TSC) && !defined(HT_MONOTONIC_CLOCK_TSC_SUPPORTED)
+#  error Time stamp counter clock is not supported on the target platform.
+#endif
 
 #if defined(HT_MONOTONIC_CLOCK_IMPL_CUSTOM)
 /* Custom implementation provided */
+static HT_INLINE HT_TimestampNs
+_ht_monotonic_clock_get_system_timestamp(void)
+{
+    return ht_monotonic_clock_get_timestamp();
+}
 #else
 
 /* Figure out the implementation based on defines */
@@ -47,8 +61,8 @@
     }
 #endif
 
-HT_TimestampNs
-ht_monotonic_clock_get_timestamp(void)
+static HT_INLINE HT_TimestampNs
+_ht_monotonic_clock_get_system_timestamp(void)
 {
 #ifdef HT_MONOTONIC_CLOCK_IMPL_CPP11
     return static_cast<HT_TimestampNs>(std::chrono::steady_clock::now().time_since_epoch().count());
@@ -73,3 +87,166 @@ ht_monotonic_clock_get_timestamp(void)
 }
 
 #endif /* HT_MONOTONIC_CLOCK_IMPL_CUSTOM */
+
+HT_TimestampNs
+ht_monotonic_clock_get_system_timestamp(void)
+{
+    return _ht_monotonic_clock_get_system_timestamp();
+}
+
+#ifdef HT_MONOTONIC_CLOCK_TSC_SUPPORTED
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#else
+#  include <cpuid.h>
+#  include <x86intrin.h>
+__extension__ typedef unsigned __int128 _ht_uint128_t;
+#endif
+
+#define HT_TSC_CALIBRATION_PERIOD HT_DUR_MS(10)
+
+/* mult == 0 means the counter hasn't been calibrated */
+static HT_TscCalibration _ht_tsc_calibration = {0, 0, 0, 0, 0};
+
+static HT_Boolean
+_ht_monotonic_clock_has_invariant_tsc(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] < 0x80000007)
+    {
+        return HT_FALSE;
+    }
+    __cpuid(info, 0x80000007);
+    return (info[3] & (1 << 8)) ? HT_TRUE : HT_FALSE;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007 ||
+            !__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    {
+        return HT_FALSE;
+    }
+    return (edx & (1u << 8)) ? HT_TRUE : HT_FALSE;
+#endif
+}
+
+static HT_INLINE HT_TimestampNs
+_ht_monotonic_clock_tsc_ticks_to_ns(uint64_t ticks, uint32_t mult, uint32_t shift)
+{
+#ifdef _MSC_VER
+    uint64_t high;
+    uint64_t low = _umul128(ticks, mult, &high);
+    return (HT_TimestampNs)__shiftright128(low, high, (unsigned char)shift);
+#else
+    return (HT_TimestampNs)(((_ht_uint128_t)ticks * mult) >> shift);
+#endif
+}
+
+HT_Boolean
+ht_monotonic_clock_calibrate_tsc(void)
+{
+    HT_TimestampNs timestamp_start, timestamp_end;
+    uint64_t tick_start, tick_end;
+    uint64_t frequency, mult;
+    uint32_t shift = 32;
+
+    if (!_ht_monotonic_clock_has_invariant_tsc())
+    {
+        return HT_FALSE;
+    }
+
+    timestamp_start = _ht_monotonic_clock_get_system_timestamp();
+    tick_start = __rdtsc();
+    do
+    {
+        timestamp_end = _ht_monotonic_clock_get_system_timestamp();
+        tick_end = __rdtsc();
+    } while (timestamp_end - timestamp_start < HT_TSC_CALIBRATION_PERIOD);
+
+    frequency = (tick_end - tick_start) * HT_DUR_S(1) / (timestamp_end - timestamp_start);
+    if (frequency == 0)
+    {
+        return HT_FALSE;
+    }
+
+    /* use the highest precision for which the multiplier still fits in 32 bits */
+    do
+    {
+        mult = ((uint64_t)HT_DUR_S(1) << shift) / frequency;
+    } while (mult > UINT32_MAX && --shift > 0);
+
+    _ht_tsc_calibration.tick_frequency = frequency;
+    _ht_tsc_calibration.tick_base = tick_end;
+    _ht_tsc_calibration.timestamp_base = timestamp_end;
+    _ht_tsc_calibration.shift = shift;
+    _ht_tsc_calibration.mult = (uint32_t)mult;
+
+    return HT_TRUE;
+}
+
+const HT_TscCalibration*
+ht_monotonic_clock_get_tsc_calibration(void)
+{
+    return _ht_tsc_calibration.mult ? &_ht_tsc_calibration : NULL;
+}
+
+HT_TimestampNs
+ht_monotonic_clock_get_tsc_timestamp(void)
+{
+    uint64_t ticks = __rdtsc();
+
+    if (HT_UNLIKELY(_ht_tsc_calibration.mult == 0))
+    {
+        return _ht_monotonic_clock_get_system_timestamp();
+    }
+
+    if (HT_UNLIKELY(ticks < _ht_tsc_calibration.tick_base))
+    {
+        return _ht_tsc_calibration.timestamp_base;
+    }
+
+    return _ht_tsc_calibration.timestamp_base + _ht_monotonic_clock_tsc_ticks_to_ns(
+                ticks - _ht_tsc_calibration.tick_base, _ht_tsc_calibration.mult, _ht_tsc_calibration.shift);
+}
+
+#else
+
+HT_Boolean
+ht_monotonic_clock_calibrate_tsc(void)
+{
+    return HT_FALSE;
+}
+
+const HT_TscCalibration*
+ht_monotonic_clock_get_tsc_calibration(void)
+{
+    return NULL;
+}
+
+#endif /* HT_MONOTONIC_CLOCK_TSC_SUPPORTED */
+
+HT_Boolean
+ht_monotonic_clock_is_tsc_used(void)
+{
+#ifdef HT_MONOTONIC_CLOCK_IMPL_TSC
+    return ht_monotonic_clock_get_tsc_calibration() != NULL;
+#else
+    return HT_FALSE;
+#endif
+}
+
+#if defined(HT_MONOTONIC_CLOCK_IMPL_TSC)
+HT_TimestampNs
+ht_monotonic_clock_get_timestamp(void)
+{
+    return ht_monotonic_clock_get_tsc_timestamp();
+}
+#elif !defined(HT_MONOTONIC_CLOCK_IMPL_CUSTOM)
+HT_TimestampNs
+ht_monotonic_clock_get_timestamp(void)
+{
+    return _ht_monotonic_clock_get_system_timestamp();
+}
+#endif
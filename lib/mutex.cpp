@@ -29,15 +29,19 @@
 #include <assert.h>
 
 #if defined(HT_MUTEX_IMPL_CPP11)
+#  include <condition_variable>
 #  include <mutex>
 #  include <system_error>
 #  define HT_MUTEX_TYPE_ std::mutex
+#  define HT_COND_VAR_TYPE_ std::condition_variable
 #elif defined(HT_MUTEX_IMPL_POSIX)
 #  include <pthread.h>
 #  define HT_MUTEX_TYPE_ pthread_mutex_t
+#  define HT_COND_VAR_TYPE_ pthread_cond_t
 #elif defined(HT_MUTEX_IMPL_WIN32)
 #  include <windows.h>
-#  define HT_MUTEX_TYPE_ HANDLE
+#  define HT_MUTEX_TYPE_ CRITICAL_SECTION
+#  define HT_COND_VAR_TYPE_ CONDITION_VARIABLE
 #endif
 
 struct _HT_Mutex
@@ -45,6 +49,11 @@ struct _HT_Mutex
     HT_MUTEX_TYPE_ mtx;
 };
 
+struct _HT_CondVar
+{
+    HT_COND_VAR_TYPE_ cv;
+};
+
 HT_Mutex*
 ht_mutex_create(void)
 {
@@ -60,7 +69,7 @@ ht_mutex_create(void)
 #elif defined(HT_MUTEX_IMPL_POSIX)
     pthread_mutex_init(&mtx->mtx, NULL);
 #elif defined(HT_MUTEX_IMPL_WIN32)
-    mtx->mtx = CreateMutex(0, FALSE, 0);
+    InitializeCriticalSection(&mtx->mtx);
 #endif
 
     return mtx;
@@ -78,7 +87,7 @@ ht_mutex_destroy(HT_Mutex* mtx)
 #elif defined(HT_MUTEX_IMPL_POSIX)
     err = pthread_mutex_destroy(&mtx->mtx) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
 #elif defined(HT_MUTEX_IMPL_WIN32)
-    err = CloseHandle(mtx->mtx) != 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+    DeleteCriticalSection(&mtx->mtx);
 #endif
 
     ht_free(mtx);
@@ -104,7 +113,8 @@ ht_mutex_lock(HT_Mutex* mtx)
 #elif defined(HT_MUTEX_IMPL_POSIX)
     return pthread_mutex_lock(&mtx->mtx) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
 #elif defined(HT_MUTEX_IMPL_WIN32)
-    return WaitForSingleObject(mtx->mtx, INFINITE) == WAIT_OBJECT_0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+    EnterCriticalSection(&mtx->mtx);
+    return HT_ERR_OK;
 #endif
 }
 
@@ -119,7 +129,83 @@ ht_mutex_unlock(HT_Mutex* mtx)
 #elif defined(HT_MUTEX_IMPL_POSIX)
     return pthread_mutex_unlock(&mtx->mtx) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
 #elif defined(HT_MUTEX_IMPL_WIN32)
-    return ReleaseMutex(mtx->mtx) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+    LeaveCriticalSection(&mtx->mtx);
+    return HT_ERR_OK;
+#endif
+}
+
+HT_CondVar*
+ht_cond_var_create(void)
+{
+    HT_CondVar* cond_var = HT_CREATE_TYPE(HT_CondVar);
+
+    if (cond_var == NULL)
+    {
+        return NULL;
+    }
+
+#ifdef HT_MUTEX_IMPL_CPP11
+    new (&cond_var->cv) std::condition_variable();
+#elif defined(HT_MUTEX_IMPL_POSIX)
+    pthread_cond_init(&cond_var->cv, NULL);
+#elif defined(HT_MUTEX_IMPL_WIN32)
+    InitializeConditionVariable(&cond_var->cv);
+#endif
+
+    return cond_var;
+}
+
+HT_ErrorCode
+ht_cond_var_destroy(HT_CondVar* cond_var)
+{
+    HT_ErrorCode err = HT_ERR_OK;
+
+    assert(cond_var);
+
+#ifdef HT_MUTEX_IMPL_CPP11
+    cond_var->cv.~condition_variable();
+#elif defined(HT_MUTEX_IMPL_POSIX)
+    err = pthread_cond_destroy(&cond_var->cv) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+#elif defined(HT_MUTEX_IMPL_WIN32)
+    /* CONDITION_VARIABLE doesn't own any resources */
+#endif
+
+    ht_free(cond_var);
+
+    return err;
+}
+
+HT_ErrorCode
+ht_cond_var_wait(HT_CondVar* cond_var, HT_Mutex* mtx)
+{
+    assert(cond_var);
+    assert(mtx);
+
+#ifdef HT_MUTEX_IMPL_CPP11
+    std::unique_lock<std::mutex> lock(mtx->mtx, std::adopt_lock);
+    cond_var->cv.wait(lock);
+    lock.release();
+    return HT_ERR_OK;
+#elif defined(HT_MUTEX_IMPL_POSIX)
+    return pthread_cond_wait(&cond_var->cv, &mtx->mtx) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+#elif defined(HT_MUTEX_IMPL_WIN32)
+    return SleepConditionVariableCS(&cond_var->cv, &mtx->mtx, INFINITE) != 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+#endif
+}
+
+HT_ErrorCode
+ht_cond_var_notify_all(HT_CondVar* cond_var)
+{
+    assert(cond_var);
+
+#ifdef HT_MUTEX_IMPL_CPP11
+    cond_var->cv.notify_all();
+    return HT_ERR_OK;
+#elif defined(HT_MUTEX_IMPL_POSIX)
+    return pthread_cond_broadcast(&cond_var->cv) == 0 ? HT_ERR_OK : HT_ERR_UNKNOWN;
+#elif defined(HT_MUTEX_IMPL_WIN32)
+    WakeAllConditionVariable(&cond_var->cv);
+    return HT_ERR_OK;
 #endif
 }
 
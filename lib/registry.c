@@ -16,11 +16,34 @@ static HT_BagVoidPtr listeners_register;
 static HT_Boolean feature_register[HT_TIMELINE_MAX_FEATURES] = {HT_FALSE};
 
 static HT_Mutex* listeners_register_mutex;
+/* Live timelines (see ht_registry_for_each_timeline()); NULL if the registry
+ * is not initialized, so timelines destroyed after ht_deinit() are ignored. */
+static HT_BagVoidPtr timelines_register;
+static HT_Mutex* timelines_register_mutex = NULL;
+/* Timelines used by ht_registry_for_each_timeline_unlocked() callbacks (a timeline
+ * is added once for every callback); they can't be unregistered until the callbacks return. */
+static HT_BagVoidPtr pinned_timelines;
+static HT_CondVar* pinned_timelines_cond_var;
 static HT_Mutex* features_register_mutex;
 static HT_Mutex* event_klass_registry_register_mutex;
 
 static size_t feature_count = 0;
 
+/* Klass info events serialized for the listeners, one blob per serialization
+ * mode. The registry only grows, so the blob covers the first klass_count
+ * klasses and only klasses registered since the last push are appended;
+ * a new listener gets all the metadata in a single callback.
+ * Protected by event_klass_registry_register_mutex. */
+typedef struct
+{
+    HT_Byte* data;
+    size_t size;
+    size_t capacity;
+    size_t klass_count;
+} HT_RegistryMetadataCache;
+
+static HT_RegistryMetadataCache metadata_cache[2];
+
 #define HT_CREATE_MUTEX_(mutex_var, error_code_var, label_if_fails) \
     do { \
         mutex_var = ht_mutex_create(); \
@@ -79,17 +102,45 @@ ht_registry_init(void)
         goto error_listeners_register;
     }
 
+    error_code = ht_bag_void_ptr_init(&timelines_register, 8);
+    if (error_code != HT_ERR_OK)
+    {
+        goto error_timelines_register;
+    }
+
+    error_code = ht_bag_void_ptr_init(&pinned_timelines, 8);
+    if (error_code != HT_ERR_OK)
+    {
+        goto error_pinned_timelines;
+    }
+
+    pinned_timelines_cond_var = ht_cond_var_create();
+    if (!pinned_timelines_cond_var)
+    {
+        error_code = HT_ERR_OUT_OF_MEMORY;
+        goto error_pinned_timelines_cond_var;
+    }
+
     HT_CREATE_MUTEX_(listeners_register_mutex, error_code, error_listeners_mutex);
     HT_CREATE_MUTEX_(features_register_mutex, error_code, error_features_mutex);
     HT_CREATE_MUTEX_(event_klass_registry_register_mutex, error_code, error_event_klass_registry_mutex);
+    HT_CREATE_MUTEX_(timelines_register_mutex, error_code, error_timelines_mutex);
 
     goto done;
 
+error_timelines_mutex:
+    ht_mutex_destroy(event_klass_registry_register_mutex);
 error_event_klass_registry_mutex:
     ht_mutex_destroy(features_register_mutex);
 error_features_mutex:
     ht_mutex_destroy(listeners_register_mutex);
 error_listeners_mutex:
+    ht_cond_var_destroy(pinned_timelines_cond_var);
+error_pinned_timelines_cond_var:
+    ht_bag_void_ptr_deinit(&pinned_timelines);
+error_pinned_timelines:
+    ht_bag_void_ptr_deinit(&timelines_register);
+error_timelines_register:
     ht_bag_void_ptr_deinit(&listeners_register);
 error_listeners_register:
     ht_bag_void_ptr_deinit(&event_klass_register);
@@ -133,13 +184,161 @@ ht_registry_deinit(void)
         ht_timeline_listener_container_unref((HT_TimelineListenerContainer*)listeners_register.data[i]);
     }
 
+    for (i = 0; i < sizeof(metadata_cache) / sizeof(metadata_cache[0]); i++)
+    {
+        ht_free(metadata_cache[i].data);
+        memset(&metadata_cache[i], 0, sizeof(metadata_cache[i]));
+    }
+
     ht_mutex_destroy(features_register_mutex);
     ht_mutex_destroy(event_klass_registry_register_mutex);
     ht_mutex_destroy(listeners_register_mutex);
+    ht_mutex_destroy(timelines_register_mutex);
+    timelines_register_mutex = NULL;
+    ht_cond_var_destroy(pinned_timelines_cond_var);
     ht_bag_void_ptr_deinit(&listeners_register);
+    ht_bag_void_ptr_deinit(&timelines_register);
+    ht_bag_void_ptr_deinit(&pinned_timelines);
     ht_bag_void_ptr_deinit(&event_klass_register);
 }
 
+/* Returns the index of the @a timeline in the @a bag, or (size_t)-1 if it's not there. */
+static size_t
+_ht_registry_find_timeline(HT_BagVoidPtr* bag, HT_Timeline* timeline)
+{
+    size_t i;
+
+    for (i = 0; i < bag->size; i++)
+    {
+        if (bag->data[i] == timeline)
+        {
+            return i;
+        }
+    }
+
+    return (size_t)-1;
+}
+
+HT_ErrorCode
+ht_registry_register_timeline(HT_Timeline* timeline)
+{
+    HT_ErrorCode error_code;
+
+    if (timelines_register_mutex == NULL)
+    {
+        return HT_ERR_OK;
+    }
+
+    ht_mutex_lock(timelines_register_mutex);
+    error_code = ht_bag_void_ptr_add(&timelines_register, timeline);
+    ht_mutex_unlock(timelines_register_mutex);
+
+    return error_code;
+}
+
+void
+ht_registry_unregister_timeline(HT_Timeline* timeline)
+{
+    size_t i;
+
+    if (timelines_register_mutex == NULL)
+    {
+        return;
+    }
+
+    ht_mutex_lock(timelines_register_mutex);
+    for (i = 0; i < timelines_register.size; i++)
+    {
+        if (timelines_register.data[i] == timeline)
+        {
+            ht_bag_void_ptr_remove_nth(&timelines_register, i);
+            break;
+        }
+    }
+    /* the timeline is about to be destroyed */
+    while (_ht_registry_find_timeline(&pinned_timelines, timeline) != (size_t)-1)
+    {
+        ht_cond_var_wait(pinned_timelines_cond_var, timelines_register_mutex);
+    }
+    ht_mutex_unlock(timelines_register_mutex);
+}
+
+void
+ht_registry_for_each_timeline(HT_RegistryTimelineCallback callback, void* user_data)
+{
+    size_t i;
+
+    if (timelines_register_mutex == NULL)
+    {
+        return;
+    }
+
+    ht_mutex_lock(timelines_register_mutex);
+    for (i = 0; i < timelines_register.size; i++)
+    {
+        callback((HT_Timeline*)timelines_register.data[i], user_data);
+    }
+    ht_mutex_unlock(timelines_register_mutex);
+}
+
+HT_ErrorCode
+ht_registry_for_each_timeline_unlocked(HT_RegistryTimelineCallback callback, void* user_data)
+{
+    HT_BagVoidPtr timelines;
+    HT_ErrorCode error_code;
+    size_t i;
+
+    if (timelines_register_mutex == NULL)
+    {
+        return HT_ERR_OK;
+    }
+
+    error_code = ht_bag_void_ptr_init(&timelines, 8);
+    if (error_code != HT_ERR_OK)
+    {
+        return error_code;
+    }
+
+    ht_mutex_lock(timelines_register_mutex);
+    for (i = 0; i < timelines_register.size && error_code == HT_ERR_OK; i++)
+    {
+        error_code = ht_bag_void_ptr_add(&timelines, timelines_register.data[i]);
+    }
+    ht_mutex_unlock(timelines_register_mutex);
+
+    for (i = 0; i < timelines.size && error_code == HT_ERR_OK; i++)
+    {
+        HT_Timeline* timeline = (HT_Timeline*)timelines.data[i];
+
+        /* the timeline might have been destroyed since the list was copied. If another
+         * timeline has been created at the same address, it's used instead, which is fine. */
+        ht_mutex_lock(timelines_register_mutex);
+        if (_ht_registry_find_timeline(&timelines_register, timeline) == (size_t)-1)
+        {
+            ht_mutex_unlock(timelines_register_mutex);
+            continue;
+        }
+        error_code = ht_bag_void_ptr_add(&pinned_timelines, timeline);
+        ht_mutex_unlock(timelines_register_mutex);
+
+        if (error_code != HT_ERR_OK)
+        {
+            break;
+        }
+
+        callback(timeline, user_data);
+
+        ht_mutex_lock(timelines_register_mutex);
+        ht_bag_void_ptr_remove_nth(&pinned_timelines, _ht_registry_find_timeline(&pinned_timelines, timeline));
+        ht_cond_var_notify_all(pinned_timelines_cond_var);
+        ht_mutex_unlock(timelines_register_mutex);
+    }
+
+    ht_bag_void_ptr_deinit(&timelines);
+
+    return error_code;
+}
+
 HT_TimelineListenerContainer*
 ht_registry_find_listener_container(const char* name)
 {
@@ -187,8 +386,6 @@ ht_registry_register_listener_container(const char* name, HT_TimelineListenerCon
     return HT_ERR_OK;
 }
 
-#define REGISTRY_LISETNER_BUFF_SIZE 4096
-
 static void
 _ht_registry_init_event_klass_info_event(HT_EventKlass* klass, HT_EventKlassInfoEvent* event)
 {
@@ -222,75 +419,115 @@ _ht_registry_init_event_klass_field_info_event(HT_EventKlass* klass, size_t fiel
     event->size = info->size;
 }
 
-static size_t
-_ht_registry_push_class_to_listener(HT_EventKlass* klass, HT_Byte* data, size_t* data_pos, HT_TimelineListenerCallback callback, void* listener, HT_Boolean serialize)
+static HT_Boolean
+_ht_registry_metadata_cache_reserve(HT_RegistryMetadataCache* cache, size_t size)
+{
+    size_t new_capacity = cache->capacity ? cache->capacity : 4096;
+    HT_Byte* new_data;
+
+    if (cache->size + size <= cache->capacity)
+    {
+        return HT_TRUE;
+    }
+
+    while (new_capacity < cache->size + size)
+    {
+        new_capacity *= 2;
+    }
+
+    new_data = (HT_Byte*)ht_realloc(cache->data, new_capacity);
+    if (new_data == NULL)
+    {
+        return HT_FALSE;
+    }
+
+    cache->data = new_data;
+    cache->capacity = new_capacity;
+
+    return HT_TRUE;
+}
+
+static HT_Boolean
+_ht_registry_metadata_cache_append_event(HT_RegistryMetadataCache* cache, HT_Event* event, HT_Boolean serialize)
+{
+    if (!_ht_registry_metadata_cache_reserve(cache, ht_event_utils_get_event_size(event, serialize)))
+    {
+        return HT_FALSE;
+    }
+
+    cache->size += ht_event_utils_serialize_event_to_buffer(event, cache->data + cache->size, serialize);
+
+    return HT_TRUE;
+}
+
+static HT_Boolean
+_ht_registry_metadata_cache_append_klass(HT_RegistryMetadataCache* cache, HT_EventKlass* klass, HT_Boolean serialize)
 {
     size_t j;
-    size_t total_size = 0;
+    size_t size = cache->size;
     HT_DECL_EVENT(HT_EventKlassInfoEvent, event);
     _ht_registry_init_event_klass_info_event(klass, &event);
 
-    if (ht_HT_EventKlassInfoEvent_get_size(HT_EVENT(&event)) > REGISTRY_LISETNER_BUFF_SIZE - *data_pos)
+    if (!_ht_registry_metadata_cache_append_event(cache, HT_EVENT(&event), serialize))
     {
-        callback(data, *data_pos, serialize, listener);
-        total_size += *data_pos;
-        *data_pos = 0;
+        goto error;
     }
 
-    *data_pos += ht_event_utils_serialize_event_to_buffer(HT_EVENT(&event), data + *data_pos, serialize);
-
     for (j = 0; j < klass->type_info->fields_count; j++)
     {
         HT_DECL_EVENT(HT_EventKlassFieldInfoEvent, field_event);
         _ht_registry_init_event_klass_field_info_event(klass, j, &field_event);
 
-        if (ht_HT_EventKlassFieldInfoEvent_get_size(HT_EVENT(&field_event)) > REGISTRY_LISETNER_BUFF_SIZE - *data_pos)
+        if (!_ht_registry_metadata_cache_append_event(cache, HT_EVENT(&field_event), serialize))
         {
-            callback(data, *data_pos, serialize, listener);
-            total_size += *data_pos;
-            *data_pos = 0;
+            goto error;
         }
-
-        *data_pos += ht_event_utils_serialize_event_to_buffer(HT_EVENT(&field_event), data + *data_pos, serialize);
     }
 
-    return total_size;
+    return HT_TRUE;
+
+error:
+    /* don't leave a part of the klass in the blob */
+    cache->size = size;
+    return HT_FALSE;
 }
 
 size_t
 ht_registry_push_registry_klasses_to_listener(HT_TimelineListenerCallback callback, void* listener, HT_Boolean serialize)
 {
-    size_t i;
-    size_t total_size = 0;
-
-    HT_Byte data[REGISTRY_LISETNER_BUFF_SIZE];
-    size_t data_pos = 0;
+    HT_RegistryMetadataCache* cache = &metadata_cache[serialize ? 1 : 0];
+    size_t total_size;
 
     ht_mutex_lock(event_klass_registry_register_mutex);
 
-    for (i = 0; i < event_klass_register.size; i++)
+    while (cache->klass_count < event_klass_register.size
+           && _ht_registry_metadata_cache_append_klass(
+               cache, (HT_EventKlass*)event_klass_register.data[cache->klass_count], serialize))
     {
-        total_size += _ht_registry_push_class_to_listener((HT_EventKlass*)event_klass_register.data[i], data, &data_pos, callback, listener, serialize);
+        cache->klass_count++;
     }
 
-    ht_mutex_unlock(event_klass_registry_register_mutex);
-
-    if (data_pos > 0)
+    /* if we ran out of memory, klasses which are not in the blob yet are
+     * appended on the next push; the listener gets what we have */
+    total_size = cache->size;
+    if (total_size > 0)
     {
-        callback(data, data_pos, serialize, listener);
-        total_size += data_pos;
+        callback(cache->data, total_size, serialize, listener);
     }
 
+    ht_mutex_unlock(event_klass_registry_register_mutex);
+
     return total_size;
 }
 
-
 #include "hawktracer/feature_cached_string.h"
 #include "hawktracer/feature_callstack.h"
+#include "hawktracer/feature_callstack_aggregation.h"
 
 void
 ht_feature_register_core_features(void)
 {
     HT_FeatureCachedString_register(); // TODO error handling
     HT_FeatureCallstack_register(); // TODO error handling
+    HT_FeatureCallstackAggregation_register(); // TODO error handling
 }
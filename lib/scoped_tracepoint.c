@@ -4,7 +4,11 @@
 
 void _ht_callstack_timeline_scoped_cleanup(HT_Timeline** timeline)
 {
-    ht_feature_callstack_stop(*timeline);
+    /* NULL if the tracepoint hasn't been sampled */
+    if (*timeline)
+    {
+        ht_feature_callstack_stop(*timeline);
+    }
 }
 
 HT_Timeline* _ht_callstack_timeline_int_start_and_ret(HT_Timeline* t, HT_CallstackEventLabel l)
@@ -19,4 +23,37 @@ HT_Timeline* _ht_callstack_timeline_string_start_and_ret(HT_Timeline* t, const c
     return t;
 }
 
+static HT_Boolean
+_ht_callstack_timeline_sample(uint32_t* counter, uint32_t rate)
+{
+    HT_Boolean sampled = *counter == 0;
+
+    if (++*counter >= rate)
+    {
+        *counter = 0;
+    }
+
+    return sampled;
+}
+
+HT_Timeline* _ht_callstack_timeline_int_sampled_start_and_ret(HT_Timeline* t, uint32_t* counter, uint32_t rate, HT_CallstackEventLabel l)
+{
+    if (!_ht_callstack_timeline_sample(counter, rate))
+    {
+        return NULL;
+    }
+    ht_feature_callstack_start_int_weighted(t, l, rate);
+    return t;
+}
+
+HT_Timeline* _ht_callstack_timeline_string_sampled_start_and_ret(HT_Timeline* t, uint32_t* counter, uint32_t rate, const char* l)
+{
+    if (!_ht_callstack_timeline_sample(counter, rate))
+    {
+        return NULL;
+    }
+    ht_feature_callstack_start_string_weighted(t, l, rate);
+    return t;
+}
+
 #endif /* __GNUC__ */
@@ -1,6 +1,7 @@
 #include "hawktracer/system_info.h"
 #include "internal/event_utils.h"
 #include "internal/system_info.h"
+#include "internal/monotonic_clock.h"
 
 HT_Endianness
 ht_system_info_get_endianness(void)
@@ -44,3 +45,31 @@ ht_system_info_push_endianness_info_to_listener(HT_TimelineListenerCallback call
 
     return data_size;
 }
+
+size_t
+ht_system_info_push_clock_calibration_to_listener(HT_TimelineListenerCallback callback, void* listener, HT_Boolean serialize)
+{
+    size_t data_size;
+    const HT_TscCalibration* calibration = ht_monotonic_clock_get_tsc_calibration();
+    HT_DECL_EVENT(HT_ClockCalibrationEvent, event);
+
+    if (!ht_monotonic_clock_is_tsc_used())
+    {
+        return 0;
+    }
+
+    event.base.id = event.base.timestamp = 0;
+    event.tick_frequency = calibration->tick_frequency;
+    event.tick_base = calibration->tick_base;
+    event.timestamp_base = calibration->timestamp_base;
+    event.mult = calibration->mult;
+    event.shift = (uint8_t) calibration->shift;
+
+    HT_Byte buffer[64];
+
+    data_size = ht_event_utils_serialize_event_to_buffer(HT_EVENT(&event), buffer, serialize);
+
+    callback(buffer, data_size, serialize, listener);
+
+    return data_size;
+}
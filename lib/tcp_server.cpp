@@ -1,144 +1,1014 @@
 #include "internal/listeners/tcp_server.h"
 #include "internal/bag.h"
 #include "internal/mutex.h"
+#include "internal/thread.h"
 #include "hawktracer/alloc.h"
 #include "hawktracer/ht_config.h"
+#include "hawktracer/monotonic_clock.h"
 
-#if defined(HT_THREAD_IMPL_CPP11) || defined(HT_THREAD_IMPL_WIN32) || defined(HT_THREAD_IMPL_POSIX)
-#  define HT_THREAD_FORCE_SELECTED
+#if defined(HT_TCP_SERVER_IMPL_EPOLL) || defined(HT_TCP_SERVER_IMPL_BLOCKING)
+#  define HT_TCP_SERVER_FORCE_SELECTED
 #endif
 
-#if !defined(HT_THREAD_FORCE_SELECTED) && defined(HT_CPP11)
-#  include <thread>
-#  define HT_THREAD_IMPL_CPP11
-#elif !defined(HT_THREAD_FORCE_SELECTED) && defined(_WIN32)
-#  include <windows.h>
-#  define HT_THREAD_IMPL_WIN32
-#elif !defined(HT_THREAD_FORCE_SELECTED) && defined(HT_HAVE_UNISTD_H)
-#  include <unistd.h>
-#  ifdef _POSIX_VERSION
-#    include <pthread.h>
-#    define HT_THREAD_IMPL_POSIX
-#  endif
+#if !defined(HT_TCP_SERVER_FORCE_SELECTED) && defined(__linux__)
+#  define HT_TCP_SERVER_IMPL_EPOLL
+#elif !defined(HT_TCP_SERVER_FORCE_SELECTED)
+#  define HT_TCP_SERVER_IMPL_BLOCKING
 #endif
 
-#ifdef HT_THREAD_IMPL_CPP11
-#  include <thread>
-#elif defined(HT_THREAD_IMPL_WIN32)
-#  include <windows.h>
-#elif defined(HT_THREAD_IMPL_POSIX)
-#  include <pthread.h>
+#ifdef _WIN32
+#include <WinSock2.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
-#ifdef HT_THREAD_IMPL_WIN32
-typedef DWORD(*ht_thread_callback_t)(void*);
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <string.h>
+
+/* how long the server tries to send queued data to clients when it's being stopped */
+#define HT_TCP_SERVER_STOP_TIMEOUT_NS 1000000000ull
+
+static void *_ht_tcp_server_run(void *user_data);
+
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+
+/* Data shared by queues of all the clients. */
+typedef struct
+{
+    size_t ref_count;
+    size_t size;
+    HT_Byte* data;
+} HT_TCPServerChunk;
+
+typedef struct _HT_TCPServerQueueItem
+{
+    struct _HT_TCPServerQueueItem* next;
+    HT_TCPServerChunk* chunk;
+    /* the last chunk of the message */
+    HT_Boolean message_end;
+    HT_Boolean droppable;
+} HT_TCPServerQueueItem;
+
+typedef struct _HT_TCPServerClient
+{
+    struct _HT_TCPServerClient* next;
+    int sock_fd;
+    HT_TCPServerQueueItem* head;
+    HT_TCPServerQueueItem* tail;
+    /* number of bytes of the head chunk which have already been sent */
+    size_t head_sent;
+    /* number of bytes in the queue which haven't been sent yet */
+    size_t queue_size;
+    /* part of the message at the head of the queue has already been sent,
+     * so the message can't be dropped */
+    HT_Boolean sending_message;
+    /* the current message is (partially) queued or sent to the client */
+    HT_Boolean message_started;
+    /* the rest of the current message should not be sent to the client */
+    HT_Boolean skip_message;
+    /* the client receives data from ht_tcp_server_write() */
+    HT_Boolean ready;
+    /* the connection is broken or the client is too slow; the client is only closed
+     * and freed by the event loop thread, so other threads don't use freed memory */
+    HT_Boolean closing;
+    /* number of writers waiting for the client to receive queued data (BLOCK policy);
+     * the client is not freed until they are done */
+    unsigned int waiting_writers;
+    HT_Boolean waiting_for_output;
+    /* identifier of the last ht_tcp_server_write() call which handled the client */
+    unsigned int write_id;
+    /* incomplete line received from the client */
+    char message[HT_TCP_SERVER_MAX_CLIENT_MESSAGE_SIZE];
+    size_t message_size;
+    /* the current line is too long, so it's discarded */
+    HT_Boolean message_overflow;
+} HT_TCPServerClient;
+
+#endif /* HT_TCP_SERVER_IMPL_EPOLL */
+
+struct _HT_TCPServer
+{
+    HT_Thread* accept_client_thread;
+    HT_Mutex* client_mutex;
+    int server_sock_fd;
+    /* path of the socket file, if the server listens on a Unix domain socket */
+    char* unix_socket_path;
+
+     OnClientConnected client_connected_cb;
+     void* client_connected_ud;
+     OnClientMessage client_message_cb;
+     void* client_message_ud;
+
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+    HT_Thread* event_loop_thread;
+    HT_CondVar* queue_cond_var;
+    HT_TCPServerClient* clients;
+    int epoll_fd;
+    int wakeup_fd;
+    size_t max_queue_size;
+    HT_TCPListenerSlowClientPolicy policy;
+    size_t dropped_size;
+    unsigned int write_id;
+    HT_Boolean in_message;
+    HT_Boolean stopping;
 #else
-typedef void*(*ht_thread_callback_t)(void*);
+    HT_BagInt client_sock_fd;
 #endif
+};
+
+HT_TCPServer*
+ht_tcp_server_create(void)
+{
+    HT_TCPServer* server = HT_CREATE_TYPE(HT_TCPServer);
+
+    server->accept_client_thread = NULL;
+    server->client_mutex = ht_mutex_create();
+    server->server_sock_fd = -1;
+    server->unix_socket_path = NULL;
+    server->client_connected_cb = NULL;
+    server->client_connected_ud = NULL;
+    server->client_message_cb = NULL;
+    server->client_message_ud = NULL;
+
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+    server->event_loop_thread = NULL;
+    server->queue_cond_var = ht_cond_var_create();
+    server->clients = NULL;
+    server->epoll_fd = -1;
+    server->wakeup_fd = -1;
+    server->max_queue_size = HT_TCP_LISTENER_DEFAULT_CLIENT_QUEUE_SIZE;
+    server->policy = HT_TCP_LISTENER_SLOW_CLIENT_DROP_OLDEST;
+    server->dropped_size = 0;
+    server->write_id = 0;
+    server->in_message = HT_FALSE;
+    server->stopping = HT_FALSE;
+#else
+    ht_bag_int_init(&server->client_sock_fd, 8);
+#endif
+
+    return server;
+}
+
+void
+ht_tcp_server_destroy(HT_TCPServer* server)
+{
+    ht_tcp_server_stop(server);
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+    ht_cond_var_destroy(server->queue_cond_var);
+#else
+    ht_bag_int_deinit(&server->client_sock_fd);
+#endif
+    ht_mutex_destroy(server->client_mutex);
+    ht_free(server);
+}
+
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+
+static void* _ht_tcp_server_run_event_loop(void* user_data);
+
+static HT_Boolean
+_ht_tcp_server_start_event_loop(HT_TCPServer* server)
+{
+    struct epoll_event event;
+
+    server->stopping = HT_FALSE;
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epoll_fd < 0 || server->wakeup_fd < 0)
+    {
+        return HT_FALSE;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wakeup_fd, &event) != 0)
+    {
+        return HT_FALSE;
+    }
+
+    server->event_loop_thread = ht_thread_create(_ht_tcp_server_run_event_loop, server);
+
+    return server->event_loop_thread != NULL;
+}
+
+static void
+_ht_tcp_server_release_chunk(HT_TCPServerChunk* chunk)
+{
+    if (--chunk->ref_count == 0)
+    {
+        ht_free(chunk);
+    }
+}
+
+static void
+_ht_tcp_server_client_pop(HT_TCPServerClient* client)
+{
+    HT_TCPServerQueueItem* item = client->head;
+
+    client->head = item->next;
+    if (client->head == NULL)
+    {
+        client->tail = NULL;
+    }
+    client->head_sent = 0;
+
+    _ht_tcp_server_release_chunk(item->chunk);
+    ht_free(item);
+}
+
+static void
+_ht_tcp_server_wake_up_event_loop(HT_TCPServer* server)
+{
+    uint64_t value = 1;
+
+    if (write(server->wakeup_fd, &value, sizeof(value)) < 0)
+    {
+        /* the thread will wake up after the epoll_wait() timeout anyway */
+    }
+}
+
+/* Can be called from any thread; the client is closed by the event loop thread. */
+static void
+_ht_tcp_server_mark_client_closing(HT_TCPServer* server, HT_TCPServerClient* client)
+{
+    if (!client->closing)
+    {
+        client->closing = HT_TRUE;
+        /* stop reporting events of the broken connection */
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->sock_fd, NULL);
+        ht_cond_var_notify_all(server->queue_cond_var);
+        _ht_tcp_server_wake_up_event_loop(server);
+    }
+}
+
+/* Must only be called from the event loop thread. */
+static void
+_ht_tcp_server_close_client(HT_TCPServer* server, HT_TCPServerClient* client)
+{
+    HT_TCPServerClient** link = &server->clients;
+
+    while (*link != client)
+    {
+        link = &(*link)->next;
+    }
+    *link = client->next;
+
+    close(client->sock_fd);
+
+    while (client->head != NULL)
+    {
+        _ht_tcp_server_client_pop(client);
+    }
+    ht_free(client);
+
+    ht_cond_var_notify_all(server->queue_cond_var);
+}
+
+static void
+_ht_tcp_server_watch_output(HT_TCPServer* server, HT_TCPServerClient* client, HT_Boolean watch)
+{
+    struct epoll_event event;
+
+    if (client->waiting_for_output == watch)
+    {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = watch ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = client;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->sock_fd, &event);
+    client->waiting_for_output = watch;
+}
+
+/* Returns number of bytes sent, or -1 if the connection is broken. */
+static ssize_t
+_ht_tcp_server_send(int sock_fd, const HT_Byte* data, size_t size)
+{
+    ssize_t sent = send(sock_fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (sent < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    return sent;
+}
+
+/* Sends as much queued data as possible. Returns HT_FALSE if the connection is broken. */
+static HT_Boolean
+_ht_tcp_server_client_send_queue(HT_TCPServer* server, HT_TCPServerClient* client)
+{
+    while (client->head != NULL)
+    {
+        HT_TCPServerQueueItem* item = client->head;
+        ssize_t sent = _ht_tcp_server_send(client->sock_fd,
+                                           item->chunk->data + client->head_sent,
+                                           item->chunk->size - client->head_sent);
+        if (sent < 0)
+        {
+            return HT_FALSE;
+        }
+        if (sent == 0)
+        {
+            break;
+        }
+
+        client->sending_message = HT_TRUE;
+        client->head_sent += (size_t)sent;
+        client->queue_size -= (size_t)sent;
+
+        if (client->head_sent == item->chunk->size)
+        {
+            if (item->message_end)
+            {
+                client->sending_message = HT_FALSE;
+            }
+            _ht_tcp_server_client_pop(client);
+        }
+    }
+
+    _ht_tcp_server_watch_output(server, client, client->head != NULL);
+    ht_cond_var_notify_all(server->queue_cond_var);
+
+    return HT_TRUE;
+}
+
+static void
+_ht_tcp_server_client_update_tail(HT_TCPServerClient* client)
+{
+    client->tail = client->head;
+    while (client->tail != NULL && client->tail->next != NULL)
+    {
+        client->tail = client->tail->next;
+    }
+}
+
+/* Drops the oldest messages until @a size bytes fit into the queue. The message
+ * which is being sent and the data which must not be dropped are kept. If the current
+ * (incomplete) message is dropped, the rest of it is skipped as well. */
+static void
+_ht_tcp_server_client_drop_oldest(HT_TCPServer* server, HT_TCPServerClient* client, size_t size)
+{
+    HT_TCPServerQueueItem** link = &client->head;
+
+    if (client->sending_message)
+    {
+        while (*link != NULL && !(*link)->message_end)
+        {
+            link = &(*link)->next;
+        }
+        if (*link != NULL)
+        {
+            link = &(*link)->next;
+        }
+    }
+
+    while (*link != NULL && client->queue_size + size > server->max_queue_size)
+    {
+        HT_TCPServerQueueItem* item = *link;
+        HT_Boolean message_end;
+
+        if (!item->droppable)
+        {
+            link = &item->next;
+            continue;
+        }
+
+        do
+        {
+            item = *link;
+            message_end = item->message_end;
+            *link = item->next;
+            client->queue_size -= item->chunk->size;
+            server->dropped_size += item->chunk->size;
+            _ht_tcp_server_release_chunk(item->chunk);
+            ht_free(item);
+        } while (!message_end && *link != NULL);
+
+        if (!message_end)
+        {
+            client->skip_message = HT_TRUE;
+        }
+    }
+
+    _ht_tcp_server_client_update_tail(client);
+}
+
+static HT_Boolean
+_ht_tcp_server_client_enqueue(HT_TCPServerClient* client, HT_TCPServerChunk** chunk,
+                              const HT_Byte* data, size_t size, size_t sent,
+                              HT_Boolean droppable)
+{
+    HT_TCPServerQueueItem* item = HT_CREATE_TYPE(HT_TCPServerQueueItem);
+
+    if (item == NULL)
+    {
+        return HT_FALSE;
+    }
+
+    if (*chunk == NULL)
+    {
+        *chunk = (HT_TCPServerChunk*)ht_alloc(sizeof(HT_TCPServerChunk) + size);
+        if (*chunk == NULL)
+        {
+            ht_free(item);
+            return HT_FALSE;
+        }
+        (*chunk)->ref_count = 0;
+        (*chunk)->size = size;
+        (*chunk)->data = (HT_Byte*)(*chunk + 1);
+        memcpy((*chunk)->data, data, size);
+    }
+
+    (*chunk)->ref_count++;
+    item->chunk = *chunk;
+    item->next = NULL;
+    item->message_end = !droppable;
+    item->droppable = droppable;
+
+    if (client->tail != NULL)
+    {
+        client->tail->next = item;
+    }
+    else
+    {
+        client->head = item;
+        client->head_sent = sent;
+    }
+    client->tail = item;
+    client->queue_size += size - sent;
+
+    return HT_TRUE;
+}
+
+/* Sends data to the client, or queues it if the client can't receive it immediately.
+ * Returns HT_FALSE if the client should be disconnected. */
+static HT_Boolean
+_ht_tcp_server_client_write(HT_TCPServer* server, HT_TCPServerClient* client,
+                            HT_TCPServerChunk** chunk, const HT_Byte* data, size_t size,
+                            HT_Boolean droppable)
+{
+    ssize_t sent = 0;
+
+    if (droppable && client->queue_size + size > server->max_queue_size)
+    {
+        switch (server->policy)
+        {
+        case HT_TCP_LISTENER_SLOW_CLIENT_DISCONNECT:
+            server->dropped_size += client->queue_size;
+            return HT_FALSE;
+        case HT_TCP_LISTENER_SLOW_CLIENT_BLOCK:
+            /* the client can't be freed while the writer is waiting for it */
+            client->waiting_writers++;
+            while (client->head != NULL && client->queue_size + size > server->max_queue_size
+                   && !server->stopping && !client->closing)
+            {
+                ht_cond_var_wait(server->queue_cond_var, server->client_mutex);
+            }
+            if (--client->waiting_writers == 0 && client->closing)
+            {
+                _ht_tcp_server_wake_up_event_loop(server);
+            }
+            /* the client might have been disconnected while waiting */
+            if (client->closing)
+            {
+                return HT_TRUE;
+            }
+            break;
+        default:
+            _ht_tcp_server_client_drop_oldest(server, client, size);
+            if (client->skip_message
+                    || (!client->message_started && client->queue_size + size > server->max_queue_size))
+            {
+                client->skip_message = HT_TRUE;
+                server->dropped_size += size;
+                return HT_TRUE;
+            }
+            break;
+        }
+    }
+
+    if (client->head == NULL)
+    {
+        sent = _ht_tcp_server_send(client->sock_fd, data, size);
+        if (sent < 0)
+        {
+            return HT_FALSE;
+        }
+        if (sent > 0)
+        {
+            client->sending_message = !droppable ? (size_t)sent < size : HT_TRUE;
+        }
+    }
+
+    if (droppable)
+    {
+        client->message_started = HT_TRUE;
+    }
+
+    if ((size_t)sent < size)
+    {
+        if (!_ht_tcp_server_client_enqueue(client, chunk, data, size, (size_t)sent, droppable))
+        {
+            /* the stream would be corrupted */
+            return HT_FALSE;
+        }
+        _ht_tcp_server_watch_output(server, client, HT_TRUE);
+    }
+
+    return HT_TRUE;
+}
+
+/* Splits data received from the client into lines, and passes them to the callback. */
+static void
+_ht_tcp_server_client_process_input(HT_TCPServer* server, HT_TCPServerClient* client, const char* data, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        if (data[i] == '\n')
+        {
+            if (!client->message_overflow && server->client_message_cb)
+            {
+                server->client_message_cb(client->sock_fd, client->message, client->message_size, server->client_message_ud);
+            }
+            client->message_size = 0;
+            client->message_overflow = HT_FALSE;
+        }
+        else if (client->message_size < sizeof(client->message))
+        {
+            client->message[client->message_size++] = data[i];
+        }
+        else
+        {
+            client->message_overflow = HT_TRUE;
+        }
+    }
+}
+
+static void
+_ht_tcp_server_handle_client_event(HT_TCPServer* server, HT_TCPServerClient* client, uint32_t events)
+{
+    HT_Boolean connected = HT_TRUE;
+
+    if (events & EPOLLIN)
+    {
+        char buffer[256];
+        ssize_t size = recv(client->sock_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (size > 0)
+        {
+            _ht_tcp_server_client_process_input(server, client, buffer, (size_t)size);
+        }
+        else if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            connected = HT_FALSE;
+        }
+    }
+
+    /* commands sent right before closing the connection are handled first */
+    if (connected && (events & (EPOLLERR | EPOLLHUP)))
+    {
+        connected = HT_FALSE;
+    }
+
+    if (connected && (events & EPOLLOUT))
+    {
+        connected = _ht_tcp_server_client_send_queue(server, client);
+    }
+
+    if (!connected)
+    {
+        _ht_tcp_server_mark_client_closing(server, client);
+    }
+}
+
+/* Closes the clients marked for closing, unless a writer still uses them. */
+static void
+_ht_tcp_server_close_marked_clients(HT_TCPServer* server)
+{
+    HT_TCPServerClient* client = server->clients;
+
+    while (client != NULL)
+    {
+        HT_TCPServerClient* next = client->next;
+        if (client->closing && client->waiting_writers == 0)
+        {
+            _ht_tcp_server_close_client(server, client);
+        }
+        client = next;
+    }
+}
+
+static HT_Boolean
+_ht_tcp_server_has_queued_data(HT_TCPServer* server)
+{
+    HT_TCPServerClient* client;
+
+    for (client = server->clients; client != NULL; client = client->next)
+    {
+        if (client->head != NULL)
+        {
+            return HT_TRUE;
+        }
+    }
+
+    return HT_FALSE;
+}
+
+static void*
+_ht_tcp_server_run_event_loop(void* user_data)
+{
+    HT_TCPServer* server = (HT_TCPServer*)user_data;
+    HT_TimestampNs stop_deadline = 0;
+    struct epoll_event events[32];
+
+    for (;;)
+    {
+        int i;
+        int count = epoll_wait(server->epoll_fd, events, sizeof(events) / sizeof(events[0]), 100);
+
+        ht_mutex_lock(server->client_mutex);
+
+        for (i = 0; i < count; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                uint64_t value;
+                if (read(server->wakeup_fd, &value, sizeof(value)) < 0)
+                {
+                    /* nothing to do, the counter is only used for waking up the thread */
+                }
+            }
+            else
+            {
+                /* clients are only freed by this thread, so the pointer is still valid */
+                HT_TCPServerClient* client = (HT_TCPServerClient*)events[i].data.ptr;
+                if (!client->closing)
+                {
+                    _ht_tcp_server_handle_client_event(server, client, events[i].events);
+                }
+            }
+        }
+
+        if (server->stopping)
+        {
+            /* try to deliver the data which has already been queued */
+            if (stop_deadline == 0)
+            {
+                stop_deadline = ht_monotonic_clock_get_timestamp() + HT_TCP_SERVER_STOP_TIMEOUT_NS;
+            }
+            if (!_ht_tcp_server_has_queued_data(server) || ht_monotonic_clock_get_timestamp() >= stop_deadline)
+            {
+                HT_TCPServerClient* client;
+                for (client = server->clients; client != NULL; client = client->next)
+                {
+                    _ht_tcp_server_mark_client_closing(server, client);
+                }
+            }
+        }
+
+        _ht_tcp_server_close_marked_clients(server);
+
+        if (server->stopping && server->clients == NULL)
+        {
+            ht_mutex_unlock(server->client_mutex);
+            break;
+        }
+
+        ht_mutex_unlock(server->client_mutex);
+    }
+
+    return NULL;
+}
+
+static void
+_ht_tcp_server_stop_event_loop(HT_TCPServer* server)
+{
+    if (server->event_loop_thread)
+    {
+        ht_mutex_lock(server->client_mutex);
+        server->stopping = HT_TRUE;
+        ht_cond_var_notify_all(server->queue_cond_var);
+        ht_mutex_unlock(server->client_mutex);
+
+        _ht_tcp_server_wake_up_event_loop(server);
+
+        ht_thread_join(server->event_loop_thread);
+        ht_thread_destroy(server->event_loop_thread);
+        server->event_loop_thread = NULL;
+    }
+
+    if (server->wakeup_fd >= 0)
+    {
+        close(server->wakeup_fd);
+        server->wakeup_fd = -1;
+    }
+    if (server->epoll_fd >= 0)
+    {
+        close(server->epoll_fd);
+        server->epoll_fd = -1;
+    }
+}
+
+static void
+_ht_tcp_server_add_client(HT_TCPServer* server, int client_fd)
+{
+    HT_TCPServerClient* client = HT_CREATE_TYPE(HT_TCPServerClient);
+    struct epoll_event event;
+
+    if (client == NULL || fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+    {
+        ht_free(client);
+        close(client_fd);
+        return;
+    }
+
+    client->sock_fd = client_fd;
+    client->head = NULL;
+    client->tail = NULL;
+    client->head_sent = 0;
+    client->queue_size = 0;
+    client->sending_message = HT_FALSE;
+    client->message_started = HT_FALSE;
+    client->skip_message = HT_FALSE;
+    client->ready = HT_FALSE;
+    client->closing = HT_FALSE;
+    client->waiting_writers = 0;
+    client->waiting_for_output = HT_FALSE;
+    client->write_id = 0;
+    client->message_size = 0;
+    client->message_overflow = HT_FALSE;
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+
+    ht_mutex_lock(server->client_mutex);
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, client_fd, &event) != 0)
+    {
+        ht_mutex_unlock(server->client_mutex);
+        ht_free(client);
+        close(client_fd);
+        return;
+    }
+    client->next = server->clients;
+    server->clients = client;
+    ht_mutex_unlock(server->client_mutex);
+
+    /* the callback is called without the lock, so it can write to the client */
+    server->client_connected_cb(client_fd, server->client_connected_ud);
+
+    ht_mutex_lock(server->client_mutex);
+    for (client = server->clients; client != NULL; client = client->next)
+    {
+        if (client->sock_fd == client_fd && !client->closing)
+        {
+            client->ready = HT_TRUE;
+            /* the client would only get the end of the current message */
+            client->skip_message = server->in_message;
+            break;
+        }
+    }
+    ht_mutex_unlock(server->client_mutex);
+}
 
-typedef struct
+void
+ht_tcp_server_write(HT_TCPServer* server, char* buffer, size_t size)
 {
-#ifdef HT_THREAD_IMPL_CPP11
-    std::thread th;
-#elif defined(HT_THREAD_IMPL_POSIX)
-    pthread_t th;
-#elif defined(HT_THREAD_IMPL_WIN32)
-    HANDLE th;
-#endif
-} HT_Thread;
+    HT_TCPServerClient* client;
+    HT_TCPServerChunk* chunk = NULL;
+    unsigned int write_id;
 
-static HT_Thread*
-ht_thread_create(ht_thread_callback_t callback, void* user_data)
-{
-    HT_Thread* th = HT_CREATE_TYPE(HT_Thread);
+    if (size == 0)
+    {
+        return;
+    }
 
-#ifdef HT_THREAD_IMPL_CPP11
-    new(&th->th) HT_Thread();
-    th->th = std::thread(callback, user_data);
-#elif defined(HT_THREAD_IMPL_POSIX)
-    pthread_create(&th->th, NULL, callback, user_data);
-#elif defined(HT_THREAD_IMPL_WIN32)
-    th->th = CreateThread(NULL, 0, callback, user_data, 0, NULL);
-#endif
+    ht_mutex_lock(server->client_mutex);
+
+    server->in_message = HT_TRUE;
+    write_id = ++server->write_id;
 
-    return th;
+    /* the list of clients can be modified while waiting for a slow client (BLOCK policy),
+     * so iteration starts from the beginning after every write; clients which have already
+     * received the chunk are skipped. There are only a few clients, so that's cheap. */
+    client = server->clients;
+    while (client != NULL)
+    {
+        if (!client->ready || client->closing || client->skip_message || client->write_id == write_id)
+        {
+            client = client->next;
+            continue;
+        }
+
+        client->write_id = write_id;
+        if (!_ht_tcp_server_client_write(server, client, &chunk, (const HT_Byte*)buffer, size, HT_TRUE))
+        {
+            _ht_tcp_server_mark_client_closing(server, client);
+        }
+        client = server->clients;
+    }
+
+    ht_mutex_unlock(server->client_mutex);
 }
 
-static void
-ht_thread_join(HT_Thread* th)
+void
+ht_tcp_server_end_message(HT_TCPServer* server)
 {
-#ifdef HT_THREAD_IMPL_CPP11
-    if (th->th.joinable())
+    HT_TCPServerClient* client;
+
+    ht_mutex_lock(server->client_mutex);
+
+    for (client = server->clients; client != NULL; client = client->next)
     {
-        th->th.join();
+        if (!client->ready)
+        {
+            continue;
+        }
+        if (client->tail != NULL)
+        {
+            client->tail->message_end = HT_TRUE;
+        }
+        else
+        {
+            client->sending_message = HT_FALSE;
+        }
+        client->message_started = HT_FALSE;
+        client->skip_message = HT_FALSE;
     }
-#elif defined(HT_THREAD_IMPL_POSIX)
-    pthread_join(th->th, NULL);
-#elif defined(HT_THREAD_IMPL_WIN32)
-    WaitForSingleObject(th->th, INFINITE);
-#endif
+    server->in_message = HT_FALSE;
+
+    ht_mutex_unlock(server->client_mutex);
 }
 
-static void
-ht_thread_destroy(HT_Thread* th)
+void
+ht_tcp_server_set_client_queue(HT_TCPServer* server, size_t max_queue_size, HT_TCPListenerSlowClientPolicy policy)
 {
-    ht_thread_join(th);
-#ifdef HT_THREAD_IMPL_CPP11
-    th->th.~thread();
-#elif defined(HT_THREAD_IMPL_WIN32)
-    CloseHandle(th->th);
-#endif
+    ht_mutex_lock(server->client_mutex);
+    server->max_queue_size = max_queue_size;
+    server->policy = policy;
+    ht_cond_var_notify_all(server->queue_cond_var);
+    ht_mutex_unlock(server->client_mutex);
+}
+
+size_t
+ht_tcp_server_get_dropped_size(HT_TCPServer* server)
+{
+    size_t dropped_size;
+
+    ht_mutex_lock(server->client_mutex);
+    dropped_size = server->dropped_size;
+    ht_mutex_unlock(server->client_mutex);
 
-    ht_free(th);
+    return dropped_size;
+}
+
+HT_Boolean
+ht_tcp_server_write_to_socket(HT_TCPServer* server, int sock_fd, char* buffer, size_t size)
+{
+    HT_TCPServerClient* client;
+    HT_TCPServerChunk* chunk = NULL;
+    HT_Boolean ret = HT_FALSE;
+
+    if (size == 0)
+    {
+        return HT_TRUE;
+    }
+
+    ht_mutex_lock(server->client_mutex);
+
+    for (client = server->clients; client != NULL; client = client->next)
+    {
+        if (client->sock_fd == sock_fd && !client->closing)
+        {
+            ret = _ht_tcp_server_client_write(server, client, &chunk, (const HT_Byte*)buffer, size, HT_FALSE);
+            if (!ret)
+            {
+                _ht_tcp_server_mark_client_closing(server, client);
+            }
+            break;
+        }
+    }
+
+    ht_mutex_unlock(server->client_mutex);
+
+    return ret;
 }
 
-#ifdef _WIN32
-#include <WinSock2.h>
-#pragma comment(lib, "Ws2_32.lib")
 #else
-#include <arpa/inet.h>
-#include <netinet/in.h>
-#include <sys/socket.h>
-#include <unistd.h>
-#endif
 
-#include <string.h>
+void
+ht_tcp_server_write(HT_TCPServer* server, char* buffer, size_t size)
+{
+    size_t i;
 
-static void *_ht_tcp_server_run(void *user_data);
+    ht_mutex_lock(server->client_mutex);
 
-struct _HT_TCPServer
+    for (i = 0; i < ht_bag_size(server->client_sock_fd); i++)
+    {
+        if (!ht_tcp_server_write_to_socket(server, ht_bag_nth(server->client_sock_fd, i), buffer, size))
+        {
+            ht_bag_int_remove_nth(&server->client_sock_fd, i);
+            i--;
+        }
+    }
+
+    ht_mutex_unlock(server->client_mutex);
+}
+
+void
+ht_tcp_server_end_message(HT_TCPServer* server)
 {
-    HT_Thread* accept_client_thread;
-    HT_BagInt client_sock_fd;
-    HT_Mutex* client_mutex;
-    int server_sock_fd;
+    (void)server;
+}
 
-     OnClientConnected client_connected_cb;
-     void* client_connected_ud;
-};
+void
+ht_tcp_server_set_client_queue(HT_TCPServer* server, size_t max_queue_size, HT_TCPListenerSlowClientPolicy policy)
+{
+    (void)server;
+    (void)max_queue_size;
+    (void)policy;
+}
 
-HT_TCPServer*
-ht_tcp_server_create(void)
+size_t
+ht_tcp_server_get_dropped_size(HT_TCPServer* server)
 {
-    HT_TCPServer* server = HT_CREATE_TYPE(HT_TCPServer);
+    (void)server;
+    return 0;
+}
 
-    ht_bag_int_init(&server->client_sock_fd, 8);
-    server->accept_client_thread = NULL;
-    server->client_mutex = ht_mutex_create();
-    server->server_sock_fd = -1;
-    server->client_connected_cb = NULL;
-    server->client_connected_ud = NULL;
+HT_Boolean
+ht_tcp_server_write_to_socket(HT_TCPServer* server, int sock_fd, char* buffer, size_t size)
+{
+    (void) server;
+    if (size == 0)
+    {
+        return HT_TRUE;
+    }
 
-    return server;
+    size_t sent = 0;
+
+    while (sent < size)
+    {
+        int n = send(sock_fd, buffer + sent, size - sent, 0);
+
+        if (n <= 0)
+        {
+            return HT_FALSE;
+        }
+
+        sent += n;
+    }
+
+    return HT_TRUE;
 }
 
+#endif /* HT_TCP_SERVER_IMPL_EPOLL */
+
 void
-ht_tcp_server_destroy(HT_TCPServer* server)
+ht_tcp_server_set_client_message_callback(HT_TCPServer* server, OnClientMessage client_message_cb, void* user_data)
 {
-    ht_tcp_server_stop(server);
-    ht_bag_int_deinit(&server->client_sock_fd);
-    ht_mutex_destroy(server->client_mutex);
-    ht_free(server);
+    server->client_message_cb = client_message_cb;
+    server->client_message_ud = user_data;
+}
+
+static HT_Boolean
+_ht_tcp_server_listen(HT_TCPServer* server, OnClientConnected client_connected_cb, void* user_data)
+{
+    if (listen(server->server_sock_fd, 5) < 0)
+    {
+        ht_tcp_server_stop(server);
+        return HT_FALSE;
+    }
+
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+    if (!_ht_tcp_server_start_event_loop(server))
+    {
+        ht_tcp_server_stop(server);
+        return HT_FALSE;
+    }
+#endif
+
+    server->client_connected_cb = client_connected_cb;
+    server->client_connected_ud = user_data;
+    server->accept_client_thread = ht_thread_create(_ht_tcp_server_run, server);
+
+    return HT_TRUE;
 }
 
 HT_Boolean
@@ -183,17 +1053,67 @@ ht_tcp_server_start(HT_TCPServer* server, int port, OnClientConnected client_con
         return HT_FALSE;
     }
 
-    if (listen(server->server_sock_fd, 5) < 0)
+    return _ht_tcp_server_listen(server, client_connected_cb, user_data);
+}
+
+HT_Boolean
+ht_tcp_server_start_unix_socket(HT_TCPServer* server, const char* path, OnClientConnected client_connected_cb, void* user_data)
+{
+#ifdef _WIN32
+    (void)server;
+    (void)path;
+    (void)client_connected_cb;
+    (void)user_data;
+    return HT_FALSE;
+#else
+    struct sockaddr_un serveraddr;
+    struct stat path_stat;
+    size_t path_length = strlen(path);
+
+    if (ht_tcp_server_is_running(server))
     {
         ht_tcp_server_stop(server);
+    }
+
+    if (path_length == 0 || path_length >= sizeof(serveraddr.sun_path))
+    {
         return HT_FALSE;
     }
 
-    server->client_connected_cb = client_connected_cb;
-    server->client_connected_ud = user_data;
-    server->accept_client_thread = ht_thread_create(_ht_tcp_server_run, server);
+    /* remove a socket left by the process which hasn't been stopped properly;
+     * any other file is not touched, and bind() fails */
+    if (stat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode))
+    {
+        unlink(path);
+    }
 
-    return HT_TRUE;
+    server->server_sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->server_sock_fd < 0)
+    {
+        return HT_FALSE;
+    }
+
+    memset(&serveraddr, 0, sizeof(serveraddr));
+    serveraddr.sun_family = AF_UNIX;
+    memcpy(serveraddr.sun_path, path, path_length + 1);
+
+    if (bind(server->server_sock_fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
+    {
+        ht_tcp_server_stop(server);
+        return HT_FALSE;
+    }
+
+    server->unix_socket_path = (char*)ht_alloc(path_length + 1);
+    if (server->unix_socket_path == NULL)
+    {
+        unlink(path);
+        ht_tcp_server_stop(server);
+        return HT_FALSE;
+    }
+    memcpy(server->unix_socket_path, path, path_length + 1);
+
+    return _ht_tcp_server_listen(server, client_connected_cb, user_data);
+#endif
 }
 
 void
@@ -204,9 +1124,11 @@ ht_tcp_server_stop(HT_TCPServer* server)
         return;
     }
 
+#ifndef HT_TCP_SERVER_IMPL_EPOLL
     ht_mutex_lock(server->client_mutex);
     ht_bag_int_clear(&server->client_sock_fd);
     ht_mutex_unlock(server->client_mutex);
+#endif
 
     int prev_sock_fd = server->server_sock_fd;
     server->server_sock_fd = -1;
@@ -223,66 +1145,38 @@ ht_tcp_server_stop(HT_TCPServer* server)
         ht_thread_destroy(server->accept_client_thread);
         server->accept_client_thread = NULL;
     }
-}
-
-HT_Boolean
-ht_tcp_server_is_running(const HT_TCPServer* server)
-{
-    return server->server_sock_fd != -1;
-}
-
-void
-ht_tcp_server_write(HT_TCPServer* server, char* buffer, size_t size)
-{
-    size_t i;
 
-    ht_mutex_lock(server->client_mutex);
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+    close(prev_sock_fd);
+    _ht_tcp_server_stop_event_loop(server);
+#endif
 
-    for (i = 0; i < ht_bag_size(server->client_sock_fd); i++)
+#ifndef _WIN32
+    if (server->unix_socket_path != NULL)
     {
-        if (!ht_tcp_server_write_to_socket(server, ht_bag_nth(server->client_sock_fd, i), buffer, size))
-        {
-            ht_bag_int_remove_nth(&server->client_sock_fd, i);
-            i--;
-        }
+        unlink(server->unix_socket_path);
+        ht_free(server->unix_socket_path);
+        server->unix_socket_path = NULL;
     }
-
-    ht_mutex_unlock(server->client_mutex);
+#endif
 }
 
 HT_Boolean
-ht_tcp_server_write_to_socket(HT_TCPServer* server, int sock_fd, char* buffer, size_t size)
+ht_tcp_server_is_running(const HT_TCPServer* server)
 {
-    (void) server;
-    if (size == 0)
-    {
-        return HT_TRUE;
-    }
-
-    size_t sent = 0;
-
-    while (sent < size)
-    {
-        int n = send(sock_fd, buffer + sent, size - sent, 0);
-
-        if (n <= 0)
-        {
-            return HT_FALSE;
-        }
-
-        sent += n;
-    }
-
-    return HT_TRUE;
+    return server->server_sock_fd != -1;
 }
 
+/* Accepts new connections. Clients are accepted by a separate thread (not by the event loop),
+ * because the OnClientConnected callback might need to wait for the listener, which can be
+ * blocked by a slow client. */
 static void*
 _ht_tcp_server_run(void* user_data)
 {
     HT_TCPServer* server = (HT_TCPServer*)user_data;
     while (ht_tcp_server_is_running(server))
     {
-        struct sockaddr_in clientaddr;
+        struct sockaddr_storage clientaddr;
 #ifdef _WIN32
         int client_len;
 #else
@@ -293,10 +1187,14 @@ _ht_tcp_server_run(void* user_data)
 
         if (client_fd >= 0)
         {
+#ifdef HT_TCP_SERVER_IMPL_EPOLL
+            _ht_tcp_server_add_client(server, client_fd);
+#else
             server->client_connected_cb(client_fd, server->client_connected_ud);
             ht_mutex_lock(server->client_mutex);
             ht_bag_int_add(&server->client_sock_fd, client_fd);
             ht_mutex_unlock(server->client_mutex);
+#endif
         }
     }
     return NULL;
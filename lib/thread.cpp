@@ -0,0 +1,259 @@
+#include "hawktracer/thread.h"
+#include "hawktracer/alloc.h"
+#include "internal/atomic.h"
+#include "internal/thread.h"
+
+#if defined(HT_THREAD_IMPL_CPP11) || defined(HT_THREAD_IMPL_WIN32) || defined(HT_THREAD_IMPL_POSIX)
+#  define HT_THREAD_FORCE_SELECTED
+#endif
+
+#if !defined(HT_THREAD_FORCE_SELECTED) && defined(HT_CPP11)
+#  define HT_THREAD_IMPL_CPP11
+#elif !defined(HT_THREAD_FORCE_SELECTED) && defined(_WIN32)
+#  define HT_THREAD_IMPL_WIN32
+#elif !defined(HT_THREAD_FORCE_SELECTED) && defined(HT_HAVE_UNISTD_H)
+#  include <unistd.h>
+#  ifdef _POSIX_VERSION
+#    define HT_THREAD_IMPL_POSIX
+#  endif
+#endif
+
+#ifdef HT_THREAD_IMPL_CPP11
+#  include <new>
+#  include <thread>
+#elif defined(HT_THREAD_IMPL_WIN32)
+#  include <windows.h>
+#elif defined(HT_THREAD_IMPL_POSIX)
+#  include <pthread.h>
+#endif
+
+static volatile HT_ThreadId _ht_current_thread_id = 0;
+
+HT_ThreadId
+ht_thread_get_current_thread_id(void)
+{
+    static HT_THREAD_LOCAL HT_ThreadId thread_id;
+
+    if (!thread_id)
+    {
+        thread_id = ht_atomic_uint32_fetch_add(&_ht_current_thread_id, 1) + 1;
+    }
+
+    return thread_id;
+}
+
+struct _HT_Thread
+{
+#ifdef HT_THREAD_IMPL_CPP11
+    std::thread th;
+#elif defined(HT_THREAD_IMPL_POSIX)
+    pthread_t th;
+    HT_Boolean joined;
+#elif defined(HT_THREAD_IMPL_WIN32)
+    HANDLE th;
+    HT_ThreadCallback callback;
+    void* user_data;
+#endif
+};
+
+#ifdef HT_THREAD_IMPL_WIN32
+static DWORD WINAPI
+_ht_thread_win32_run(LPVOID user_data)
+{
+    HT_Thread* th = (HT_Thread*)user_data;
+    th->callback(th->user_data);
+    return 0;
+}
+#endif
+
+HT_Thread*
+ht_thread_create(HT_ThreadCallback callback, void* user_data)
+{
+    HT_Thread* th = HT_CREATE_TYPE(HT_Thread);
+
+    if (th == NULL)
+    {
+        return NULL;
+    }
+
+#ifdef HT_THREAD_IMPL_CPP11
+    new(&th->th) std::thread(callback, user_data);
+#elif defined(HT_THREAD_IMPL_POSIX)
+    th->joined = HT_FALSE;
+    if (pthread_create(&th->th, NULL, callback, user_data) != 0)
+    {
+        ht_free(th);
+        th = NULL;
+    }
+#elif defined(HT_THREAD_IMPL_WIN32)
+    th->callback = callback;
+    th->user_data = user_data;
+    th->th = CreateThread(NULL, 0, _ht_thread_win32_run, th, 0, NULL);
+    if (th->th == NULL)
+    {
+        ht_free(th);
+        th = NULL;
+    }
+#endif
+
+    return th;
+}
+
+void
+ht_thread_join(HT_Thread* th)
+{
+#ifdef HT_THREAD_IMPL_CPP11
+    if (th->th.joinable())
+    {
+        th->th.join();
+    }
+#elif defined(HT_THREAD_IMPL_POSIX)
+    if (!th->joined)
+    {
+        pthread_join(th->th, NULL);
+        th->joined = HT_TRUE;
+    }
+#elif defined(HT_THREAD_IMPL_WIN32)
+    WaitForSingleObject(th->th, INFINITE);
+#endif
+}
+
+void
+ht_thread_destroy(HT_Thread* th)
+{
+    ht_thread_join(th);
+#ifdef HT_THREAD_IMPL_CPP11
+    th->th.~thread();
+#elif defined(HT_THREAD_IMPL_WIN32)
+    CloseHandle(th->th);
+#endif
+
+    ht_free(th);
+}
+
+typedef struct _HT_ThreadExitCallbackNode HT_ThreadExitCallbackNode;
+
+struct _HT_ThreadExitCallbackNode
+{
+    HT_ThreadExitCallbackNode* next;
+    HT_ThreadExitCallback callback;
+    void* user_data;
+};
+
+/* Callbacks might register new callbacks, they're run as well. */
+static void
+_ht_thread_run_exit_callbacks(HT_ThreadExitCallbackNode** head)
+{
+    while (*head)
+    {
+        HT_ThreadExitCallbackNode* node = *head;
+        *head = node->next;
+        node->callback(node->user_data);
+        ht_free(node);
+    }
+}
+
+static HT_ThreadExitCallbackNode*
+_ht_thread_create_exit_callback_node(HT_ThreadExitCallback callback, void* user_data, HT_ThreadExitCallbackNode* next)
+{
+    HT_ThreadExitCallbackNode* node = HT_CREATE_TYPE(HT_ThreadExitCallbackNode);
+
+    if (node)
+    {
+        node->next = next;
+        node->callback = callback;
+        node->user_data = user_data;
+    }
+
+    return node;
+}
+
+#if !defined(HT_CPP11) && defined(HT_HAVE_UNISTD_H)
+#  include <unistd.h>
+#endif
+
+#ifdef HT_CPP11
+struct ThreadExitCallbacks
+{
+    ~ThreadExitCallbacks()
+    {
+        _ht_thread_run_exit_callbacks(&head);
+    }
+
+    HT_ThreadExitCallbackNode* head;
+};
+
+static HT_THREAD_LOCAL ThreadExitCallbacks thread_exit_callbacks;
+
+HT_Boolean
+ht_thread_register_exit_callback(HT_ThreadExitCallback callback, void* user_data)
+{
+    HT_ThreadExitCallbackNode* node = _ht_thread_create_exit_callback_node(callback, user_data, thread_exit_callbacks.head);
+
+    if (node == NULL)
+    {
+        return HT_FALSE;
+    }
+
+    thread_exit_callbacks.head = node;
+
+    return HT_TRUE;
+}
+
+#elif defined(HT_HAVE_UNISTD_H) && defined(_POSIX_VERSION)
+
+#include <pthread.h>
+
+static pthread_key_t thread_exit_key;
+static pthread_once_t thread_exit_once_control = PTHREAD_ONCE_INIT;
+
+/* The key is already cleared, so callbacks registered by the callbacks
+ * are run in the next destructor iteration. */
+static void _ht_thread_exit_key_destructor(void* head)
+{
+    HT_ThreadExitCallbackNode* node = (HT_ThreadExitCallbackNode*)head;
+    _ht_thread_run_exit_callbacks(&node);
+}
+
+static void create_thread_exit_key(void)
+{
+    pthread_key_create(&thread_exit_key, _ht_thread_exit_key_destructor);
+}
+
+HT_Boolean
+ht_thread_register_exit_callback(HT_ThreadExitCallback callback, void* user_data)
+{
+    HT_ThreadExitCallbackNode* node;
+
+    pthread_once(&thread_exit_once_control, create_thread_exit_key);
+
+    node = _ht_thread_create_exit_callback_node(
+                callback, user_data, (HT_ThreadExitCallbackNode*)pthread_getspecific(thread_exit_key));
+    if (node == NULL)
+    {
+        return HT_FALSE;
+    }
+
+    if (pthread_setspecific(thread_exit_key, node) != 0)
+    {
+        ht_free(node);
+        return HT_FALSE;
+    }
+
+    return HT_TRUE;
+}
+
+#else
+
+HT_Boolean
+ht_thread_register_exit_callback(HT_ThreadExitCallback callback, void* user_data)
+{
+    (void)callback;
+    (void)user_data;
+    (void)_ht_thread_create_exit_callback_node;
+    (void)_ht_thread_run_exit_callbacks;
+
+    return HT_FALSE;
+}
+
+#endif
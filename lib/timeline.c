@@ -1,10 +1,14 @@
 #include <hawktracer/timeline.h>
 #include <hawktracer/alloc.h>
+#include <hawktracer/core_events.h>
 
+#include "internal/atomic.h"
+#include "internal/buffer_dispatcher.h"
 #include "internal/error.h"
 #include "internal/feature.h"
 #include "internal/registry.h"
 #include "internal/mutex.h"
+#include "internal/thread.h"
 #include "internal/timeline_listener_container.h"
 
 #include <string.h>
@@ -17,6 +21,82 @@
         } \
     } while (0)
 
+typedef struct _HT_TimelineBufferNode HT_TimelineBufferNode;
+typedef struct _HT_TimelineThreadContext HT_TimelineThreadContext;
+
+/* A state of the compact serialization of a buffer (see ht_timeline_enable_compact_serialization()). */
+typedef struct
+{
+    size_t block_offset;
+    /* Events are appended to the current block only if nothing else has been written
+     * to the buffer since the last one, i.e. if the end of the block is the buffer usage. */
+    size_t block_end;
+    HT_CompactContext context;
+} HT_TimelineCompactState;
+
+#define HT_TIMELINE_COMPACT_NO_BLOCK ((size_t)-1)
+
+/* A size of the serialized HT_CompactBlockEvent. */
+#define HT_TIMELINE_COMPACT_BLOCK_HEADER_SIZE \
+    (sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs) + sizeof(HT_EventId) + sizeof(uint32_t))
+
+/* A space required for a compact event of the given regular size (including a new block header). */
+#define HT_TIMELINE_COMPACT_MAX_SIZE(size) (HT_TIMELINE_COMPACT_BLOCK_HEADER_SIZE + 2 * (size))
+
+/* A buffer used by #HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER timelines */
+struct _HT_TimelineBufferNode
+{
+    HT_TimelineBufferNode* next;
+    /* NULL if the node has been allocated for a single event which doesn't fit
+     * into a regular buffer; such node is released once it's delivered to listeners. */
+    HT_TimelineThreadContext* owner;
+    size_t usage;
+    HT_Byte* data;
+};
+
+/* States of the thread context. A context is released when its thread exits (so it
+ * can be re-used by another thread), and it's detached from the thread when the timeline
+ * is destroyed before the thread exits; in that case, the context is freed by whichever
+ * of the thread and ht_timeline_destroy() finishes later. */
+typedef enum
+{
+    /* owned by a thread */
+    HT_TIMELINE_THREAD_CONTEXT_ACTIVE = 0,
+    /* the owner thread is exiting, and it's handing off the current buffer */
+    HT_TIMELINE_THREAD_CONTEXT_EXITING,
+    /* can be taken by any thread */
+    HT_TIMELINE_THREAD_CONTEXT_FREE,
+    /* the timeline is being destroyed while the owner thread is still running */
+    HT_TIMELINE_THREAD_CONTEXT_DETACHING,
+    /* the owner thread exited while the timeline was being destroyed; freed by ht_timeline_destroy() */
+    HT_TIMELINE_THREAD_CONTEXT_ORPHANED,
+    /* the timeline has been destroyed; freed by the owner thread */
+    HT_TIMELINE_THREAD_CONTEXT_DETACHED
+} HT_TimelineThreadContextState;
+
+struct _HT_TimelineThreadContext
+{
+    HT_TimelineThreadContext* next;
+    HT_Timeline* timeline;
+    /* NULL if the context is free */
+    void* volatile thread_key;
+    volatile long state;
+    /* Contexts of all the timelines used by the thread (see _ht_timeline_thread_exit());
+     * only accessed by the owner thread. */
+    HT_TimelineThreadContext* thread_next;
+    HT_Boolean in_thread_list;
+    /* NULL if the context is free and its buffer has been handed off */
+    HT_TimelineBufferNode* current;
+    /* Only accessed by the thread owning the context. */
+    HT_TimelineBufferNode* free_nodes;
+    /* Nodes already delivered to listeners. Pushed by a dispatching thread,
+     * taken (all at once) by the thread owning the context. */
+    HT_TimelineBufferNode* returned_nodes;
+    /* The last flush request handled by the thread (see ht_timeline_request_flush_all()). */
+    uint64_t flush_request;
+    HT_TimelineCompactState compact;
+};
+
 struct _HT_Timeline
 {
     HT_Feature* features[HT_TIMELINE_MAX_FEATURES];
@@ -27,94 +107,1066 @@ struct _HT_Timeline
     HT_TimelineListenerContainer* listeners;
     struct _HT_Mutex* locking_policy;
     HT_Boolean serialize_events;
+    HT_TimelineThreadSafety thread_safety;
+    uint64_t serial;
+    HT_TimelineThreadContext* thread_contexts;
+    /* Full buffers waiting for being delivered to listeners (in reversed order). */
+    HT_TimelineBufferNode* ready_nodes;
+    volatile long dispatching;
+    /* Non-NULL if asynchronous flush is enabled; the dispatcher owns the buffer then. */
+    HT_BufferDispatcher* dispatcher;
+    /* The last flush request handled by the timeline (see ht_timeline_request_flush_all()). */
+    uint64_t flush_request;
+    HT_Boolean compact_serialization;
+    HT_TimelineCompactState compact;
 };
 
+#define HT_TIMELINE_THREAD_CACHE_SIZE 4
+
+typedef struct
+{
+    uint64_t serial;
+    HT_TimelineThreadContext* context;
+} HT_TimelineThreadCacheEntry;
+
+/* The address of the cache is also used as a key identifying the thread. */
+static HT_THREAD_LOCAL HT_TimelineThreadCacheEntry _ht_timeline_thread_cache[HT_TIMELINE_THREAD_CACHE_SIZE];
+
+/* Contexts owned by the current thread, linked by thread_next; released when the thread exits. */
+static HT_THREAD_LOCAL HT_TimelineThreadContext* _ht_timeline_thread_contexts;
+static HT_THREAD_LOCAL HT_Boolean _ht_timeline_thread_exit_registered;
+
+static volatile uint64_t _ht_timeline_last_serial = 0;
+
+/* Incremented by ht_timeline_request_flush_all(); timelines compare it with the last
+ * request they've handled when the event is pushed. */
+static volatile uint64_t _ht_timeline_flush_request = 0;
+
 static void
 _ht_timeline_flush(HT_Timeline* timeline)
 {
     if (timeline->buffer_usage)
     {
-        ht_timeline_listener_container_notify_listeners(timeline->listeners, timeline->buffer, timeline->buffer_usage, timeline->serialize_events);
-        timeline->buffer_usage = 0;
+        if (timeline->dispatcher)
+        {
+            timeline->buffer = ht_buffer_dispatcher_swap(timeline->dispatcher, timeline->buffer, timeline->buffer_usage);
+        }
+        else
+        {
+            ht_timeline_listener_container_notify_listeners(timeline->listeners, timeline->buffer, timeline->buffer_usage, timeline->serialize_events);
+        }
+        timeline->buffer_usage = 0;
+    }
+    timeline->compact.block_end = HT_TIMELINE_COMPACT_NO_BLOCK;
+}
+
+/* Must be called with the timeline lock held. */
+static HT_INLINE void
+_ht_timeline_handle_flush_request(HT_Timeline* timeline)
+{
+    uint64_t flush_request = ht_atomic_uint64_load(&_ht_timeline_flush_request);
+
+    if (HT_UNLIKELY(timeline->flush_request != flush_request))
+    {
+        timeline->flush_request = flush_request;
+        _ht_timeline_flush(timeline);
+    }
+}
+
+static void
+_ht_timeline_notify_listeners(HT_Timeline* timeline, TEventPtr events, size_t size)
+{
+    if (timeline->dispatcher)
+    {
+        ht_buffer_dispatcher_push_copy(timeline->dispatcher, events, size);
+    }
+    else
+    {
+        ht_timeline_listener_container_notify_listeners(timeline->listeners, events, size, timeline->serialize_events);
+    }
+}
+
+static void
+_ht_timeline_dispatcher_callback(HT_Byte* data, size_t size, void* user_data)
+{
+    HT_Timeline* timeline = (HT_Timeline*)user_data;
+
+    ht_timeline_listener_container_notify_listeners(timeline->listeners, data, size, timeline->serialize_events);
+}
+
+void
+ht_timeline_init_event(HT_Timeline* timeline, HT_Event* event)
+{
+    event->timestamp = ht_monotonic_clock_get_timestamp();
+    event->id = ht_event_id_provider_next(timeline->id_provider);
+}
+
+static HT_INLINE size_t
+_ht_timeline_get_event_size(HT_Timeline* timeline, HT_Event* event)
+{
+    HT_EventKlass* klass = HT_EVENT_GET_KLASS(event);
+
+    return timeline->serialize_events ? klass->get_size(event) : klass->type_info->size;
+}
+
+static HT_INLINE void
+_ht_timeline_write_event(HT_Timeline* timeline, HT_Event* event, HT_Byte* buffer, size_t size)
+{
+    if (timeline->serialize_events)
+    {
+        HT_EVENT_GET_KLASS(event)->serialize(event, buffer);
+    }
+    else
+    {
+        memcpy(buffer, event, size);
+    }
+}
+
+static HT_INLINE HT_Boolean
+_ht_timeline_use_compact_serialization(HT_Timeline* timeline, HT_Event* event, size_t size)
+{
+    return timeline->compact_serialization
+            && HT_EVENT_GET_KLASS(event)->serialize_compact != NULL
+            && HT_TIMELINE_COMPACT_MAX_SIZE(size) <= timeline->buffer_capacity;
+}
+
+/* Writes the event in the compact format at the @a usage offset of the buffer;
+ * the buffer must have at least HT_TIMELINE_COMPACT_MAX_SIZE() bytes available.
+ * Returns a number of bytes written. */
+static size_t
+_ht_timeline_write_compact_event(HT_TimelineCompactState* state, HT_Event* event, HT_Byte* buffer, size_t usage)
+{
+    size_t offset = usage;
+    uint32_t block_size;
+
+    if (state->block_end != usage)
+    {
+        HT_DECL_EVENT(HT_CompactBlockEvent, block_event);
+        block_event.base.timestamp = event->timestamp;
+        block_event.base.id = event->id;
+        block_event.size = 0;
+
+        state->block_offset = usage;
+        state->context.timestamp = event->timestamp;
+        state->context.id = event->id;
+        offset += HT_EVENT_SERIALIZE_FUNCTION(HT_CompactBlockEvent)(HT_EVENT(&block_event), buffer + offset);
+    }
+
+    offset += HT_EVENT_GET_KLASS(event)->serialize_compact(event, buffer + offset, &state->context);
+
+    /* the size of the block is updated after every event, so the buffer can be flushed at any time */
+    block_size = (uint32_t)(offset - state->block_offset - HT_TIMELINE_COMPACT_BLOCK_HEADER_SIZE);
+    memcpy(buffer + state->block_offset + HT_TIMELINE_COMPACT_BLOCK_HEADER_SIZE - sizeof(block_size),
+           &block_size, sizeof(block_size));
+    state->block_end = offset;
+
+    return offset - usage;
+}
+
+/* Serializes the event at the @a usage offset of the buffer if it fits there, so the size
+ * of the event doesn't have to be computed separately. Otherwise, leaves the @a usage
+ * unchanged and only sets the @a size of the event. */
+static HT_INLINE HT_Boolean
+_ht_timeline_try_write_serialized_event(HT_Timeline* timeline, HT_Event* event, HT_Byte* buffer, size_t* usage, size_t* size)
+{
+    *size = HT_EVENT_GET_KLASS(event)->try_serialize(event, buffer + *usage, timeline->buffer_capacity - *usage);
+
+    if (HT_LIKELY(*usage + *size <= timeline->buffer_capacity))
+    {
+        *usage += *size;
+        return HT_TRUE;
+    }
+
+    return HT_FALSE;
+}
+
+static HT_TimelineBufferNode*
+_ht_timeline_buffer_node_create(size_t capacity, HT_TimelineThreadContext* owner)
+{
+    HT_TimelineBufferNode* node = (HT_TimelineBufferNode*)ht_alloc(sizeof(HT_TimelineBufferNode) + capacity);
+
+    if (node == NULL)
+    {
+        return NULL;
+    }
+
+    node->next = NULL;
+    node->owner = owner;
+    node->usage = 0;
+    node->data = (HT_Byte*)(node + 1);
+
+    return node;
+}
+
+static void
+_ht_timeline_buffer_node_list_destroy(HT_TimelineBufferNode* node)
+{
+    while (node)
+    {
+        HT_TimelineBufferNode* next = node->next;
+        ht_free(node);
+        node = next;
+    }
+}
+
+static void
+_ht_timeline_buffer_node_push(HT_TimelineBufferNode* volatile* head, HT_TimelineBufferNode* node)
+{
+    HT_TimelineBufferNode* first;
+
+    do
+    {
+        first = (HT_TimelineBufferNode*)ht_atomic_ptr_load((void* volatile*)head);
+        node->next = first;
+    } while (!ht_atomic_ptr_compare_exchange((void* volatile*)head, first, node));
+}
+
+static void
+_ht_timeline_release_buffer_node(HT_TimelineBufferNode* node)
+{
+    if (node->owner == NULL)
+    {
+        ht_free(node);
+    }
+    else
+    {
+        node->usage = 0;
+        _ht_timeline_buffer_node_push(&node->owner->returned_nodes, node);
+    }
+}
+
+/* Delivers all the ready nodes to listeners. Only one thread at a time dispatches
+ * the nodes (so listeners don't have to be re-entrant); if the function is called
+ * while other thread is dispatching, the nodes will be delivered by that thread. */
+static void
+_ht_timeline_dispatch_ready_nodes(HT_Timeline* timeline)
+{
+    do
+    {
+        HT_TimelineBufferNode* nodes;
+
+        if (ht_atomic_long_exchange(&timeline->dispatching, 1) != 0)
+        {
+            return;
+        }
+
+        while ((nodes = (HT_TimelineBufferNode*)ht_atomic_ptr_exchange((void* volatile*)&timeline->ready_nodes, NULL)) != NULL)
+        {
+            HT_TimelineBufferNode* ordered = NULL;
+
+            while (nodes)
+            {
+                HT_TimelineBufferNode* next = nodes->next;
+                nodes->next = ordered;
+                ordered = nodes;
+                nodes = next;
+            }
+
+            while (ordered)
+            {
+                HT_TimelineBufferNode* next = ordered->next;
+                ht_timeline_listener_container_notify_listeners(timeline->listeners, ordered->data, ordered->usage, timeline->serialize_events);
+                _ht_timeline_release_buffer_node(ordered);
+                ordered = next;
+            }
+        }
+
+        ht_atomic_long_exchange(&timeline->dispatching, 0);
+    } while (ht_atomic_ptr_load((void* volatile*)&timeline->ready_nodes) != NULL);
+}
+
+static HT_TimelineBufferNode*
+_ht_timeline_thread_context_take_node(HT_Timeline* timeline, HT_TimelineThreadContext* context)
+{
+    HT_TimelineBufferNode* node = context->free_nodes;
+
+    if (node == NULL)
+    {
+        node = (HT_TimelineBufferNode*)ht_atomic_ptr_exchange((void* volatile*)&context->returned_nodes, NULL);
+    }
+
+    if (node == NULL)
+    {
+        return _ht_timeline_buffer_node_create(timeline->buffer_capacity, context);
+    }
+
+    context->free_nodes = node->next;
+    node->next = NULL;
+
+    return node;
+}
+
+static HT_Boolean
+_ht_timeline_thread_context_hand_off(HT_Timeline* timeline, HT_TimelineThreadContext* context)
+{
+    HT_TimelineBufferNode* node = _ht_timeline_thread_context_take_node(timeline, context);
+
+    if (node == NULL)
+    {
+        return HT_FALSE;
+    }
+
+    _ht_timeline_buffer_node_push(&timeline->ready_nodes, context->current);
+    context->current = node;
+    context->compact.block_end = HT_TIMELINE_COMPACT_NO_BLOCK;
+
+    return HT_TRUE;
+}
+
+/* Called by the thread when it exits. The current buffer is handed off, so it's delivered
+ * by the next dispatch (e.g. ht_timeline_flush_all()), and the context can be taken by a new thread. */
+static void
+_ht_timeline_thread_exit(void* user_data)
+{
+    HT_TimelineThreadContext* context = _ht_timeline_thread_contexts;
+    (void)user_data;
+
+    /* the thread might still push events (e.g. from destructors of other thread-local objects),
+     * it must not use the released contexts then */
+    memset(_ht_timeline_thread_cache, 0, sizeof(_ht_timeline_thread_cache));
+    _ht_timeline_thread_contexts = NULL;
+    _ht_timeline_thread_exit_registered = HT_FALSE;
+
+    while (context)
+    {
+        HT_TimelineThreadContext* next = context->thread_next;
+
+        context->thread_next = NULL;
+        if (ht_atomic_long_compare_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_ACTIVE, HT_TIMELINE_THREAD_CONTEXT_EXITING))
+        {
+            if (context->current->usage > 0)
+            {
+                _ht_timeline_buffer_node_push(&context->timeline->ready_nodes, context->current);
+                context->current = NULL;
+            }
+            context->in_thread_list = HT_FALSE;
+            ht_atomic_ptr_store(&context->thread_key, NULL);
+            ht_atomic_long_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_FREE);
+        }
+        else if (!ht_atomic_long_compare_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_DETACHING, HT_TIMELINE_THREAD_CONTEXT_ORPHANED))
+        {
+            /* HT_TIMELINE_THREAD_CONTEXT_DETACHED */
+            ht_free(context);
+        }
+
+        context = next;
+    }
+}
+
+/* Frees contexts of destroyed timelines, so the list doesn't grow if the thread creates many timelines. */
+static void
+_ht_timeline_prune_thread_contexts(void)
+{
+    HT_TimelineThreadContext** context = &_ht_timeline_thread_contexts;
+
+    while (*context)
+    {
+        HT_TimelineThreadContext* current = *context;
+        if (ht_atomic_long_load(&current->state) == HT_TIMELINE_THREAD_CONTEXT_DETACHED)
+        {
+            *context = current->thread_next;
+            ht_free(current);
+        }
+        else
+        {
+            context = &current->thread_next;
+        }
+    }
+}
+
+static void
+_ht_timeline_thread_context_attach(HT_TimelineThreadContext* context, const void* thread_key)
+{
+    ht_atomic_ptr_store(&context->thread_key, (void*)thread_key);
+    context->flush_request = ht_atomic_uint64_load(&_ht_timeline_flush_request);
+    context->compact.block_end = HT_TIMELINE_COMPACT_NO_BLOCK;
+    context->in_thread_list = _ht_timeline_thread_exit_registered;
+    if (context->in_thread_list)
+    {
+        context->thread_next = _ht_timeline_thread_contexts;
+        _ht_timeline_thread_contexts = context;
+    }
+}
+
+/* Takes a context released by an exited thread. */
+static HT_TimelineThreadContext*
+_ht_timeline_take_free_thread_context(HT_Timeline* timeline, const void* thread_key)
+{
+    HT_TimelineThreadContext* context = (HT_TimelineThreadContext*)ht_atomic_ptr_load((void* volatile*)&timeline->thread_contexts);
+
+    for (; context; context = context->next)
+    {
+        if (ht_atomic_long_load(&context->state) != HT_TIMELINE_THREAD_CONTEXT_FREE
+                || !ht_atomic_long_compare_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_FREE, HT_TIMELINE_THREAD_CONTEXT_ACTIVE))
+        {
+            continue;
+        }
+
+        if (context->current == NULL)
+        {
+            context->current = _ht_timeline_thread_context_take_node(timeline, context);
+            if (context->current == NULL)
+            {
+                ht_atomic_long_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_FREE);
+                return NULL;
+            }
+        }
+
+        _ht_timeline_thread_context_attach(context, thread_key);
+        return context;
+    }
+
+    return NULL;
+}
+
+static HT_TimelineThreadContext*
+_ht_timeline_find_or_create_thread_context(HT_Timeline* timeline, const void* thread_key)
+{
+    HT_TimelineThreadContext* context = (HT_TimelineThreadContext*)ht_atomic_ptr_load((void* volatile*)&timeline->thread_contexts);
+
+    /* If the thread exit callback couldn't be registered, the key of an exited thread
+     * might be re-used by a new one; in that case the new thread takes over the context. */
+    for (; context; context = context->next)
+    {
+        if (ht_atomic_ptr_load(&context->thread_key) == thread_key
+                && ht_atomic_long_load(&context->state) == HT_TIMELINE_THREAD_CONTEXT_ACTIVE)
+        {
+            return context;
+        }
+    }
+
+    _ht_timeline_prune_thread_contexts();
+
+    if (!_ht_timeline_thread_exit_registered)
+    {
+        _ht_timeline_thread_exit_registered = ht_thread_register_exit_callback(_ht_timeline_thread_exit, NULL);
+    }
+
+    if (_ht_timeline_thread_exit_registered)
+    {
+        context = _ht_timeline_take_free_thread_context(timeline, thread_key);
+        if (context != NULL)
+        {
+            return context;
+        }
+    }
+
+    context = HT_CREATE_TYPE(HT_TimelineThreadContext);
+    if (context == NULL)
+    {
+        return NULL;
+    }
+
+    context->timeline = timeline;
+    context->state = HT_TIMELINE_THREAD_CONTEXT_ACTIVE;
+    context->thread_next = NULL;
+    context->free_nodes = NULL;
+    context->returned_nodes = NULL;
+    context->current = _ht_timeline_buffer_node_create(timeline->buffer_capacity, context);
+    if (context->current == NULL)
+    {
+        ht_free(context);
+        return NULL;
+    }
+    _ht_timeline_thread_context_attach(context, thread_key);
+
+    do
+    {
+        context->next = (HT_TimelineThreadContext*)ht_atomic_ptr_load((void* volatile*)&timeline->thread_contexts);
+    } while (!ht_atomic_ptr_compare_exchange((void* volatile*)&timeline->thread_contexts, context->next, context));
+
+    return context;
+}
+
+static HT_INLINE HT_TimelineThreadContext*
+_ht_timeline_get_thread_context(HT_Timeline* timeline)
+{
+    HT_TimelineThreadCacheEntry* entry = &_ht_timeline_thread_cache[timeline->serial % HT_TIMELINE_THREAD_CACHE_SIZE];
+
+    if (HT_UNLIKELY(entry->serial != timeline->serial))
+    {
+        HT_TimelineThreadContext* context = _ht_timeline_find_or_create_thread_context(timeline, _ht_timeline_thread_cache);
+        if (context == NULL)
+        {
+            return NULL;
+        }
+        entry->serial = timeline->serial;
+        entry->context = context;
+    }
+
+    return entry->context;
+}
+
+/* Makes sure there's at least @a size bytes available in the current buffer of the context. */
+static HT_INLINE HT_Boolean
+_ht_timeline_thread_context_make_space(HT_Timeline* timeline, HT_TimelineThreadContext* context, size_t size)
+{
+    if (HT_UNLIKELY(context->current->usage > 0 && timeline->buffer_capacity < context->current->usage + size))
+    {
+        if (!_ht_timeline_thread_context_hand_off(timeline, context))
+        {
+            return HT_FALSE;
+        }
+        _ht_timeline_dispatch_ready_nodes(timeline);
+    }
+
+    return HT_TRUE;
+}
+
+static HT_INLINE void
+_ht_timeline_thread_context_handle_flush_request(HT_Timeline* timeline, HT_TimelineThreadContext* context)
+{
+    uint64_t flush_request = ht_atomic_uint64_load(&_ht_timeline_flush_request);
+
+    if (HT_UNLIKELY(context->flush_request != flush_request))
+    {
+        context->flush_request = flush_request;
+        if (context->current->usage > 0)
+        {
+            _ht_timeline_thread_context_hand_off(timeline, context);
+        }
+        _ht_timeline_dispatch_ready_nodes(timeline);
+    }
+}
+
+static void
+_ht_timeline_push_event_per_thread_buffer(HT_Timeline* timeline, HT_Event* event)
+{
+    HT_TimelineThreadContext* context = _ht_timeline_get_thread_context(timeline);
+    HT_Boolean compact = HT_FALSE;
+    size_t size;
+
+    if (HT_UNLIKELY(context == NULL))
+    {
+        return;
+    }
+
+    if (timeline->serialize_events && !timeline->compact_serialization)
+    {
+        if (HT_LIKELY(_ht_timeline_try_write_serialized_event(
+                          timeline, event, context->current->data, &context->current->usage, &size)))
+        {
+            goto done;
+        }
+    }
+    else
+    {
+        size = _ht_timeline_get_event_size(timeline, event);
+        compact = _ht_timeline_use_compact_serialization(timeline, event, size);
+        if (compact)
+        {
+            size = HT_TIMELINE_COMPACT_MAX_SIZE(size);
+        }
+    }
+
+    if (!_ht_timeline_thread_context_make_space(timeline, context, size))
+    {
+        return;
+    }
+
+    if (HT_UNLIKELY(timeline->buffer_capacity < size))
+    {
+        HT_TimelineBufferNode* node = _ht_timeline_buffer_node_create(size, NULL);
+        if (node == NULL)
+        {
+            return;
+        }
+        _ht_timeline_write_event(timeline, event, node->data, size);
+        node->usage = size;
+        _ht_timeline_buffer_node_push(&timeline->ready_nodes, node);
+        _ht_timeline_dispatch_ready_nodes(timeline);
+    }
+    else if (compact)
+    {
+        context->current->usage += _ht_timeline_write_compact_event(
+                    &context->compact, event, context->current->data, context->current->usage);
+    }
+    else
+    {
+        _ht_timeline_write_event(timeline, event, context->current->data + context->current->usage, size);
+        context->current->usage += size;
+    }
+
+done:
+    _ht_timeline_thread_context_handle_flush_request(timeline, context);
+}
+
+static void
+_ht_timeline_flush_per_thread_buffer(HT_Timeline* timeline)
+{
+    HT_TimelineThreadContext* context = _ht_timeline_get_thread_context(timeline);
+
+    if (context != NULL && context->current->usage > 0)
+    {
+        _ht_timeline_thread_context_hand_off(timeline, context);
     }
+
+    _ht_timeline_dispatch_ready_nodes(timeline);
 }
 
-void
-ht_timeline_init_event(HT_Timeline* timeline, HT_Event* event)
+/* Detaches the context from its thread (if the thread is still running).
+ * Returns HT_TRUE if the thread still references the context. */
+static HT_Boolean
+_ht_timeline_thread_context_detach(HT_TimelineThreadContext* context)
 {
-    event->timestamp = ht_monotonic_clock_get_timestamp();
-    event->id = ht_event_id_provider_next(timeline->id_provider);
+    for (;;)
+    {
+        long state = ht_atomic_long_load(&context->state);
+
+        if (state == HT_TIMELINE_THREAD_CONTEXT_EXITING)
+        {
+            /* the thread is just handing off its buffer */
+            continue;
+        }
+
+        if (state != HT_TIMELINE_THREAD_CONTEXT_ACTIVE || !context->in_thread_list)
+        {
+            return HT_FALSE;
+        }
+
+        if (ht_atomic_long_compare_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_ACTIVE, HT_TIMELINE_THREAD_CONTEXT_DETACHING))
+        {
+            return HT_TRUE;
+        }
+    }
 }
 
-void
-ht_timeline_push_event(HT_Timeline* timeline, HT_Event* event)
+/* Must not be called when any other thread pushes events to the timeline. */
+static void
+_ht_timeline_destroy_thread_contexts(HT_Timeline* timeline)
 {
-    HT_EventKlass* klass = HT_EVENT_GET_KLASS(event);
+    HT_TimelineThreadContext* context;
 
-    assert(timeline);
-    assert(event);
+    for (context = timeline->thread_contexts; context; context = context->next)
+    {
+        _ht_timeline_thread_context_detach(context);
 
-    _TIMELINE_LOCK(timeline, lock);
+        if (context->current == NULL)
+        {
+            continue;
+        }
+        if (context->current->usage > 0)
+        {
+            _ht_timeline_buffer_node_push(&timeline->ready_nodes, context->current);
+        }
+        else
+        {
+            ht_free(context->current);
+        }
+        context->current = NULL;
+    }
 
-    if (timeline->serialize_events)
+    _ht_timeline_dispatch_ready_nodes(timeline);
+
+    context = timeline->thread_contexts;
+    while (context)
+    {
+        HT_TimelineThreadContext* next = context->next;
+        _ht_timeline_buffer_node_list_destroy(context->free_nodes);
+        _ht_timeline_buffer_node_list_destroy(context->returned_nodes);
+        context->free_nodes = NULL;
+        context->returned_nodes = NULL;
+        /* if the thread is still running, it frees the context once it exits */
+        if (!ht_atomic_long_compare_exchange(&context->state, HT_TIMELINE_THREAD_CONTEXT_DETACHING, HT_TIMELINE_THREAD_CONTEXT_DETACHED))
+        {
+            ht_free(context);
+        }
+        context = next;
+    }
+    timeline->thread_contexts = NULL;
+}
+
+/* Must be called with the timeline lock held. */
+static HT_INLINE void
+_ht_timeline_push_event_locked(HT_Timeline* timeline, HT_Event* event)
+{
+    size_t size;
+    HT_Boolean compact = HT_FALSE;
+
+    if (timeline->serialize_events && !timeline->compact_serialization)
+    {
+        if (HT_LIKELY(_ht_timeline_try_write_serialized_event(
+                          timeline, event, timeline->buffer, &timeline->buffer_usage, &size)))
+        {
+            return;
+        }
+    }
+    else
     {
-        size_t size = klass->get_size(event);
-        if (timeline->buffer_capacity < timeline->buffer_usage + size)
+        size = _ht_timeline_get_event_size(timeline, event);
+        compact = _ht_timeline_use_compact_serialization(timeline, event, size);
+        if (compact)
         {
-            _ht_timeline_flush(timeline);
+            size = HT_TIMELINE_COMPACT_MAX_SIZE(size);
         }
+    }
+
+    if (timeline->buffer_capacity < timeline->buffer_usage + size)
+    {
+        _ht_timeline_flush(timeline);
+    }
 
-        if (timeline->buffer_capacity < size)
+    if (timeline->buffer_capacity < size)
+    {
+        if (timeline->serialize_events)
         {
             HT_Byte local_buffer[128];
             if (size > sizeof(local_buffer)/sizeof(local_buffer[0]))
             {
                 HT_Byte* buff = (HT_Byte*)ht_alloc(size);
                 event->klass->serialize(event, buff);
-                ht_timeline_listener_container_notify_listeners(timeline->listeners, buff, size, timeline->serialize_events);
+                _ht_timeline_notify_listeners(timeline, buff, size);
                 ht_free(buff);
             }
             else
             {
                 event->klass->serialize(event, local_buffer);
-                ht_timeline_listener_container_notify_listeners(timeline->listeners, local_buffer, size, timeline->serialize_events);
+                _ht_timeline_notify_listeners(timeline, local_buffer, size);
             }
         }
         else
         {
-            event->klass->serialize(event, timeline->buffer + timeline->buffer_usage);
-            timeline->buffer_usage += size;
+            _ht_timeline_notify_listeners(timeline, (TEventPtr)event, size);
+        }
+    }
+    else if (compact)
+    {
+        timeline->buffer_usage += _ht_timeline_write_compact_event(
+                    &timeline->compact, event, timeline->buffer, timeline->buffer_usage);
+    }
+    else
+    {
+        _ht_timeline_write_event(timeline, event, timeline->buffer + timeline->buffer_usage, size);
+        timeline->buffer_usage += size;
+    }
+}
+
+void
+ht_timeline_push_event(HT_Timeline* timeline, HT_Event* event)
+{
+    assert(timeline);
+    assert(event);
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        _ht_timeline_push_event_per_thread_buffer(timeline, event);
+        return;
+    }
+
+    _TIMELINE_LOCK(timeline, lock);
+
+    _ht_timeline_push_event_locked(timeline, event);
+
+    _ht_timeline_handle_flush_request(timeline);
+
+    _TIMELINE_LOCK(timeline, unlock);
+}
+
+#define HT_TIMELINE_EVENT_AT_(events, index, stride) ((HT_Event*)((HT_Byte*)(events) + (index) * (stride)))
+
+void
+ht_timeline_push_events(HT_Timeline* timeline, HT_EventKlass* klass, HT_Event* events, size_t count)
+{
+    size_t stride;
+    size_t i = 0;
+
+    assert(timeline);
+    assert(klass);
+    assert(events || count == 0);
+
+    stride = klass->type_info->size;
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        for (i = 0; i < count; i++)
+        {
+            _ht_timeline_push_event_per_thread_buffer(timeline, HT_TIMELINE_EVENT_AT_(events, i, stride));
+        }
+        return;
+    }
+
+    _TIMELINE_LOCK(timeline, lock);
+
+    while (i < count)
+    {
+        if (!timeline->serialize_events)
+        {
+            /* events are stored as they are, so all the events which fit into the buffer are copied at once */
+            size_t batch_count = (timeline->buffer_capacity - timeline->buffer_usage) / stride;
+            if (batch_count > count - i)
+            {
+                batch_count = count - i;
+            }
+            if (batch_count > 0)
+            {
+                memcpy(timeline->buffer + timeline->buffer_usage, HT_TIMELINE_EVENT_AT_(events, i, stride), batch_count * stride);
+                timeline->buffer_usage += batch_count * stride;
+                i += batch_count;
+                continue;
+            }
         }
+
+        _ht_timeline_push_event_locked(timeline, HT_TIMELINE_EVENT_AT_(events, i, stride));
+        i++;
+    }
+
+    _ht_timeline_handle_flush_request(timeline);
+
+    _TIMELINE_LOCK(timeline, unlock);
+}
+
+/* Events built by ht_timeline_push_event_columns() which fit into the size are stored on the stack. */
+#define HT_TIMELINE_COLUMNS_SCRATCH_SIZE 256
+
+void
+ht_timeline_push_event_columns(HT_Timeline* timeline, HT_Event* prototype, const void* const* columns, size_t count)
+{
+    union
+    {
+        HT_Byte data[HT_TIMELINE_COLUMNS_SCRATCH_SIZE];
+        /* makes sure fields of the event are aligned */
+        uint64_t u64;
+        double d;
+        void* ptr;
+    } scratch;
+    MKCREFLECT_TypeInfo* type_info;
+    HT_Event* event;
+    size_t i, j;
+
+    assert(timeline);
+    assert(prototype);
+    assert(columns || count == 0);
+
+    type_info = HT_EVENT_GET_KLASS(prototype)->type_info;
+    if (HT_LIKELY(type_info->size <= sizeof(scratch.data)))
+    {
+        event = (HT_Event*)scratch.data;
     }
     else
     {
-        if (timeline->buffer_capacity < timeline->buffer_usage + klass->type_info->size)
+        event = (HT_Event*)ht_alloc(type_info->size);
+        if (event == NULL)
+        {
+            return;
+        }
+    }
+    memcpy(event, prototype, type_info->size);
+
+    if (timeline->thread_safety != HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        _TIMELINE_LOCK(timeline, lock);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        /* the first field is the base, which is taken from the prototype */
+        for (j = 1; j < type_info->fields_count; j++)
         {
-            _ht_timeline_flush(timeline);
+            MKCREFLECT_FieldInfo* field = &type_info->fields[j];
+            memcpy((HT_Byte*)event + field->offset, (const HT_Byte*)columns[j - 1] + i * field->size, field->size);
         }
+        event->id = ht_event_id_provider_next(timeline->id_provider);
 
-        if (timeline->buffer_capacity < klass->type_info->size)
+        if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
         {
-            ht_timeline_listener_container_notify_listeners(timeline->listeners, (TEventPtr)event, klass->type_info->size, timeline->serialize_events);
+            _ht_timeline_push_event_per_thread_buffer(timeline, event);
         }
         else
         {
-            memcpy(timeline->buffer + timeline->buffer_usage, event, klass->type_info->size);
-            timeline->buffer_usage += klass->type_info->size;
+            _ht_timeline_push_event_locked(timeline, event);
+        }
+    }
+
+    if (timeline->thread_safety != HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        _ht_timeline_handle_flush_request(timeline);
+        _TIMELINE_LOCK(timeline, unlock);
+    }
+
+    if (event != (HT_Event*)scratch.data)
+    {
+        ht_free(event);
+    }
+}
+
+HT_Byte*
+ht_timeline_reserve(HT_Timeline* timeline, size_t size)
+{
+    assert(timeline);
+
+    if (HT_UNLIKELY(timeline->buffer_capacity < size) || timeline->compact_serialization)
+    {
+        return NULL;
+    }
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        HT_TimelineThreadContext* context = _ht_timeline_get_thread_context(timeline);
+
+        if (HT_UNLIKELY(context == NULL) || !_ht_timeline_thread_context_make_space(timeline, context, size))
+        {
+            return NULL;
         }
+
+        return context->current->data + context->current->usage;
+    }
+
+    _TIMELINE_LOCK(timeline, lock);
+
+    if (timeline->buffer_capacity < timeline->buffer_usage + size)
+    {
+        _ht_timeline_flush(timeline);
+    }
+
+    return timeline->buffer + timeline->buffer_usage;
+}
+
+void
+ht_timeline_commit(HT_Timeline* timeline, size_t size)
+{
+    assert(timeline);
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        HT_TimelineThreadContext* context = _ht_timeline_get_thread_context(timeline);
+
+        context->current->usage += size;
+        _ht_timeline_thread_context_handle_flush_request(timeline, context);
+        return;
     }
 
+    timeline->buffer_usage += size;
+
+    _ht_timeline_handle_flush_request(timeline);
+
     _TIMELINE_LOCK(timeline, unlock);
 }
 
+HT_Boolean
+ht_timeline_get_serialize_events(HT_Timeline* timeline)
+{
+    return timeline->serialize_events;
+}
+
 void
 ht_timeline_flush(HT_Timeline* timeline)
 {
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        _ht_timeline_flush_per_thread_buffer(timeline);
+        return;
+    }
+
+    _TIMELINE_LOCK(timeline, lock);
+
+    if (timeline->dispatcher)
+    {
+        /* explicit flush never drops events, and doesn't wait for listeners with the lock held */
+        if (timeline->buffer_usage)
+        {
+            timeline->buffer = ht_buffer_dispatcher_flush(timeline->dispatcher, timeline->buffer, timeline->buffer_usage);
+            timeline->buffer_usage = 0;
+        }
+        timeline->compact.block_end = HT_TIMELINE_COMPACT_NO_BLOCK;
+    }
+    else
+    {
+        _ht_timeline_flush(timeline);
+    }
+
+    _TIMELINE_LOCK(timeline, unlock);
+
+    if (timeline->dispatcher)
+    {
+        ht_buffer_dispatcher_wait_idle(timeline->dispatcher);
+    }
+}
+
+void
+ht_timeline_request_flush_all(void)
+{
+    ht_atomic_uint64_fetch_add(&_ht_timeline_flush_request, 1);
+}
+
+static void
+_ht_timeline_flush_from_any_thread(HT_Timeline* timeline, void* user_data)
+{
+    (void)user_data;
+
+    switch (timeline->thread_safety)
+    {
+    case HT_TIMELINE_THREAD_SAFETY_LOCK:
+        ht_timeline_flush(timeline);
+        break;
+    case HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER:
+        /* buffers being filled belong to their threads */
+        _ht_timeline_dispatch_ready_nodes(timeline);
+        break;
+    default:
+        /* flushed on the next push (see ht_timeline_request_flush_all()) */
+        break;
+    }
+}
+
+void
+ht_timeline_flush_all(void)
+{
+    ht_timeline_request_flush_all();
+    /* listeners can be slow (or create timelines), so the registry isn't locked while flushing */
+    ht_registry_for_each_timeline_unlocked(_ht_timeline_flush_from_any_thread, NULL);
+}
+
+HT_ErrorCode
+ht_timeline_enable_async_flush(HT_Timeline* timeline, size_t pool_depth, HT_AsyncFlushPolicy policy)
+{
+    HT_ErrorCode error_code = HT_ERR_OK;
+    HT_BufferDispatcher* dispatcher;
+
+    assert(timeline);
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER || timeline->dispatcher)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    dispatcher = ht_buffer_dispatcher_create(timeline->buffer_capacity, pool_depth, policy,
+                                             _ht_timeline_dispatcher_callback, timeline, &error_code);
+    if (dispatcher == NULL)
+    {
+        return error_code;
+    }
+
     _TIMELINE_LOCK(timeline, lock);
 
     _ht_timeline_flush(timeline);
+    ht_free(timeline->buffer);
+    timeline->buffer = ht_buffer_dispatcher_get_buffer(dispatcher);
+    timeline->dispatcher = dispatcher;
 
     _TIMELINE_LOCK(timeline, unlock);
+
+    return HT_ERR_OK;
+}
+
+HT_ErrorCode
+ht_timeline_enable_compact_serialization(HT_Timeline* timeline)
+{
+    assert(timeline);
+
+    if (!timeline->serialize_events)
+    {
+        return HT_ERR_INVALID_ARGUMENT;
+    }
+
+    timeline->compact_serialization = HT_TRUE;
+
+    return HT_ERR_OK;
+}
+
+uint64_t
+ht_timeline_get_dropped_buffer_count(HT_Timeline* timeline)
+{
+    return timeline->dispatcher ? ht_buffer_dispatcher_get_dropped_count(timeline->dispatcher) : 0;
 }
 
 HT_ErrorCode
@@ -186,6 +1238,20 @@ ht_timeline_create(size_t buffer_capacity,
                    HT_Boolean serialize_events,
                    const char* listeners,
                    HT_ErrorCode* out_err)
+{
+    return ht_timeline_create_full(buffer_capacity,
+                                   thread_safe ? HT_TIMELINE_THREAD_SAFETY_LOCK : HT_TIMELINE_THREAD_SAFETY_NONE,
+                                   serialize_events,
+                                   listeners,
+                                   out_err);
+}
+
+HT_Timeline*
+ht_timeline_create_full(size_t buffer_capacity,
+                        HT_TimelineThreadSafety thread_safety,
+                        HT_Boolean serialize_events,
+                        const char* listeners,
+                        HT_ErrorCode* out_err)
 {
     HT_ErrorCode error_code = HT_ERR_OK;
     HT_Timeline* timeline = HT_CREATE_TYPE(HT_Timeline);
@@ -195,12 +1261,20 @@ ht_timeline_create(size_t buffer_capacity,
         goto done;
     }
 
-    timeline->buffer = (HT_Byte*)ht_alloc(buffer_capacity);
-
-    if (timeline->buffer == NULL)
+    if (thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
     {
-        error_code = HT_ERR_OUT_OF_MEMORY;
-        goto error_allocate_buffer;
+        /* each thread allocates its own buffers */
+        timeline->buffer = NULL;
+    }
+    else
+    {
+        timeline->buffer = (HT_Byte*)ht_alloc(buffer_capacity);
+
+        if (timeline->buffer == NULL)
+        {
+            error_code = HT_ERR_OUT_OF_MEMORY;
+            goto error_allocate_buffer;
+        }
     }
 
     timeline->listeners = ht_find_or_create_listener(listeners);
@@ -210,7 +1284,7 @@ ht_timeline_create(size_t buffer_capacity,
         goto error_create_listener;
     }
 
-    if (thread_safe)
+    if (thread_safety == HT_TIMELINE_THREAD_SAFETY_LOCK)
     {
         timeline->locking_policy = ht_mutex_create();
         if (timeline->locking_policy == NULL)
@@ -228,10 +1302,30 @@ ht_timeline_create(size_t buffer_capacity,
     timeline->buffer_capacity = buffer_capacity;
     timeline->id_provider = ht_event_id_provider_get_default();
     timeline->serialize_events = serialize_events;
+    timeline->thread_safety = thread_safety;
+    timeline->serial = ht_atomic_uint64_fetch_add(&_ht_timeline_last_serial, 1) + 1;
+    timeline->thread_contexts = NULL;
+    timeline->ready_nodes = NULL;
+    timeline->dispatching = 0;
+    timeline->dispatcher = NULL;
+    timeline->flush_request = ht_atomic_uint64_load(&_ht_timeline_flush_request);
+    timeline->compact_serialization = HT_FALSE;
+    timeline->compact.block_end = HT_TIMELINE_COMPACT_NO_BLOCK;
     memset(timeline->features, 0, sizeof(timeline->features));
 
+    error_code = ht_registry_register_timeline(timeline);
+    if (error_code != HT_ERR_OK)
+    {
+        goto error_register_timeline;
+    }
+
     goto done;
 
+error_register_timeline:
+    if (timeline->locking_policy)
+    {
+        ht_mutex_destroy(timeline->locking_policy);
+    }
 error_locking_policy:
     ht_timeline_listener_container_unref(timeline->listeners);
 error_create_listener:
@@ -252,8 +1346,27 @@ ht_timeline_destroy(HT_Timeline* timeline)
 
     assert(timeline);
 
-    ht_timeline_flush(timeline);
-    ht_free(timeline->buffer);
+    /* other threads can't access the timeline afterwards (see ht_timeline_flush_all()) */
+    ht_registry_unregister_timeline(timeline);
+
+    if (timeline->thread_safety == HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER)
+    {
+        _ht_timeline_destroy_thread_contexts(timeline);
+    }
+    else
+    {
+        ht_timeline_flush(timeline);
+    }
+
+    if (timeline->dispatcher)
+    {
+        /* the buffer belongs to the dispatcher's pool */
+        ht_buffer_dispatcher_destroy(timeline->dispatcher);
+    }
+    else
+    {
+        ht_free(timeline->buffer);
+    }
 
     ht_timeline_listener_container_unref(timeline->listeners);
 
@@ -206,6 +206,7 @@ ht_timeline_listener_push_metadata(HT_TimelineListenerCallback callback, void* l
     size += ht_system_info_push_endianness_info_to_listener(callback, listener, serialize);
     size += ht_registry_push_registry_klasses_to_listener(callback, listener, serialize);
     size += ht_system_info_push_system_info_to_listener(callback, listener, serialize);
+    size += ht_system_info_push_clock_calibration_to_listener(callback, listener, serialize);
 
     return size;
 }
@@ -1,8 +1,13 @@
 #include "hawktracer/parser/file_stream.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace HawkTracer {
 namespace parser {
 
+#define FILE_STREAM_CHUNK_SIZE (64 * 1024)
+
 FileStream::FileStream(std::string file_name) :
     _file_name(std::move(file_name))
 {
@@ -16,6 +21,10 @@ FileStream::~FileStream()
 bool FileStream::start()
 {
     _file = fopen(_file_name.c_str(), "rb");
+    _decoder = StreamDecoder();
+    _buffer.clear();
+    _buffer_pos = 0;
+    _error = false;
     return _file != nullptr;
 }
 
@@ -28,15 +37,60 @@ void FileStream::stop()
     }
 }
 
+bool FileStream::_fill_buffer()
+{
+    char chunk[FILE_STREAM_CHUNK_SIZE];
+
+    _buffer.clear();
+    _buffer_pos = 0;
+
+    // compressed frame might not produce any data until the whole frame is read
+    while (_buffer.empty() && _file)
+    {
+        size_t size = fread(chunk, 1, sizeof(chunk), _file);
+        if (size == 0)
+        {
+            // a partial frame left in the decoder means the file is truncated
+            _error = !_decoder.finish(_buffer);
+            stop();
+        }
+        else if (!_decoder.decode(chunk, size, _buffer))
+        {
+            _error = true;
+            stop();
+        }
+    }
+
+    return !_buffer.empty();
+}
+
 bool FileStream::read_data(char* buff, size_t size)
 {
-    fread(buff, 1, size, _file);
-    return !feof(_file);
+    while (size > 0)
+    {
+        if (_buffer_pos == _buffer.size() && !_fill_buffer())
+        {
+            return false;
+        }
+
+        size_t count = std::min(size, _buffer.size() - _buffer_pos);
+        memcpy(buff, _buffer.data() + _buffer_pos, count);
+        _buffer_pos += count;
+        buff += count;
+        size -= count;
+    }
+
+    return true;
 }
 
 int FileStream::read_byte()
 {
-    return fgetc(_file);
+    if (_buffer_pos == _buffer.size() && !_fill_buffer())
+    {
+        return -1;
+    }
+
+    return static_cast<unsigned char>(_buffer[_buffer_pos++]);
 }
 
 } // namespace parser
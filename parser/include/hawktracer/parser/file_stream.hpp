@@ -2,8 +2,10 @@
 #define HAWKTRACER_PARSER_FILE_STREAM_HPP
 
 #include <hawktracer/parser/stream.hpp>
+#include <hawktracer/parser/stream_decoder.hpp>
 
 #include <cstdio>
+#include <vector>
 
 namespace HawkTracer {
 namespace parser {
@@ -20,10 +22,17 @@ public:
     int read_byte() override;
 
     bool is_continuous() override { return false; }
+    bool has_error() override { return _error; }
 
 private:
+    bool _fill_buffer();
+
     FILE* _file = nullptr;
     std::string _file_name;
+    StreamDecoder _decoder;
+    std::vector<char> _buffer;
+    size_t _buffer_pos = 0;
+    bool _error = false;
 };
 
 } // namespace parser
@@ -31,13 +31,21 @@ public:
 
     bool eos() const { return !_is_running; }
     void wait_for_complete();
+    // true if reading stopped because the stream was truncated or malformed
+    bool has_stream_error() const { return !_is_running && _stream->has_error(); }
 
 private:
     void _read_events();
+    bool _read_event_payload(Event base_event);
     void _read_event(bool& is_error, Event& event, Event* base_event);
     bool _read_string(FieldType& value);
     bool _read_numeric(FieldType& value, const EventKlassField& field);
     bool _read_struct(FieldType& value, const EventKlassField& field, Event* event, Event* base_event);
+    bool _read_compact_block(const Event& block_base_event);
+    bool _read_compact_base_event(Event& base_event);
+    bool _read_varint(uint64_t& value);
+    int _read_byte();
+    bool _read_data(char* buff, size_t size);
 
     void _call_callbacks(const Event& event);
 
@@ -50,6 +58,12 @@ private:
     std::mutex _mtx_cv;
     bool _flat_events;
     HT_Endianness _endianness = HT_ENDIANNESS_LITTLE;
+    uint64_t _position = 0;
+    // State of the compact block being read (see compact_encoding.h)
+    HT_EventKlassId _compact_block_klass_id = HT_INVALID_KLASS_ID;
+    bool _compact = false;
+    HT_TimestampNs _compact_timestamp = 0;
+    HT_EventId _compact_id = 0;
 };
 
 } // namespace parser
@@ -67,6 +67,12 @@ public:
     }
 
     virtual bool is_continuous() = 0;
+
+    // true if the stream ended because the data was truncated or malformed
+    virtual bool has_error()
+    {
+        return false;
+    }
 };
 
 } // namespace parser
@@ -0,0 +1,60 @@
+#ifndef HAWKTRACER_PARSER_STREAM_DECODER_HPP
+#define HAWKTRACER_PARSER_STREAM_DECODER_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace HawkTracer {
+namespace parser {
+
+/**
+ * Converts the data produced by listeners to a raw event stream.
+ *
+ * If the stream starts with the compressed stream marker (see hawktracer/compression.h),
+ * frames are decompressed; otherwise, the data is passed through unchanged.
+ * The data can be provided in chunks of any size.
+ */
+class StreamDecoder
+{
+public:
+    /**
+     * Decodes a chunk of the stream.
+     *
+     * @param data the chunk of the stream.
+     * @param size a size of the chunk.
+     * @param out a buffer where the decoded data is appended to.
+     *
+     * @return true if the chunk has been decoded; false if the stream is malformed.
+     */
+    bool decode(const char* data, size_t size, std::vector<char>& out);
+
+    /**
+     * Notifies the decoder that there's no more data in the stream.
+     *
+     * @param out a buffer where the remaining decoded data is appended to.
+     *
+     * @return true if the stream ended on a frame boundary; otherwise, false.
+     */
+    bool finish(std::vector<char>& out);
+
+    bool is_compressed() const { return _state == State::COMPRESSED; }
+
+private:
+    enum class State
+    {
+        DETECTING,
+        RAW,
+        COMPRESSED
+    };
+
+    bool _decode_frames(std::vector<char>& out);
+
+    State _state = State::DETECTING;
+    std::vector<char> _pending;
+    size_t _pending_pos = 0;
+};
+
+} // namespace parser
+} // namespace HawkTracer
+
+#endif // HAWKTRACER_PARSER_STREAM_DECODER_HPP
@@ -19,6 +19,11 @@ ProtocolReader::ProtocolReader(KlassRegister* klass_register, std::unique_ptr<St
 {
     register_events_listener([this] (const Event& event) {
         _klass_register->handle_register_events(event);
+        if (event.get_klass()->get_id() == to_underlying(WellKnownKlasses::EventKlassInfoEventKlass) &&
+                std::strcmp(event.get_value<char*>("event_klass_name"), "HT_CompactBlockEvent") == 0)
+        {
+            _compact_block_klass_id = event.get_value<HT_EventKlassId>("info_klass_id");
+        }
     });
 }
 
@@ -68,45 +73,144 @@ void ProtocolReader::_read_events()
         Event base_event(_klass_register->get_klass(to_underlying(WellKnownKlasses::EventKlass)));
         _read_event(is_error, base_event, nullptr);
 
-        if (is_error)
+        if (is_error || !_read_event_payload(std::move(base_event)))
         {
             break;
         }
+    }
 
-        auto klass_id = base_event.get_value<uint32_t>("klass_id");
+    _is_running = false;
+    _cv.notify_one();
+}
 
-        if (klass_id == to_underlying(WellKnownKlasses::EventKlass))
-        {
-            _call_callbacks(base_event);
-            continue;
-        }
+bool ProtocolReader::_read_event_payload(Event base_event)
+{
+    bool is_error = false;
+    auto klass_id = base_event.get_value<uint32_t>("klass_id");
 
-        Event event(_klass_register->get_klass(base_event.get_value<uint32_t>("klass_id")));
-        if (_flat_events)
-        {
-            _read_event(is_error, event, nullptr);
-            event.merge(std::move(base_event));
-        }
-        else
-        {
-            _read_event(is_error, event, &base_event);
-        }
+    if (klass_id == to_underlying(WellKnownKlasses::EventKlass))
+    {
+        _call_callbacks(base_event);
+        return true;
+    }
+
+    if (klass_id == _compact_block_klass_id && !_compact)
+    {
+        return _read_compact_block(base_event);
+    }
+
+    Event event(_klass_register->get_klass(klass_id));
+    if (_flat_events)
+    {
+        _read_event(is_error, event, nullptr);
+        event.merge(std::move(base_event));
+    }
+    else
+    {
+        _read_event(is_error, event, &base_event);
+    }
+
+    if (is_error)
+    {
+        return false;
+    }
+
+    if (klass_id == to_underlying(WellKnownKlasses::EndiannessInfoEventKlass))
+    {
+        _endianness = static_cast<HT_Endianness>(event.get_value<uint8_t>("endianness"));
+    }
+
+    _call_callbacks(event);
+    return true;
+}
+
+static uint64_t decode_zigzag(uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+bool ProtocolReader::_read_compact_block(const Event& block_base_event)
+{
+    uint32_t size;
+    if (!_read_data(reinterpret_cast<char*>(&size), sizeof(size)))
+    {
+        return false;
+    }
+    size = convert_endianness_to_native(size, _endianness);
+
+    _compact_timestamp = block_base_event.get_value<HT_TimestampNs>("timestamp");
+    _compact_id = block_base_event.get_value<HT_EventId>("id");
+    _compact = true;
 
-        if (is_error)
+    uint64_t end = _position + size;
+    bool ok = true;
+    while (ok && _position < end)
+    {
+        Event base_event(_klass_register->get_klass(to_underlying(WellKnownKlasses::EventKlass)));
+        ok = _read_compact_base_event(base_event) && _read_event_payload(std::move(base_event));
+    }
+
+    _compact = false;
+    return ok && _position == end;
+}
+
+bool ProtocolReader::_read_compact_base_event(Event& base_event)
+{
+    uint64_t klass_id, timestamp_delta, id_delta;
+    if (!_read_varint(klass_id) || !_read_varint(timestamp_delta) || !_read_varint(id_delta))
+    {
+        return false;
+    }
+
+    _compact_timestamp += decode_zigzag(timestamp_delta);
+    _compact_id += decode_zigzag(id_delta);
+
+    auto klass = base_event.get_klass();
+    base_event.set_value(klass->get_field("klass_id", false).get(), static_cast<uint32_t>(klass_id));
+    base_event.set_value(klass->get_field("timestamp", false).get(), _compact_timestamp);
+    base_event.set_value(klass->get_field("id", false).get(), _compact_id);
+
+    return true;
+}
+
+bool ProtocolReader::_read_varint(uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        int c = _read_byte();
+        if (c < 0)
         {
-            break;
+            return false;
         }
-
-        if (klass_id == to_underlying(WellKnownKlasses::EndiannessInfoEventKlass))
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
         {
-            _endianness = static_cast<HT_Endianness>(event.get_value<uint8_t>("endianness"));
+            return true;
         }
+    }
 
-        _call_callbacks(event);
+    return false;
+}
+
+int ProtocolReader::_read_byte()
+{
+    int c = _stream->read_byte();
+    if (c >= 0)
+    {
+        _position++;
     }
+    return c;
+}
 
-    _is_running = false;
-    _cv.notify_one();
+bool ProtocolReader::_read_data(char* buff, size_t size)
+{
+    if (!_stream->read_data(buff, size))
+    {
+        return false;
+    }
+    _position += size;
+    return true;
 }
 
 void ProtocolReader::_read_event(bool& is_error, Event& event, Event* base_event)
@@ -154,7 +258,7 @@ bool ProtocolReader::_read_string(FieldType& value)
     }
 
     int c;
-    while ((c = _stream->read_byte()) > 0)
+    while ((c = _read_byte()) > 0)
     {
         data[pos++] = (char)c;
         if (pos == length)
@@ -184,8 +288,36 @@ bool ProtocolReader::_read_string(FieldType& value)
 
 bool ProtocolReader::_read_numeric(FieldType& value, const EventKlassField& field)
 {
+    if (_compact && field.is_numeric())
+    {
+        uint64_t v;
+        if (!_read_varint(v))
+        {
+            return false;
+        }
+
+        switch (field.get_type_id())
+        {
+#define SET_VALUE(field_id, c_type) case FieldTypeId::field_id: value.f_##field_id = static_cast<c_type>(v); break
+#define SET_SIGNED_VALUE(field_id, c_type) case FieldTypeId::field_id: value.f_##field_id = static_cast<c_type>(decode_zigzag(v)); break
+        SET_VALUE(UINT8, uint8_t);
+        SET_SIGNED_VALUE(INT8, int8_t);
+        SET_VALUE(UINT16, uint16_t);
+        SET_SIGNED_VALUE(INT16, int16_t);
+        SET_VALUE(UINT32, uint32_t);
+        SET_SIGNED_VALUE(INT32, int32_t);
+        SET_VALUE(UINT64, uint64_t);
+        SET_SIGNED_VALUE(INT64, int64_t);
+#undef SET_SIGNED_VALUE
+#undef SET_VALUE
+        default: assert(0); return false;
+        }
+
+        return true;
+    }
+
     char buff[16];
-    if (!_stream->read_data(buff, field.get_sizeof()))
+    if (!_read_data(buff, field.get_sizeof()))
     {
         return false;
     }
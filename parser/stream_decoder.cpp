@@ -0,0 +1,117 @@
+#include "hawktracer/parser/stream_decoder.hpp"
+
+#include <hawktracer/compression.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace HawkTracer {
+namespace parser {
+
+bool StreamDecoder::decode(const char* data, size_t size, std::vector<char>& out)
+{
+    switch (_state)
+    {
+    case State::RAW:
+        out.insert(out.end(), data, data + size);
+        return true;
+
+    case State::DETECTING:
+    {
+        size_t count = std::min(size, HT_COMPRESSION_STREAM_MAGIC_SIZE - _pending.size());
+        _pending.insert(_pending.end(), data, data + count);
+        data += count;
+        size -= count;
+
+        if (memcmp(_pending.data(), HT_COMPRESSION_STREAM_MAGIC, _pending.size()) != 0)
+        {
+            _state = State::RAW;
+            out.insert(out.end(), _pending.begin(), _pending.end());
+            out.insert(out.end(), data, data + size);
+            _pending.clear();
+            return true;
+        }
+
+        if (_pending.size() < HT_COMPRESSION_STREAM_MAGIC_SIZE)
+        {
+            return true;
+        }
+
+        _state = State::COMPRESSED;
+        _pending.clear();
+    }
+        /* fall through */
+    case State::COMPRESSED:
+        _pending.insert(_pending.end(), data, data + size);
+        return _decode_frames(out);
+    }
+
+    return false;
+}
+
+bool StreamDecoder::_decode_frames(std::vector<char>& out)
+{
+    bool ok = true;
+
+    while (_pending.size() - _pending_pos >= HT_COMPRESSION_FRAME_HEADER_SIZE)
+    {
+        const HT_Byte* header = reinterpret_cast<const HT_Byte*>(_pending.data() + _pending_pos);
+        uint32_t raw_size, compressed_size;
+        ht_compression_read_frame_header(header, &raw_size, &compressed_size);
+
+        // sizes come from the stream, so they're checked before anything is allocated
+        if (raw_size > HT_COMPRESSION_MAX_FRAME_SIZE
+                || compressed_size > ht_compression_get_max_compressed_size(HT_COMPRESSION_MAX_FRAME_SIZE))
+        {
+            ok = false;
+            break;
+        }
+
+        size_t payload_size = compressed_size ? compressed_size : raw_size;
+        if (_pending.size() - _pending_pos - HT_COMPRESSION_FRAME_HEADER_SIZE < payload_size)
+        {
+            break;
+        }
+
+        const char* payload = _pending.data() + _pending_pos + HT_COMPRESSION_FRAME_HEADER_SIZE;
+        if (compressed_size == 0)
+        {
+            out.insert(out.end(), payload, payload + raw_size);
+        }
+        else
+        {
+            size_t out_size = out.size();
+            out.resize(out_size + raw_size);
+            if (ht_compression_decompress(reinterpret_cast<const HT_Byte*>(payload), compressed_size,
+                                          reinterpret_cast<HT_Byte*>(out.data() + out_size), raw_size) != HT_ERR_OK)
+            {
+                out.resize(out_size);
+                ok = false;
+                break;
+            }
+        }
+
+        _pending_pos += HT_COMPRESSION_FRAME_HEADER_SIZE + payload_size;
+    }
+
+    _pending.erase(_pending.begin(), _pending.begin() + _pending_pos);
+    _pending_pos = 0;
+
+    return ok;
+}
+
+bool StreamDecoder::finish(std::vector<char>& out)
+{
+    if (_state == State::DETECTING)
+    {
+        // stream is shorter than the marker, so it can't be compressed
+        out.insert(out.end(), _pending.begin(), _pending.end());
+        _pending.clear();
+        _state = State::RAW;
+    }
+
+    return _pending.empty();
+}
+
+} // namespace parser
+} // namespace HawkTracer
@@ -149,3 +149,26 @@ TEST(TestCallGraph, TestMultpleCalls)
 }
 
 
+
+TEST(TestCallGraph, WeightedEventsShouldBeCountedWithTheirWeight)
+{
+    // Arrange
+    std::vector<CallGraph::NodeData> events = {
+        CallGraph::NodeData("root", 0, 100, 3),
+        CallGraph::NodeData("child", 10, 20, 3),
+        CallGraph::NodeData("root", 200, 50)
+    };
+    CallGraph call_graph;
+
+    // Act
+    auto response = call_graph.make(events);
+
+    // Assert
+    ASSERT_EQ(1u, response.size());
+    ASSERT_EQ(4, response[0].second);
+    ASSERT_EQ(350u, response[0].first->total_duration);
+    ASSERT_EQ(60u, response[0].first->total_children_duration);
+    ASSERT_EQ(1u, response[0].first->children.size());
+    ASSERT_EQ(3, response[0].first->children[0].second);
+    ASSERT_EQ(60u, response[0].first->children[0].first->total_duration);
+}
@@ -0,0 +1,88 @@
+#include <client/callstack_summary_converter.hpp>
+#include <hawktracer/feature_callstack_aggregation.h>
+#include <hawktracer/parser/make_unique.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using HawkTracer::client::CallstackSummaryConverter;
+using namespace HawkTracer::parser;
+
+class TestCallstackSummaryConverter : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        _summary_klass = std::make_shared<EventKlass>("HT_CallstackSummaryEvent", 100);
+        for (const char* name : {"path_id", "parent_path_id", "frame_label", "count", "total_duration",
+                                 "self_duration", "min_duration", "max_duration"})
+        {
+            _summary_klass->add_field(make_unique<EventKlassField>(name, "uint64_t", FieldTypeId::UINT64));
+        }
+        _histogram_klass = std::make_shared<EventKlass>("HT_CallstackSummaryHistogramEvent", 101);
+        _histogram_klass->add_field(make_unique<EventKlassField>("path_id", "uint64_t", FieldTypeId::UINT64));
+        _histogram_klass->add_field(make_unique<EventKlassField>("bucket", "uint16_t", FieldTypeId::UINT16));
+        _histogram_klass->add_field(make_unique<EventKlassField>("count", "uint32_t", FieldTypeId::UINT32));
+    }
+
+    void push_summary(uint64_t path_id, uint64_t parent_path_id, uint64_t label, uint64_t count,
+                      uint64_t total, uint64_t self, uint64_t min, uint64_t max)
+    {
+        Event event(_summary_klass);
+        uint64_t values[] = {path_id, parent_path_id, label, count, total, self, min, max};
+        size_t i = 0;
+        for (const auto& field : _summary_klass->get_fields())
+        {
+            event.set_value<uint64_t>(field.get(), values[i++]);
+        }
+        _converter.process_event(event);
+    }
+
+    void push_histogram(uint64_t path_id, HT_DurationNs duration, uint32_t count)
+    {
+        Event event(_histogram_klass);
+        auto fields = _histogram_klass->get_fields();
+        event.set_value<uint64_t>(fields[0].get(), path_id);
+        event.set_value<uint16_t>(fields[1].get(), (uint16_t)ht_feature_callstack_aggregation_get_bucket(duration));
+        event.set_value<uint32_t>(fields[2].get(), count);
+        _converter.process_event(event);
+    }
+
+    std::shared_ptr<EventKlass> _summary_klass;
+    std::shared_ptr<EventKlass> _histogram_klass;
+    CallstackSummaryConverter _converter;
+};
+
+TEST_F(TestCallstackSummaryConverter, SummariesShouldBeMergedAndRenderedAsTree)
+{
+    // Arrange
+    push_summary(10, 0, 1, 2, 1000, 400, 400, 600);
+    push_histogram(10, 400, 1);
+    push_histogram(10, 600, 1);
+    push_summary(20, 10, 2, 4, 600, 600, 100, 200);
+    push_histogram(20, 100, 3);
+    push_histogram(20, 200, 1);
+    push_summary(30, 0, 3, 1, 50, 50, 50, 50);
+    push_histogram(30, 50, 1);
+    // next interval
+    push_summary(10, 0, 1, 1, 800, 800, 800, 800);
+    push_histogram(10, 800, 1);
+
+    // Act
+    std::stringstream report;
+    _converter.write_report(report);
+
+    // Assert
+    std::string header;
+    std::getline(report, header);
+    ASSERT_EQ('#', header[0]);
+    std::string line;
+    std::getline(report, line);
+    ASSERT_EQ("1 3 1800 1200 400 600 800 512 768 768", line);
+    std::getline(report, line);
+    ASSERT_EQ("  2 4 600 600 100 150 200 100 192 192", line);
+    std::getline(report, line);
+    ASSERT_EQ("3 1 50 50 50 50 50 50 50 50", line);
+    ASSERT_FALSE(std::getline(report, line));
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include "hawktracer/client_utils/shm_client_stream.hpp"
+#include "hawktracer/client_utils/unix_socket_client_stream.hpp"
+
+#include <hawktracer/listeners/shm_listener.h>
+#include <hawktracer/listeners/tcp_listener.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef __unix__
+
+using HawkTracer::ClientUtils::ShmClientStream;
+using HawkTracer::ClientUtils::UnixSocketClientStream;
+
+static std::vector<char> make_data(size_t size)
+{
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (char)(i * 7 % 253);
+    }
+    return data;
+}
+
+static std::vector<char> read_all(HawkTracer::parser::Stream& stream)
+{
+    std::vector<char> data;
+    int b;
+    while ((b = stream.read_byte()) >= 0)
+    {
+        data.push_back((char)b);
+    }
+    return data;
+}
+
+static bool ends_with(const std::vector<char>& data, const std::vector<char>& suffix)
+{
+    return data.size() >= suffix.size() && std::equal(suffix.begin(), suffix.end(), data.end() - suffix.size());
+}
+
+TEST(TestLocalClientStreams, ShmClientStreamShouldReadAllDataWrittenByListener)
+{
+    // Arrange
+    const size_t chunk_size = 4096;
+    std::vector<char> data = make_data(1024 * 1024);
+    HT_ShmListener* listener = ht_shm_listener_create("ht_shm_client_stream_test_segment", 64 * 1024, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ShmClientStream stream("ht_shm_client_stream_test_segment", false);
+    ASSERT_TRUE(stream.start());
+
+    // Act
+    std::thread producer([&] {
+        /* the ring is much smaller than the data; chunks dropped because
+         * the consumer hasn't read the ring yet are pushed again */
+        for (size_t offset = 0; offset < data.size();)
+        {
+            size_t dropped_size = ht_shm_listener_get_dropped_size(listener);
+            ht_shm_listener_callback((TEventPtr)&data[offset], chunk_size, HT_TRUE, listener);
+            if (ht_shm_listener_get_dropped_size(listener) == dropped_size)
+            {
+                offset += chunk_size;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        ht_shm_listener_stop(listener);
+    });
+    std::vector<char> received = read_all(stream);
+    producer.join();
+
+    // Assert
+    ASSERT_LT(data.size(), received.size());
+    ASSERT_TRUE(ends_with(received, data));
+
+    ht_shm_listener_destroy(listener);
+}
+
+TEST(TestLocalClientStreams, ShmClientStreamShouldFailIfSegmentDoesNotExist)
+{
+    // Arrange
+    ShmClientStream stream("ht_shm_client_stream_non_existing_segment", false);
+
+    // Act & Assert
+    ASSERT_FALSE(stream.start());
+}
+
+TEST(TestLocalClientStreams, UnixSocketClientStreamShouldReadDataWrittenByListener)
+{
+    // Arrange
+    const char* path = "ht_unix_socket_client_stream_test.sock";
+    std::vector<char> data = make_data(256 * 1024);
+    HT_TCPListener* listener = ht_tcp_listener_create_unix_socket(path, 4096, HT_FALSE, nullptr);
+    ASSERT_NE(nullptr, listener);
+    UnixSocketClientStream stream(path, false);
+    ASSERT_TRUE(stream.start());
+    /* the client starts receiving events right after the metadata */
+    int first_byte = stream.read_byte();
+    ASSERT_LE(0, first_byte);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Act
+    std::thread consumer([&] {
+        std::vector<char> received = read_all(stream);
+        ASSERT_TRUE(ends_with(received, data));
+    });
+    ht_tcp_listener_callback((TEventPtr)data.data(), data.size(), HT_TRUE, listener);
+    ht_tcp_listener_destroy(listener);
+    consumer.join();
+
+    // Assert
+    ASSERT_FALSE(UnixSocketClientStream(path, false).start());
+}
+
+#endif /* __unix__ */
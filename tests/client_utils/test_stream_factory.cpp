@@ -46,3 +46,25 @@ TEST(TestStreamFactory, ShouldNotFailIfFileExists)
     // Cleanup
     remove(file_name.c_str());
 }
+
+TEST(TestStreamFactory, ShouldCreateStreamForUnixSocket)
+{
+    // Arrange
+    // Act & Assert
+    ASSERT_TRUE(make_stream_from_string("unix:/tmp/hawktracer.sock"));
+}
+
+TEST(TestStreamFactory, ShouldCreateStreamForSharedMemorySegment)
+{
+    // Arrange
+    // Act & Assert
+    ASSERT_TRUE(make_stream_from_string("shm:hawktracer"));
+}
+
+TEST(TestStreamFactory, ShouldFailIfLocalStreamNameIsEmpty)
+{
+    // Arrange
+    // Act & Assert
+    ASSERT_FALSE(make_stream_from_string("unix:"));
+    ASSERT_FALSE(make_stream_from_string("shm:"));
+}
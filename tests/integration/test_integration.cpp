@@ -74,11 +74,13 @@ public:
     }
 
 protected:
-    static std::vector<HT_Byte> _generate_data(std::function<void(HT_Timeline* timeline)> push_event_callback)
+    static std::vector<HT_Byte> _generate_data(std::function<void(HT_Timeline* timeline)> push_event_callback,
+                                               bool compact = false,
+                                               HT_TimelineThreadSafety thread_safety = HT_TIMELINE_THREAD_SAFETY_NONE)
     {
         std::vector<HT_Byte> data;
         HT_ErrorCode err = HT_ERR_OK;
-        HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, NULL, &err);
+        HT_Timeline* timeline = ht_timeline_create_full(1024, thread_safety, HT_TRUE, NULL, &err);
 
         auto event_callback =[](TEventPtr events, size_t event_count, HT_Boolean serialized, void* user_data)
         {
@@ -90,6 +92,10 @@ protected:
         };
 
         EXPECT_EQ(HT_ERR_OK, err);
+        if (compact)
+        {
+            EXPECT_EQ(HT_ERR_OK, ht_timeline_enable_compact_serialization(timeline));
+        }
 
         ht_timeline_register_listener(timeline, event_callback, &data);
         ht_timeline_listener_push_metadata(event_callback, &data, HT_TRUE);
@@ -201,3 +207,116 @@ TEST_F(TestIntegration, HandleBaseEventShouldNotFail)
     // Assert
     ASSERT_TRUE(was_event);
 }
+
+static std::vector<Event> read_events(std::vector<HT_Byte> data, HT_EventKlassId klass_id, bool flat_events = true)
+{
+    KlassRegister registry;
+    std::vector<Event> events;
+
+    ProtocolReader reader(&registry, HawkTracer::parser::make_unique<MemoryStream>(std::move(data)), flat_events);
+    reader.register_events_listener([&events, klass_id] (const Event& event) {
+        if (event.get_klass()->get_id() == klass_id)
+        {
+            events.push_back(event);
+        }
+    });
+
+    reader.start();
+    reader.wait_for_complete();
+
+    return events;
+}
+
+TEST_F(TestIntegration, CompactEventsShouldBeDecodedByParser)
+{
+    // Arrange
+    const std::string long_string(600, 'x'); // doesn't fit into the buffer in the compact format
+    auto push_events = [&long_string] (HT_Timeline* timeline) {
+        for (int i = 0; i < 100; i++)
+        {
+            HT_DECL_EVENT(IntegrationTestEvent, event);
+            HT_EVENT(&event)->timestamp = 1000000 + (i % 3 == 0 ? -i : i) * 1000;
+            HT_EVENT(&event)->id = 500 - i;
+            event.uint8_t_field = (uint8_t)(250 + i);
+            event.uint16_t_field = (uint16_t)(i * 1000);
+            event.uint32_t_field = (uint32_t)-1 - i;
+            event.uint64_t_field = (uint64_t)-1 - i;
+            event.int8_t_field = (int8_t)(i - 128);
+            event.int16_t_field = (int16_t)(-i * 300);
+            event.int32_t_field = INT32_MIN + i;
+            event.int64_t_field = (i % 2) ? INT64_MIN + i : INT64_MAX - i;
+            event.string_field = (i % 10 == 5) ? long_string.c_str() : "test";
+            ht_timeline_push_event(timeline, HT_EVENT(&event));
+        }
+    };
+    HT_EventKlassId klass_id = HT_EVENT_KLASS_GET(IntegrationTestEvent)->klass_id;
+
+    // Act
+    auto compact_data = _generate_data(push_events, true);
+    auto expected_events = read_events(_generate_data(push_events), klass_id);
+    auto compact_events = read_events(compact_data, klass_id);
+    auto compact_nested_events = read_events(compact_data, klass_id, false);
+
+    // Assert
+    ASSERT_EQ(100u, expected_events.size());
+    ASSERT_EQ(expected_events.size(), compact_events.size());
+    ASSERT_EQ(expected_events.size(), compact_nested_events.size());
+    for (size_t i = 0; i < expected_events.size(); i++)
+    {
+        const Event& expected = expected_events[i];
+        const Event& actual = compact_events[i];
+        ASSERT_EQ(expected.get_value<uint64_t>("timestamp"), actual.get_value<uint64_t>("timestamp"));
+        ASSERT_EQ(expected.get_value<uint64_t>("id"), actual.get_value<uint64_t>("id"));
+        ASSERT_EQ(expected.get_value<uint8_t>("uint8_t_field"), actual.get_value<uint8_t>("uint8_t_field"));
+        ASSERT_EQ(expected.get_value<uint16_t>("uint16_t_field"), actual.get_value<uint16_t>("uint16_t_field"));
+        ASSERT_EQ(expected.get_value<uint32_t>("uint32_t_field"), actual.get_value<uint32_t>("uint32_t_field"));
+        ASSERT_EQ(expected.get_value<uint64_t>("uint64_t_field"), actual.get_value<uint64_t>("uint64_t_field"));
+        ASSERT_EQ(expected.get_value<int8_t>("int8_t_field"), actual.get_value<int8_t>("int8_t_field"));
+        ASSERT_EQ(expected.get_value<int16_t>("int16_t_field"), actual.get_value<int16_t>("int16_t_field"));
+        ASSERT_EQ(expected.get_value<int32_t>("int32_t_field"), actual.get_value<int32_t>("int32_t_field"));
+        ASSERT_EQ(expected.get_value<int64_t>("int64_t_field"), actual.get_value<int64_t>("int64_t_field"));
+        ASSERT_STREQ(expected.get_value<char*>("string_field"), actual.get_value<char*>("string_field"));
+
+        const Event* nested_base = compact_nested_events[i].get_value<Event*>("base");
+        ASSERT_EQ(expected.get_value<uint64_t>("timestamp"), nested_base->get_value<uint64_t>("timestamp"));
+        ASSERT_EQ(expected.get_value<uint64_t>("id"), nested_base->get_value<uint64_t>("id"));
+    }
+}
+
+TEST_F(TestIntegration, CompactCallstackEventsShouldBeAtLeastTwiceSmaller)
+{
+    // Arrange
+    const int event_count = 1000;
+    auto push_events = [event_count] (HT_Timeline* timeline) {
+        for (int i = 0; i < event_count; i++)
+        {
+            HT_DECL_EVENT(HT_CallstackIntEvent, event);
+            HT_EVENT(&event)->timestamp = 1000000000 + i * 1500;
+            HT_EVENT(&event)->id = 1000 + i;
+            HT_CALLSTACK_BASE_EVENT(&event)->duration = 200 + i % 700;
+            HT_CALLSTACK_BASE_EVENT(&event)->thread_id = 1234;
+            event.label = 0x7f1234560000 + (i % 16) * 64;
+            ht_timeline_push_event(timeline, HT_EVENT(&event));
+        }
+    };
+    HT_EventKlassId klass_id = HT_EVENT_KLASS_GET(HT_CallstackIntEvent)->klass_id;
+    size_t metadata_size = _generate_data([] (HT_Timeline*) {}).size();
+
+    // Act
+    auto data = _generate_data(push_events);
+    auto compact_data = _generate_data(push_events, true, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER);
+
+    // Assert
+    ASSERT_LE(2 * (compact_data.size() - metadata_size), data.size() - metadata_size);
+
+    auto expected_events = read_events(std::move(data), klass_id);
+    auto compact_events = read_events(std::move(compact_data), klass_id);
+    ASSERT_EQ((size_t)event_count, compact_events.size());
+    for (size_t i = 0; i < compact_events.size(); i++)
+    {
+        ASSERT_EQ(expected_events[i].get_value<uint64_t>("timestamp"), compact_events[i].get_value<uint64_t>("timestamp"));
+        ASSERT_EQ(expected_events[i].get_value<uint64_t>("duration"), compact_events[i].get_value<uint64_t>("duration"));
+        ASSERT_EQ(expected_events[i].get_value<uint32_t>("thread_id"), compact_events[i].get_value<uint32_t>("thread_id"));
+        ASSERT_EQ(expected_events[i].get_value<uint64_t>("label"), compact_events[i].get_value<uint64_t>("label"));
+    }
+}
@@ -170,3 +170,300 @@ TEST_F(TestFileDumpListener, ForceFlushListenerShouldUpdateFileImmediately)
 
 #endif /* __linux__ */
 
+
+#include <hawktracer/feature_cached_string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* rotating_test_file = "dump_listener_rotating_test_file";
+
+static std::string get_segment_path(size_t number)
+{
+    return std::string(rotating_test_file) + "." + std::to_string(number);
+}
+
+static std::vector<char> read_segment(size_t number)
+{
+    std::vector<char> content;
+    FILE* fp = fopen(get_segment_path(number).c_str(), "rb");
+    if (fp)
+    {
+        char buff[256];
+        size_t read;
+        while ((read = fread(buff, 1, sizeof(buff), fp)) > 0)
+        {
+            content.insert(content.end(), buff, buff + read);
+        }
+        fclose(fp);
+    }
+    return content;
+}
+
+static bool segment_exists(size_t number)
+{
+    FILE* fp = fopen(get_segment_path(number).c_str(), "rb");
+    if (fp)
+    {
+        fclose(fp);
+    }
+    return fp != nullptr;
+}
+
+static void remove_segments()
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        remove(get_segment_path(i).c_str());
+    }
+}
+
+// Segments are opened by a separate thread, so the listener might need a few
+// attempts before it switches to a new one.
+static bool push_until_segment(HT_Timeline* timeline, HT_FileDumpListener* listener, size_t segment_number,
+                               int max_attempts = 5000)
+{
+    for (int i = 0; i < max_attempts && ht_file_dump_listener_get_segment_number(listener) < segment_number; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = i;
+        ht_timeline_push_event(timeline, &event);
+        ht_timeline_flush(timeline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return ht_file_dump_listener_get_segment_number(listener) >= segment_number;
+}
+
+static void expect_segment_starts_with_metadata(const std::vector<char>& segment, size_t metadata_size)
+{
+    HT_DECL_EVENT(HT_EndiannessInfoEvent, endianness_event);
+    HT_EventKlassId klass_id;
+
+    ASSERT_LE(metadata_size, segment.size());
+    memcpy(&klass_id, segment.data(), sizeof(klass_id));
+    EXPECT_EQ(HT_EVENT_GET_KLASS(&endianness_event)->klass_id, klass_id);
+}
+
+TEST_F(TestFileDumpListener, RotatingListenerShouldFailIfFileCanNotBeOpened)
+{
+    // Arrange
+    HT_ErrorCode error;
+    HT_FileDumpListenerRotation rotation = {1024, 0, 0};
+
+    // Act
+    HT_FileDumpListener* listener = ht_file_dump_listener_create_rotating(
+                "/non/existing/file", 4096u, &rotation, nullptr, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_CANT_OPEN_FILE, error);
+}
+
+TEST_F(TestFileDumpListener, RotationBySizeShouldCreateSegmentsStartingWithMetadata)
+{
+    // Arrange
+    remove_segments();
+    HT_Timeline* timeline = create_timeline();
+    HT_FileDumpListenerRotation rotation = {_registry_klass_bytes + 200, 0, 0};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_rotating(
+                timeline, rotating_test_file, 64u, &rotation, nullptr);
+    ASSERT_NE(nullptr, listener);
+
+    // Act
+    ASSERT_TRUE(push_until_segment(timeline, listener, 2));
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    for (size_t i = 0; i < 3; i++)
+    {
+        std::vector<char> segment = read_segment(i);
+        expect_segment_starts_with_metadata(segment, _registry_klass_bytes);
+        if (i < 2)
+        {
+            EXPECT_LE(_registry_klass_bytes + 200, segment.size());
+        }
+    }
+    // the segment opened ahead of time should be removed
+    ASSERT_FALSE(segment_exists(3));
+}
+
+TEST_F(TestFileDumpListener, RotationByTimeShouldCreateNewSegment)
+{
+    // Arrange
+    remove_segments();
+    HT_Timeline* timeline = create_timeline();
+    HT_FileDumpListenerRotation rotation = {0, 1000000u, 0};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_rotating(
+                timeline, rotating_test_file, 4096u, &rotation, nullptr);
+
+    // Act
+    ASSERT_TRUE(push_until_segment(timeline, listener, 1));
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    expect_segment_starts_with_metadata(read_segment(0), _registry_klass_bytes);
+    expect_segment_starts_with_metadata(read_segment(1), _registry_klass_bytes);
+}
+
+TEST_F(TestFileDumpListener, OldSegmentsShouldBeRemovedIfMaxCountIsSet)
+{
+    // Arrange
+    remove_segments();
+    HT_Timeline* timeline = create_timeline();
+    HT_FileDumpListenerRotation rotation = {_registry_klass_bytes + 20, 0, 2};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_rotating(
+                timeline, rotating_test_file, 4096u, &rotation, nullptr);
+
+    // Act
+    ASSERT_TRUE(push_until_segment(timeline, listener, 4));
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    ASSERT_FALSE(segment_exists(0));
+    ASSERT_FALSE(segment_exists(1));
+    ASSERT_FALSE(segment_exists(2));
+    ASSERT_TRUE(segment_exists(3));
+    ASSERT_TRUE(segment_exists(4));
+}
+
+TEST_F(TestFileDumpListener, EverySegmentShouldContainStringMappings)
+{
+    // Arrange
+    remove_segments();
+    const std::string label = "rotating_listener_test_label";
+    HT_Timeline* timeline = create_timeline();
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    HT_FileDumpListenerRotation rotation = {_registry_klass_bytes + 200, 0, 0};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_rotating(
+                timeline, rotating_test_file, 4096u, &rotation, nullptr);
+    ht_feature_cached_string_add_mapping(timeline, label.c_str());
+
+    // Act
+    ASSERT_TRUE(push_until_segment(timeline, listener, 2));
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    for (size_t i = 0; i < 3; i++)
+    {
+        std::vector<char> segment = read_segment(i);
+        EXPECT_NE(segment.end(), std::search(segment.begin(), segment.end(), label.begin(), label.end()))
+                << "segment " << i;
+    }
+}
+
+#ifdef __linux__
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+TEST_F(TestFileDumpListener, RotationShouldBeRetriedIfSegmentCouldNotBeOpened)
+{
+    // Arrange
+    remove_segments();
+    // a directory in place of the next segment makes opening it fail
+    ASSERT_EQ(0, mkdir(get_segment_path(1).c_str(), 0755));
+    HT_Timeline* timeline = create_timeline();
+    HT_FileDumpListenerRotation rotation = {_registry_klass_bytes + 200, 0, 0};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_rotating(
+                timeline, rotating_test_file, 64u, &rotation, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_FALSE(push_until_segment(timeline, listener, 1, 100));
+
+    // Act
+    ASSERT_EQ(0, rmdir(get_segment_path(1).c_str()));
+    bool rotated = push_until_segment(timeline, listener, 1);
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    ASSERT_TRUE(rotated);
+    expect_segment_starts_with_metadata(read_segment(1), _registry_klass_bytes);
+}
+
+#endif /* __linux__ */
+
+#include <hawktracer/compression.h>
+
+static std::vector<char> read_file(const char* filename)
+{
+    std::vector<char> content;
+    FILE* fp = fopen(filename, "rb");
+    if (fp)
+    {
+        char buff[256];
+        size_t read;
+        while ((read = fread(buff, 1, sizeof(buff), fp)) > 0)
+        {
+            content.insert(content.end(), buff, buff + read);
+        }
+        fclose(fp);
+    }
+    return content;
+}
+
+TEST_F(TestFileDumpListener, CompressionShouldFailIfBufferIsDisabled)
+{
+    // Arrange
+    HT_ErrorCode error;
+
+    // Act
+    HT_FileDumpListener* listener = ht_file_dump_listener_create_full(test_file, 0, nullptr, nullptr, HT_TRUE, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+}
+
+TEST_F(TestFileDumpListener, CompressedFileShouldStartWithMarkerAndBeSmallerThanUncompressedOne)
+{
+    // Arrange
+    const char* compressed_file = "dump_listener_compressed_test_file";
+    HT_Timeline* timeline = create_timeline();
+    ASSERT_NE(nullptr, ht_file_dump_listener_register_full(timeline, compressed_file, 4096u, nullptr, HT_TRUE, nullptr));
+    ASSERT_NE(nullptr, ht_file_dump_listener_register(timeline, test_file, 4096u, nullptr));
+
+    // Act
+    for (int i = 0; i < 10000; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = i;
+        event.timestamp = i * 10;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    std::vector<char> compressed = read_file(compressed_file);
+    std::vector<char> uncompressed = read_file(test_file);
+    ASSERT_LT(0u, compressed.size());
+    ASSERT_EQ(0, memcmp(compressed.data(), HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC_SIZE));
+    ASSERT_LT(compressed.size() * 2, uncompressed.size());
+    remove(compressed_file);
+}
+
+TEST_F(TestFileDumpListener, EveryCompressedSegmentShouldStartWithMarker)
+{
+    // Arrange
+    remove_segments();
+    HT_Timeline* timeline = create_timeline();
+    HT_FileDumpListenerRotation rotation = {_registry_klass_bytes / 4 + 200, 0, 0};
+    HT_FileDumpListener* listener = ht_file_dump_listener_register_full(
+                timeline, rotating_test_file, 4096u, &rotation, HT_TRUE, nullptr);
+
+    // Act
+    ASSERT_TRUE(push_until_segment(timeline, listener, 2));
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    for (size_t i = 0; i < 3; i++)
+    {
+        std::vector<char> segment = read_segment(i);
+        ASSERT_LE((size_t)HT_COMPRESSION_STREAM_MAGIC_SIZE, segment.size()) << "segment " << i;
+        EXPECT_EQ(0, memcmp(segment.data(), HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC_SIZE))
+                << "segment " << i;
+    }
+    remove_segments();
+}
@@ -0,0 +1,299 @@
+#include <hawktracer/listeners/flight_recorder_listener.h>
+#include <hawktracer/feature_cached_string.h>
+#include <hawktracer/timeline_listener.h>
+
+#include "../test_test_events.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static const char* test_file = "flight_recorder_listener_test_file";
+
+static const size_t event_size = sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs) + sizeof(HT_EventId);
+
+class TestFlightRecorderListener : public ::testing::Test
+{
+protected:
+    // klasses might be registered by the tests, so the size is not constant
+    static size_t get_metadata_size()
+    {
+        return ht_timeline_listener_push_metadata(
+                    [](TEventPtr, size_t, HT_Boolean, void*){}, nullptr, HT_TRUE);
+    }
+
+    static std::vector<HT_Byte> read_file()
+    {
+        std::vector<HT_Byte> content;
+        FILE* fp = fopen(test_file, "rb");
+        if (fp)
+        {
+            HT_Byte buff[256];
+            size_t read;
+            while ((read = fread(buff, 1, sizeof(buff), fp)) > 0)
+            {
+                content.insert(content.end(), buff, buff + read);
+            }
+            fclose(fp);
+        }
+        return content;
+    }
+
+    static std::vector<HT_EventId> read_event_ids()
+    {
+        std::vector<HT_Byte> content = read_file();
+        std::vector<HT_EventId> ids;
+
+        for (size_t offset = get_metadata_size(); offset + event_size <= content.size(); offset += event_size)
+        {
+            HT_EventId id;
+            memcpy(&id, content.data() + offset + sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs), sizeof(id));
+            ids.push_back(id);
+        }
+        return ids;
+    }
+
+    static void push_events(HT_Timeline* timeline, HT_EventId first_id, HT_EventId last_id)
+    {
+        for (HT_EventId id = first_id; id <= last_id; id++)
+        {
+            HT_DECL_EVENT(HT_Event, event);
+            event.id = id;
+            event.timestamp = 1;
+            ht_timeline_push_event(timeline, &event);
+            ht_timeline_flush(timeline);
+        }
+    }
+};
+
+TEST_F(TestFlightRecorderListener, CreateShouldFailIfCapacityIsTooSmall)
+{
+    // Arrange
+    HT_ErrorCode error;
+
+    // Act
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_create(2, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+}
+
+TEST_F(TestFlightRecorderListener, DumpOfEmptyListenerShouldOnlyContainMetadata)
+{
+    // Arrange
+    HT_ErrorCode error;
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_create(1024, &error);
+    ASSERT_EQ(HT_ERR_OK, error);
+
+    // Act
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    ASSERT_EQ(get_metadata_size(), read_file().size());
+
+    ht_flight_recorder_listener_destroy(listener);
+}
+
+TEST_F(TestFlightRecorderListener, DumpShouldFailIfFileCanNotBeOpened)
+{
+    // Arrange
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_create(1024, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_CANT_OPEN_FILE, ht_flight_recorder_listener_dump(listener, "/non/existing/file"));
+
+    ht_flight_recorder_listener_destroy(listener);
+}
+
+TEST_F(TestFlightRecorderListener, DumpShouldContainAllEventsIfBufferIsNotFull)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(timeline, 1024, nullptr);
+
+    // Act
+    push_events(timeline, 1, 3);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    ASSERT_EQ(get_metadata_size() + 3 * event_size, read_file().size());
+    ASSERT_EQ(std::vector<HT_EventId>({1, 2, 3}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, OldEventsShouldBeOverwrittenByNewOnes)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    // every record has a 4-byte header; the buffer fits exactly 5 records
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(
+                timeline, 5 * (event_size + 4), nullptr);
+
+    // Act
+    push_events(timeline, 1, 12);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_EventId>({8, 9, 10, 11, 12}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, WrappedBufferShouldKeepRecordsInOrder)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    // the tail of the buffer is too small for a record, so it stays unused after wrapping
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(
+                timeline, 4 * (event_size + 4) + 10, nullptr);
+
+    // Act
+    push_events(timeline, 1, 6);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_EventId>({3, 4, 5, 6}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, ChunkBiggerThanCapacityShouldBeDropped)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(
+                timeline, 2 * (event_size + 4), nullptr);
+    push_events(timeline, 1, 1);
+
+    // Act
+    for (HT_EventId id = 2; id < 5; id++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = id;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_flush(timeline);
+
+    // Assert
+    ASSERT_EQ(1u, ht_flight_recorder_listener_get_dropped_count(listener));
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+    ASSERT_EQ(std::vector<HT_EventId>({1}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, NonSerializedTimeline)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(timeline, 1024, nullptr);
+
+    // Act
+    push_events(timeline, 7, 8);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    ASSERT_EQ(get_metadata_size() + 2 * event_size, read_file().size());
+    ASSERT_EQ(std::vector<HT_EventId>({7, 8}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, DumpShouldContainKlassesRegisteredAfterCreation)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(timeline, 1024, nullptr);
+    HT_REGISTER_EVENT_KLASS(FlightRecorderTestEvent);
+    std::vector<HT_Byte> metadata;
+    ht_timeline_listener_push_metadata([](TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        static_cast<std::vector<HT_Byte>*>(ud)->insert(static_cast<std::vector<HT_Byte>*>(ud)->end(), events, events + size);
+    }, &metadata, HT_TRUE);
+
+    // Act
+    HT_TIMELINE_PUSH_EVENT(timeline, FlightRecorderTestEvent, 5);
+    ht_timeline_flush(timeline);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    std::vector<HT_Byte> content = read_file();
+    ASSERT_EQ(metadata.size() + event_size + sizeof(int), content.size());
+    ASSERT_TRUE(std::equal(metadata.begin(), metadata.end(), content.begin()));
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestFlightRecorderListener, DumpShouldContainStringMappingsOverwrittenInBuffer)
+{
+    // Arrange
+    const std::string label = "flight_recorder_test_label";
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(
+                timeline, 5 * (event_size + 4), nullptr);
+
+    // Act
+    ht_feature_cached_string_add_mapping(timeline, label.c_str());
+    ht_timeline_flush(timeline);
+    push_events(timeline, 1, 12);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump(listener, test_file));
+
+    // Assert
+    std::vector<HT_Byte> content = read_file();
+    ASSERT_NE(content.end(), std::search(content.begin(), content.end(), label.begin(), label.end()));
+
+    ht_timeline_destroy(timeline);
+}
+
+#ifdef __linux__
+
+#include <signal.h>
+
+TEST_F(TestFlightRecorderListener, SignalShouldTriggerDump)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(timeline, 1024, nullptr);
+    remove(test_file);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump_on_signal(listener, SIGUSR1, test_file));
+    push_events(timeline, 1, 2);
+
+    // Act
+    raise(SIGUSR1);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_EventId>({1, 2}), read_event_ids());
+
+    ht_timeline_destroy(timeline);
+    signal(SIGUSR1, SIG_DFL);
+}
+
+TEST_F(TestFlightRecorderListener, SignalDumpShouldContainMappingsAddedAfterAttaching)
+{
+    // Arrange
+    const std::string label = "flight_recorder_signal_test_label";
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    HT_FlightRecorderListener* listener = ht_flight_recorder_listener_register(timeline, 1024, nullptr);
+    remove(test_file);
+    ASSERT_EQ(HT_ERR_OK, ht_flight_recorder_listener_dump_on_signal(listener, SIGUSR1, test_file));
+
+    // Act
+    ht_feature_cached_string_add_mapping(timeline, label.c_str());
+    ht_timeline_flush(timeline);
+    push_events(timeline, 1, 2);
+    raise(SIGUSR1);
+
+    // Assert
+    std::vector<HT_Byte> content = read_file();
+    ASSERT_NE(content.end(), std::search(content.begin(), content.end(), label.begin(), label.end()));
+
+    ht_timeline_destroy(timeline);
+    signal(SIGUSR1, SIG_DFL);
+}
+
+#endif /* __linux__ */
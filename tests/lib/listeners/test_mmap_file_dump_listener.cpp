@@ -0,0 +1,171 @@
+#include <hawktracer/listeners/mmap_file_dump_listener.h>
+#include <hawktracer/listeners/file_dump_listener.h>
+#include <hawktracer/timeline_listener.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __unix__
+
+static const char* test_file = "mmap_dump_listener_test_file";
+static const char* reference_file = "mmap_dump_listener_reference_file";
+
+static std::vector<char> read_file(const char* filename)
+{
+    std::vector<char> content;
+    FILE* fp = fopen(filename, "rb");
+    if (fp)
+    {
+        char buff[256];
+        size_t read;
+        while ((read = fread(buff, 1, sizeof(buff), fp)) > 0)
+        {
+            content.insert(content.end(), buff, buff + read);
+        }
+        fclose(fp);
+    }
+    return content;
+}
+
+class TestMmapFileDumpListener : public ::testing::Test
+{
+protected:
+    static void SetUpTestCase()
+    {
+        _registry_klass_bytes = ht_timeline_listener_push_metadata(
+                    [](TEventPtr, size_t, HT_Boolean, void*){}, nullptr, HT_TRUE);
+    }
+
+    static size_t _registry_klass_bytes;
+};
+
+size_t TestMmapFileDumpListener::_registry_klass_bytes;
+
+TEST_F(TestMmapFileDumpListener, InitShouldFailIfFileCanNotBeOpened)
+{
+    // Arrange
+    HT_ErrorCode error;
+
+    // Act
+    HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_create("/non/existing/file", 4096u, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_CANT_OPEN_FILE, error);
+}
+
+TEST_F(TestMmapFileDumpListener, InitShouldFailIfExtentSizeIsZero)
+{
+    // Arrange
+    HT_ErrorCode error;
+
+    // Act
+    HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_create(test_file, 0, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+}
+
+TEST_F(TestMmapFileDumpListener, FileShouldBeTruncatedToDataSizeOnStop)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ht_mmap_file_dump_listener_register(timeline, test_file, 1024 * 1024, nullptr);
+
+    HT_DECL_EVENT(HT_Event, event);
+    event.id = 32;
+    event.timestamp = 9983;
+
+    // Act
+    ht_timeline_push_event(timeline, &event);
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    std::vector<char> content = read_file(test_file);
+    ASSERT_EQ(_registry_klass_bytes + event.klass->get_size(&event), content.size());
+    size_t offset = _registry_klass_bytes;
+#define ASSERT_FROM_BUFFER(event_value) \
+    EXPECT_EQ(event_value, *(decltype(&event_value))(content.data() + offset)); offset += sizeof(event_value)
+    ASSERT_FROM_BUFFER(event.klass->klass_id);
+    ASSERT_FROM_BUFFER(event.timestamp);
+    ASSERT_FROM_BUFFER(event.id);
+#undef ASSERT_FROM_BUFFER
+}
+
+static void push_events(HT_Timeline* timeline, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = i;
+        event.timestamp = i * 2;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_flush(timeline);
+}
+
+static void check_same_as_file_dump_listener(HT_Boolean serialize, size_t extent_size, size_t event_count, size_t metadata_size)
+{
+    HT_Timeline* timeline = ht_timeline_create(1000, HT_FALSE, serialize, nullptr, nullptr);
+    ht_mmap_file_dump_listener_register(timeline, test_file, extent_size, nullptr);
+    ht_file_dump_listener_register(timeline, reference_file, 4096u, nullptr);
+
+    push_events(timeline, event_count);
+    ht_timeline_destroy(timeline);
+
+    // metadata contains timestamps, so only events are compared
+    std::vector<char> reference = read_file(reference_file);
+    std::vector<char> content = read_file(test_file);
+    ASSERT_LT(event_count * 20, reference.size());
+    ASSERT_EQ(reference.size(), content.size());
+    ASSERT_TRUE(std::equal(reference.begin() + metadata_size, reference.end(), content.begin() + metadata_size));
+}
+
+TEST_F(TestMmapFileDumpListener, EventsCrossingExtentsShouldBeStoredLikeInFileDumpListener)
+{
+    // extent size is rounded up to a single page, which is not a multiple
+    // of the chunk and event size, so data is split between extents
+    check_same_as_file_dump_listener(HT_TRUE, 1, 10000, _registry_klass_bytes);
+}
+
+TEST_F(TestMmapFileDumpListener, UnserializedEventsShouldBeStoredLikeInFileDumpListener)
+{
+    check_same_as_file_dump_listener(HT_FALSE, 1, 10000, _registry_klass_bytes);
+}
+
+TEST_F(TestMmapFileDumpListener, CallbackShouldBeIgnoredAfterStop)
+{
+    // Arrange
+    HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_create(test_file, 4096u, nullptr);
+    ht_mmap_file_dump_listener_stop(listener);
+
+    HT_DECL_EVENT(HT_Event, event);
+
+    // Act
+    ht_mmap_file_dump_listener_callback((TEventPtr)&event, sizeof(event), HT_FALSE, listener);
+
+    // Assert
+    ASSERT_EQ(_registry_klass_bytes, read_file(test_file).size());
+    ht_mmap_file_dump_listener_destroy(listener);
+}
+
+TEST_F(TestMmapFileDumpListener, FlushShouldSucceed)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    HT_MmapFileDumpListener* listener = ht_mmap_file_dump_listener_register(timeline, test_file, 4096u, nullptr);
+
+    // Act
+    push_events(timeline, 10);
+
+    // Assert
+    ASSERT_EQ(HT_ERR_OK, ht_mmap_file_dump_listener_flush(listener, HT_TRUE));
+    ASSERT_EQ(HT_ERR_OK, ht_mmap_file_dump_listener_flush(listener, HT_FALSE));
+
+    ht_timeline_destroy(timeline);
+}
+
+#endif /* __unix__ */
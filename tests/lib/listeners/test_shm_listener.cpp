@@ -0,0 +1,220 @@
+#include <hawktracer/listeners/shm_listener.h>
+#include <hawktracer/timeline_listener.h>
+
+#include "../test_test_events.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#ifdef __unix__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char* test_segment = "ht_shm_listener_test_segment";
+
+class TestShmListener : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        /* the listener doesn't replace segments left by failed tests */
+        shm_unlink((std::string("/") + test_segment).c_str());
+        /* klasses might be registered by the tests, so the size is not constant */
+        _registry_klass_bytes = ht_timeline_listener_push_metadata(
+                    [](TEventPtr, size_t, HT_Boolean, void*){}, nullptr, HT_TRUE);
+    }
+
+    void TearDown() override
+    {
+        if (_header)
+        {
+            munmap(_header, _mapping_size);
+        }
+    }
+
+    /* Maps the segment like a client does. */
+    void _map_segment()
+    {
+        int fd = shm_open((std::string("/") + test_segment).c_str(), O_RDWR, 0);
+        ASSERT_LE(0, fd);
+        struct stat st;
+        ASSERT_EQ(0, fstat(fd, &st));
+        _mapping_size = (size_t)st.st_size;
+        void* map = mmap(nullptr, _mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        ASSERT_NE(MAP_FAILED, map);
+        _header = (HT_ShmListenerHeader*)map;
+        _data = (char*)map + _header->data_offset;
+    }
+
+    std::vector<char> _read(uint64_t position, size_t size)
+    {
+        std::vector<char> data(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] = _data[(position + i) % _header->capacity];
+        }
+        return data;
+    }
+
+    size_t _registry_klass_bytes = 0;
+    HT_ShmListenerHeader* _header = nullptr;
+    char* _data = nullptr;
+    size_t _mapping_size = 0;
+};
+
+TEST_F(TestShmListener, CreateShouldFailForInvalidArguments)
+{
+    // Arrange
+    HT_ErrorCode error;
+
+    // Act & Assert
+    ASSERT_EQ(nullptr, ht_shm_listener_create(test_segment, 0, &error));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+    ASSERT_EQ(nullptr, ht_shm_listener_create("", 4096, &error));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+}
+
+TEST_F(TestShmListener, CreateShouldFailIfSegmentAlreadyExists)
+{
+    // Arrange
+    std::string segment_name = std::string("/") + test_segment;
+    int fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_LE(0, fd);
+    close(fd);
+    HT_ErrorCode error;
+
+    // Act
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 1024 * 1024, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_CANT_OPEN_FILE, error);
+    /* the existing segment is left untouched */
+    ASSERT_EQ(0, shm_unlink(segment_name.c_str()));
+}
+
+TEST_F(TestShmListener, CreateShouldFailIfMetadataDoesNotFitIntoRing)
+{
+    // Arrange
+    HT_REGISTER_EVENT_KLASS(LargeTestEvent);
+    HT_REGISTER_EVENT_KLASS(SuperLargeTestEvent);
+    size_t metadata_size = ht_timeline_listener_push_metadata(
+                [](TEventPtr, size_t, HT_Boolean, void*){}, nullptr, HT_TRUE);
+    ASSERT_LT((size_t)sysconf(_SC_PAGESIZE), metadata_size);
+    HT_ErrorCode error;
+
+    // Act
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 1, &error);
+
+    // Assert
+    ASSERT_EQ(nullptr, listener);
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, error);
+    ASSERT_GT(0, shm_open((std::string("/") + test_segment).c_str(), O_RDONLY, 0));
+}
+
+TEST_F(TestShmListener, SegmentShouldContainMetadataAndEvents)
+{
+    // Arrange
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 1024 * 1024, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_NO_FATAL_FAILURE(_map_segment());
+    std::vector<char> events(1000);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        events[i] = (char)i;
+    }
+
+    // Act
+    ht_shm_listener_callback((TEventPtr)events.data(), events.size(), HT_TRUE, listener);
+
+    // Assert
+    ASSERT_EQ(HT_SHM_LISTENER_MAGIC, _header->magic);
+    ASSERT_EQ(HT_SHM_LISTENER_VERSION, _header->version);
+    ASSERT_LE(1024u * 1024u, _header->capacity);
+    ASSERT_EQ(0u, _header->closed);
+    ASSERT_EQ(_registry_klass_bytes + events.size(), _header->write_position);
+    ASSERT_EQ(events, _read(_registry_klass_bytes, events.size()));
+
+    ht_shm_listener_destroy(listener);
+    ASSERT_EQ(1u, _header->closed);
+}
+
+TEST_F(TestShmListener, DataShouldBeDroppedAsWholeIfRingIsFull)
+{
+    // Arrange
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 64 * 1024, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_NO_FATAL_FAILURE(_map_segment());
+    std::vector<char> events(_header->capacity - _registry_klass_bytes + 1, 'a');
+
+    // Act
+    ht_shm_listener_callback((TEventPtr)events.data(), events.size(), HT_TRUE, listener);
+
+    // Assert
+    ASSERT_EQ(events.size(), ht_shm_listener_get_dropped_size(listener));
+    ASSERT_EQ(events.size(), _header->dropped_size);
+    ASSERT_EQ(_registry_klass_bytes, _header->write_position);
+
+    ht_shm_listener_destroy(listener);
+}
+
+TEST_F(TestShmListener, DataShouldWrapAroundWhenConsumerReadsIt)
+{
+    // Arrange
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 64 * 1024, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_NO_FATAL_FAILURE(_map_segment());
+    std::vector<char> events(_header->capacity - 10);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        events[i] = (char)(i % 251);
+    }
+
+    // Act
+    /* the consumer has read the metadata */
+    __atomic_store_n(&_header->read_position, _header->write_position, __ATOMIC_RELEASE);
+    ht_shm_listener_callback((TEventPtr)events.data(), events.size(), HT_TRUE, listener);
+
+    // Assert
+    ASSERT_EQ(0u, ht_shm_listener_get_dropped_size(listener));
+    ASSERT_EQ(_registry_klass_bytes + events.size(), _header->write_position);
+    ASSERT_EQ(events, _read(_registry_klass_bytes, events.size()));
+
+    ht_shm_listener_destroy(listener);
+}
+
+TEST_F(TestShmListener, UnserializedEventsShouldBeSerializedToRing)
+{
+    // Arrange
+    HT_ShmListener* listener = ht_shm_listener_create(test_segment, 64 * 1024, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_NO_FATAL_FAILURE(_map_segment());
+    __atomic_store_n(&_header->read_position, _header->write_position, __ATOMIC_RELEASE);
+
+    HT_DECL_EVENT(HT_Event, event);
+    HT_Event events[2] = {event, event};
+    events[0].id = 32;
+    events[0].timestamp = 9983;
+    events[1].id = 33;
+    events[1].timestamp = 9984;
+
+    // Act
+    ht_shm_listener_callback((TEventPtr)events, sizeof(events), HT_FALSE, listener);
+
+    // Assert
+    size_t event_size = events[0].klass->get_size(&events[0]);
+    ASSERT_EQ(_registry_klass_bytes + 2 * event_size, _header->write_position);
+    std::vector<char> serialized = _read(_registry_klass_bytes + event_size, event_size);
+    ASSERT_EQ(events[1].klass->klass_id, *(HT_EventKlassId*)serialized.data());
+    ASSERT_EQ(events[1].timestamp, *(HT_TimestampNs*)(serialized.data() + sizeof(HT_EventKlassId)));
+    ASSERT_EQ(events[1].id, *(HT_EventId*)(serialized.data() + sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs)));
+
+    ht_shm_listener_destroy(listener);
+}
+
+#endif /* __unix__ */
@@ -1,7 +1,29 @@
 #include <hawktracer/listeners/tcp_listener.h>
+#include <hawktracer/category.h>
+#include <hawktracer/feature_cached_string.h>
+#include <hawktracer/feature_callstack.h>
+#include <hawktracer/feature_callstack_aggregation.h>
+
+#include <internal/global_timeline.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 TEST(TestTcpListener, DISABLED_ApplicationShouldNotCrashWhenCreatingListenerFails)
 {
     // Arrange
@@ -17,3 +39,523 @@ TEST(TestTcpListener, DISABLED_ApplicationShouldNotCrashWhenCreatingListenerFail
     ASSERT_EQ(nullptr, listener2);
     ASSERT_NE(HT_ERR_OK, err);
 }
+
+TEST(TestTcpListener, SetSlowClientPolicyShouldFailForInvalidArguments)
+{
+    // Arrange
+    HT_TCPListener* listener = ht_tcp_listener_create(8788, 2048, nullptr);
+    ASSERT_NE(nullptr, listener);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_tcp_listener_set_slow_client_policy(listener, 0, HT_TCP_LISTENER_SLOW_CLIENT_BLOCK));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_tcp_listener_set_slow_client_policy(listener, 1024, (HT_TCPListenerSlowClientPolicy)7));
+    ASSERT_EQ(HT_ERR_OK, ht_tcp_listener_set_slow_client_policy(listener, 1024, HT_TCP_LISTENER_SLOW_CLIENT_DISCONNECT));
+
+    ht_tcp_listener_destroy(listener);
+}
+
+TEST(TestTcpListener, SetPausedShouldChangePausedState)
+{
+    // Arrange
+    HT_TCPListener* listener = ht_tcp_listener_create(8792, 2048, nullptr);
+    ASSERT_NE(nullptr, listener);
+
+    // Act & Assert
+    ASSERT_FALSE(ht_tcp_listener_is_paused(listener));
+    ht_tcp_listener_set_paused(listener, HT_TRUE);
+    ASSERT_TRUE(ht_tcp_listener_is_paused(listener));
+    ht_tcp_listener_set_paused(listener, HT_FALSE);
+    ASSERT_FALSE(ht_tcp_listener_is_paused(listener));
+
+    ht_tcp_listener_destroy(listener);
+}
+
+#ifdef __linux__
+
+/* Stress tests with a slow client. All the reads have deadlines, so a bug in the server
+ * makes the tests fail instead of hanging. */
+class TestTcpListenerSlowClient : public ::testing::Test
+{
+protected:
+    static constexpr size_t message_size = 64 * 1024;
+    static constexpr size_t queue_size = 128 * 1024;
+
+    void TearDown() override
+    {
+        for (int fd : _sockets)
+        {
+            close(fd);
+        }
+    }
+
+    int _connect(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        /* small receive buffer, so the slow client gets full quickly */
+        int buffer_size = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        _sockets.push_back(fd);
+        return fd;
+    }
+
+    /* Reads data until the connection is closed, or the timeout expires.
+     * Returns false on timeout. */
+    static bool _read_until_closed(int fd, std::vector<char>& data, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+        char buffer[4096];
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+            {
+                continue;
+            }
+            ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+            if (size <= 0)
+            {
+                return true;
+            }
+            data.insert(data.end(), buffer, buffer + size);
+            std::this_thread::sleep_for(delay);
+        }
+        return false;
+    }
+
+    /* Waits until the client gets the metadata, so it receives the events pushed afterwards. */
+    static size_t _wait_for_metadata(int fd)
+    {
+        char buffer[4096];
+        size_t total = 0;
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (poll(&pfd, 1, total ? 200 : 5000) > 0)
+        {
+            ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+            if (size <= 0)
+            {
+                break;
+            }
+            total += size;
+        }
+        return total;
+    }
+
+    static void _push_messages(HT_TCPListener* listener, size_t count)
+    {
+        std::vector<HT_Byte> message(message_size);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::fill(message.begin(), message.end(), (HT_Byte)(i % 251 + 1));
+            ht_tcp_listener_callback(message.data(), message.size(), HT_TRUE, listener);
+        }
+    }
+
+    std::vector<int> _sockets;
+};
+
+constexpr size_t TestTcpListenerSlowClient::message_size;
+constexpr size_t TestTcpListenerSlowClient::queue_size;
+
+TEST_F(TestTcpListenerSlowClient, SlowClientShouldNotBlockPushingThreadWhenDroppingOldestData)
+{
+    // Arrange
+    const int port = 8789;
+    const size_t message_count = 512;
+    HT_TCPListener* listener = ht_tcp_listener_create(port, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_EQ(HT_ERR_OK, ht_tcp_listener_set_slow_client_policy(listener, queue_size, HT_TCP_LISTENER_SLOW_CLIENT_DROP_OLDEST));
+
+    int slow_fd = _connect(port);
+    int fast_fd = _connect(port);
+    ASSERT_LE(0, slow_fd);
+    ASSERT_LE(0, fast_fd);
+    size_t slow_metadata_size = _wait_for_metadata(slow_fd);
+    ASSERT_LT(0u, slow_metadata_size);
+    ASSERT_LT(0u, _wait_for_metadata(fast_fd));
+
+    std::vector<char> fast_data;
+    bool fast_closed = false;
+    std::thread fast_reader([&] { fast_closed = _read_until_closed(fast_fd, fast_data); });
+
+    // Act
+    auto start = std::chrono::steady_clock::now();
+    _push_messages(listener, message_count);
+    auto push_time = std::chrono::steady_clock::now() - start;
+
+    size_t dropped_size = ht_tcp_listener_get_dropped_size(listener);
+
+    std::vector<char> slow_data;
+    bool slow_closed = false;
+    std::thread slow_reader([&] { slow_closed = _read_until_closed(slow_fd, slow_data); });
+    ht_tcp_listener_destroy(listener);
+    slow_reader.join();
+    fast_reader.join();
+
+    // Assert
+    ASSERT_TRUE(slow_closed);
+    ASSERT_TRUE(fast_closed);
+    ASSERT_LT(push_time, std::chrono::seconds(10));
+    ASSERT_LT(0u, dropped_size);
+    ASSERT_LT(slow_data.size(), message_count * message_size);
+    ASSERT_LT(0u, fast_data.size());
+    /* only whole messages are dropped */
+    ASSERT_EQ(0u, slow_data.size() % message_size);
+    ASSERT_EQ(0u, fast_data.size() % message_size);
+    ASSERT_LE(message_size, slow_data.size());
+    /* the last message is never dropped */
+    ASSERT_EQ(std::vector<char>(message_size, (char)((message_count - 1) % 251 + 1)),
+              std::vector<char>(slow_data.end() - message_size, slow_data.end()));
+}
+
+TEST_F(TestTcpListenerSlowClient, SlowClientShouldBeDisconnectedWhenQueueIsFull)
+{
+    // Arrange
+    const int port = 8790;
+    HT_TCPListener* listener = ht_tcp_listener_create(port, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_EQ(HT_ERR_OK, ht_tcp_listener_set_slow_client_policy(listener, queue_size, HT_TCP_LISTENER_SLOW_CLIENT_DISCONNECT));
+
+    int slow_fd = _connect(port);
+    ASSERT_LE(0, slow_fd);
+    ASSERT_LT(0u, _wait_for_metadata(slow_fd));
+
+    // Act
+    _push_messages(listener, 64);
+
+    // Assert
+    std::vector<char> slow_data;
+    ASSERT_TRUE(_read_until_closed(slow_fd, slow_data));
+    ASSERT_LT(slow_data.size(), 64 * message_size);
+    ASSERT_LT(0u, ht_tcp_listener_get_dropped_size(listener));
+
+    ht_tcp_listener_destroy(listener);
+}
+
+TEST_F(TestTcpListenerSlowClient, SlowClientShouldReceiveAllDataWhenPushingThreadIsBlocked)
+{
+    // Arrange
+    const int port = 8791;
+    const size_t message_count = 16;
+    HT_TCPListener* listener = ht_tcp_listener_create(port, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ASSERT_EQ(HT_ERR_OK, ht_tcp_listener_set_slow_client_policy(listener, queue_size, HT_TCP_LISTENER_SLOW_CLIENT_BLOCK));
+
+    int slow_fd = _connect(port);
+    ASSERT_LE(0, slow_fd);
+    ASSERT_LT(0u, _wait_for_metadata(slow_fd));
+
+    std::vector<char> slow_data;
+    bool slow_closed = false;
+    std::thread slow_reader([&] { slow_closed = _read_until_closed(slow_fd, slow_data, std::chrono::milliseconds(1)); });
+
+    // Act
+    _push_messages(listener, message_count);
+    size_t dropped_size = ht_tcp_listener_get_dropped_size(listener);
+    ht_tcp_listener_destroy(listener);
+    slow_reader.join();
+
+    // Assert
+    ASSERT_TRUE(slow_closed);
+    ASSERT_EQ(0u, dropped_size);
+    ASSERT_EQ(message_count * message_size, slow_data.size());
+}
+
+/* Commands are handled by the server thread, so the tests wait until they're applied. */
+class TestTcpListenerRemoteControl : public TestTcpListenerSlowClient
+{
+protected:
+    static void _send(int fd, const std::string& data)
+    {
+        ASSERT_EQ((ssize_t)data.size(), send(fd, data.data(), data.size(), MSG_NOSIGNAL));
+    }
+
+    static bool _wait_until(std::function<bool()> condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    /* Reads @a size bytes, or less if they don't arrive before the timeout. */
+    static std::vector<char> _read(int fd, size_t size, std::chrono::milliseconds timeout)
+    {
+        std::vector<char> data;
+        char buffer[4096];
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        while (data.size() < size && std::chrono::steady_clock::now() < deadline)
+        {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 10) <= 0)
+            {
+                continue;
+            }
+            ssize_t received = recv(fd, buffer, std::min(sizeof(buffer), size - data.size()), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            data.insert(data.end(), buffer, buffer + received);
+        }
+        return data;
+    }
+};
+
+TEST_F(TestTcpListenerRemoteControl, ClientShouldPauseAndResumeListener)
+{
+    // Arrange
+    HT_TCPListener* listener = ht_tcp_listener_create(8793, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8793);
+    ASSERT_LE(0, fd);
+    ASSERT_LT(0u, _wait_for_metadata(fd));
+
+    // Act & Assert
+    _send(fd, "pa");
+    _send(fd, "use\n");
+    ASSERT_TRUE(_wait_until([listener] { return ht_tcp_listener_is_paused(listener) == HT_TRUE; }));
+    _push_messages(listener, 1);
+    ASSERT_EQ(0u, _read(fd, message_size, std::chrono::milliseconds(200)).size());
+
+    /* too long lines and unknown commands are ignored */
+    _send(fd, std::string(1000, 'x') + "\nunknown\nresume now\nresume\r\n");
+    ASSERT_TRUE(_wait_until([listener] { return ht_tcp_listener_is_paused(listener) == HT_FALSE; }));
+    _push_messages(listener, 1);
+    ASSERT_EQ(message_size, _read(fd, message_size, std::chrono::seconds(20)).size());
+
+    ht_tcp_listener_destroy(listener);
+}
+
+TEST_F(TestTcpListenerRemoteControl, CommandsShouldBeIgnoredUnlessEnabled)
+{
+    // Arrange
+    HT_TCPListener* listener = ht_tcp_listener_create(8799, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    int fd = _connect(8799);
+    ASSERT_LE(0, fd);
+    ASSERT_LT(0u, _wait_for_metadata(fd));
+
+    // Act
+    _send(fd, "pause\n");
+    _push_messages(listener, 1);
+
+    // Assert
+    ASSERT_EQ(message_size, _read(fd, message_size, std::chrono::seconds(20)).size());
+    ASSERT_FALSE(ht_tcp_listener_is_paused(listener));
+
+    ht_tcp_listener_destroy(listener);
+}
+
+TEST_F(TestTcpListenerRemoteControl, ClientShouldChangeCategoriesAndGlobalTimelineBufferSize)
+{
+    // Arrange
+    size_t prev_buffer_size = ht_global_timeline_get_buffer_size();
+    HT_Category category = ht_category_register("test_remote_control", nullptr);
+    HT_TCPListener* listener = ht_tcp_listener_create(8794, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8794);
+    ASSERT_LE(0, fd);
+
+    // Act & Assert
+    _send(fd, "disable-categories test_remote_control\n");
+    ASSERT_TRUE(_wait_until([category] { return !HT_CATEGORY_IS_ENABLED(category); }));
+    _send(fd, "enable-categories test_remote_control,other\n");
+    ASSERT_TRUE(_wait_until([category] { return HT_CATEGORY_IS_ENABLED(category); }));
+
+    _send(fd, "new-global-timeline-buffer-size 0\nnew-global-timeline-buffer-size -5\n"
+              "new-global-timeline-buffer-size 12ab\nnew-global-timeline-buffer-size 12345\n");
+    ASSERT_TRUE(_wait_until([prev_buffer_size] { return ht_global_timeline_get_buffer_size() != prev_buffer_size; }));
+    ASSERT_EQ(12345u, ht_global_timeline_get_buffer_size());
+
+    _send(fd, "new-global-timeline-buffer-size 99999999999999\n");
+    ASSERT_TRUE(_wait_until([] { return ht_global_timeline_get_buffer_size() == HT_TCP_LISTENER_MAX_GLOBAL_TIMELINE_BUFFER_SIZE; }));
+    _send(fd, "new-global-timeline-buffer-size 1\n");
+    ASSERT_TRUE(_wait_until([] { return ht_global_timeline_get_buffer_size() == HT_TCP_LISTENER_MIN_GLOBAL_TIMELINE_BUFFER_SIZE; }));
+
+    ht_global_timeline_set_buffer_size(prev_buffer_size);
+    ht_tcp_listener_destroy(listener);
+}
+
+static void
+count_flushes_listener(TEventPtr, size_t, HT_Boolean, void* user_data)
+{
+    (*static_cast<std::atomic<int>*>(user_data))++;
+}
+
+TEST_F(TestTcpListenerRemoteControl, ClientShouldRequestFlushOfAllTimelines)
+{
+    // Arrange
+    const size_t max_event_count = 10000;
+    std::atomic<int> flush_count(0);
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event) * max_event_count, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, count_flushes_listener, &flush_count);
+    HT_TCPListener* listener = ht_tcp_listener_create(8795, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8795);
+    ASSERT_LE(0, fd);
+
+    // Act
+    _send(fd, "flush\n");
+    /* the timeline is not thread-safe, so it's flushed when an event is pushed after the command is handled */
+    for (size_t i = 0; i < max_event_count - 1 && flush_count == 0; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        ht_timeline_push_event(timeline, &event);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    // Assert
+    ASSERT_EQ(1, flush_count);
+
+    ht_tcp_listener_destroy(listener);
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTcpListenerRemoteControl, FlushCommandShouldFlushIdleThreadSafeTimeline)
+{
+    // Arrange
+    std::atomic<int> flush_count(0);
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, count_flushes_listener, &flush_count);
+    HT_TCPListener* listener = ht_tcp_listener_create(8796, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8796);
+    ASSERT_LE(0, fd);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(timeline, &event);
+    ASSERT_EQ(0, flush_count);
+
+    // Act
+    _send(fd, "flush\n");
+
+    // Assert
+    ASSERT_TRUE(_wait_until([&flush_count] { return flush_count == 1; }));
+
+    ht_tcp_listener_destroy(listener);
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTcpListenerRemoteControl, LabelMappedWhilePausedShouldBeSentAfterResume)
+{
+    // Arrange
+    static const char label[] = "label_mapped_while_paused";
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_cached_string_enable(timeline, HT_FALSE));
+    HT_TCPListener* listener = ht_tcp_listener_register(timeline, 8797, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8797);
+    ASSERT_LE(0, fd);
+    ASSERT_LT(0u, _wait_for_metadata(fd));
+
+    _send(fd, "pause\n");
+    ASSERT_TRUE(_wait_until([listener] { return ht_tcp_listener_is_paused(listener) == HT_TRUE; }));
+    ht_feature_cached_string_add_mapping(timeline, label);
+    ht_timeline_flush(timeline);
+
+    // Act
+    _send(fd, "resume\n");
+    ASSERT_TRUE(_wait_until([listener] { return ht_tcp_listener_is_paused(listener) == HT_FALSE; }));
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(timeline, &event);
+    ht_timeline_flush(timeline);
+
+    // Assert
+    std::vector<char> data;
+    ht_timeline_destroy(timeline);
+    ASSERT_TRUE(_read_until_closed(fd, data));
+    ASSERT_NE(data.end(), std::search(data.begin(), data.end(), label, label + sizeof(label) - 1));
+}
+
+static void
+callstack_weights_listener(TEventPtr events, size_t size, HT_Boolean, void* user_data)
+{
+    std::vector<uint32_t>* weights = static_cast<std::vector<uint32_t>*>(user_data);
+    TEventPtr end = events + size;
+
+    while (events < end)
+    {
+        HT_EventKlass* klass = HT_EVENT_GET_KLASS(events);
+        if (klass == ht_HT_CallstackIntEvent_get_event_klass_instance())
+        {
+            weights->push_back(1);
+        }
+        else if (klass == ht_HT_CallstackSampledIntEvent_get_event_klass_instance())
+        {
+            weights->push_back(((HT_CallstackSampledIntEvent*)events)->weight);
+        }
+        events += klass->type_info->size;
+    }
+}
+
+TEST_F(TestTcpListenerRemoteControl, ClientShouldChangeCallstackFeatures)
+{
+    // Arrange
+    std::vector<uint32_t> weights;
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ht_feature_callstack_enable(timeline);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_aggregation_enable(timeline, 0, HT_FALSE));
+    ht_timeline_register_listener(timeline, callstack_weights_listener, &weights);
+    HT_TCPListener* listener = ht_tcp_listener_create(8798, 4096, nullptr);
+    ASSERT_NE(nullptr, listener);
+    ht_tcp_listener_set_remote_commands_enabled(listener, HT_TRUE);
+    int fd = _connect(8798);
+    ASSERT_LE(0, fd);
+
+    /* returns a number of root frames pushed to the timeline */
+    auto push_frames = [timeline, &weights](size_t count) {
+        size_t prev_size = weights.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            ht_feature_callstack_start_int(timeline, 1);
+            ht_feature_callstack_stop(timeline);
+        }
+        ht_timeline_flush(timeline);
+        return weights.size() - prev_size;
+    };
+
+    // Act & Assert
+    ASSERT_EQ(0u, push_frames(1));
+    _send(fd, "pause-aggregation\n");
+    ASSERT_TRUE(_wait_until([&push_frames] { return push_frames(1) == 1; }));
+
+    _send(fd, "duration-threshold 1000000000000\nduration-threshold 1000000000000 0\n");
+    ASSERT_TRUE(_wait_until([&push_frames] { return push_frames(1) == 0; }));
+
+    _send(fd, "duration-threshold 0 0\nsampling-rate 99999999999\nsampling-rate 3\n");
+    ASSERT_TRUE(_wait_until([&] { return push_frames(1) == 1 && weights.back() == 3; }));
+
+    /* 1 in every 3 frames is recorded unless the frames are aggregated */
+    _send(fd, "sampling-rate 1\nresume-aggregation\n");
+    ASSERT_TRUE(_wait_until([&push_frames] { return push_frames(3) == 0; }));
+
+    ht_tcp_listener_destroy(listener);
+    ht_timeline_unregister_all_listeners(timeline);
+    ht_timeline_destroy(timeline);
+}
+
+#endif
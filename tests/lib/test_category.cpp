@@ -0,0 +1,134 @@
+#include <hawktracer/category.h>
+#include <hawktracer/feature_callstack.h>
+#include <hawktracer/tracepoint.h>
+
+#include "test_common.h"
+#include "test_test_events.h"
+
+#include <gtest/gtest.h>
+
+class TestCategory : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_FALSE, HT_FALSE, nullptr, nullptr);
+        ht_feature_callstack_enable(_timeline);
+        ht_timeline_register_listener(_timeline, test_listener<HT_CallstackIntEvent>, &_info);
+    }
+
+    void TearDown() override
+    {
+        ht_category_set_enabled(HT_CATEGORY_ALL, HT_TRUE);
+        ht_timeline_destroy(_timeline);
+    }
+
+    HT_Timeline* _timeline;
+    NotifyInfo<HT_CallstackIntEvent> _info;
+};
+
+TEST_F(TestCategory, RegisterShouldReturnSameCategoryForSameName)
+{
+    // Arrange
+    HT_ErrorCode err;
+
+    // Act
+    HT_Category category1 = ht_category_register("test_register_1", &err);
+    HT_Category category2 = ht_category_register("test_register_2", &err);
+    HT_Category category1_again = ht_category_register("test_register_1", &err);
+
+    // Assert
+    ASSERT_EQ(HT_ERR_OK, err);
+    ASSERT_NE(0u, category1);
+    ASSERT_NE(0u, category2);
+    ASSERT_EQ(0u, category1 & category2);
+    ASSERT_EQ(category1, category1_again);
+    ASSERT_TRUE(HT_CATEGORY_IS_ENABLED(category1 | category2));
+}
+
+TEST_F(TestCategory, RegisterShouldFailForInvalidNames)
+{
+    // Arrange
+    HT_ErrorCode err;
+
+    // Act & Assert
+    ASSERT_EQ(0u, ht_category_register("", &err));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, err);
+    ASSERT_EQ(0u, ht_category_register("all", &err));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, err);
+    ASSERT_EQ(0u, ht_category_register(std::string(HT_CATEGORY_MAX_NAME_LENGTH + 1, 'x').c_str(), &err));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, err);
+    ASSERT_NE(0u, ht_category_register(std::string(HT_CATEGORY_MAX_NAME_LENGTH, 'x').c_str(), &err));
+    ASSERT_EQ(HT_ERR_OK, err);
+}
+
+TEST_F(TestCategory, TracepointsOfDisabledCategoriesShouldNotBePushed)
+{
+    // Arrange
+    HT_Category enabled_category = ht_category_register("test_tracepoint_enabled", NULL);
+    HT_Category disabled_category = ht_category_register("test_tracepoint_disabled", NULL);
+
+    // Act
+    ht_category_set_enabled(disabled_category, HT_FALSE);
+    {
+        HT_TP_CATEGORY_SCOPED_INT(_timeline, enabled_category, 1);
+    }
+    {
+        HT_TP_CATEGORY_SCOPED_INT(_timeline, disabled_category, 2);
+    }
+    {
+        HT_TP_CATEGORY_SCOPED_INT(_timeline, disabled_category | enabled_category, 3);
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(2u, _info.values.size());
+    ASSERT_EQ(1u, _info.values[0].label);
+    ASSERT_EQ(3u, _info.values[1].label);
+}
+
+TEST_F(TestCategory, EventsOfDisabledCategoriesShouldNotBePushed)
+{
+    // Arrange
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    HT_Category enabled_category = ht_category_register("test_push_enabled", NULL);
+    HT_Category disabled_category = ht_category_register("test_push_disabled", NULL);
+    NotifyInfo<RegistryTestEvent> info;
+    ht_timeline_register_listener(_timeline, test_listener<RegistryTestEvent>, &info);
+    int evaluated_count = 0;
+
+    // Act
+    ht_category_set_enabled(disabled_category, HT_FALSE);
+    HT_TIMELINE_PUSH_EVENT_IN_CATEGORY(_timeline, enabled_category, RegistryTestEvent, 1 + 0 * evaluated_count++);
+    HT_TIMELINE_PUSH_EVENT_IN_CATEGORY(_timeline, disabled_category, RegistryTestEvent, 2 + 0 * evaluated_count++);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(1u, info.values.size());
+    ASSERT_EQ(1, info.values[0].field);
+    // parameters of events which are not pushed are not evaluated
+    ASSERT_EQ(1, evaluated_count);
+}
+
+TEST_F(TestCategory, SetEnabledByNamesShouldApplyToCategoriesRegisteredLater)
+{
+    // Act
+    ASSERT_EQ(HT_ERR_OK, ht_category_set_enabled_by_names("test_names_1,test_names_2", HT_FALSE));
+    HT_Category category1 = ht_category_register("test_names_1", NULL);
+    HT_Category category2 = ht_category_register("test_names_2", NULL);
+    HT_Category category3 = ht_category_register("test_names_3", NULL);
+
+    // Assert
+    ASSERT_FALSE(HT_CATEGORY_IS_ENABLED(category1));
+    ASSERT_FALSE(HT_CATEGORY_IS_ENABLED(category2));
+    ASSERT_TRUE(HT_CATEGORY_IS_ENABLED(category3));
+
+    ASSERT_EQ(HT_ERR_OK, ht_category_set_enabled_by_names("test_names_2", HT_TRUE));
+    ASSERT_FALSE(HT_CATEGORY_IS_ENABLED(category1));
+    ASSERT_TRUE(HT_CATEGORY_IS_ENABLED(category2));
+
+    ASSERT_EQ(HT_ERR_OK, ht_category_set_enabled_by_names("all", HT_FALSE));
+    ASSERT_EQ(0u, ht_category_get_enabled());
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_category_set_enabled_by_names("test_names_1,,all", HT_TRUE));
+    ASSERT_EQ(HT_CATEGORY_ALL, ht_category_get_enabled());
+}
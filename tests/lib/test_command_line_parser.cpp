@@ -1,5 +1,6 @@
 #include <internal/command_line_parser.h>
 #include <internal/global_timeline.h>
+#include <hawktracer/category.h>
 
 #include "test_common.h"
 
@@ -34,6 +35,22 @@ TEST_F(TestCommandLineParserLib, SettingBufferSizeShouldPassForValidInput)
     ht_global_timeline_set_buffer_size(_buff_size);
 }
 
+TEST_F(TestCommandLineParserLib, CompactSerializationFlagShouldEnableCompactSerialization)
+{
+    // Arrange
+    const char* args[] = {"app", "--ht-global-timeline-compact-serialization", "--ht-global-timeline-buffer-size", "76"};
+
+    // Act
+    ht_command_line_parse_args(4, (char**)args);
+
+    // Assert
+    ASSERT_TRUE(ht_global_timeline_get_compact_serialization());
+    ASSERT_EQ(76u, ht_global_timeline_get_buffer_size());
+
+    // Cleanup
+    ht_global_timeline_set_compact_serialization(HT_FALSE);
+}
+
 TEST_F(TestCommandLineParserLib, SettingBufferSizeShouldFailForOutOfRangeValue)
 {
     // Arrange
@@ -79,3 +96,20 @@ TEST_F(TestCommandLineParserLib, PassingInvalidArgumentShouldSkipTheArgument)
     ht_command_line_parse_args(2, (char**)args);
 }
 
+
+TEST_F(TestCommandLineParserLib, CategoriesShouldBeDisabledAndEnabledByNames)
+{
+    // Arrange
+    const char* args[] = {"app", "--ht-disable-categories", "test_cli_1,test_cli_2", "--ht-enable-categories", "test_cli_2"};
+    HT_Category category1 = ht_category_register("test_cli_1", NULL);
+
+    // Act
+    ht_command_line_parse_args(5, (char**)args);
+
+    // Assert
+    ASSERT_FALSE(HT_CATEGORY_IS_ENABLED(category1));
+    ASSERT_TRUE(HT_CATEGORY_IS_ENABLED(ht_category_register("test_cli_2", NULL)));
+
+    // Cleanup
+    ht_category_set_enabled(HT_CATEGORY_ALL, HT_TRUE);
+}
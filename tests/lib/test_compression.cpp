@@ -0,0 +1,154 @@
+#include <hawktracer/compression.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+class TestCompression : public ::testing::Test
+{
+protected:
+    static std::vector<HT_Byte> _compress(const std::vector<HT_Byte>& data)
+    {
+        std::vector<HT_Byte> compressed(ht_compression_get_max_compressed_size(data.size()));
+        std::vector<uint32_t> work_memory(HT_COMPRESSION_WORK_MEMORY_SIZE / sizeof(uint32_t));
+        size_t size = ht_compression_compress(data.data(), data.size(), compressed.data(), compressed.size(), work_memory.data());
+        compressed.resize(size);
+        return compressed;
+    }
+
+    static void _assert_round_trip(const std::vector<HT_Byte>& data)
+    {
+        std::vector<HT_Byte> compressed = _compress(data);
+        ASSERT_LT(0u, compressed.size());
+
+        std::vector<HT_Byte> decompressed(data.size());
+        ASSERT_EQ(HT_ERR_OK, ht_compression_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+        ASSERT_EQ(data, decompressed);
+    }
+};
+
+TEST_F(TestCompression, EmptyInputShouldBeCompressedAndDecompressed)
+{
+    _assert_round_trip({});
+}
+
+TEST_F(TestCompression, SmallInputsShouldBeCompressedAndDecompressed)
+{
+    for (size_t size = 1; size < 40; size++)
+    {
+        std::vector<HT_Byte> data(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] = (HT_Byte)(i % 3);
+        }
+        _assert_round_trip(data);
+    }
+}
+
+TEST_F(TestCompression, RepetitiveDataShouldBeCompressedWell)
+{
+    // Arrange
+    std::vector<HT_Byte> data(100000, 0);
+
+    // Act
+    std::vector<HT_Byte> compressed = _compress(data);
+
+    // Assert
+    ASSERT_LT(compressed.size(), data.size() / 100);
+    _assert_round_trip(data);
+}
+
+TEST_F(TestCompression, EventLikeDataShouldBeCompressedAndDecompressed)
+{
+    // Arrange
+    std::vector<HT_Byte> data;
+    for (uint64_t i = 0; i < 10000; i++)
+    {
+        uint32_t klass_id = 5;
+        uint64_t timestamp = 1000000 + i * 37;
+        uint64_t id = i;
+        uint64_t duration = 100 + i % 13;
+        data.insert(data.end(), (HT_Byte*)&klass_id, (HT_Byte*)&klass_id + sizeof(klass_id));
+        data.insert(data.end(), (HT_Byte*)&timestamp, (HT_Byte*)&timestamp + sizeof(timestamp));
+        data.insert(data.end(), (HT_Byte*)&id, (HT_Byte*)&id + sizeof(id));
+        data.insert(data.end(), (HT_Byte*)&duration, (HT_Byte*)&duration + sizeof(duration));
+    }
+
+    // Act
+    std::vector<HT_Byte> compressed = _compress(data);
+
+    // Assert
+    ASSERT_LT(compressed.size(), data.size() / 2);
+    _assert_round_trip(data);
+}
+
+TEST_F(TestCompression, RandomDataShouldNotExceedMaxCompressedSize)
+{
+    // Arrange
+    std::mt19937 generator(42);
+    std::vector<HT_Byte> data(70000);
+    for (auto& b : data)
+    {
+        b = (HT_Byte)generator();
+    }
+
+    // Act
+    std::vector<HT_Byte> compressed = _compress(data);
+
+    // Assert
+    ASSERT_LE(compressed.size(), ht_compression_get_max_compressed_size(data.size()));
+    _assert_round_trip(data);
+}
+
+TEST_F(TestCompression, CompressShouldFailIfOutputBufferIsTooSmall)
+{
+    // Arrange
+    std::mt19937 generator(42);
+    std::vector<HT_Byte> data(1000);
+    for (auto& b : data)
+    {
+        b = (HT_Byte)generator();
+    }
+    std::vector<HT_Byte> compressed(data.size() / 2);
+    std::vector<uint32_t> work_memory(HT_COMPRESSION_WORK_MEMORY_SIZE / sizeof(uint32_t));
+
+    // Act
+    size_t size = ht_compression_compress(data.data(), data.size(), compressed.data(), compressed.size(), work_memory.data());
+
+    // Assert
+    ASSERT_EQ(0u, size);
+}
+
+TEST_F(TestCompression, DecompressShouldFailForMalformedInput)
+{
+    // Arrange
+    std::vector<HT_Byte> data(1000, 7);
+    std::vector<HT_Byte> compressed = _compress(data);
+    std::vector<HT_Byte> decompressed(data.size());
+
+    // Act & Assert
+    // wrong decompressed size
+    ASSERT_EQ(HT_ERR_INVALID_FORMAT, ht_compression_decompress(compressed.data(), compressed.size(), decompressed.data(), data.size() - 1));
+    // truncated block
+    ASSERT_EQ(HT_ERR_INVALID_FORMAT, ht_compression_decompress(compressed.data(), compressed.size() - 1, decompressed.data(), data.size()));
+    // match offset pointing before the beginning of the output
+    const HT_Byte invalid_offset[] = {0x10, 'a', 0x10, 0x00, 0x00};
+    ASSERT_EQ(HT_ERR_INVALID_FORMAT, ht_compression_decompress(invalid_offset, sizeof(invalid_offset), decompressed.data(), 5));
+}
+
+TEST_F(TestCompression, FrameHeaderShouldBeReadCorrectly)
+{
+    // Arrange
+    HT_Byte header[HT_COMPRESSION_FRAME_HEADER_SIZE];
+    uint32_t raw_size, compressed_size;
+
+    // Act
+    ht_compression_write_frame_header(header, 0x12345678u, 0xABCDEFu);
+    ht_compression_read_frame_header(header, &raw_size, &compressed_size);
+
+    // Assert
+    ASSERT_EQ(0x78, header[0]);
+    ASSERT_EQ(0x12345678u, raw_size);
+    ASSERT_EQ(0xABCDEFu, compressed_size);
+}
@@ -62,6 +62,137 @@ TEST(TestSerializeEvent, CallstackStringEventSerialize)
     ASSERT_STREQ((char*)buffer + offset, event.label);
 }
 
+TEST(TestSerializeEvent, FixedSizeShouldBeKnownOnlyForKlassesWithoutStrings)
+{
+    // Arrange
+    HT_DECL_EVENT(HT_CallstackIntEvent, int_event)
+    HT_DECL_EVENT(HT_EndiannessInfoEvent, endianness_event)
+
+    // Act & Assert
+    ASSERT_EQ((size_t)HT_EVENT_FIXED_SIZE(HT_CallstackIntEvent), HT_EVENT_GET_KLASS(&int_event)->get_size(HT_EVENT(&int_event)));
+    ASSERT_EQ((size_t)HT_EVENT_FIXED_SIZE(HT_EndiannessInfoEvent), HT_EVENT_GET_KLASS(&endianness_event)->get_size(HT_EVENT(&endianness_event)));
+    ASSERT_EQ(0, HT_EVENT_FIXED_SIZE(HT_CallstackStringEvent));
+    ASSERT_EQ(0, HT_EVENT_FIXED_SIZE(HT_EventKlassFieldInfoEvent));
+}
+
+TEST(TestSerializeEvent, TrySerializeShouldWriteSameDataAsSerialize)
+{
+    // Arrange
+    HT_DECL_EVENT(HT_CallstackStringEvent, event)
+    HT_Byte expected[1024];
+    HT_Byte buffer[1024];
+
+    HT_EVENT(&event)->timestamp = 9381;
+    HT_EVENT(&event)->id = 132;
+    HT_CALLSTACK_BASE_EVENT(&event)->duration = 332;
+    HT_CALLSTACK_BASE_EVENT(&event)->thread_id = 8;
+    event.label = "hello_world";
+
+    // Act
+    size_t expected_size = HT_EVENT_GET_KLASS(&event)->serialize(HT_EVENT(&event), expected);
+    size_t size = HT_EVENT_GET_KLASS(&event)->try_serialize(HT_EVENT(&event), buffer, expected_size);
+
+    // Assert
+    ASSERT_EQ(expected_size, size);
+    ASSERT_EQ(HT_EVENT_GET_KLASS(&event)->get_size(HT_EVENT(&event)), size);
+    ASSERT_EQ(0, memcmp(expected, buffer, size));
+}
+
+TEST(TestSerializeEvent, TrySerializeShouldNotWriteOutsideOfCapacity)
+{
+    // Arrange
+    HT_DECL_EVENT(HT_CallstackStringEvent, string_event)
+    HT_DECL_EVENT(HT_CallstackIntEvent, int_event)
+    string_event.label = "hello_world";
+    size_t string_event_size = HT_EVENT_GET_KLASS(&string_event)->get_size(HT_EVENT(&string_event));
+    size_t int_event_size = HT_EVENT_GET_KLASS(&int_event)->get_size(HT_EVENT(&int_event));
+    HT_Byte buffer[1024];
+
+    for (size_t capacity = 0; capacity < string_event_size; capacity++)
+    {
+        memset(buffer, 0xAB, sizeof(buffer));
+
+        // Act
+        size_t size = HT_EVENT_GET_KLASS(&string_event)->try_serialize(HT_EVENT(&string_event), buffer, capacity);
+
+        // Assert
+        ASSERT_EQ(string_event_size, size);
+        for (size_t i = capacity; i < sizeof(buffer); i++)
+        {
+            ASSERT_EQ(0xAB, buffer[i]);
+        }
+    }
+
+    memset(buffer, 0xAB, sizeof(buffer));
+    ASSERT_EQ(int_event_size, HT_EVENT_GET_KLASS(&int_event)->try_serialize(HT_EVENT(&int_event), buffer, int_event_size - 1));
+    ASSERT_EQ(0xAB, buffer[0]);
+}
+
+TEST(TestSerializeEvent, CompactWriteUintShouldUseMinimalNumberOfBytes)
+{
+    // Arrange
+    HT_Byte buffer[HT_COMPACT_VARINT_MAX_SIZE];
+
+    // Act & Assert
+    ASSERT_EQ(1u, ht_compact_write_uint(buffer, 0));
+    ASSERT_EQ(0x00, buffer[0]);
+    ASSERT_EQ(1u, ht_compact_write_uint(buffer, 127));
+    ASSERT_EQ(0x7f, buffer[0]);
+    ASSERT_EQ(2u, ht_compact_write_uint(buffer, 300));
+    ASSERT_EQ(0xac, buffer[0]);
+    ASSERT_EQ(0x02, buffer[1]);
+    ASSERT_EQ((size_t)HT_COMPACT_VARINT_MAX_SIZE, ht_compact_write_uint(buffer, (uint64_t)-1));
+    ASSERT_EQ(0x01, buffer[HT_COMPACT_VARINT_MAX_SIZE - 1]);
+}
+
+TEST(TestSerializeEvent, CompactWriteIntShouldUseZigZagEncoding)
+{
+    // Arrange
+    HT_Byte buffer[HT_COMPACT_VARINT_MAX_SIZE];
+
+    // Act & Assert
+    ASSERT_EQ(1u, ht_compact_write_int(buffer, 0));
+    ASSERT_EQ(0x00, buffer[0]);
+    ASSERT_EQ(1u, ht_compact_write_int(buffer, -1));
+    ASSERT_EQ(0x01, buffer[0]);
+    ASSERT_EQ(1u, ht_compact_write_int(buffer, 1));
+    ASSERT_EQ(0x02, buffer[0]);
+    ASSERT_EQ(1u, ht_compact_write_int(buffer, -64));
+    ASSERT_EQ(0x7f, buffer[0]);
+    ASSERT_EQ((size_t)HT_COMPACT_VARINT_MAX_SIZE, ht_compact_write_int(buffer, INT64_MIN));
+}
+
+TEST(TestSerializeEvent, CallstackIntEventSerializeCompact)
+{
+    // Arrange
+    HT_DECL_EVENT(HT_CallstackIntEvent, event)
+    HT_Byte buffer[1024];
+    HT_CompactContext context = {9000, 130};
+
+    HT_EVENT(&event)->timestamp = 9381;
+    HT_EVENT(&event)->id = 129;
+    HT_CALLSTACK_BASE_EVENT(&event)->duration = 332;
+    HT_CALLSTACK_BASE_EVENT(&event)->thread_id = 8;
+    event.label = 83123;
+
+    // Act
+    size_t size = HT_EVENT_GET_KLASS(&event)->serialize_compact(HT_EVENT(&event), buffer, &context);
+
+    // Assert
+    HT_Byte expected[HT_COMPACT_VARINT_MAX_SIZE * 6];
+    size_t offset = ht_compact_write_uint(expected, HT_EVENT_GET_KLASS(&event)->klass_id);
+    offset += ht_compact_write_int(expected + offset, 381);
+    offset += ht_compact_write_int(expected + offset, -1);
+    offset += ht_compact_write_uint(expected + offset, 332);
+    offset += ht_compact_write_uint(expected + offset, 8);
+    offset += ht_compact_write_uint(expected + offset, 83123);
+    ASSERT_EQ(offset, size);
+    ASSERT_EQ(0, memcmp(expected, buffer, size));
+    ASSERT_EQ(9381u, context.timestamp);
+    ASSERT_EQ(129u, context.id);
+    ASSERT_GE(HT_EVENT_GET_KLASS(&event)->get_size(HT_EVENT(&event)), 3 * size);
+}
+
 TEST(TestEvent, IsInstanceOfShouldReturnTrueIfEventIsInstanceOfKlass)
 {
     // Arrange
@@ -2,6 +2,10 @@
 
 #include <hawktracer/event_id_provider.h>
 
+#include <set>
+#include <thread>
+#include <vector>
+
 TEST(EventIdProviderTest, BaseTest)
 {
     // Arrange
@@ -26,3 +30,55 @@ TEST(EventIdProviderTest, DefaultProvider)
     ASSERT_EQ(first + 2, ht_event_id_provider_next(provider));
     ASSERT_EQ(first + 3, ht_event_id_provider_next(provider));
 }
+
+TEST(EventIdProviderTest, BlockSizeShouldGiveConsecutiveIdentifiersToOneThread)
+{
+    // Arrange
+    HT_EventIdProvider* provider = ht_event_id_provider_create();
+    ht_event_id_provider_set_block_size(provider, 4);
+
+    // Act & Assert
+    HT_EventId first = ht_event_id_provider_next(provider);
+    for (HT_EventId i = 1; i < 10; i++)
+    {
+        ASSERT_EQ(first + i, ht_event_id_provider_next(provider));
+    }
+
+    ht_event_id_provider_destroy(provider);
+}
+
+TEST(EventIdProviderTest, BlockSizeShouldGiveUniqueIdentifiersToMultipleThreads)
+{
+    // Arrange
+    const size_t thread_count = 4;
+    const size_t id_count = 10000;
+    HT_EventIdProvider* provider = ht_event_id_provider_create();
+    ht_event_id_provider_set_block_size(provider, 64);
+    std::vector<std::vector<HT_EventId>> ids(thread_count);
+
+    // Act
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([provider, &ids, t, id_count] {
+            for (size_t i = 0; i < id_count; i++)
+            {
+                ids[t].push_back(ht_event_id_provider_next(provider));
+            }
+        });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+
+    // Assert
+    std::set<HT_EventId> unique_ids;
+    for (const auto& thread_ids : ids)
+    {
+        unique_ids.insert(thread_ids.begin(), thread_ids.end());
+    }
+    ASSERT_EQ(thread_count * id_count, unique_ids.size());
+
+    ht_event_id_provider_destroy(provider);
+}
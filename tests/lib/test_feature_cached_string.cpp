@@ -2,10 +2,15 @@
 
 #include <hawktracer/ht_config.h>
 #include <hawktracer/feature_cached_string.h>
+#include <hawktracer/feature_callstack.h>
+#include <hawktracer/string_scoped_tracepoint.h>
 
 #include "test_common.h"
 #include <gtest/gtest.h>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 TEST(TestFeatureCachedString, AddMappingShouldEmitStringMappingEvent)
 {
@@ -128,6 +133,165 @@ TEST(TestFeatureCachedString, DynamicStrings)
     ht_timeline_destroy(timeline);
 }
 
+TEST(TestFeatureCachedString, DynamicStringsAddedFromManyThreadsShouldBeMappedOnce)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_TRUE, HT_FALSE, NULL, NULL);
+    ht_feature_cached_string_enable(timeline, HT_TRUE);
+    NotifyInfo<HT_StringMappingEvent> string_map_info;
+    std::vector<std::string> labels;
+    for (int i = 0; i < 500; i++)
+    {
+        labels.push_back("label" + std::to_string(i));
+    }
+
+    ht_timeline_register_listener(timeline, test_listener<HT_StringMappingEvent>, &string_map_info);
+
+    // Act
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&] {
+            for (const auto& label : labels)
+            {
+                ht_feature_cached_string_add_mapping_dynamic(timeline, label.c_str());
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    ht_timeline_flush(timeline);
+
+    // Assert
+    ASSERT_EQ(labels.size(), string_map_info.values.size());
+    std::unordered_map<std::string, uint64_t> actual_labels;
+    for (const auto& element : string_map_info.values)
+    {
+        actual_labels[element.label] = element.identifier;
+    }
+    ASSERT_EQ(labels.size(), actual_labels.size());
+
+    ht_timeline_destroy(timeline);
+}
+
+#ifdef HT_TP_CONSTEXPR_STRACEPOINT
+
+TEST(TestFeatureCachedString, ConstexprLabelHashShouldMatchDynamicMapping)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, NULL, NULL);
+    ht_feature_cached_string_enable(timeline, HT_FALSE);
+    constexpr uintptr_t ascii_hash = HawkTracer::ConstexprLabel::hash("test_label");
+    constexpr uintptr_t non_ascii_hash = HawkTracer::ConstexprLabel::hash("\xc5\x82" "abel");
+
+    // Act & Assert
+    ASSERT_EQ(ht_feature_cached_string_add_mapping_dynamic(timeline, "test_label"), ascii_hash);
+    ASSERT_EQ(ht_feature_cached_string_add_mapping_dynamic(timeline, "\xc5\x82" "abel"), non_ascii_hash);
+
+    ht_timeline_destroy(timeline);
+}
+
+struct ConstexprTracepointInfo
+{
+    std::vector<HT_StringMappingEvent> mappings;
+    std::vector<HT_CallstackIntEvent> int_events;
+};
+
+static void constexpr_tracepoint_listener(TEventPtr events, size_t size, HT_Boolean serialized, void* user_data)
+{
+    auto info = static_cast<ConstexprTracepointInfo*>(user_data);
+    ASSERT_FALSE(serialized);
+
+    for (TEventPtr end = events + size; events < end; events += HT_EVENT_GET_KLASS(events)->type_info->size)
+    {
+        if (HT_EVENT_IS_INSTANCE_OF(events, HT_StringMappingEvent))
+        {
+            info->mappings.push_back(*(HT_StringMappingEvent*)events);
+        }
+        else if (HT_EVENT_IS_INSTANCE_OF(events, HT_CallstackIntEvent))
+        {
+            info->int_events.push_back(*(HT_CallstackIntEvent*)events);
+        }
+    }
+}
+
+static void constexpr_traced_function(HT_Timeline* timeline)
+{
+    HT_TP_CONSTEXPR_STRACEPOINT(timeline, "constexpr_traced_function_label")
+}
+
+TEST(TestFeatureCachedString, ConstexprTracepointShouldAddMappingOnce)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_TRUE, HT_FALSE, NULL, NULL);
+    ht_feature_cached_string_enable(timeline, HT_TRUE);
+    ht_feature_callstack_enable(timeline);
+    ConstexprTracepointInfo info;
+    ht_timeline_register_listener(timeline, constexpr_tracepoint_listener, &info);
+
+    // Act
+    constexpr_traced_function(timeline);
+    std::thread([timeline] {
+        constexpr_traced_function(timeline);
+        constexpr_traced_function(timeline);
+    }).join();
+    ht_timeline_flush(timeline);
+
+    // Assert
+    uintptr_t expected_id = ht_feature_cached_string_add_mapping_dynamic(timeline, "constexpr_traced_function_label");
+    ASSERT_EQ(1u, info.mappings.size());
+    ASSERT_EQ(expected_id, info.mappings.front().identifier);
+    ASSERT_STREQ("constexpr_traced_function_label", info.mappings.front().label);
+    ASSERT_EQ(3u, info.int_events.size());
+    for (const auto& event : info.int_events)
+    {
+        ASSERT_EQ(expected_id, event.label);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST(TestFeatureCachedString, ConstexprTracepointShouldAddMappingToEveryTimeline)
+{
+    // Arrange
+    HT_Timeline* first_timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, NULL, NULL);
+    HT_Timeline* second_timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, NULL, NULL);
+    ConstexprTracepointInfo first_info;
+    ConstexprTracepointInfo second_info;
+    for (HT_Timeline* timeline : {first_timeline, second_timeline})
+    {
+        ht_feature_cached_string_enable(timeline, HT_FALSE);
+        ht_feature_callstack_enable(timeline);
+    }
+    ht_timeline_register_listener(first_timeline, constexpr_tracepoint_listener, &first_info);
+    ht_timeline_register_listener(second_timeline, constexpr_tracepoint_listener, &second_info);
+
+    // Act
+    constexpr_traced_function(first_timeline);
+    constexpr_traced_function(second_timeline);
+    constexpr_traced_function(second_timeline);
+    ht_timeline_flush(first_timeline);
+    ht_timeline_flush(second_timeline);
+
+    // Assert
+    uintptr_t expected_id = HawkTracer::ConstexprLabel::hash("constexpr_traced_function_label");
+    ASSERT_EQ(1u, first_info.mappings.size());
+    ASSERT_EQ(expected_id, first_info.mappings.front().identifier);
+    ASSERT_EQ(1u, first_info.int_events.size());
+    ASSERT_EQ(1u, second_info.mappings.size());
+    ASSERT_EQ(expected_id, second_info.mappings.front().identifier);
+    ASSERT_STREQ("constexpr_traced_function_label", second_info.mappings.front().label);
+    ASSERT_EQ(2u, second_info.int_events.size());
+    ASSERT_EQ(1u, ht_feature_cached_string_get_mapping_count(second_timeline));
+
+    ht_timeline_destroy(first_timeline);
+    ht_timeline_destroy(second_timeline);
+}
+
+#endif /* HT_TP_CONSTEXPR_STRACEPOINT */
+
 TEST(TestFeatureCachedString, PushMapShouldSendDynamicAndStaticMapping)
 {
     // Arrange
@@ -1,3 +1,4 @@
+#include <hawktracer/thread.h>
 #include <hawktracer/tracepoint.h>
 
 #include "test_allocator.h"
@@ -6,7 +7,9 @@
 
 #include <gtest/gtest.h>
 
+#include <map>
 #include <thread>
+#include <vector>
 
 class TestFeatureCallstack : public ::testing::Test
 {
@@ -125,6 +128,59 @@ TEST_F(TestFeatureCallstack, CallstackTimelinesRunOnDifferentThreadsShouldGenera
     ASSERT_NE(event1.base.thread_id, event2.base.thread_id);
 }
 
+TEST_F(TestFeatureCallstack, ThreadsSharingTimelineShouldHaveSeparateCallstacks)
+{
+    // Arrange
+    _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    ht_feature_callstack_enable(_timeline);
+    NotifyInfo<HT_CallstackIntEvent> info;
+    ht_timeline_register_listener(_timeline, test_listener<HT_CallstackIntEvent>, &info);
+    const int thread_count = 4;
+    const int iteration_count = 200;
+
+    // Act
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([this, t] {
+            for (int i = 0; i < iteration_count; i++)
+            {
+                ht_feature_callstack_start_int(_timeline, t * 10);
+                ht_feature_callstack_start_int(_timeline, t * 10 + 1);
+                std::this_thread::yield();
+                ht_feature_callstack_stop(_timeline);
+                ht_feature_callstack_stop(_timeline);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(2u * thread_count * iteration_count, info.values.size());
+    // every thread should have only reported its own labels, inner scope first
+    std::map<HT_ThreadId, std::vector<HT_CallstackEventLabel>> labels;
+    for (const auto& event : info.values)
+    {
+        labels[event.base.thread_id].push_back(event.label);
+    }
+    ASSERT_EQ((size_t)thread_count, labels.size());
+    for (const auto& thread_labels : labels)
+    {
+        ASSERT_EQ(2u * iteration_count, thread_labels.second.size());
+        HT_CallstackEventLabel outer = thread_labels.second[1];
+        ASSERT_EQ(0u, outer % 10);
+        for (size_t i = 0; i < thread_labels.second.size(); i += 2)
+        {
+            ASSERT_EQ(outer + 1, thread_labels.second[i]);
+            ASSERT_EQ(outer, thread_labels.second[i + 1]);
+        }
+    }
+}
+
 TEST_F(TestFeatureCallstack, MixedCallstackEventTypes)
 {
     // Arrange
@@ -256,3 +312,370 @@ TEST_F(TestFeatureCallstack, MixedEventPublishing)
     ASSERT_EQ(3, info.values[2].info);
     ASSERT_EQ(1, info.values[3].info);
 }
+
+struct CallstackNotifyInfo
+{
+    std::vector<HT_CallstackEventLabel> labels;
+    std::vector<uint32_t> weights;
+    std::vector<HT_CallstackOverflowEvent> overflows;
+    std::map<HT_CallstackEventLabel, uint64_t> filtered;
+    // labels of the int events, and 0 for overflow events, in the order they were pushed
+    std::vector<HT_CallstackEventLabel> order;
+};
+
+static void callstack_test_listener(TEventPtr events, size_t size, HT_Boolean, void* user_data)
+{
+    CallstackNotifyInfo* info = static_cast<CallstackNotifyInfo*>(user_data);
+    TEventPtr end = events + size;
+
+    while (events < end)
+    {
+        HT_EventKlass* klass = HT_EVENT_GET_KLASS(events);
+        if (klass == ht_HT_CallstackOverflowEvent_get_event_klass_instance())
+        {
+            info->overflows.push_back(*(HT_CallstackOverflowEvent*)events);
+            info->order.push_back(0);
+        }
+        else if (klass == ht_HT_CallstackFilteredEvent_get_event_klass_instance())
+        {
+            HT_CallstackFilteredEvent* event = (HT_CallstackFilteredEvent*)events;
+            ASSERT_EQ(ht_thread_get_current_thread_id(), event->thread_id);
+            info->filtered[event->frame_label] += event->dropped_count;
+        }
+        else if (klass == ht_HT_CallstackIntEvent_get_event_klass_instance())
+        {
+            info->labels.push_back(((HT_CallstackIntEvent*)events)->label);
+            info->weights.push_back(1);
+            info->order.push_back(info->labels.back());
+        }
+        else if (klass == ht_HT_CallstackSampledIntEvent_get_event_klass_instance())
+        {
+            info->labels.push_back(((HT_CallstackIntEvent*)events)->label);
+            info->weights.push_back(((HT_CallstackSampledIntEvent*)events)->weight);
+            info->order.push_back(info->labels.back());
+        }
+        events += klass->type_info->size;
+    }
+}
+
+TEST_F(TestFeatureCallstack, EnableFixedDepthShouldFailForInvalidArguments)
+{
+    // Arrange
+    HT_Timeline* tm = ht_timeline_create(16u, HT_FALSE, HT_FALSE, nullptr, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_feature_callstack_enable_fixed_depth(tm, 0, sizeof(HT_CallstackIntEvent)));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_feature_callstack_enable_fixed_depth(tm, 8, sizeof(HT_Event)));
+
+    ht_timeline_destroy(tm);
+}
+
+TEST_F(TestFeatureCallstack, FixedDepthShouldReportFramesAboveMaxDepthAsOverflow)
+{
+    // Arrange
+    _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_enable_fixed_depth(_timeline, 2, sizeof(HT_CallstackIntEvent)));
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+
+    // Act
+    for (int i = 1; i <= 4; i++)
+    {
+        ht_feature_callstack_start_int(_timeline, i);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        ht_feature_callstack_stop(_timeline);
+    }
+    // the stack can be used again after the overflow
+    ht_feature_callstack_start_int(_timeline, 5);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(1u, info.overflows.size());
+    ASSERT_EQ(2u, info.overflows[0].dropped_count);
+    ASSERT_EQ(ht_thread_get_current_thread_id(), info.overflows[0].thread_id);
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({0, 2, 1, 5}), info.order);
+}
+
+TEST_F(TestFeatureCallstack, NewThreadShouldNotSeeFramesLeftByExitedThread)
+{
+    // Arrange
+    _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_enable_fixed_depth(_timeline, 2, sizeof(HT_CallstackIntEvent)));
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+    std::thread([this] {
+        // exits with a full stack, and one frame above it
+        for (int i = 1; i <= 3; i++)
+        {
+            ht_feature_callstack_start_int(_timeline, i);
+        }
+    }).join();
+
+    // Act
+    std::thread([this] {
+        ht_feature_callstack_start_int(_timeline, 4);
+        ht_feature_callstack_stop(_timeline);
+    }).join();
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({4}), info.labels);
+    ASSERT_EQ(0u, info.overflows.size());
+}
+
+TEST_F(TestFeatureCallstack, FixedDepthShouldDropEventsBiggerThanFrameSize)
+{
+    // Arrange
+    _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_enable_fixed_depth(_timeline, 4, sizeof(HT_CallstackBaseEvent)));
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+
+    // Act
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(0u, info.labels.size());
+    ASSERT_EQ(1u, info.overflows.size());
+    ASSERT_EQ(1u, info.overflows[0].dropped_count);
+}
+
+TEST_F(TestFeatureCallstack, FixedDepthShouldNotAllocateMemoryOnceThreadStackIsCreated)
+{
+    // Arrange
+    _timeline = ht_timeline_create(sizeof(HT_CallstackIntEvent) * 8, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_enable_fixed_depth(_timeline, 16, sizeof(HT_CallstackIntEvent)));
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+
+    // Act
+    {
+        ScopedSetAlloc allocator(ht_test_null_realloc);
+        for (int i = 1; i <= 20; i++)
+        {
+            ht_feature_callstack_start_int(_timeline, i);
+        }
+        for (int i = 0; i < 20; i++)
+        {
+            ht_feature_callstack_stop(_timeline);
+        }
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(16u, info.labels.size());
+    ASSERT_EQ(16u, info.labels.front());
+    ASSERT_EQ(1u, info.labels.back());
+    ASSERT_EQ(1u, info.overflows.size());
+    ASSERT_EQ(4u, info.overflows[0].dropped_count);
+}
+
+TEST_F(TestFeatureCallstack, SetDurationThresholdShouldFailIfFeatureIsNotEnabled)
+{
+    // Arrange
+    HT_Timeline* tm = ht_timeline_create(16u, HT_FALSE, HT_FALSE, nullptr, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_FEATURE_NOT_REGISTERED, ht_feature_callstack_set_duration_threshold(tm, 1000, 0));
+    ASSERT_EQ(HT_ERR_FEATURE_NOT_REGISTERED, ht_feature_callstack_set_label_duration_threshold(tm, 1, 1000));
+
+    ht_timeline_destroy(tm);
+}
+
+TEST_F(TestFeatureCallstack, FramesShorterThanThresholdShouldNotBePushed)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackIntEvent) * 8);
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_duration_threshold(_timeline, 1000000000, 0));
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_label_duration_threshold(_timeline, 3, 0));
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_label_duration_threshold(_timeline, 1, 0));
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_label_duration_threshold(_timeline, 2, 1000000000));
+
+    // Act
+    for (HT_CallstackEventLabel label = 1; label <= 4; label++)
+    {
+        ht_feature_callstack_start_int(_timeline, label);
+        ht_feature_callstack_stop(_timeline);
+    }
+    // the threshold of the label can be changed
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_label_duration_threshold(_timeline, 1, 1000000000));
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    // and the filter can be disabled
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_duration_threshold(_timeline, 0, 0));
+    ht_feature_callstack_start_int(_timeline, 4);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({1, 3, 4}), info.labels);
+    ASSERT_EQ(0u, info.filtered.size());
+}
+
+TEST_F(TestFeatureCallstack, DroppedFramesShouldBeReportedPerLabel)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackIntEvent) * 8);
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_duration_threshold(_timeline, 1000000000, 50000000));
+
+    // Act
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_start_string(_timeline, "label");
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+    ASSERT_EQ(0u, info.filtered.size());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    ht_feature_callstack_start_int(_timeline, 2);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(0u, info.labels.size());
+    ASSERT_EQ((std::map<HT_CallstackEventLabel, uint64_t>{{0, 1}, {1, 2}, {2, 1}}), info.filtered);
+}
+
+TEST_F(TestFeatureCallstack, SetSamplingShouldFailForInvalidArguments)
+{
+    // Arrange
+    HT_Timeline* tm = ht_timeline_create(16u, HT_FALSE, HT_FALSE, nullptr, nullptr);
+    init_timeline(sizeof(HT_CallstackIntEvent));
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_FEATURE_NOT_REGISTERED, ht_feature_callstack_set_sampling_rate(tm, 10));
+    ASSERT_EQ(HT_ERR_FEATURE_NOT_REGISTERED, ht_feature_callstack_set_sampling_window(tm, 10, 100));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_feature_callstack_set_sampling_rate(_timeline, (uint64_t)1 << 32));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_feature_callstack_set_sampling_window(_timeline, 0, 100));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_feature_callstack_set_sampling_window(_timeline, 101, 100));
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_sampling_window(_timeline, 0, 0));
+
+    ht_timeline_destroy(tm);
+}
+
+TEST_F(TestFeatureCallstack, SamplingRateShouldRecordWholeCallstacksOfEveryNthRootFrame)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackIntEvent) * 16);
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_sampling_rate(_timeline, 3));
+
+    // Act
+    for (HT_CallstackEventLabel label = 0; label < 7; label++)
+    {
+        ht_feature_callstack_start_int(_timeline, label * 10);
+        ht_feature_callstack_start_int(_timeline, label * 10 + 1);
+        ht_feature_callstack_stop(_timeline);
+        ht_feature_callstack_start_int_weighted(_timeline, label * 10 + 2, 2);
+        ht_feature_callstack_stop(_timeline);
+        ht_feature_callstack_stop(_timeline);
+    }
+    // sampling can be disabled
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_sampling_rate(_timeline, 0));
+    ht_feature_callstack_start_int(_timeline, 100);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({1, 2, 0, 31, 32, 30, 61, 62, 60, 100}), info.labels);
+    ASSERT_EQ(std::vector<uint32_t>({3, 6, 3, 3, 6, 3, 3, 6, 3, 1}), info.weights);
+}
+
+TEST_F(TestFeatureCallstack, SamplingWindowCoveringWholePeriodShouldRecordAllFrames)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackIntEvent) * 16);
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_sampling_rate(_timeline, 5));
+    // the window replaces the rate
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_set_sampling_window(_timeline, 1000, 1000));
+
+    // Act
+    for (HT_CallstackEventLabel label = 0; label < 3; label++)
+    {
+        ht_feature_callstack_start_int(_timeline, label);
+        ht_feature_callstack_stop(_timeline);
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({0, 1, 2}), info.labels);
+    ASSERT_EQ(std::vector<uint32_t>({1, 1, 1}), info.weights);
+}
+
+static void sampled_scoped_tracepoint(HT_Timeline* timeline, HT_CallstackEventLabel label)
+{
+    HT_TP_SAMPLED_SCOPED_INT(timeline, 4, label);
+}
+
+TEST_F(TestFeatureCallstack, SampledScopedTracepointShouldRecordEveryNthHitPerThread)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackIntEvent) * 16);
+    CallstackNotifyInfo info;
+    ht_timeline_register_listener(_timeline, callstack_test_listener, &info);
+
+    // Act
+    for (HT_CallstackEventLabel label = 0; label < 8; label++)
+    {
+        sampled_scoped_tracepoint(_timeline, label);
+    }
+    // the new thread has its own counter
+    std::thread th([this] {
+        sampled_scoped_tracepoint(_timeline, 100);
+    });
+    th.join();
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<HT_CallstackEventLabel>({0, 4, 100}), info.labels);
+    ASSERT_EQ(std::vector<uint32_t>({4, 4, 4}), info.weights);
+}
+
+static void callstack_klass_listener(TEventPtr events, size_t size, HT_Boolean, void* user_data)
+{
+    auto klasses = static_cast<std::vector<std::pair<HT_EventKlass*, uint32_t>>*>(user_data);
+    TEventPtr end = events + size;
+
+    while (events < end)
+    {
+        HT_EventKlass* klass = HT_EVENT_GET_KLASS(events);
+        klasses->emplace_back(klass, klass == ht_HT_CallstackSampledStringEvent_get_event_klass_instance() ?
+                                  ((HT_CallstackSampledStringEvent*)events)->weight : 1);
+        events += klass->type_info->size;
+    }
+}
+
+TEST_F(TestFeatureCallstack, OnlyFramesWithWeightOtherThanOneShouldBePushedAsSampledEvents)
+{
+    // Arrange
+    init_timeline(sizeof(HT_CallstackSampledStringEvent) * 16);
+    std::vector<std::pair<HT_EventKlass*, uint32_t>> klasses;
+    ht_timeline_register_listener(_timeline, callstack_klass_listener, &klasses);
+
+    // Act
+    ht_feature_callstack_start_string_weighted(_timeline, "sampled", 5);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_start_string_weighted(_timeline, "not_sampled", 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(2u, klasses.size());
+    ASSERT_EQ(ht_HT_CallstackSampledStringEvent_get_event_klass_instance(), klasses[0].first);
+    ASSERT_EQ(5u, klasses[0].second);
+    ASSERT_EQ(ht_HT_CallstackStringEvent_get_event_klass_instance(), klasses[1].first);
+}
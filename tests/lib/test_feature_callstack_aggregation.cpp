@@ -0,0 +1,379 @@
+#include <hawktracer/feature_callstack.h>
+#include <hawktracer/feature_callstack_aggregation.h>
+#include <hawktracer/duration_conversion.h>
+#include <hawktracer/monotonic_clock.h>
+#include "internal/feature_callstack_aggregation.h"
+
+#include "test_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <thread>
+#include <vector>
+
+struct AggregationNotifyInfo
+{
+    std::vector<HT_CallstackSummaryEvent> summaries;
+    std::map<uint64_t, std::map<uint16_t, uint32_t>> histograms;
+    std::vector<HT_CallstackIntEvent> int_events;
+    std::vector<std::string> string_labels;
+
+    const HT_CallstackSummaryEvent* find_summary(HT_CallstackEventLabel label) const
+    {
+        for (const auto& summary : summaries)
+        {
+            if (summary.frame_label == label)
+            {
+                return &summary;
+            }
+        }
+        return nullptr;
+    }
+};
+
+static void aggregation_test_listener(TEventPtr events, size_t size, HT_Boolean, void* user_data)
+{
+    AggregationNotifyInfo* info = static_cast<AggregationNotifyInfo*>(user_data);
+    TEventPtr end = events + size;
+
+    while (events < end)
+    {
+        HT_EventKlass* klass = HT_EVENT_GET_KLASS(events);
+        if (klass == ht_HT_CallstackSummaryEvent_get_event_klass_instance())
+        {
+            info->summaries.push_back(*(HT_CallstackSummaryEvent*)events);
+        }
+        else if (klass == ht_HT_CallstackSummaryHistogramEvent_get_event_klass_instance())
+        {
+            HT_CallstackSummaryHistogramEvent* event = (HT_CallstackSummaryHistogramEvent*)events;
+            info->histograms[event->path_id][event->bucket] += event->count;
+        }
+        else if (klass == ht_HT_CallstackIntEvent_get_event_klass_instance())
+        {
+            info->int_events.push_back(*(HT_CallstackIntEvent*)events);
+        }
+        else if (klass == ht_HT_CallstackStringEvent_get_event_klass_instance())
+        {
+            info->string_labels.push_back(((HT_CallstackStringEvent*)events)->label);
+        }
+        events += klass->type_info->size;
+    }
+}
+
+class TestFeatureCallstackAggregation : public ::testing::Test
+{
+protected:
+    void init_timeline(HT_DurationNs summary_interval, HT_Boolean thread_safe = HT_FALSE)
+    {
+        _timeline = ht_timeline_create(1024, thread_safe, HT_FALSE, nullptr, nullptr);
+        ht_feature_callstack_enable(_timeline);
+        ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_aggregation_enable(_timeline, summary_interval, thread_safe));
+        ht_timeline_register_listener(_timeline, aggregation_test_listener, &_info);
+    }
+
+    void TearDown() override
+    {
+        if (_timeline)
+        {
+            ht_timeline_unregister_all_listeners(_timeline);
+            ht_timeline_destroy(_timeline);
+        }
+    }
+
+    HT_Timeline* _timeline = nullptr;
+    AggregationNotifyInfo _info;
+};
+
+TEST_F(TestFeatureCallstackAggregation, BucketsShouldBeLogLinear)
+{
+    for (HT_DurationNs duration = 0; duration < 8; duration++)
+    {
+        ASSERT_EQ(duration, ht_feature_callstack_aggregation_get_bucket(duration));
+    }
+    ASSERT_EQ(8u, ht_feature_callstack_aggregation_get_bucket(9));
+    ASSERT_EQ(9u, ht_feature_callstack_aggregation_get_bucket(10));
+    ASSERT_EQ(HT_CALLSTACK_AGGREGATION_HISTOGRAM_SIZE - 1u, ht_feature_callstack_aggregation_get_bucket((HT_DurationNs)-1));
+
+    for (HT_DurationNs duration = 1; duration < ((HT_DurationNs)1 << 41); duration = duration * 3 / 2 + 1)
+    {
+        size_t bucket = ht_feature_callstack_aggregation_get_bucket(duration);
+        ASSERT_LE(ht_feature_callstack_aggregation_get_bucket_min_duration(bucket), duration);
+        ASSERT_GT(ht_feature_callstack_aggregation_get_bucket_min_duration(bucket + 1), duration);
+    }
+}
+
+TEST_F(TestFeatureCallstackAggregation, FramesShouldBeAggregatedByPath)
+{
+    // Arrange
+    init_timeline(0);
+
+    // Act
+    for (int i = 0; i < 3; i++)
+    {
+        ht_feature_callstack_start_int(_timeline, 1);
+        for (int j = 0; j < 2; j++)
+        {
+            ht_feature_callstack_start_int(_timeline, 2);
+            ht_feature_callstack_stop(_timeline);
+        }
+        ht_feature_callstack_stop(_timeline);
+    }
+    ht_feature_callstack_start_int(_timeline, 2);
+    ht_feature_callstack_stop(_timeline);
+    ht_timeline_flush(_timeline);
+    ASSERT_EQ(0u, _info.summaries.size());
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(0u, _info.int_events.size());
+    ASSERT_EQ(3u, _info.summaries.size());
+
+    const HT_CallstackSummaryEvent* outer = _info.find_summary(1);
+    ASSERT_NE(nullptr, outer);
+    ASSERT_EQ(0u, outer->parent_path_id);
+    ASSERT_EQ(3u, outer->count);
+
+    const HT_CallstackSummaryEvent* inner = nullptr;
+    const HT_CallstackSummaryEvent* root = nullptr;
+    for (const auto& summary : _info.summaries)
+    {
+        if (summary.frame_label == 2)
+        {
+            (summary.parent_path_id == outer->path_id ? inner : root) = &summary;
+        }
+    }
+    ASSERT_NE(nullptr, inner);
+    ASSERT_NE(nullptr, root);
+    ASSERT_NE(inner->path_id, root->path_id);
+    ASSERT_EQ(6u, inner->count);
+    ASSERT_EQ(1u, root->count);
+    ASSERT_EQ(0u, root->parent_path_id);
+
+    ASSERT_EQ(outer->total_duration - inner->total_duration, outer->self_duration);
+    ASSERT_EQ(inner->total_duration, inner->self_duration);
+    ASSERT_LE(inner->min_duration, inner->max_duration);
+    ASSERT_LE(inner->min_duration * inner->count, inner->total_duration);
+    ASSERT_GE(inner->max_duration * inner->count, inner->total_duration);
+
+    for (const auto& summary : _info.summaries)
+    {
+        uint64_t count = 0;
+        for (const auto& bucket : _info.histograms[summary.path_id])
+        {
+            ASSERT_GE(bucket.first, ht_feature_callstack_aggregation_get_bucket(summary.min_duration));
+            ASSERT_LE(bucket.first, ht_feature_callstack_aggregation_get_bucket(summary.max_duration));
+            count += bucket.second;
+        }
+        ASSERT_EQ(summary.count, count);
+    }
+}
+
+TEST_F(TestFeatureCallstackAggregation, FlushShouldOnlyPushFramesCompletedSinceLastSummary)
+{
+    // Arrange
+    init_timeline(0);
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+
+    // Act
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(2u, _info.summaries.size());
+    ASSERT_EQ(_info.summaries[0].path_id, _info.summaries[1].path_id);
+    ASSERT_EQ(1u, _info.summaries[0].count);
+    ASSERT_EQ(1u, _info.summaries[1].count);
+}
+
+TEST_F(TestFeatureCallstackAggregation, SummaryShouldBePushedWhenIntervalElapses)
+{
+    // Arrange
+    init_timeline(1);
+
+    // Act
+    for (int i = 0; i < 3; i++)
+    {
+        ht_feature_callstack_start_int(_timeline, 1);
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+        ht_feature_callstack_stop(_timeline);
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(3u, _info.summaries.size());
+}
+
+TEST_F(TestFeatureCallstackAggregation, NonIntFramesShouldBePushedToTimeline)
+{
+    // Arrange
+    init_timeline(0);
+
+    // Act
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_start_string(_timeline, "string_label");
+    ht_feature_callstack_start_int(_timeline, 2);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(std::vector<std::string>({"string_label"}), _info.string_labels);
+    ASSERT_EQ(2u, _info.summaries.size());
+    const HT_CallstackSummaryEvent* outer = _info.find_summary(1);
+    const HT_CallstackSummaryEvent* inner = _info.find_summary(2);
+    ASSERT_NE(nullptr, outer);
+    ASSERT_NE(nullptr, inner);
+    // the string frame is transparent for the path
+    ASSERT_EQ(outer->path_id, inner->parent_path_id);
+}
+
+TEST_F(TestFeatureCallstackAggregation, FramesFromManyThreadsShouldBeAggregated)
+{
+    // Arrange
+    init_timeline(0, HT_TRUE);
+    const int thread_count = 4;
+    const int iteration_count = 500;
+
+    // Act
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([this] {
+            for (int i = 0; i < iteration_count; i++)
+            {
+                ht_feature_callstack_start_int(_timeline, 1);
+                ht_feature_callstack_start_int(_timeline, 2 + i % 8);
+                ht_feature_callstack_stop(_timeline);
+                ht_feature_callstack_stop(_timeline);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(9u, _info.summaries.size());
+    uint64_t inner_count = 0;
+    for (const auto& summary : _info.summaries)
+    {
+        if (summary.frame_label != 1)
+        {
+            inner_count += summary.count;
+        }
+    }
+    ASSERT_EQ((uint64_t)thread_count * iteration_count, _info.find_summary(1)->count);
+    ASSERT_EQ((uint64_t)thread_count * iteration_count, inner_count);
+}
+
+TEST_F(TestFeatureCallstackAggregation, WeightedFramesShouldBeCountedWithTheirWeight)
+{
+    // Arrange
+    init_timeline(0);
+
+    // Act
+    ht_feature_callstack_start_int_weighted(_timeline, 1, 5);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    const HT_CallstackSummaryEvent* summary = _info.find_summary(1);
+    ASSERT_NE(nullptr, summary);
+    ASSERT_EQ(6u, summary->count);
+    uint64_t histogram_count = 0;
+    for (const auto& bucket : _info.histograms[summary->path_id])
+    {
+        histogram_count += bucket.second;
+    }
+    ASSERT_EQ(6u, histogram_count);
+}
+
+TEST_F(TestFeatureCallstackAggregation, FrameCompletedBeforeLastSummaryShouldNotTriggerSummary)
+{
+    // Arrange
+    init_timeline(HT_DUR_S(1));
+    HT_FeatureCallstackAggregation* aggregation = ht_feature_callstack_aggregation_get(_timeline);
+    HT_TimestampNs frame_end = ht_monotonic_clock_get_timestamp();
+    ht_feature_callstack_aggregation_flush(_timeline);
+
+    // Act
+    /* e.g. a frame of another thread which was waiting for the lock */
+    ASSERT_TRUE(ht_feature_callstack_aggregation_add(_timeline, aggregation, 1, 0, 1, 10, 10, 1, frame_end - 1));
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(0u, _info.summaries.size());
+}
+
+TEST_F(TestFeatureCallstackAggregation, FrameShouldBePushedToTimelineIfThereIsNoMemoryForNewPath)
+{
+    // Arrange
+    init_timeline(0);
+    HT_CallstackEventLabel label = 1;
+    /* fill the table of paths up to the point where it has to grow */
+    for (; label <= 48; label++)
+    {
+        ht_feature_callstack_start_int(_timeline, label);
+        ht_feature_callstack_stop(_timeline);
+    }
+    ht_feature_callstack_start_int(_timeline, label);
+
+    // Act
+    {
+        ScopedSetAlloc allocator(ht_test_null_realloc);
+        ht_feature_callstack_stop(_timeline);
+    }
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(48u, _info.summaries.size());
+    ASSERT_EQ(1u, _info.int_events.size());
+    ASSERT_EQ(label, _info.int_events[0].label);
+}
+
+TEST_F(TestFeatureCallstackAggregation, FramesShouldBePushedToTimelineWhenAggregationIsPaused)
+{
+    // Arrange
+    init_timeline(0);
+
+    // Act
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_aggregation_set_paused(_timeline, HT_TRUE));
+    ht_feature_callstack_start_int(_timeline, 1);
+    ht_feature_callstack_stop(_timeline);
+    ASSERT_EQ(HT_ERR_OK, ht_feature_callstack_aggregation_set_paused(_timeline, HT_FALSE));
+    ht_feature_callstack_start_int(_timeline, 2);
+    ht_feature_callstack_stop(_timeline);
+    ht_feature_callstack_aggregation_flush(_timeline);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(1u, _info.int_events.size());
+    ASSERT_EQ(1u, _info.int_events[0].label);
+    ASSERT_EQ(1u, _info.summaries.size());
+    ASSERT_NE(nullptr, _info.find_summary(2));
+}
+
+TEST_F(TestFeatureCallstackAggregation, SetPausedShouldFailIfFeatureIsNotEnabled)
+{
+    // Arrange
+    _timeline = ht_timeline_create(1024, HT_FALSE, HT_FALSE, nullptr, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_FEATURE_NOT_REGISTERED, ht_feature_callstack_aggregation_set_paused(_timeline, HT_TRUE));
+}
@@ -1,7 +1,10 @@
 #include "test_allocator.h"
 
 #include <internal/hash_map.h>
+#include <atomic>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(TestHashMap, GetValueShouldReturnNullIfElementDoesNotExist)
@@ -163,3 +166,176 @@ TEST(TestHashMap, ForEachShouldStopWhenCallbackReturnsFalse)
 
     ht_hash_map_deinit(&map);
 }
+
+TEST(TestHashMap, InsertShouldKeepAllElementsWhenMapGrows)
+{
+    // Arrange
+    HT_HashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_hash_map_init(&map));
+    const uint64_t element_count = 100000;
+    static const char* values[] = {"value0", "value1", "value2"};
+
+    // Act
+    for (uint64_t i = 0; i < element_count; i++)
+    {
+        // keys of static labels are aligned addresses
+        ASSERT_EQ(NULL, ht_hash_map_insert(&map, i * 16, values[i % 3], NULL));
+    }
+
+    // Assert
+    for (uint64_t i = 0; i < element_count; i++)
+    {
+        ASSERT_EQ(values[i % 3], ht_hash_map_get_value(&map, i * 16));
+    }
+    ASSERT_EQ(NULL, ht_hash_map_get_value(&map, element_count * 16));
+    ASSERT_EQ(NULL, ht_hash_map_get_value(&map, 8));
+
+    size_t visited = 0;
+    ht_hash_map_for_each(&map, [](uint64_t, const char*, void* ud) {
+        (*static_cast<size_t*>(ud))++;
+        return HT_TRUE;
+    }, &visited);
+    ASSERT_EQ(element_count, visited);
+
+    ht_hash_map_deinit(&map);
+}
+
+TEST(TestHashMap, InsertShouldFailIfValueIsNull)
+{
+    // Arrange
+    HT_HashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_hash_map_init(&map));
+    HT_ErrorCode err;
+
+    // Act
+    const char* ret = ht_hash_map_insert(&map, 1234, NULL, &err);
+
+    // Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, err);
+    ASSERT_EQ(NULL, ret);
+    ASSERT_EQ(NULL, ht_hash_map_get_value(&map, 1234));
+
+    ht_hash_map_deinit(&map);
+}
+
+TEST(TestConcurrentHashMap, GetValueShouldReturnInsertedValues)
+{
+    // Arrange
+    HT_ConcurrentHashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_concurrent_hash_map_init(&map));
+    HT_ErrorCode err;
+
+    // Act
+    ASSERT_EQ(NULL, ht_concurrent_hash_map_insert(&map, 1234, "value1", &err));
+    ASSERT_EQ(HT_ERR_OK, err);
+    const char* ret = ht_concurrent_hash_map_insert(&map, 1234, "value2", &err);
+
+    // Assert
+    ASSERT_STREQ("value1", ret);
+    ASSERT_EQ(HT_ERR_OK, err);
+    ASSERT_STREQ("value2", ht_concurrent_hash_map_get_value(&map, 1234));
+    ASSERT_EQ(NULL, ht_concurrent_hash_map_get_value(&map, 4321));
+
+    ht_concurrent_hash_map_deinit(&map);
+}
+
+TEST(TestConcurrentHashMap, InsertShouldKeepAllElementsWhenMapGrows)
+{
+    // Arrange
+    HT_ConcurrentHashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_concurrent_hash_map_init(&map));
+    const uint64_t element_count = 10000;
+    static const char* values[] = {"value0", "value1", "value2"};
+
+    // Act
+    for (uint64_t i = 0; i < element_count; i++)
+    {
+        ASSERT_EQ(NULL, ht_concurrent_hash_map_insert(&map, i, values[i % 3], NULL));
+    }
+
+    // Assert
+    for (uint64_t i = 0; i < element_count; i++)
+    {
+        ASSERT_EQ(values[i % 3], ht_concurrent_hash_map_get_value(&map, i));
+    }
+
+    size_t visited = 0;
+    ht_concurrent_hash_map_for_each(&map, [](uint64_t, const char*, void* ud) {
+        (*static_cast<size_t*>(ud))++;
+        return HT_TRUE;
+    }, &visited);
+    ASSERT_EQ(element_count, visited);
+
+    ht_concurrent_hash_map_deinit(&map);
+}
+
+TEST(TestConcurrentHashMap, InsertShouldFailIfAllocationFails)
+{
+    // Arrange
+    HT_ConcurrentHashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_concurrent_hash_map_init(&map));
+
+    ScopedSetAlloc allocator(ht_test_null_realloc);
+    HT_ErrorCode err;
+    uint64_t i = 0;
+
+    // Act
+    do
+    {
+        ht_concurrent_hash_map_insert(&map, i++, "value", &err);
+    } while (i < 1024 && err == HT_ERR_OK);
+
+    // Assert
+    ASSERT_EQ(HT_ERR_OUT_OF_MEMORY, err);
+    ASSERT_EQ(NULL, ht_concurrent_hash_map_get_value(&map, i - 1));
+    ASSERT_STREQ("value", ht_concurrent_hash_map_get_value(&map, i - 2));
+
+    allocator.reset();
+    ht_concurrent_hash_map_deinit(&map);
+}
+
+TEST(TestConcurrentHashMap, ReadersShouldSeeAllValuesWhileMapIsModified)
+{
+    // Arrange
+    HT_ConcurrentHashMap map;
+    ASSERT_EQ(HT_ERR_OK, ht_concurrent_hash_map_init(&map));
+    const uint64_t element_count = 20000;
+    std::atomic<uint64_t> inserted_count(0);
+    std::atomic<bool> failed(false);
+
+    // Act
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+    {
+        readers.emplace_back([&] {
+            uint64_t count;
+            do
+            {
+                count = inserted_count.load();
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    if (ht_concurrent_hash_map_get_value(&map, i) == NULL)
+                    {
+                        failed = true;
+                    }
+                }
+            } while (count < element_count);
+        });
+    }
+
+    for (uint64_t i = 0; i < element_count; i++)
+    {
+        ht_concurrent_hash_map_insert(&map, i, "value", NULL);
+        inserted_count = i + 1;
+    }
+
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    // Assert
+    ASSERT_FALSE(failed);
+
+    ht_concurrent_hash_map_deinit(&map);
+}
@@ -1,10 +1,13 @@
 #include "test_allocator.h"
 
+#include <hawktracer/compression.h>
 #include <hawktracer/events.h>
 #include <internal/listener_buffer.h>
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 TEST(TestListenerBuffer, ShouldCallCallbackForSerializedEvent)
 {
     // Arrange
@@ -73,3 +76,59 @@ TEST(TestListenerBuffer, BypassModeEnabled)
     ASSERT_EQ(1, num_calls);
     ht_listener_buffer_deinit(&buffer);
 }
+
+TEST(TestListenerBuffer, EnableCompressionShouldFailInBypassMode)
+{
+    // Arrange
+    HT_ListenerBuffer buffer;
+    ht_listener_buffer_init(&buffer, 0);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_listener_buffer_enable_compression(&buffer));
+    ht_listener_buffer_deinit(&buffer);
+}
+
+TEST(TestListenerBuffer, CompressedBufferShouldEmitFramesWhichDecompressToOriginalData)
+{
+    // Arrange
+    HT_ListenerBuffer buffer;
+    std::vector<HT_Byte> input(1000);
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        input[i] = (HT_Byte)(i % 10);
+    }
+    std::vector<HT_Byte> output;
+    ht_listener_buffer_init(&buffer, 256);
+    ASSERT_EQ(HT_ERR_OK, ht_listener_buffer_enable_compression(&buffer));
+
+    // Act
+    auto callback = [] (void* user_data, HT_Byte* data, size_t size) {
+        auto out = (std::vector<HT_Byte>*)user_data;
+        out->insert(out->end(), data, data + size);
+    };
+    ht_listener_buffer_write_stream_header(&buffer, callback, &output);
+    ht_listener_buffer_process_serialized_events(&buffer, input.data(), input.size(), callback, &output);
+    ht_listener_buffer_flush(&buffer, callback, &output);
+    ht_listener_buffer_flush(&buffer, callback, &output); // empty buffer doesn't produce a frame
+
+    // Assert
+    ASSERT_EQ(0, memcmp(output.data(), HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC_SIZE));
+    ASSERT_LT(output.size(), input.size() / 2);
+
+    std::vector<HT_Byte> decoded;
+    size_t pos = HT_COMPRESSION_STREAM_MAGIC_SIZE;
+    while (pos < output.size())
+    {
+        uint32_t raw_size, compressed_size;
+        ht_compression_read_frame_header(output.data() + pos, &raw_size, &compressed_size);
+        pos += HT_COMPRESSION_FRAME_HEADER_SIZE;
+        ASSERT_NE(0u, compressed_size);
+        size_t decoded_size = decoded.size();
+        decoded.resize(decoded_size + raw_size);
+        ASSERT_EQ(HT_ERR_OK, ht_compression_decompress(output.data() + pos, compressed_size,
+                                                       decoded.data() + decoded_size, raw_size));
+        pos += compressed_size;
+    }
+    ASSERT_EQ(input, decoded);
+    ht_listener_buffer_deinit(&buffer);
+}
@@ -0,0 +1,73 @@
+#include <hawktracer/monotonic_clock.h>
+#include <hawktracer/duration_conversion.h>
+#include <internal/monotonic_clock.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(TestMonotonicClock, TimestampShouldNotDecrease)
+{
+    // Arrange
+    HT_TimestampNs previous = ht_monotonic_clock_get_timestamp();
+
+    for (int i = 0; i < 1000; i++)
+    {
+        // Act
+        HT_TimestampNs current = ht_monotonic_clock_get_timestamp();
+
+        // Assert
+        ASSERT_LE(previous, current);
+        previous = current;
+    }
+}
+
+#ifdef HT_MONOTONIC_CLOCK_TSC_SUPPORTED
+
+TEST(TestMonotonicClock, TscTimestampShouldFollowSystemClock)
+{
+    // Arrange
+    if (!ht_monotonic_clock_calibrate_tsc())
+    {
+        // CPU doesn't provide invariant time stamp counter
+        ASSERT_EQ(nullptr, ht_monotonic_clock_get_tsc_calibration());
+        return;
+    }
+
+    // Act
+    HT_TimestampNs system_start = ht_monotonic_clock_get_system_timestamp();
+    HT_TimestampNs tsc_start = ht_monotonic_clock_get_tsc_timestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    HT_TimestampNs tsc_end = ht_monotonic_clock_get_tsc_timestamp();
+    HT_TimestampNs system_end = ht_monotonic_clock_get_system_timestamp();
+
+    // Assert
+    const HT_TscCalibration* calibration = ht_monotonic_clock_get_tsc_calibration();
+    ASSERT_NE(nullptr, calibration);
+    ASSERT_LT(0u, calibration->tick_frequency);
+    ASSERT_LT(0u, calibration->mult);
+
+    HT_DurationNs system_duration = system_end - system_start;
+    HT_DurationNs tsc_duration = tsc_end - tsc_start;
+    ASSERT_LE(tsc_duration, system_duration);
+    ASSERT_GE(tsc_duration, system_duration - system_duration / 20); // 5% tolerance
+}
+
+TEST(TestMonotonicClock, TscTimestampShouldNotDecrease)
+{
+    // Arrange
+    ht_monotonic_clock_calibrate_tsc();
+    HT_TimestampNs previous = ht_monotonic_clock_get_tsc_timestamp();
+
+    for (int i = 0; i < 1000; i++)
+    {
+        // Act
+        HT_TimestampNs current = ht_monotonic_clock_get_tsc_timestamp();
+
+        // Assert
+        ASSERT_LE(previous, current);
+        previous = current;
+    }
+}
+
+#endif /* HT_MONOTONIC_CLOCK_TSC_SUPPORTED */
@@ -54,6 +54,43 @@ TEST(TestRegistry, PushAllKlassInfoEventsShouldPushAll)
     ht_timeline_destroy(timeline);
 }
 
+TEST(TestRegistry, PushKlassInfoEventsShouldUseSingleCallback)
+{
+    // Arrange
+    NotifyInfo<HT_EventKlass> info;
+
+    // Act
+    size_t size = ht_registry_push_registry_klasses_to_listener(test_listener<HT_EventKlass>, &info, HT_TRUE);
+
+    // Assert
+    ASSERT_EQ(1, info.notify_count);
+    ASSERT_EQ(size, info.notified_events);
+}
+
+TEST(TestRegistry, PushKlassInfoEventsShouldIncludeNewlyRegisteredKlass)
+{
+    // Arrange
+    NotifyInfo<HT_EventKlass> info_before;
+    size_t size_before = ht_registry_push_registry_klasses_to_listener(test_listener<HT_EventKlass>, &info_before, HT_FALSE);
+    size_t serialized_size_before = ht_registry_push_registry_klasses_to_listener(test_listener<HT_EventKlass>, &info_before, HT_TRUE);
+
+    // Act
+    HT_REGISTER_EVENT_KLASS(RegistryMetadataTestEvent);
+    NotifyInfo<HT_EventKlass> info_after;
+    size_t size_after = ht_registry_push_registry_klasses_to_listener(test_listener<HT_EventKlass>, &info_after, HT_FALSE);
+
+    // Assert
+    size_t field_count = HT_EVENT_KLASS_GET(RegistryMetadataTestEvent)->type_info->fields_count;
+    ASSERT_EQ(1, info_after.notify_count);
+    ASSERT_EQ(size_before + sizeof(HT_EventKlassInfoEvent) + field_count * sizeof(HT_EventKlassFieldInfoEvent), size_after);
+    ASSERT_EQ(info_before.values.size() + field_count + 1, info_after.values.size());
+
+    NotifyInfo<HT_EventKlass> serialized_info;
+    size_t serialized_size = ht_registry_push_registry_klasses_to_listener(test_listener<HT_EventKlass>, &serialized_info, HT_TRUE);
+    ASSERT_EQ(serialized_size, serialized_info.notified_events);
+    ASSERT_LT(serialized_size_before, serialized_size);
+}
+
 TEST(TestRegistry, RegisterListenerTwiceShouldFail)
 {
     // Arrange
@@ -13,8 +13,12 @@ HT_DECLARE_EVENT_KLASS(RegistryTestEvent_ID_ONE, HT_Event, (INTEGER, int, field)
 
 HT_DECLARE_EVENT_KLASS(RegistryTestEvent_ID_TWO, HT_Event, (INTEGER, int, field))
 
+HT_DECLARE_EVENT_KLASS(RegistryMetadataTestEvent, HT_Event, (INTEGER, int, field1), (STRING, const char*, field2))
+
 HT_DECLARE_EVENT_KLASS(DoubleTestEvent, HT_Event, (DOUBLE, double, field))
 
+HT_DECLARE_EVENT_KLASS(FlightRecorderTestEvent, HT_Event, (INTEGER, int, field))
+
 HT_DECLARE_EVENT_KLASS(LargeTestEvent, HT_Event,
                        (DOUBLE, double, field1),
                        (DOUBLE, double, field2),
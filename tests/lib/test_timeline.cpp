@@ -3,9 +3,11 @@
 
 #include "test_test_events.h"
 #include "test_common.h"
+#include "test_allocator.h"
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <thread>
 
 class TestTimeline : public ::testing::Test
@@ -64,6 +66,104 @@ TEST_F(TestTimeline, FlushEventsShouldNotifyListener)
     ASSERT_EQ(1, info.notify_count);
 }
 
+TEST_F(TestTimeline, RequestFlushAllShouldFlushTimelineOnNextPush)
+{
+    // Arrange
+    NotifyInfo<HT_Event> info;
+
+    ht_timeline_register_listener(_timeline, test_listener<HT_Event>, &info);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(_timeline, &event);
+
+    // Act
+    ht_timeline_request_flush_all();
+
+    // Assert
+    ASSERT_EQ(0, info.notify_count);
+    ht_timeline_push_event(_timeline, &event);
+    ASSERT_EQ(2 * sizeof(HT_Event), info.notified_events);
+    ASSERT_EQ(1, info.notify_count);
+    // the request is only handled once
+    ht_timeline_push_event(_timeline, &event);
+    ASSERT_EQ(1, info.notify_count);
+}
+
+TEST_F(TestTimeline, RequestFlushAllShouldFlushPerThreadBufferTimelineOnNextPush)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create_full(sizeof(HT_Event) * 3, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, NULL, NULL);
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(timeline, &event);
+
+    // Act
+    ht_timeline_request_flush_all();
+    ht_timeline_push_event(timeline, &event);
+
+    // Assert
+    ASSERT_EQ(2u, info.values.size());
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, FlushAllShouldFlushThreadSafeTimelinesImmediately)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event) * 3, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    NotifyInfo<HT_Event> info;
+    NotifyInfo<HT_Event> unsafe_info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+    ht_timeline_register_listener(_timeline, test_listener<HT_Event>, &unsafe_info);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(timeline, &event);
+    ht_timeline_push_event(_timeline, &event);
+
+    // Act
+    ht_timeline_flush_all();
+
+    // Assert
+    ASSERT_EQ(1, info.notify_count);
+    ASSERT_EQ(1 * sizeof(HT_Event), info.notified_events);
+    // timelines which are not thread-safe are flushed on the next push
+    ASSERT_EQ(0, unsafe_info.notify_count);
+    ht_timeline_push_event(_timeline, &event);
+    ASSERT_EQ(1, unsafe_info.notify_count);
+
+    ht_timeline_destroy(timeline);
+}
+
+static void
+create_and_destroy_timeline_listener(TEventPtr, size_t, HT_Boolean, void* user_data)
+{
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_destroy(timeline);
+    (*static_cast<int*>(user_data))++;
+}
+
+TEST_F(TestTimeline, FlushAllListenerShouldBeAbleToCreateAndDestroyTimelines)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event) * 3, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    int call_count = 0;
+    ht_timeline_register_listener(timeline, create_and_destroy_timeline_listener, &call_count);
+
+    HT_DECL_EVENT(HT_Event, event);
+    ht_timeline_push_event(timeline, &event);
+
+    // Act
+    ht_timeline_flush_all();
+
+    // Assert
+    ASSERT_EQ(1, call_count);
+
+    ht_timeline_unregister_all_listeners(timeline);
+    ht_timeline_destroy(timeline);
+}
+
 TEST_F(TestTimeline, TimelineShouldBeFlushedBeforeUninitialized)
 {
     // Arrange
@@ -158,6 +258,696 @@ TEST_F(TestTimeline, ThreadSafeMessageShouldWorkWithMultipleThreads)
     ht_timeline_destroy(timeline);
 }
 
+TEST_F(TestTimeline, PerThreadBufferTimelineShouldDeliverAllEventsFromMultipleThreads)
+{
+    // Arrange
+    const size_t thread_count = 4;
+    const size_t event_count = 20000;
+    HT_Timeline* timeline = ht_timeline_create_full(sizeof(HT_Event) * 3, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, NULL, NULL);
+
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+
+    // Act
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([timeline, t, &event_count, &thread_count] {
+            for (size_t i = t; i < event_count; i += thread_count)
+            {
+                HT_DECL_EVENT(HT_Event, event);
+                event.timestamp = i;
+                ht_timeline_push_event(timeline, &event);
+            }
+        });
+    }
+
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    std::vector<HT_TimestampNs> all_values(event_count, 1);
+    HT_TimestampNs sum = 0;
+    for (const auto& event : info.values)
+    {
+        ASSERT_GT(event_count, event.timestamp);
+        sum += all_values[(size_t)event.timestamp];
+        all_values[(size_t)event.timestamp] = 0;
+    }
+
+    ASSERT_EQ(event_count, sum);
+}
+
+TEST_F(TestTimeline, PerThreadBufferTimelineShouldHandOffBufferWhenThreadExits)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create_full(sizeof(HT_Event) * 3, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, NULL, NULL);
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+
+    // Act
+    std::thread([timeline] {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = 7;
+        ht_timeline_push_event(timeline, &event);
+    }).join();
+    ht_timeline_flush_all();
+
+    // Assert
+    ASSERT_EQ(1u, info.values.size());
+    ASSERT_EQ(7u, info.values[0].timestamp);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PerThreadBufferTimelineShouldReuseContextOfExitedThread)
+{
+    // Arrange
+    const size_t buffer_size = 4096;
+    HT_Timeline* timeline = ht_timeline_create_full(buffer_size, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, NULL, NULL);
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+
+    auto push_event = [timeline] (HT_TimestampNs timestamp) {
+        std::thread([timeline, timestamp] {
+            HT_DECL_EVENT(HT_Event, event);
+            event.timestamp = timestamp;
+            ht_timeline_push_event(timeline, &event);
+        }).join();
+        ht_timeline_flush_all();
+    };
+    push_event(1);
+
+    // Act
+    {
+        // not enough memory for a new context and buffer
+        LimitedSizeAllocator allocator(buffer_size / 2);
+        ScopedSetAlloc alloc_setter(LimitedSizeAllocator::realloc, &allocator);
+        push_event(2);
+    }
+
+    // Assert
+    ASSERT_EQ(2u, info.values.size());
+    ASSERT_EQ(2u, info.values[1].timestamp);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PerThreadBufferTimelineShouldKeepOrderOfEventsFromOneThread)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create_full(sizeof(HT_Event) * 3, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, NULL, NULL);
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, test_listener<HT_Event>, &info);
+
+    // Act
+    for (HT_TimestampNs i = 0; i < 10; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+
+    // Assert
+    ASSERT_EQ(9u, info.values.size()); // last event not sent, because buffer is not full
+    ht_timeline_flush(timeline);
+    ASSERT_EQ(10u, info.values.size());
+    for (size_t i = 0; i < info.values.size(); i++)
+    {
+        ASSERT_EQ(i, info.values[i].timestamp);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PerThreadBufferTimelineShouldDeliverTooLargeEvent)
+{
+    // Arrange
+    HT_Timeline* timeline = ht_timeline_create_full(1, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_TRUE, nullptr, nullptr);
+    HT_Byte buffer[64];
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean /* is_serialized */, void* user_data) {
+        HT_Byte* data = (HT_Byte*)user_data;
+        memcpy(data, events, event_count);
+    }, buffer);
+
+    // Act
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    HT_DECL_EVENT(RegistryTestEvent, event);
+    event.field = 30;
+    ht_timeline_push_event(timeline, ((HT_Event*)(&event)));
+
+    // Assert
+    HT_Event tmp_event;
+    int read_value = *(int*)(buffer + ht_HT_Event_get_size(&tmp_event));
+    ASSERT_EQ(event.field, read_value);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, AsyncFlushTimelineShouldDeliverEventsFromDispatcherThread)
+{
+    // Arrange
+    struct UD
+    {
+        NotifyInfo<HT_Event> info;
+        std::thread::id thread_id;
+    } user_data;
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event) * 3, HT_TRUE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean is_serialized, void* ud) {
+        UD* data = static_cast<UD*>(ud);
+        data->thread_id = std::this_thread::get_id();
+        test_listener<HT_Event>(events, event_count, is_serialized, &data->info);
+    }, &user_data);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(timeline, 4, HT_ASYNC_FLUSH_POLICY_BLOCK));
+
+    // Act
+    for (HT_TimestampNs i = 0; i < 10; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_flush(timeline);
+
+    // Assert
+    ASSERT_EQ(10u, user_data.info.values.size());
+    for (size_t i = 0; i < user_data.info.values.size(); i++)
+    {
+        ASSERT_EQ(i, user_data.info.values[i].timestamp);
+    }
+    ASSERT_NE(std::this_thread::get_id(), user_data.thread_id);
+    ASSERT_EQ(0u, ht_timeline_get_dropped_buffer_count(timeline));
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, EnableAsyncFlushShouldFailForInvalidArguments)
+{
+    // Arrange
+    HT_Timeline* per_thread_timeline = ht_timeline_create_full(64, HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE, nullptr, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_timeline_enable_async_flush(_timeline, 1, HT_ASYNC_FLUSH_POLICY_BLOCK));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_timeline_enable_async_flush(per_thread_timeline, 2, HT_ASYNC_FLUSH_POLICY_BLOCK));
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(_timeline, 2, HT_ASYNC_FLUSH_POLICY_BLOCK));
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_timeline_enable_async_flush(_timeline, 2, HT_ASYNC_FLUSH_POLICY_BLOCK));
+
+    ht_timeline_destroy(per_thread_timeline);
+}
+
+TEST_F(TestTimeline, AsyncFlushWithDropPolicyShouldDropBuffersWhenPoolIsExhausted)
+{
+    // Arrange
+    struct UD
+    {
+        NotifyInfo<HT_Event> info;
+        std::atomic<bool> blocked{true};
+    } user_data;
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event), HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean is_serialized, void* ud) {
+        UD* data = static_cast<UD*>(ud);
+        while (data->blocked)
+        {
+            std::this_thread::yield();
+        }
+        test_listener<HT_Event>(events, event_count, is_serialized, &data->info);
+    }, &user_data);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(timeline, 2, HT_ASYNC_FLUSH_POLICY_DROP));
+
+    // Act
+    for (HT_TimestampNs i = 0; i < 5; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    user_data.blocked = false;
+    ht_timeline_flush(timeline);
+
+    // Assert
+    // first buffer is held by the listener, so the second one is re-used for all following events
+    ASSERT_EQ(3u, ht_timeline_get_dropped_buffer_count(timeline));
+    ASSERT_EQ(2u, user_data.info.values.size());
+    ASSERT_EQ(0u, user_data.info.values[0].timestamp);
+    ASSERT_EQ(4u, user_data.info.values[1].timestamp);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, AsyncFlushListenerShouldBeAbleToPushToTheSameTimelineDuringFlush)
+{
+    // Arrange
+    struct UD
+    {
+        HT_Timeline* timeline;
+        NotifyInfo<HT_Event> info;
+        bool pushed = false;
+    } user_data;
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event), HT_TRUE, HT_FALSE, nullptr, nullptr);
+    user_data.timeline = timeline;
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean is_serialized, void* ud) {
+        UD* data = static_cast<UD*>(ud);
+        test_listener<HT_Event>(events, event_count, is_serialized, &data->info);
+        if (!data->pushed)
+        {
+            // give the main thread time to start flushing
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            data->pushed = true;
+            HT_DECL_EVENT(HT_Event, event);
+            event.timestamp = 100;
+            ht_timeline_push_event(data->timeline, &event);
+        }
+    }, &user_data);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(timeline, 2, HT_ASYNC_FLUSH_POLICY_BLOCK));
+
+    // Act
+    for (HT_TimestampNs i = 0; i < 2; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_flush(timeline);
+    ht_timeline_flush(timeline);
+
+    // Assert
+    ASSERT_EQ(3u, user_data.info.values.size());
+    ASSERT_EQ(0u, user_data.info.values[0].timestamp);
+    ASSERT_EQ(1u, user_data.info.values[1].timestamp);
+    ASSERT_EQ(100u, user_data.info.values[2].timestamp);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, AsyncFlushWithDropPolicyShouldDropOversizedEventsWhenTooManyCopiesAreQueued)
+{
+    // Arrange
+    struct UD
+    {
+        NotifyInfo<RegistryTestEvent> info;
+        std::atomic<bool> blocked{true};
+    } user_data;
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event), HT_FALSE, HT_FALSE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean is_serialized, void* ud) {
+        UD* data = static_cast<UD*>(ud);
+        while (data->blocked)
+        {
+            std::this_thread::yield();
+        }
+        test_listener<RegistryTestEvent>(events, event_count, is_serialized, &data->info);
+    }, &user_data);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(timeline, 2, HT_ASYNC_FLUSH_POLICY_DROP));
+
+    // Act
+    for (int i = 0; i < 5; i++)
+    {
+        HT_TIMELINE_PUSH_EVENT(timeline, RegistryTestEvent, i);
+    }
+    user_data.blocked = false;
+    ht_timeline_flush(timeline);
+
+    // Assert
+    // at most pool depth (2) copies are queued (including the one held by the listener)
+    ASSERT_EQ(3u, ht_timeline_get_dropped_buffer_count(timeline));
+    ASSERT_EQ(2u, user_data.info.values.size());
+    ASSERT_EQ(0, user_data.info.values[0].field);
+    ASSERT_EQ(1, user_data.info.values[1].field);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, AsyncFlushWithBlockPolicyShouldNotLoseEventsWithSlowListener)
+{
+    // Arrange
+    const size_t event_count = 50;
+    HT_Timeline* timeline = ht_timeline_create(sizeof(HT_Event), HT_TRUE, HT_FALSE, nullptr, nullptr);
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(timeline, [] (TEventPtr events, size_t event_count, HT_Boolean is_serialized, void* ud) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        test_listener<HT_Event>(events, event_count, is_serialized, ud);
+    }, &info);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_async_flush(timeline, 2, HT_ASYNC_FLUSH_POLICY_BLOCK));
+
+    // Act
+    for (HT_TimestampNs i = 0; i < event_count; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.timestamp = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_destroy(timeline);
+
+    // Assert
+    ASSERT_EQ(event_count, info.values.size());
+    for (size_t i = 0; i < info.values.size(); i++)
+    {
+        ASSERT_EQ(i, info.values[i].timestamp);
+    }
+}
+
+TEST_F(TestTimeline, ReserveShouldFailIfSizeExceedsBufferCapacity)
+{
+    // Act & Assert
+    ASSERT_EQ(nullptr, ht_timeline_reserve(_timeline, sizeof(HT_Event) * 3 + 1));
+}
+
+TEST_F(TestTimeline, ReserveAndCommitShouldStoreEventInTimelineBuffer)
+{
+    // Arrange
+    NotifyInfo<HT_Event> info;
+    ht_timeline_register_listener(_timeline, test_listener<HT_Event>, &info);
+
+    // Act
+    for (HT_TimestampNs i = 0; i < 4; i++)
+    {
+        HT_Event* event = (HT_Event*)ht_timeline_reserve(_timeline, sizeof(HT_Event));
+        ASSERT_NE(nullptr, event);
+        event->klass = HT_EVENT_KLASS_GET(HT_Event);
+        event->timestamp = i;
+        event->id = i;
+        ht_timeline_commit(_timeline, sizeof(HT_Event));
+    }
+
+    // Assert
+    ASSERT_EQ(3u, info.values.size()); // reserving 4th event flushed the buffer
+    ht_timeline_flush(_timeline);
+    ASSERT_EQ(4u, info.values.size());
+    for (size_t i = 0; i < info.values.size(); i++)
+    {
+        ASSERT_EQ(i, info.values[i].timestamp);
+    }
+}
+
+TEST_F(TestTimeline, EnableCompactSerializationShouldFailIfTimelineDoesNotSerializeEvents)
+{
+    // Arrange
+    HT_Timeline* serializing_timeline = ht_timeline_create(64, HT_FALSE, HT_TRUE, nullptr, nullptr);
+
+    // Act & Assert
+    ASSERT_EQ(HT_ERR_INVALID_ARGUMENT, ht_timeline_enable_compact_serialization(_timeline));
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_compact_serialization(serializing_timeline));
+    ASSERT_EQ(nullptr, ht_timeline_reserve(serializing_timeline, sizeof(HT_Event)));
+
+    ht_timeline_destroy(serializing_timeline);
+}
+
+static void test_compact_serialization(HT_TimelineThreadSafety thread_safety)
+{
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    std::vector<HT_Byte> actual;
+    auto listener = [] (TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        std::vector<HT_Byte>* data = static_cast<std::vector<HT_Byte>*>(ud);
+        data->insert(data->end(), events, events + size);
+    };
+    HT_Timeline* timeline = ht_timeline_create_full(256, thread_safety, HT_TRUE, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, listener, &actual);
+    ASSERT_EQ(HT_ERR_OK, ht_timeline_enable_compact_serialization(timeline));
+    HT_DECL_EVENT(RegistryTestEvent, tmp_event);
+    size_t serialized_size = ht_RegistryTestEvent_get_size(HT_EVENT(&tmp_event));
+
+    for (int i = 0; i < 10; i++)
+    {
+        HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, RegistryTestEvent, (ht_base_event), i);
+    }
+    ht_timeline_flush(timeline);
+
+    // a single block: the header (HT_CompactBlockEvent) followed by the compact events
+    size_t header_size = sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs) + sizeof(HT_EventId) + sizeof(uint32_t);
+    ASSERT_LT(header_size, actual.size());
+    ASSERT_GT(10 * serialized_size, actual.size());
+    HT_EventKlassId klass_id;
+    memcpy(&klass_id, actual.data(), sizeof(klass_id));
+    ASSERT_EQ(HT_EVENT_KLASS_GET(HT_CompactBlockEvent)->klass_id, klass_id);
+    uint32_t block_size;
+    memcpy(&block_size, actual.data() + header_size - sizeof(block_size), sizeof(block_size));
+    ASSERT_EQ(actual.size() - header_size, block_size);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, CompactTimelineShouldStoreEventsInBlock)
+{
+    test_compact_serialization(HT_TIMELINE_THREAD_SAFETY_NONE);
+    test_compact_serialization(HT_TIMELINE_THREAD_SAFETY_LOCK);
+    test_compact_serialization(HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER);
+}
+
+static void test_push_event_in_place(HT_TimelineThreadSafety thread_safety, HT_Boolean serialize)
+{
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    std::vector<HT_Byte> actual;
+    auto listener = [] (TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        std::vector<HT_Byte>* data = static_cast<std::vector<HT_Byte>*>(ud);
+        data->insert(data->end(), events, events + size);
+    };
+    HT_Timeline* timeline = ht_timeline_create_full(64, thread_safety, serialize, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, listener, &actual);
+    HT_DECL_EVENT(RegistryTestEvent, tmp_event);
+    size_t serialized_size = ht_RegistryTestEvent_get_size(HT_EVENT(&tmp_event));
+
+    for (int i = 0; i < 10; i++)
+    {
+        HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, RegistryTestEvent, (ht_base_event), i);
+    }
+    ht_timeline_flush(timeline);
+
+    ASSERT_EQ(10 * (serialize ? serialized_size : sizeof(RegistryTestEvent)), actual.size());
+    for (int i = 0; i < 10; i++)
+    {
+        RegistryTestEvent event;
+        if (serialize)
+        {
+            memcpy(&event.field, actual.data() + (i + 1) * serialized_size - sizeof(int), sizeof(int));
+        }
+        else
+        {
+            memcpy(&event, actual.data() + i * sizeof(RegistryTestEvent), sizeof(RegistryTestEvent));
+            ASSERT_EQ(HT_EVENT_KLASS_GET(RegistryTestEvent), event.base.klass);
+        }
+        ASSERT_EQ(i, event.field);
+    }
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PushEventInPlaceShouldWriteEventToTimelineBuffer)
+{
+    test_push_event_in_place(HT_TIMELINE_THREAD_SAFETY_NONE, HT_FALSE);
+    test_push_event_in_place(HT_TIMELINE_THREAD_SAFETY_LOCK, HT_TRUE);
+    test_push_event_in_place(HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_TRUE);
+    test_push_event_in_place(HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE);
+}
+
+static std::vector<HT_Byte> push_events_one_by_one(HT_TimelineThreadSafety thread_safety, HT_Boolean serialize,
+                                                   std::vector<RegistryTestEvent>& events)
+{
+    std::vector<HT_Byte> actual;
+    auto listener = [] (TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        std::vector<HT_Byte>* data = static_cast<std::vector<HT_Byte>*>(ud);
+        data->insert(data->end(), events, events + size);
+    };
+    HT_Timeline* timeline = ht_timeline_create_full(64, thread_safety, serialize, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, listener, &actual);
+
+    for (auto& event : events)
+    {
+        ht_timeline_push_event(timeline, HT_EVENT(&event));
+    }
+
+    ht_timeline_destroy(timeline);
+    return actual;
+}
+
+static void test_push_events(HT_TimelineThreadSafety thread_safety, HT_Boolean serialize)
+{
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    std::vector<HT_Byte> actual;
+    auto listener = [] (TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        std::vector<HT_Byte>* data = static_cast<std::vector<HT_Byte>*>(ud);
+        data->insert(data->end(), events, events + size);
+    };
+    HT_Timeline* timeline = ht_timeline_create_full(64, thread_safety, serialize, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, listener, &actual);
+    std::vector<RegistryTestEvent> events(25);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        HT_DECL_EVENT(RegistryTestEvent, event);
+        ht_timeline_init_event(timeline, HT_EVENT(&event));
+        event.field = (int)i;
+        events[i] = event;
+    }
+
+    ht_timeline_push_events(timeline, HT_EVENT_KLASS_GET(RegistryTestEvent), HT_EVENT(events.data()), events.size());
+    ht_timeline_flush(timeline);
+
+    ASSERT_EQ(push_events_one_by_one(thread_safety, serialize, events), actual);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PushEventsShouldStoreEventsAsPushEvent)
+{
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_NONE, HT_FALSE);
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_NONE, HT_TRUE);
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_LOCK, HT_FALSE);
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_LOCK, HT_TRUE);
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_FALSE);
+    test_push_events(HT_TIMELINE_THREAD_SAFETY_PER_THREAD_BUFFER, HT_TRUE);
+}
+
+TEST_F(TestTimeline, PushEventColumnsShouldBuildEventsFromFieldValues)
+{
+    // Arrange
+    HT_REGISTER_EVENT_KLASS(RegistryMetadataTestEvent);
+    NotifyInfo<RegistryMetadataTestEvent> info;
+    ht_timeline_register_listener(_timeline, test_listener<RegistryMetadataTestEvent>, &info);
+    HT_DECL_EVENT(RegistryMetadataTestEvent, prototype);
+    ht_timeline_init_event(_timeline, HT_EVENT(&prototype));
+    int field1_values[] = {7, 8, 9, 10};
+    const char* field2_values[] = {"a", "b", "c", "d"};
+    const void* columns[] = {field1_values, field2_values};
+
+    // Act
+    ht_timeline_push_event_columns(_timeline, HT_EVENT(&prototype), columns, 4);
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(4u, info.values.size());
+    for (size_t i = 0; i < info.values.size(); i++)
+    {
+        ASSERT_EQ(HT_EVENT_KLASS_GET(RegistryMetadataTestEvent), info.values[i].base.klass);
+        ASSERT_EQ(prototype.base.timestamp, info.values[i].base.timestamp);
+        ASSERT_EQ(field1_values[i], info.values[i].field1);
+        ASSERT_STREQ(field2_values[i], info.values[i].field2);
+        if (i > 0)
+        {
+            ASSERT_LT(info.values[i - 1].base.id, info.values[i].base.id);
+        }
+    }
+}
+
+TEST_F(TestTimeline, PushEventColumnsShouldNotAllocateMemoryForSmallEvents)
+{
+    // Arrange
+    HT_REGISTER_EVENT_KLASS(RegistryMetadataTestEvent);
+    NotifyInfo<RegistryMetadataTestEvent> info;
+    ht_timeline_register_listener(_timeline, test_listener<RegistryMetadataTestEvent>, &info);
+    HT_DECL_EVENT(RegistryMetadataTestEvent, prototype);
+    ht_timeline_init_event(_timeline, HT_EVENT(&prototype));
+    int field1_values[] = {7, 8};
+    const char* field2_values[] = {"a", "b"};
+    const void* columns[] = {field1_values, field2_values};
+
+    // Act
+    {
+        ScopedSetAlloc allocator(ht_test_null_realloc);
+        ht_timeline_push_event_columns(_timeline, HT_EVENT(&prototype), columns, 2);
+    }
+    ht_timeline_flush(_timeline);
+
+    // Assert
+    ASSERT_EQ(2u, info.values.size());
+    ASSERT_EQ(8, info.values[1].field1);
+}
+
+// Compares the event written by HT_TIMELINE_PUSH_EVENT_IN_PLACE() to the expected event
+// (with the timestamp and the identifier taken from the written event); returns the size of the event.
+template<typename T>
+static size_t compare_event_pushed_in_place(const HT_Byte* data, HT_Boolean serialize, T expected)
+{
+    HT_Event* base = HT_EVENT(&expected);
+    if (!serialize)
+    {
+        T actual;
+        memcpy(&actual, data, sizeof(T));
+        base->timestamp = HT_EVENT(&actual)->timestamp;
+        base->id = HT_EVENT(&actual)->id;
+        std::vector<HT_Byte> expected_data(base->klass->get_size(base));
+        std::vector<HT_Byte> actual_data(expected_data.size());
+        base->klass->serialize(base, expected_data.data());
+        base->klass->serialize(HT_EVENT(&actual), actual_data.data());
+        EXPECT_EQ(expected_data, actual_data);
+        return sizeof(T);
+    }
+
+    memcpy(&base->timestamp, data + sizeof(HT_EventKlassId), sizeof(HT_TimestampNs));
+    memcpy(&base->id, data + sizeof(HT_EventKlassId) + sizeof(HT_TimestampNs), sizeof(HT_EventId));
+    std::vector<HT_Byte> expected_data(base->klass->get_size(base));
+    base->klass->serialize(base, expected_data.data());
+    EXPECT_EQ(expected_data, std::vector<HT_Byte>(data, data + expected_data.size()));
+    return expected_data.size();
+}
+
+static void test_push_event_in_place_fields(HT_Boolean serialize)
+{
+    std::vector<HT_Byte> actual;
+    auto listener = [] (TEventPtr events, size_t size, HT_Boolean, void* ud) {
+        std::vector<HT_Byte>* data = static_cast<std::vector<HT_Byte>*>(ud);
+        data->insert(data->end(), events, events + size);
+    };
+    HT_Timeline* timeline = ht_timeline_create(128, HT_FALSE, serialize, nullptr, nullptr);
+    ht_timeline_register_listener(timeline, listener, &actual);
+
+    for (int i = 0; i < 10; i++)
+    {
+        HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, TestCallstackEvent, ({ht_base_event, 10u + i, 3}), i);
+        HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, RegistryMetadataTestEvent, (ht_base_event), i, i % 2 ? "label" : nullptr);
+    }
+    ht_timeline_flush(timeline);
+
+    size_t offset = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        HT_DECL_EVENT(TestCallstackEvent, callstack_event);
+        HT_CALLSTACK_BASE_EVENT(&callstack_event)->duration = 10u + i;
+        HT_CALLSTACK_BASE_EVENT(&callstack_event)->thread_id = 3;
+        callstack_event.info = i;
+        offset += compare_event_pushed_in_place(actual.data() + offset, serialize, callstack_event);
+
+        HT_DECL_EVENT(RegistryMetadataTestEvent, metadata_event);
+        metadata_event.field1 = i;
+        metadata_event.field2 = i % 2 ? "label" : nullptr;
+        offset += compare_event_pushed_in_place(actual.data() + offset, serialize, metadata_event);
+    }
+    ASSERT_EQ(actual.size(), offset);
+
+    ht_timeline_destroy(timeline);
+}
+
+TEST_F(TestTimeline, PushEventInPlaceShouldWriteAllFieldsOfEvent)
+{
+    HT_REGISTER_EVENT_KLASS(TestCallstackEvent);
+    HT_REGISTER_EVENT_KLASS(RegistryMetadataTestEvent);
+
+    test_push_event_in_place_fields(HT_TRUE);
+    test_push_event_in_place_fields(HT_FALSE);
+}
+
+TEST_F(TestTimeline, PushEventInPlaceShouldFallBackToPushEventForTooLargeEvent)
+{
+    // Arrange
+    HT_REGISTER_EVENT_KLASS(RegistryTestEvent);
+    HT_Timeline* timeline = ht_timeline_create(1, HT_TRUE, HT_TRUE, nullptr, nullptr);
+    size_t notified_size = 0;
+    ht_timeline_register_listener(timeline, [] (TEventPtr, size_t size, HT_Boolean, void* ud) {
+        *static_cast<size_t*>(ud) += size;
+    }, &notified_size);
+
+    // Act
+    HT_TIMELINE_PUSH_EVENT_IN_PLACE(timeline, RegistryTestEvent, (ht_base_event), 5);
+
+    // Assert
+    HT_DECL_EVENT(RegistryTestEvent, tmp_event);
+    ASSERT_EQ(ht_RegistryTestEvent_get_size(HT_EVENT(&tmp_event)), notified_size);
+
+    ht_timeline_destroy(timeline);
+}
+
 TEST_F(TestTimeline, SharedListener)
 {
     // Arrange
@@ -89,6 +89,7 @@ TEST_F(TestFileStream, ReadByteShouldReturnNegativeValueIfReachesEOF)
 
     // Assert
     ASSERT_LT(b, 0);
+    ASSERT_FALSE(stream.has_error());
 }
 
 TEST_F(TestFileStream, ReadDataShouldReturnDataFromCurrentPointer)
@@ -124,3 +125,108 @@ TEST_F(TestFileStream, ReadDataShouldFailIfRequestTooMuchData)
     // Assert
     ASSERT_FALSE(res);
 }
+
+#include <hawktracer/listeners/file_dump_listener.h>
+
+static std::vector<char> read_all(Stream& stream)
+{
+    std::vector<char> content;
+    int b;
+    char buf[7];
+
+    // mix both reading methods
+    while (stream.read_data(buf, sizeof(buf)))
+    {
+        content.insert(content.end(), buf, buf + sizeof(buf));
+        if ((b = stream.read_byte()) < 0)
+        {
+            return content;
+        }
+        content.push_back((char)b);
+    }
+    while ((b = stream.read_byte()) >= 0)
+    {
+        content.push_back((char)b);
+    }
+
+    return content;
+}
+
+TEST_F(TestFileStream, CompressedFileShouldBeReadTransparently)
+{
+    // Arrange
+    const char* compressed_file = "test_file_stream_compressed_file";
+    const char* raw_file = "test_file_stream_raw_file";
+    size_t metadata_size = ht_timeline_listener_push_metadata(
+                [](TEventPtr, size_t, HT_Boolean, void*){}, nullptr, HT_TRUE);
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ht_file_dump_listener_register_full(timeline, compressed_file, 1000u, nullptr, HT_TRUE, nullptr);
+    ht_file_dump_listener_register(timeline, raw_file, 1000u, nullptr);
+    for (int i = 0; i < 5000; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_destroy(timeline);
+
+    FileStream compressed_stream(compressed_file);
+    FileStream raw_stream(raw_file);
+    ASSERT_TRUE(compressed_stream.start());
+    ASSERT_TRUE(raw_stream.start());
+
+    // Act
+    std::vector<char> compressed_content = read_all(compressed_stream);
+    std::vector<char> raw_content = read_all(raw_stream);
+
+    // Assert
+    // metadata contains timestamps, so only events are compared
+    ASSERT_LT(metadata_size, raw_content.size());
+    ASSERT_EQ(raw_content.size(), compressed_content.size());
+    ASSERT_TRUE(std::equal(raw_content.begin() + metadata_size, raw_content.end(),
+                           compressed_content.begin() + metadata_size));
+    ASSERT_FALSE(compressed_stream.has_error());
+
+    remove(compressed_file);
+    remove(raw_file);
+}
+
+TEST_F(TestFileStream, TruncatedCompressedFileShouldBeReportedAsError)
+{
+    // Arrange
+    const char* compressed_file = "test_file_stream_truncated_file";
+    HT_Timeline* timeline = ht_timeline_create(1024, HT_FALSE, HT_TRUE, nullptr, nullptr);
+    ht_file_dump_listener_register_full(timeline, compressed_file, 1000u, nullptr, HT_TRUE, nullptr);
+    for (int i = 0; i < 100; i++)
+    {
+        HT_DECL_EVENT(HT_Event, event);
+        event.id = i;
+        ht_timeline_push_event(timeline, &event);
+    }
+    ht_timeline_destroy(timeline);
+
+    std::vector<char> content;
+    FILE* fp = fopen(compressed_file, "rb");
+    ASSERT_NE(nullptr, fp);
+    int c;
+    while ((c = fgetc(fp)) != EOF)
+    {
+        content.push_back((char)c);
+    }
+    fclose(fp);
+    fp = fopen(compressed_file, "wb");
+    ASSERT_NE(nullptr, fp);
+    fwrite(content.data(), 1, content.size() - 1, fp);
+    fclose(fp);
+
+    FileStream stream(compressed_file);
+    ASSERT_TRUE(stream.start());
+
+    // Act
+    read_all(stream);
+
+    // Assert
+    ASSERT_TRUE(stream.has_error());
+
+    remove(compressed_file);
+}
@@ -0,0 +1,150 @@
+#include <hawktracer/parser/stream_decoder.hpp>
+#include <hawktracer/compression.h>
+
+#include <gtest/gtest.h>
+
+using namespace HawkTracer::parser;
+
+static std::vector<char> make_compressed_stream(const std::vector<char>& data, size_t frame_size)
+{
+    std::vector<char> stream(HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC + HT_COMPRESSION_STREAM_MAGIC_SIZE);
+    std::vector<uint32_t> work_memory(HT_COMPRESSION_WORK_MEMORY_SIZE / sizeof(uint32_t));
+
+    for (size_t pos = 0; pos < data.size(); pos += frame_size)
+    {
+        size_t raw_size = std::min(frame_size, data.size() - pos);
+        std::vector<HT_Byte> frame(HT_COMPRESSION_FRAME_HEADER_SIZE + ht_compression_get_max_compressed_size(raw_size));
+        size_t compressed_size = ht_compression_compress((const HT_Byte*)data.data() + pos, raw_size,
+                                                         frame.data() + HT_COMPRESSION_FRAME_HEADER_SIZE,
+                                                         frame.size() - HT_COMPRESSION_FRAME_HEADER_SIZE,
+                                                         work_memory.data());
+        ht_compression_write_frame_header(frame.data(), (uint32_t)raw_size, (uint32_t)compressed_size);
+        stream.insert(stream.end(), frame.begin(), frame.begin() + HT_COMPRESSION_FRAME_HEADER_SIZE + compressed_size);
+    }
+
+    return stream;
+}
+
+static std::vector<char> make_data(size_t size)
+{
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (char)(i % 17 + (i / 100));
+    }
+    return data;
+}
+
+TEST(TestStreamDecoder, UncompressedStreamShouldBePassedThrough)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> data = {1, 0, 0, 0, 5, 6, 7};
+    std::vector<char> out;
+
+    // Act
+    ASSERT_TRUE(decoder.decode(data.data(), 2, out));
+    ASSERT_TRUE(decoder.decode(data.data() + 2, data.size() - 2, out));
+    ASSERT_TRUE(decoder.finish(out));
+
+    // Assert
+    ASSERT_FALSE(decoder.is_compressed());
+    ASSERT_EQ(data, out);
+}
+
+TEST(TestStreamDecoder, StreamShorterThanMarkerShouldBePassedThrough)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> out;
+
+    // Act
+    ASSERT_TRUE(decoder.decode("HT", 2, out));
+    ASSERT_TRUE(out.empty());
+    ASSERT_TRUE(decoder.finish(out));
+
+    // Assert
+    ASSERT_EQ(std::vector<char>({'H', 'T'}), out);
+}
+
+TEST(TestStreamDecoder, CompressedStreamShouldBeDecodedIfProvidedByteByByte)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> data = make_data(5000);
+    std::vector<char> stream = make_compressed_stream(data, 1024);
+    std::vector<char> out;
+
+    // Act
+    for (char c : stream)
+    {
+        ASSERT_TRUE(decoder.decode(&c, 1, out));
+    }
+    ASSERT_TRUE(decoder.finish(out));
+
+    // Assert
+    ASSERT_TRUE(decoder.is_compressed());
+    ASSERT_EQ(data, out);
+}
+
+TEST(TestStreamDecoder, StoredFramesShouldBeDecoded)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> stream(HT_COMPRESSION_STREAM_MAGIC, HT_COMPRESSION_STREAM_MAGIC + HT_COMPRESSION_STREAM_MAGIC_SIZE);
+    HT_Byte header[HT_COMPRESSION_FRAME_HEADER_SIZE];
+    ht_compression_write_frame_header(header, 3, 0);
+    stream.insert(stream.end(), header, header + sizeof(header));
+    stream.insert(stream.end(), {'a', 'b', 'c'});
+    std::vector<char> out;
+
+    // Act
+    ASSERT_TRUE(decoder.decode(stream.data(), stream.size(), out));
+    ASSERT_TRUE(decoder.finish(out));
+
+    // Assert
+    ASSERT_EQ(std::vector<char>({'a', 'b', 'c'}), out);
+}
+
+TEST(TestStreamDecoder, TruncatedStreamShouldBeReportedOnFinish)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> stream = make_compressed_stream(make_data(1000), 1000);
+    std::vector<char> out;
+
+    // Act
+    ASSERT_TRUE(decoder.decode(stream.data(), stream.size() - 1, out));
+
+    // Assert
+    ASSERT_FALSE(decoder.finish(out));
+    ASSERT_TRUE(out.empty());
+}
+
+TEST(TestStreamDecoder, MalformedFrameShouldFailDecoding)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> stream = make_compressed_stream(make_data(1000), 1000);
+    // announce bigger decompressed size than the block really has
+    ht_compression_write_frame_header((HT_Byte*)stream.data() + HT_COMPRESSION_STREAM_MAGIC_SIZE, 1001,
+                                      (uint32_t)(stream.size() - HT_COMPRESSION_STREAM_MAGIC_SIZE - HT_COMPRESSION_FRAME_HEADER_SIZE));
+    std::vector<char> out;
+
+    // Act & Assert
+    ASSERT_FALSE(decoder.decode(stream.data(), stream.size(), out));
+}
+
+TEST(TestStreamDecoder, FrameBiggerThanMaxFrameSizeShouldFailDecoding)
+{
+    // Arrange
+    StreamDecoder decoder;
+    std::vector<char> stream = make_compressed_stream(make_data(1000), 1000);
+    ht_compression_write_frame_header((HT_Byte*)stream.data() + HT_COMPRESSION_STREAM_MAGIC_SIZE, 0xFFFFFFFF,
+                                      (uint32_t)(stream.size() - HT_COMPRESSION_STREAM_MAGIC_SIZE - HT_COMPRESSION_FRAME_HEADER_SIZE));
+    std::vector<char> out;
+
+    // Act & Assert
+    ASSERT_FALSE(decoder.decode(stream.data(), stream.size(), out));
+    ASSERT_TRUE(out.empty());
+}